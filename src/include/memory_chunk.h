@@ -233,6 +233,17 @@ public:
         return m_allocated - m_data_begin;
     }
   
+    /**
+     * MemoryChunk::get_check_sum:
+     *
+     * Get the check sum of the content in the MemoryChunk,
+     * the same check sum is saved in the file header.
+     *
+     */
+    guint32 get_check_sum(){
+        return get_check_sum(m_data_begin, size());
+    }
+
     /**
      * MemoryChunk::set_chunk:
      * @begin: the begin of the data
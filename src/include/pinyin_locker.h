@@ -0,0 +1,104 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PINYIN_LOCKER_H
+#define PINYIN_LOCKER_H
+
+#include <glib.h>
+
+namespace pinyin{
+
+/**
+ * MutexLocker:
+ *
+ * Lock the mutex until the end of the scope.
+ *
+ */
+class MutexLocker{
+private:
+    GMutex * m_mutex;
+
+    /* Disallow copy. */
+    MutexLocker(const MutexLocker &);
+    MutexLocker & operator=(const MutexLocker &);
+
+public:
+    MutexLocker(GMutex * mutex) : m_mutex(mutex) {
+        g_mutex_lock(m_mutex);
+    }
+
+    ~MutexLocker() {
+        g_mutex_unlock(m_mutex);
+    }
+};
+
+/**
+ * ReaderLocker:
+ *
+ * Lock the reader-writer lock for reading until the end of the scope,
+ * the readers run concurrently.
+ *
+ */
+class ReaderLocker{
+private:
+    GRWLock * m_lock;
+
+    /* Disallow copy. */
+    ReaderLocker(const ReaderLocker &);
+    ReaderLocker & operator=(const ReaderLocker &);
+
+public:
+    ReaderLocker(GRWLock * lock) : m_lock(lock) {
+        g_rw_lock_reader_lock(m_lock);
+    }
+
+    ~ReaderLocker() {
+        g_rw_lock_reader_unlock(m_lock);
+    }
+};
+
+/**
+ * WriterLocker:
+ *
+ * Lock the reader-writer lock for writing until the end of the scope,
+ * the writer excludes all the readers and other writers.
+ *
+ */
+class WriterLocker{
+private:
+    GRWLock * m_lock;
+
+    /* Disallow copy. */
+    WriterLocker(const WriterLocker &);
+    WriterLocker & operator=(const WriterLocker &);
+
+public:
+    WriterLocker(GRWLock * lock) : m_lock(lock) {
+        g_rw_lock_writer_lock(m_lock);
+    }
+
+    ~WriterLocker() {
+        g_rw_lock_writer_unlock(m_lock);
+    }
+};
+
+};
+
+#endif
@@ -28,6 +28,7 @@
 
 #include "novel_types.h"
 #include <limits.h>
+#include <assert.h>
 
 namespace pinyin{
 
@@ -70,8 +71,128 @@ class FacadePhraseIndex;
  *     See also comments on lookup_value_t.
  */
 
+/**
+ * LookupStepTable:
+ *
+ * The open addressing hash table from the lookup key to the index in
+ * the lookup step content. Most steps only have a few nodes, so the
+ * small tables use the inline slots without allocation.
+ *
+ */
+class LookupStepTable{
+private:
+    struct slot_t{
+        lookup_key_t m_key;
+        /* empty_value when the slot is free. */
+        guint32 m_value;
+    };
+
+    static const guint32 empty_value = G_MAXUINT32;
+    static const guint32 inline_slots = 16;
+
+    slot_t m_inline_slots[inline_slots];
+    /* m_nslot is always a power of two. */
+    slot_t * m_slots;
+    guint32 m_nslot;
+    guint32 m_size;
+
+    /* Disallow copy. */
+    LookupStepTable(const LookupStepTable &);
+    LookupStepTable & operator=(const LookupStepTable &);
+
+    static guint32 hash(lookup_key_t key) {
+        guint32 hash = key * 2654435761U;
+        return hash ^ (hash >> 16);
+    }
+
+    static void clear_slots(slot_t * slots, guint32 nslot) {
+        for (guint32 i = 0; i < nslot; ++i)
+            slots[i].m_value = empty_value;
+    }
+
+    /* return the slot of the key, or the free slot to insert it. */
+    slot_t * probe(lookup_key_t key) const {
+        const guint32 mask = m_nslot - 1;
+        guint32 pos = hash(key) & mask;
+
+        while (true) {
+            slot_t * slot = m_slots + pos;
+            if (empty_value == slot->m_value || key == slot->m_key)
+                return slot;
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    void grow() {
+        slot_t * old_slots = m_slots;
+        const guint32 old_nslot = m_nslot;
+
+        m_nslot = old_nslot * 2;
+        m_slots = g_new(slot_t, m_nslot);
+        clear_slots(m_slots, m_nslot);
+
+        for (guint32 i = 0; i < old_nslot; ++i) {
+            if (empty_value != old_slots[i].m_value)
+                *probe(old_slots[i].m_key) = old_slots[i];
+        }
+
+        if (old_slots != m_inline_slots)
+            g_free(old_slots);
+    }
+
+public:
+    LookupStepTable() {
+        m_slots = m_inline_slots;
+        m_nslot = inline_slots;
+        m_size = 0;
+        clear_slots(m_slots, m_nslot);
+    }
+
+    ~LookupStepTable() {
+        if (m_slots != m_inline_slots)
+            g_free(m_slots);
+        m_slots = NULL;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    /* keep the allocated slots for the next search. */
+    void clear() {
+        if (m_size)
+            clear_slots(m_slots, m_nslot);
+        m_size = 0;
+    }
+
+    bool lookup(lookup_key_t key, /* out */ guint32 & value) const {
+        const slot_t * slot = probe(key);
+        if (empty_value == slot->m_value)
+            return false;
+
+        value = slot->m_value;
+        return true;
+    }
+
+    /* insert or replace the value of the key. */
+    void insert(lookup_key_t key, guint32 value) {
+        assert(empty_value != value);
+
+        /* keep the load factor below 3/4. */
+        if ((m_size + 1) * 4 > m_nslot * 3)
+            grow();
+
+        slot_t * slot = probe(key);
+        if (empty_value == slot->m_value)
+            ++m_size;
+
+        slot->m_key = key;
+        slot->m_value = value;
+    }
+};
+
 /* Key: lookup_key_t, Value: int m, index to m_steps_content[i][m] */
-typedef GHashTable * LookupStepIndex;
+typedef LookupStepTable * LookupStepIndex;
 /* Array of lookup_value_t or trellis_node */
 typedef GArray * LookupStepContent;
 
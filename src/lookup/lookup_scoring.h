@@ -0,0 +1,374 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOOKUP_SCORING_H
+#define LOOKUP_SCORING_H
+
+#include <math.h>
+#include <glib.h>
+#include "novel_types.h"
+
+namespace pinyin{
+
+/**
+ * fast_log:
+ * @x: the positive normal float.
+ * @returns: the natural logarithm of @x.
+ *
+ * Compute the natural logarithm without the libm call,
+ * the relative error is below 1e-6 for the possibilities in (0, 1).
+ *
+ */
+static inline gfloat fast_log(gfloat x) {
+    union { gfloat m_float; guint32 m_bits; } value;
+    value.m_float = x;
+
+    gint32 exponent = (gint32) ((value.m_bits >> 23) & 0xff) - 127;
+    /* the mantissa in [1, 2). */
+    value.m_bits = (value.m_bits & 0x007fffff) | 0x3f800000;
+
+    /* move the mantissa into [sqrt(0.5), sqrt(2)), without the branch. */
+    const gint32 large = value.m_float > (gfloat) M_SQRT2;
+    exponent += large;
+    const gfloat mantissa = value.m_float * (1.f - 0.5f * large);
+
+    /* log(m) = 2 * atanh(s), where s = (m - 1) / (m + 1). */
+    const gfloat s = (mantissa - 1.f) / (mantissa + 1.f);
+    const gfloat s2 = s * s;
+    const gfloat series = 1.f + s2 * (1.f / 3 + s2 * (1.f / 5 +
+                                      s2 * (1.f / 7 + s2 * (1.f / 9))));
+
+    return exponent * (gfloat) M_LN2 + 2.f * s * series;
+}
+
+class LookupScorer;
+
+/**
+ * CandidateBatch:
+ *
+ * The candidates of the trellis expansion in the structure of arrays,
+ * which are scored together by the LookupScorer.
+ *
+ */
+class CandidateBatch{
+    friend class LookupScorer;
+private:
+    /* Array of phrase_token_t */
+    GArray * m_tokens;
+    /* Array of guint8 */
+    GArray * m_lengths;
+    /* Array of gfloat */
+    GArray * m_bigram_poss;
+    /* Array of gdouble */
+    GArray * m_unigram_poss;
+    /* Array of gfloat, the log possibility of the pronunciation. */
+    GArray * m_pinyin_log_poss;
+    /* Array of gfloat, filled by the LookupScorer. */
+    GArray * m_scores;
+
+public:
+    /**
+     * CandidateBatch::CandidateBatch:
+     *
+     * The constructor of the CandidateBatch.
+     *
+     */
+    CandidateBatch() {
+        m_tokens = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+        m_lengths = g_array_new(FALSE, FALSE, sizeof(guint8));
+        m_bigram_poss = g_array_new(FALSE, FALSE, sizeof(gfloat));
+        m_unigram_poss = g_array_new(FALSE, FALSE, sizeof(gdouble));
+        m_pinyin_log_poss = g_array_new(FALSE, FALSE, sizeof(gfloat));
+        m_scores = g_array_new(FALSE, FALSE, sizeof(gfloat));
+    }
+
+    /**
+     * CandidateBatch::~CandidateBatch:
+     *
+     * The destructor of the CandidateBatch.
+     *
+     */
+    ~CandidateBatch() {
+        g_array_free(m_tokens, TRUE);
+        g_array_free(m_lengths, TRUE);
+        g_array_free(m_bigram_poss, TRUE);
+        g_array_free(m_unigram_poss, TRUE);
+        g_array_free(m_pinyin_log_poss, TRUE);
+        g_array_free(m_scores, TRUE);
+    }
+
+    /**
+     * CandidateBatch::size:
+     * @returns: the number of the candidates.
+     *
+     * Get the number of the candidates.
+     *
+     */
+    size_t size() const {
+        return m_tokens->len;
+    }
+
+    /**
+     * CandidateBatch::resize:
+     * @size: the number of the candidates.
+     *
+     * Resize all the arrays at once, and keep the allocated memory
+     * when shrinking.
+     *
+     */
+    void resize(size_t size) {
+        g_array_set_size(m_tokens, size);
+        g_array_set_size(m_lengths, size);
+        g_array_set_size(m_bigram_poss, size);
+        g_array_set_size(m_unigram_poss, size);
+        g_array_set_size(m_pinyin_log_poss, size);
+        g_array_set_size(m_scores, size);
+    }
+
+    /**
+     * CandidateBatch::set:
+     * @index: the index of the candidate.
+     * @token: the phrase token.
+     * @length: the phrase length.
+     * @bigram_poss: the bi-gram possibility of the phrase.
+     * @unigram_poss: the uni-gram possibility of the phrase.
+     * @pinyin_log_poss: the log pronunciation possibility of the phrase.
+     *
+     * Set the candidate, the index must be less than the size.
+     *
+     */
+    void set(size_t index, phrase_token_t token, guint8 length,
+             gfloat bigram_poss, gdouble unigram_poss,
+             gfloat pinyin_log_poss) {
+        g_array_index(m_tokens, phrase_token_t, index) = token;
+        g_array_index(m_lengths, guint8, index) = length;
+        g_array_index(m_bigram_poss, gfloat, index) = bigram_poss;
+        g_array_index(m_unigram_poss, gdouble, index) = unigram_poss;
+        g_array_index(m_pinyin_log_poss, gfloat, index) = pinyin_log_poss;
+    }
+
+    phrase_token_t get_token(size_t index) const {
+        return g_array_index(m_tokens, phrase_token_t, index);
+    }
+
+    guint8 get_length(size_t index) const {
+        return g_array_index(m_lengths, guint8, index);
+    }
+
+    gfloat get_bigram_possibility(size_t index) const {
+        return g_array_index(m_bigram_poss, gfloat, index);
+    }
+
+    gdouble get_unigram_possibility(size_t index) const {
+        return g_array_index(m_unigram_poss, gdouble, index);
+    }
+
+    gfloat get_pinyin_log_possibility(size_t index) const {
+        return g_array_index(m_pinyin_log_poss, gfloat, index);
+    }
+
+    gfloat get_score(size_t index) const {
+        return g_array_index(m_scores, gfloat, index);
+    }
+};
+
+/**
+ * LookupScorer:
+ *
+ * Compute the log possibility of the edges in the trellis.
+ *
+ * The fast scoring folds the uni-gram lambda and the reciprocal of
+ * the total frequency into one weight per search, and uses fast_log.
+ * The exact scoring keeps the original formulas for the evaluation.
+ *
+ */
+class LookupScorer{
+private:
+    const gfloat m_bigram_lambda;
+    const gfloat m_unigram_lambda;
+
+    bool m_exact;
+
+    guint32 m_total_freq;
+    /* the reciprocal of the total frequency. */
+    gdouble m_total_freq_reciprocal;
+
+public:
+    /**
+     * LookupScorer::LookupScorer:
+     * @lambda: the bi-gram lambda.
+     *
+     * The constructor of the LookupScorer.
+     *
+     */
+    LookupScorer(gfloat lambda) :
+        m_bigram_lambda(lambda), m_unigram_lambda(1. - lambda) {
+        m_exact = false;
+        m_total_freq = 0;
+        m_total_freq_reciprocal = 0.;
+    }
+
+    /**
+     * LookupScorer::set_exact_scoring:
+     * @exact: whether to use the exact scoring.
+     *
+     * Use the exact scoring, mainly to evaluate the fast scoring.
+     *
+     */
+    void set_exact_scoring(bool exact) {
+        m_exact = exact;
+    }
+
+    /**
+     * LookupScorer::get_exact_scoring:
+     * @returns: whether the exact scoring is used.
+     *
+     * Get whether the exact scoring is used.
+     *
+     */
+    bool get_exact_scoring() const {
+        return m_exact;
+    }
+
+    /**
+     * LookupScorer::prepare:
+     * @total_freq: the total uni-gram frequency of the phrase index.
+     *
+     * Compute the weights before each search.
+     *
+     */
+    void prepare(guint32 total_freq) {
+        m_total_freq = total_freq;
+        m_total_freq_reciprocal = total_freq ? 1. / total_freq : 0.;
+    }
+
+    /**
+     * LookupScorer::get_unigram_possibility:
+     * @freq: the uni-gram frequency of the phrase.
+     * @returns: the uni-gram possibility of the phrase.
+     *
+     * Get the uni-gram possibility of the phrase.
+     *
+     */
+    gdouble get_unigram_possibility(guint32 freq) const {
+        if (m_exact)
+            return freq / (gdouble) m_total_freq;
+
+        return freq * m_total_freq_reciprocal;
+    }
+
+    /**
+     * LookupScorer::unigram_score:
+     * @unigram_poss: the uni-gram possibility of the phrase.
+     * @pinyin_log_poss: the log pronunciation possibility of the phrase.
+     * @returns: the log possibility of the uni-gram edge.
+     *
+     * Compute the log possibility of the uni-gram edge.
+     *
+     */
+    gfloat unigram_score(gdouble unigram_poss, gfloat pinyin_log_poss) const {
+        if (m_exact)
+            return log(unigram_poss * m_unigram_lambda) + pinyin_log_poss;
+
+        return fast_log(unigram_poss * m_unigram_lambda) + pinyin_log_poss;
+    }
+
+    /**
+     * LookupScorer::bigram_score:
+     * @bigram_poss: the bi-gram possibility of the phrase.
+     * @unigram_poss: the uni-gram possibility of the phrase.
+     * @pinyin_log_poss: the log pronunciation possibility of the phrase.
+     * @returns: the log possibility of the bi-gram edge.
+     *
+     * Compute the log possibility of the interpolated bi-gram edge.
+     *
+     */
+    gfloat bigram_score(gfloat bigram_poss, gdouble unigram_poss,
+                        gfloat pinyin_log_poss) const {
+        if (m_exact)
+            return log(m_bigram_lambda * bigram_poss +
+                       m_unigram_lambda * unigram_poss) + pinyin_log_poss;
+
+        return fast_log(m_bigram_lambda * bigram_poss +
+                        m_unigram_lambda * unigram_poss) + pinyin_log_poss;
+    }
+
+    /**
+     * LookupScorer::score_unigrams:
+     * @batch: the candidates to be scored.
+     *
+     * Compute the log possibilities of the uni-gram edges,
+     * the fast loop has no branch and is vectorized by GCC at -O3,
+     * but not by the very cheap cost model of -O2.
+     *
+     */
+    void score_unigrams(CandidateBatch & batch) const {
+        const size_t size = batch.size();
+
+        const gdouble * unigram = (const gdouble *) batch.m_unigram_poss->data;
+        const gfloat * pinyin = (const gfloat *) batch.m_pinyin_log_poss->data;
+        gfloat * scores = (gfloat *) batch.m_scores->data;
+
+        if (m_exact) {
+            for (size_t i = 0; i < size; ++i)
+                scores[i] = log(unigram[i] * m_unigram_lambda) + pinyin[i];
+            return;
+        }
+
+        const gdouble unigram_lambda = m_unigram_lambda;
+        for (size_t i = 0; i < size; ++i)
+            scores[i] = fast_log(unigram[i] * unigram_lambda) + pinyin[i];
+    }
+
+    /**
+     * LookupScorer::score_bigrams:
+     * @batch: the candidates to be scored.
+     *
+     * Compute the log possibilities of the interpolated bi-gram edges,
+     * the fast loop has no branch and is vectorized by GCC at -O3,
+     * but not by the very cheap cost model of -O2.
+     *
+     */
+    void score_bigrams(CandidateBatch & batch) const {
+        const size_t size = batch.size();
+
+        const gfloat * bigram = (const gfloat *) batch.m_bigram_poss->data;
+        const gdouble * unigram = (const gdouble *) batch.m_unigram_poss->data;
+        const gfloat * pinyin = (const gfloat *) batch.m_pinyin_log_poss->data;
+        gfloat * scores = (gfloat *) batch.m_scores->data;
+
+        if (m_exact) {
+            for (size_t i = 0; i < size; ++i)
+                scores[i] = log(m_bigram_lambda * bigram[i] +
+                                m_unigram_lambda * unigram[i]) + pinyin[i];
+            return;
+        }
+
+        const gfloat bigram_lambda = m_bigram_lambda;
+        const gdouble unigram_lambda = m_unigram_lambda;
+        for (size_t i = 0; i < size; ++i)
+            scores[i] = fast_log(bigram_lambda * bigram[i] +
+                                 unigram_lambda * unigram[i]) + pinyin[i];
+    }
+};
+
+};
+
+#endif
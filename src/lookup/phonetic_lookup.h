@@ -29,12 +29,16 @@
 #include "phonetic_key_matrix.h"
 #include "ngram.h"
 #include "lookup.h"
+#include "single_gram_cache.h"
+#include "lookup_scoring.h"
 
 namespace pinyin{
 
 
 /* internal definition */
 static const size_t nbeam = 32;
+/* the number of the cached merged single grams. */
+static const guint32 bigram_cache_size = 512;
 
 #define LONG_SENTENCE_PENALTY log(1.2f)
 
@@ -62,32 +66,28 @@ struct trellis_value_t {
     }
 };
 
+/* pack the sentence length and the possibility into one integer,
+   the shorter sentence is greater, then the better possibility. */
+static inline guint64 trellis_value_key(const trellis_value_t * item) {
+    union { gfloat m_float; guint32 m_bits; } poss;
+    poss.m_float = item->m_poss;
+
+    /* flip the bits to compare the floats as the unsigned integers. */
+    const guint32 mask = (guint32) ((gint32) poss.m_bits >> 31) | 0x80000000U;
+    const guint32 length = ~(guint32) item->m_sentence_length;
+    return ((guint64) length << 32) | (poss.m_bits ^ mask);
+}
+
 template <gint32 nstore>
 static bool inline trellis_value_less_than(const trellis_value_t * item_lhs,
                                            const trellis_value_t * item_rhs) {
-#if 1
-    if (nstore > 1) {
-        /* allow longer sentence */
-        if (item_lhs->m_sentence_length + 1 == item_rhs->m_sentence_length &&
-            item_lhs->m_poss + LONG_SENTENCE_PENALTY < item_rhs->m_poss)
-            return true;
+    /* allow longer sentence */
+    if (nstore > 1 &&
+        item_lhs->m_sentence_length + 1 == item_rhs->m_sentence_length)
+        return item_lhs->m_poss + LONG_SENTENCE_PENALTY < item_rhs->m_poss;
 
-        if (item_lhs->m_sentence_length == item_rhs->m_sentence_length + 1 &&
-            item_lhs->m_poss < item_rhs->m_poss + LONG_SENTENCE_PENALTY)
-            return true;
-    }
-#endif
-
-    /* the same length but better possibility */
-    if (item_lhs->m_sentence_length == item_rhs->m_sentence_length &&
-        item_lhs->m_poss < item_rhs->m_poss)
-        return true;
-
-    /* shorter sentence */
-    if (item_lhs->m_sentence_length > item_rhs->m_sentence_length)
-        return true;
-
-    return false;
+    /* the same length but better possibility, or shorter sentence. */
+    return trellis_value_key(item_lhs) < trellis_value_key(item_rhs);
 }
 
 #if 0
@@ -110,13 +110,36 @@ struct matrix_value_t {
 };
 #endif
 
-#if 0
-/* for debug purpose */
 #include "phonetic_lookup_linear.h"
-#else
-/* for optimization */
 #include "phonetic_lookup_heap.h"
-#endif
+
+/* the largest nstore which scans the trellis node linearly,
+   the heap node of the 28-byte trellis values is measured faster
+   from nstore 2 up to 64. */
+static const gint32 trellis_linear_max_nstore = 1;
+
+/**
+ * trellis_node_policy:
+ *
+ * Select the storage of the trellis node by nstore,
+ * the single element for nstore 1, the linear scan for the small nodes,
+ * the heap for the large nodes.
+ *
+ */
+template <gint32 nstore, bool linear = (nstore <= trellis_linear_max_nstore)>
+struct trellis_node_policy {
+    typedef trellis_linear_node<nstore> node_t;
+};
+
+template <gint32 nstore>
+struct trellis_node_policy<nstore, false> {
+    typedef trellis_heap_node<nstore> node_t;
+};
+
+template <>
+struct trellis_node_policy<1, true> {
+    typedef trellis_single_node node_t;
+};
 
 struct trellis_constraint_t {
     /* the constraint type */
@@ -138,11 +161,13 @@ struct trellis_constraint_t {
 };
 
 
-/* use maximum heap to get the topest results. */
+/* use maximum heap to get the topest results,
+   skip the results worse than the best possibility minus the margin. */
 template<gint32 nstore>
 bool get_top_results(size_t num,
                      /* out */ GPtrArray * topresults,
-                     /* in */ GPtrArray * candidates) {
+                     /* in */ GPtrArray * candidates,
+                     gfloat margin = FLT_MAX) {
     g_ptr_array_set_size(topresults, 0);
 
     if (0 == candidates->len)
@@ -153,11 +178,20 @@ bool get_top_results(size_t num,
     trellis_value_t ** end =
         (trellis_value_t **) &g_ptr_array_index(candidates, candidates->len);
 
+    gfloat threshold = -FLT_MAX;
+    if (margin < FLT_MAX) {
+        gfloat best = -FLT_MAX;
+        for (trellis_value_t ** iter = begin; iter != end; ++iter)
+            best = std_lite::max(best, (*iter)->m_poss);
+        threshold = best - margin;
+    }
+
     std_lite::make_heap(begin, end, trellis_value_less_than<nstore>);
 
     while (end != begin) {
         trellis_value_t * one = *begin;
-        g_ptr_array_add(topresults, one);
+        if (one->m_poss >= threshold)
+            g_ptr_array_add(topresults, one);
 
         std_lite::pop_heap(begin, end, trellis_value_less_than<nstore>);
         --end;
@@ -177,67 +211,323 @@ static G_GNUC_UNUSED gint trellis_value_compare(const trellis_value_t ** lhs,
     return -((*lhs)->m_poss - (*rhs)->m_poss);
 }
 
-template <gint32 nstore, gint32 nbest>
+/* Note:
+ *   The trellis nodes of all steps are stored in one node arena,
+ *   and indexed by one open addressing table keyed by (step, token).
+ *   Both are recycled across the get_nbest_match calls,
+ *   so the trellis is allocation-free in steady state.
+ *
+ *   The node arena grows by blocks, as the trellis_value_t pointers
+ *   returned by get_candidates must stay valid when later steps grow.
+ */
+static const gint32 trellis_block_size = 256;
+/* the initial index slots of each step. */
+static const guint32 trellis_slots_per_step = 32;
+
+struct trellis_step_t {
+    /* the first and last node of this step in the node arena. */
+    gint32 m_first;
+    gint32 m_last;
+    gint32 m_length;
+};
+
+struct trellis_slot_t {
+    /* only valid when m_generation equals to the trellis generation. */
+    guint32 m_generation;
+    gint32 m_step;
+    lookup_key_t m_token;
+    /* the index in the node arena. */
+    gint32 m_node;
+};
+
+template <typename node_t>
+struct trellis_arena_item_t {
+    node_t m_node;
+    /* the token of this node, used to remove the node from the index. */
+    lookup_key_t m_token;
+    /* the next node in the same step, -1 for the last node.
+       for the freed nodes, the next node in the free list. */
+    gint32 m_next;
+};
+
+template <gint32 nstore, gint32 nbest,
+          typename node_t = typename trellis_node_policy<nstore>::node_t>
 class ForwardPhoneticTrellis {
 private:
-    /* Array of LookupStepIndex */
-    GPtrArray * m_steps_index;
-    /* Array of LookupStepContent */
-    GPtrArray * m_steps_content;
+    typedef trellis_arena_item_t<node_t> arena_item_t;
+
+    /* Array of trellis_step_t */
+    GArray * m_steps;
+    /* Array of arena_item_t blocks, each contains trellis_block_size items */
+    GPtrArray * m_blocks;
+    /* the used nodes in the node arena. */
+    gint32 m_nnode;
+    /* the freed nodes by rewind, re-used before the unused nodes. */
+    gint32 m_free;
+    gint32 m_nfree;
+
+    /* open addressing index, m_nslot is always a power of two. */
+    trellis_slot_t * m_slots;
+    guint32 m_nslot;
+    guint32 m_nused;
+    guint32 m_generation;
+
+    /* the scratch candidates of get_step_tails, kept between the calls. */
+    GPtrArray * m_tail_candidates;
+
+private:
+    arena_item_t * get_item(gint32 node) const {
+        arena_item_t * block = (arena_item_t *)
+            g_ptr_array_index(m_blocks, node / trellis_block_size);
+        return block + node % trellis_block_size;
+    }
+
+    static guint32 hash_slot(gint32 step, lookup_key_t token) {
+        guint32 hash = token * 2654435761U;
+        hash ^= (guint32) step * 40503U + (hash >> 16);
+        return hash;
+    }
+
+    /* return the slot of (step, token), or the free slot to insert it. */
+    trellis_slot_t * probe_slot(gint32 step, lookup_key_t token) const {
+        const guint32 mask = m_nslot - 1;
+        guint32 pos = hash_slot(step, token) & mask;
+
+        while (true) {
+            trellis_slot_t * slot = m_slots + pos;
+
+            if (slot->m_generation != m_generation)
+                return slot;
+
+            if (slot->m_step == step && slot->m_token == token)
+                return slot;
+
+            pos = (pos + 1) & mask;
+        }
+
+        abort();
+    }
+
+    /* only grow the index, the slots are kept for later calls. */
+    bool reserve_slots(guint32 nslot) {
+        if (nslot <= m_nslot)
+            return false;
+
+        trellis_slot_t * old_slots = m_slots;
+        const guint32 old_nslot = m_nslot;
+
+        /* zero generation is never used by the trellis. */
+        m_slots = g_new0(trellis_slot_t, nslot);
+        m_nslot = nslot;
+
+        for (guint32 i = 0; i < old_nslot; ++i) {
+            trellis_slot_t * old_slot = old_slots + i;
+            if (old_slot->m_generation != m_generation)
+                continue;
+
+            *probe_slot(old_slot->m_step, old_slot->m_token) = *old_slot;
+        }
+
+        g_free(old_slots);
+        return true;
+    }
+
+    /* remove the slot, and shift back the following slots
+       to keep the probe sequences un-broken. */
+    void erase_slot(trellis_slot_t * slot) {
+        const guint32 mask = m_nslot - 1;
+        guint32 hole = slot - m_slots;
+        guint32 pos = hole;
+
+        while (true) {
+            pos = (pos + 1) & mask;
+            trellis_slot_t * next = m_slots + pos;
+
+            if (next->m_generation != m_generation)
+                break;
+
+            /* skip the slot whose home is between hole and pos. */
+            guint32 home = hash_slot(next->m_step, next->m_token) & mask;
+            if (hole <= pos ? (hole < home && home <= pos) :
+                (hole < home || home <= pos))
+                continue;
+
+            m_slots[hole] = *next;
+            hole = pos;
+        }
+
+        m_slots[hole].m_generation = 0;
+        --m_nused;
+    }
+
+    gint32 new_node(gint32 index, lookup_key_t token) {
+        gint32 node = m_free;
+
+        if (-1 != node) {
+            m_free = get_item(node)->m_next;
+            --m_nfree;
+        } else {
+            node = m_nnode;
+
+            /* only allocate when the node arena is exhausted. */
+            if ((guint) (node / trellis_block_size) >= m_blocks->len)
+                g_ptr_array_add(m_blocks,
+                                g_new(arena_item_t, trellis_block_size));
+
+            ++m_nnode;
+        }
+
+        arena_item_t * item = get_item(node);
+        item->m_node.clear();
+        item->m_token = token;
+        item->m_next = -1;
+
+        trellis_step_t * step = &g_array_index(m_steps, trellis_step_t, index);
+        if (-1 == step->m_last)
+            step->m_first = node;
+        else
+            get_item(step->m_last)->m_next = node;
+        step->m_last = node;
+        ++step->m_length;
+
+        return node;
+    }
+
+    node_t * find_node(gint32 index, lookup_key_t token) const {
+        trellis_slot_t * slot = probe_slot(index, token);
+        if (slot->m_generation != m_generation)
+            return NULL;
+
+        return &get_item(slot->m_node)->m_node;
+    }
+
+    /* insert the node if not exists. */
+    node_t * lookup_node(gint32 index, lookup_key_t token) {
+        /* keep the load factor below one half. */
+        if ((m_nused + 1) * 2 > m_nslot)
+            reserve_slots(m_nslot * 2);
+
+        trellis_slot_t * slot = probe_slot(index, token);
+        if (slot->m_generation != m_generation) {
+            slot->m_generation = m_generation;
+            slot->m_step = index;
+            slot->m_token = token;
+            slot->m_node = new_node(index, token);
+            ++m_nused;
+        }
+
+        return &get_item(slot->m_node)->m_node;
+    }
+
+    /* initialize the steps from begin to nstep. */
+    bool init_steps(gint32 begin, gint32 nstep) {
+        g_array_set_size(m_steps, nstep);
+
+        for (int i = begin; i < nstep; ++i) {
+            trellis_step_t * step = &g_array_index(m_steps, trellis_step_t, i);
+            step->m_first = -1;
+            step->m_last = -1;
+            step->m_length = 0;
+        }
+
+        /* size the index from the matrix length. */
+        guint32 nslot = 64;
+        while (nslot < nstep * trellis_slots_per_step)
+            nslot *= 2;
+        reserve_slots(nslot);
+
+        return true;
+    }
 
 public:
     ForwardPhoneticTrellis() {
-        m_steps_index = g_ptr_array_new();
-        m_steps_content = g_ptr_array_new();
+        m_steps = g_array_new(FALSE, FALSE, sizeof(trellis_step_t));
+        m_blocks = g_ptr_array_new();
+        m_nnode = 0;
+        m_free = -1;
+        m_nfree = 0;
+
+        m_slots = NULL;
+        m_nslot = 0;
+        m_nused = 0;
+        m_generation = 1;
+
+        m_tail_candidates = g_ptr_array_new();
     }
 
     ~ForwardPhoneticTrellis() {
         clear();
-        g_ptr_array_free(m_steps_index, TRUE);
-        m_steps_index = NULL;
-        g_ptr_array_free(m_steps_content, TRUE);
-        m_steps_content = NULL;
+
+        g_array_free(m_steps, TRUE);
+        m_steps = NULL;
+
+        for (size_t i = 0; i < m_blocks->len; ++i)
+            g_free(g_ptr_array_index(m_blocks, i));
+        g_ptr_array_free(m_blocks, TRUE);
+        m_blocks = NULL;
+
+        g_free(m_slots);
+        m_slots = NULL;
+        m_nslot = 0;
+
+        g_ptr_array_free(m_tail_candidates, TRUE);
+        m_tail_candidates = NULL;
     }
 
 public:
     size_t size() const {
-        assert(m_steps_index->len == m_steps_content->len);
-        return m_steps_index->len;
+        return m_steps->len;
     }
 
     bool clear() {
-        /* clear m_steps_index */
-        for ( size_t i = 0; i < m_steps_index->len; ++i){
-            LookupStepIndex step_index = (LookupStepIndex) g_ptr_array_index(m_steps_index, i);
-            g_hash_table_destroy(step_index);
-            g_ptr_array_index(m_steps_index, i) = NULL;
+        /* recycle the node arena. */
+        m_nnode = 0;
+        m_free = -1;
+        m_nfree = 0;
+        g_array_set_size(m_steps, 0);
+
+        /* invalidate all index slots by bumping the generation. */
+        m_nused = 0;
+        ++m_generation;
+        if (0 == m_generation) {
+            memset(m_slots, 0, m_nslot * sizeof(trellis_slot_t));
+            m_generation = 1;
         }
-        g_ptr_array_set_size(m_steps_index, 0);
-
-        /* clear m_steps_content */
-        for ( size_t i = 0; i < m_steps_content->len; ++i){
-            LookupStepContent step_content = (LookupStepContent) g_ptr_array_index(m_steps_content, i);
-            g_array_free(step_content, TRUE);
-            g_ptr_array_index(m_steps_content, i) = NULL;
-        }
-        g_ptr_array_set_size(m_steps_content, 0);
 
         return true;
     }
 
     bool prepare(gint32 nstep) {
         /* add null start step */
-        g_ptr_array_set_size(m_steps_index, nstep);
-        g_ptr_array_set_size(m_steps_content, nstep);
-
-        for (int i = 0; i < nstep; ++i) {
-            /* initialize m_steps_index */
-            g_ptr_array_index(m_steps_index, i) = g_hash_table_new(g_direct_hash, g_direct_equal);
-            /* initialize m_steps_content */
-            g_ptr_array_index(m_steps_content, i) = g_array_new(FALSE, FALSE, sizeof(trellis_node<nstore>));
+        return init_steps(0, nstep);
+    }
+
+    /* keep the first nvalid steps, and re-use the trellis for nstep. */
+    bool rewind(gint32 nvalid, gint32 nstep) {
+        assert(0 < nvalid && nvalid <= (gint32) m_steps->len);
+        assert(nvalid <= nstep);
+
+        /* free the nodes of the invalid steps. */
+        for (gint32 i = nvalid; i < (gint32) m_steps->len; ++i) {
+            const trellis_step_t * step = &g_array_index
+                (m_steps, trellis_step_t, i);
+
+            gint32 node = step->m_first;
+            while (-1 != node) {
+                arena_item_t * item = get_item(node);
+                gint32 next = item->m_next;
+
+                erase_slot(probe_slot(i, item->m_token));
+
+                item->m_next = m_free;
+                m_free = node;
+                ++m_nfree;
+
+                node = next;
+            }
         }
 
-        return true;
+        return init_steps(nvalid, nstep);
     }
 
     /* Array of phrase_token_t */
@@ -250,19 +540,8 @@ public:
             trellis_value_t initial_value(log(1.f));
             initial_value.m_handles[1] = token;
 
-            trellis_node<nstore> initial_node;
-            check_result(initial_node.eval_item(&initial_value));
-
-            LookupStepContent initial_step_content = (LookupStepContent)
-                g_ptr_array_index(m_steps_content, 0);
-            initial_step_content = g_array_append_val
-                (initial_step_content, initial_node);
-
-            LookupStepIndex initial_step_index = (LookupStepIndex)
-                g_ptr_array_index(m_steps_index, 0);
-            g_hash_table_insert(initial_step_index,
-                                GUINT_TO_POINTER(initial_key),
-                                GUINT_TO_POINTER(initial_step_content->len - 1));
+            node_t * initial_node = lookup_node(0, initial_key);
+            check_result(initial_node->eval_item(&initial_value));
         }
 
         return true;
@@ -271,23 +550,23 @@ public:
     /* PtrArray of trellis_value_t pointer */
     bool get_candidates(/* in */ gint32 index,
                         /* out */ GPtrArray * candidates) const {
-        LookupStepContent step = (LookupStepContent)
-            g_ptr_array_index(m_steps_content, index);
+        const trellis_step_t * step = &g_array_index
+            (m_steps, trellis_step_t, index);
 
         g_ptr_array_set_size(candidates, 0);
 
-        if (0 == step->len)
+        if (0 == step->m_length)
             return false;
 
-        for (size_t i = 0; i < step->len; ++i) {
-            trellis_node<nstore> * node = &g_array_index
-                (step, trellis_node<nstore>, i);
+        for (gint32 node = step->m_first; -1 != node;
+             node = get_item(node)->m_next) {
+            node_t * cur = &get_item(node)->m_node;
 
             // only initialized in the get_candidates method.
-            node->number();
+            cur->number();
 
-            const trellis_value_t * value = node->begin();
-            for (; value < node->end(); ++value) {
+            const trellis_value_t * value = cur->begin();
+            for (; value < cur->end(); ++value) {
                 g_ptr_array_add(candidates, (trellis_value_t *)value);
             }
         }
@@ -300,63 +579,36 @@ public:
     /* insert candidate */
     bool insert_candidate(gint32 index, lookup_key_t token,
                           const trellis_value_t * candidate) {
-        LookupStepIndex step_index = (LookupStepIndex) g_ptr_array_index(m_steps_index, index);
-        LookupStepContent step_content = (LookupStepContent) g_ptr_array_index(m_steps_content, index);
-
-        gpointer key = NULL, value = NULL;
-        gboolean lookup_result = g_hash_table_lookup_extended
-            (step_index, GUINT_TO_POINTER(token), &key, &value);
-
-        if (!lookup_result) {
-            trellis_node<nstore> node;
-            check_result(node.eval_item(candidate));
-
-            g_array_append_val(step_content, node);
-            g_hash_table_insert(step_index, GUINT_TO_POINTER(token), GUINT_TO_POINTER(step_content->len - 1));
-            return true;
-        } else {
-            size_t node_index = GPOINTER_TO_UINT(value);
-            trellis_node<nstore> * node = &g_array_index
-                (step_content, trellis_node<nstore>, node_index);
-
-            return node->eval_item(candidate);
-        }
-
-        abort();
+        node_t * node = lookup_node(index, token);
+        return node->eval_item(candidate);
     }
 
     /* get tails */
     /* Array of trellis_value_t * */
     bool get_tails(/* out */ GPtrArray * tails) const {
-        gint32 tail_index = size() - 1;
+        return get_step_tails(size() - 1, tails);
+    }
 
-        GPtrArray * candidates = g_ptr_array_new();
+    /* get the tails of the partial search, which ends at the step. */
+    /* Array of trellis_value_t * */
+    bool get_step_tails(gint32 tail_index, /* out */ GPtrArray * tails) const {
+        GPtrArray * candidates = m_tail_candidates;
         get_candidates(tail_index, candidates);
         get_top_results<nstore>(nbest, tails, candidates);
 
         g_ptr_array_sort(tails, (GCompareFunc)trellis_value_compare);
 
-        g_ptr_array_free(candidates, TRUE);
+        g_ptr_array_set_size(candidates, 0);
         return true;
     }
 
     /* get candidate */
     bool get_candidate(gint32 index, lookup_key_t token, gint32 sub_index,
                        const trellis_value_t * & candidate) const {
-        LookupStepIndex step_index = (LookupStepIndex) g_ptr_array_index(m_steps_index, index);
-        LookupStepContent step_content = (LookupStepContent) g_ptr_array_index(m_steps_content, index);
-
-        gpointer key = NULL, value = NULL;
-        gboolean lookup_result = g_hash_table_lookup_extended
-            (step_index, GUINT_TO_POINTER(token), &key, &value);
-
-        if (!lookup_result)
+        node_t * node = find_node(index, token);
+        if (NULL == node)
             return false;
 
-        size_t node_index = GPOINTER_TO_UINT(value);
-        trellis_node<nstore> * node = &g_array_index
-            (step_content, trellis_node<nstore>, node_index);
-
         if (sub_index >= node->length())
             return false;
 
@@ -364,10 +616,15 @@ public:
 
         return true;
     }
+
+    /* get the number of the used trellis nodes. */
+    gint32 get_node_count() const {
+        return m_nnode - m_nfree;
+    }
 };
 
-template <gint32 nstore, gint32 nbest>
-bool extract_result(const ForwardPhoneticTrellis<nstore, nbest> * trellis,
+template <gint32 nstore, gint32 nbest, typename node_t>
+bool extract_result(const ForwardPhoneticTrellis<nstore, nbest, node_t> * trellis,
                     const trellis_value_t * tail,
                     /* out */ MatchResult & result) {
     /* reset result */
@@ -463,16 +720,27 @@ class NBestMatchResults {
 private:
     /* Array of MatchResult */
     GPtrArray * m_results;
+    /* Array of MatchResult, the cleared results to be re-used. */
+    GPtrArray * m_spare_results;
 
 public:
     NBestMatchResults() {
         m_results = g_ptr_array_new();
+        m_spare_results = g_ptr_array_new();
     }
 
     ~NBestMatchResults() {
         clear();
         g_ptr_array_free(m_results, TRUE);
         m_results = NULL;
+
+        for (size_t i = 0; i < m_spare_results->len; ++i) {
+            MatchResult array =
+                (MatchResult) g_ptr_array_index(m_spare_results, i);
+            g_array_free(array, TRUE);
+        }
+        g_ptr_array_free(m_spare_results, TRUE);
+        m_spare_results = NULL;
     }
 
 public:
@@ -489,11 +757,11 @@ public:
     }
 
     bool clear() {
-        /* free m_results */
+        /* keep m_results for the next add_result calls. */
         for (size_t i = 0; i < m_results->len; ++i) {
             MatchResult array =
                 (MatchResult) g_ptr_array_index(m_results, i);
-            g_array_free(array, TRUE);
+            g_ptr_array_add(m_spare_results, array);
         }
         g_ptr_array_set_size(m_results, 0);
 
@@ -502,8 +770,15 @@ public:
 
     /* copy result here */
     bool add_result(MatchResult result) {
-        MatchResult array = g_array_new
-            (TRUE, TRUE, sizeof(phrase_token_t));
+        MatchResult array = NULL;
+        if (m_spare_results->len) {
+            array = (MatchResult) g_ptr_array_index
+                (m_spare_results, m_spare_results->len - 1);
+            g_ptr_array_set_size(m_spare_results, m_spare_results->len - 1);
+            g_array_set_size(array, 0);
+        } else {
+            array = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
+        }
 
         g_array_append_vals(array, result->data, result->len);
 
@@ -512,19 +787,57 @@ public:
     }
 };
 
-template <gint32 nstore, gint32 nbest>
+
+/**
+ * PhoneticLookup:
+ *
+ * The n-best phonetic lookup, nstore is the number of the values kept
+ * in each trellis node, node_t is the storage of the trellis node.
+ *
+ */
+template <gint32 nstore, gint32 nbest,
+          typename node_t = typename trellis_node_policy<nstore>::node_t>
 class PhoneticLookup {
 private:
-    const gfloat bigram_lambda;
-    const gfloat unigram_lambda;
+    LookupScorer m_scorer;
 
     /* memory cache */
     GArray * m_cached_keys;
     PhraseItem m_cached_phrase_item;
-    SingleGram m_merged_single_gram;
+    SingleGramCache m_bigram_cache;
+
+    /* the beam of each step, the number of the expanded results
+       and the log possibility margin to the best result. */
+    size_t m_beam_size;
+    gfloat m_beam_margin;
+
+    /* the candidates of the current span. */
+    CandidateBatch m_span;
+    /* the candidates to be scored together. */
+    CandidateBatch m_batch;
+
+    /* the scratch arrays of get_nbest_match, truncated in each call
+       instead of being allocated. */
+    GPtrArray * m_candidates;
+    GPtrArray * m_topresults;
+    GPtrArray * m_tails;
+    MatchResult m_result;
+    BigramPhraseArray m_bigram_phrase_items;
 
 protected:
-    ForwardPhoneticTrellis<nstore, nbest> m_trellis;
+    ForwardPhoneticTrellis<nstore, nbest, node_t> m_trellis;
+
+    /* the trellis of the previous get_nbest_match call,
+       re-used when only the tail of the matrix is changed. */
+    bool m_trellis_valid;
+    /* Array of trellis_constraint_t */
+    GArray * m_cached_constraints;
+    TokenVector m_cached_prefixes;
+    /* Array of gint32, the step where the search from each step stopped. */
+    GArray * m_step_reaches;
+    /* the first step not searched when the deadline is reached,
+       the number of the steps when the search is finished. */
+    gint32 m_resume_step;
 
 protected:
     /* saved varibles */
@@ -537,26 +850,36 @@ protected:
     Bigram * m_user_bigram;
 
 protected:
-    bool search_unigram2(GPtrArray * topresults,
-                         int start, int end,
-                         PhraseIndexRanges ranges) {
-        if (0 == topresults->len)
-            return false;
-
-        trellis_value_t * max = (trellis_value_t *)
-            g_ptr_array_index(topresults, 0);
+    /* fill the candidates of the span from the phrase index ranges,
+       the log pinyin possibility is computed once for each token. */
+    bool gather_span(int start, int end, PhraseIndexRanges ranges) {
+        m_span.resize(0);
 
         const trellis_constraint_t * constraint = NULL;
         check_result(m_constraints->get_constraint(start, constraint));
 
         if (CONSTRAINT_ONESTEP == constraint->m_type) {
-            return unigram_gen_next_step(start, constraint->m_constraint_step,
-                                         max, constraint->m_token);
+            m_span.resize(1);
+            gather_candidate(0, start, constraint->m_constraint_step,
+                             constraint->m_token);
+            return true;
         }
 
-        bool found = false;
-
         if (NO_CONSTRAINT == constraint->m_type) {
+            size_t size = 0;
+            for ( size_t m = 0; m < PHRASE_INDEX_LIBRARY_COUNT; ++m){
+                GArray * array = ranges[m];
+                if ( !array ) continue;
+
+                for ( size_t n = 0; n < array->len; ++n){
+                    PhraseIndexRange * range = &g_array_index(array, PhraseIndexRange, n);
+                    size += range->m_range_end - range->m_range_begin;
+                }
+            }
+
+            m_span.resize(size);
+
+            size_t index = 0;
             for ( size_t m = 0; m < PHRASE_INDEX_LIBRARY_COUNT; ++m){
                 GArray * array = ranges[m];
                 if ( !array ) continue;
@@ -565,14 +888,73 @@ protected:
                     PhraseIndexRange * range = &g_array_index(array, PhraseIndexRange, n);
                     for ( phrase_token_t token = range->m_range_begin;
                           token != range->m_range_end; ++token){
-                        found = unigram_gen_next_step(start, end, max, token) ||
-                            found;
+                        gather_candidate(index++, start, end, token);
                     }
                 }
             }
         }
 
-        return found;
+        return true;
+    }
+
+    /* keep the position of the token in the span,
+       even if the phrase item is missing. */
+    void gather_candidate(size_t index, int start, int end,
+                          phrase_token_t token) {
+        guint8 phrase_length = 0;
+        gdouble unigram_poss = 0.;
+        gfloat pinyin_log_poss = -FLT_MAX;
+
+        PhraseItemView item;
+        if (!m_phrase_index->get_phrase_item_view(token, item)) {
+            phrase_length = item.get_phrase_length();
+            unigram_poss = m_scorer.get_unigram_possibility
+                (item.get_unigram_frequency());
+
+            /* the exact scoring doesn't use the quantized value. */
+            if (m_scorer.get_exact_scoring()) {
+                gfloat pinyin_poss = compute_pronunciation_possibility
+                    (m_matrix, start, end, m_cached_keys, item);
+                if (pinyin_poss > 0.)
+                    pinyin_log_poss = log(pinyin_poss);
+            } else {
+                pinyin_log_poss = compute_pronunciation_log_possibility
+                    (m_matrix, start, end, m_cached_keys, item);
+            }
+        }
+
+        m_span.set(index, token, phrase_length, 0., unigram_poss,
+                   pinyin_log_poss);
+    }
+
+    bool search_unigram2(GPtrArray * topresults,
+                         int start, int end) {
+        if (0 == topresults->len)
+            return false;
+
+        trellis_value_t * max = (trellis_value_t *)
+            g_ptr_array_index(topresults, 0);
+
+        /* the candidates are the part of the span. */
+        m_batch.resize(m_span.size());
+        size_t size = 0;
+        for (size_t i = 0; i < m_span.size(); ++i) {
+            gdouble elem_poss = m_span.get_unigram_possibility(i);
+            if ( elem_poss < DBL_EPSILON )
+                continue;
+
+            gfloat pinyin_log_poss = m_span.get_pinyin_log_possibility(i);
+            if ( pinyin_log_poss < min_pinyin_log_poss )
+                continue;
+
+            m_batch.set(size++, m_span.get_token(i), m_span.get_length(i),
+                        0., elem_poss, pinyin_log_poss);
+        }
+        m_batch.resize(size);
+
+        m_scorer.score_unigrams(m_batch);
+
+        return save_next_steps(start, end, max);
     }
 
     bool search_bigram2(GPtrArray * topresults,
@@ -582,8 +964,7 @@ protected:
         check_result(m_constraints->get_constraint(start, constraint));
 
         bool found = false;
-        BigramPhraseArray bigram_phrase_items = g_array_new
-            (FALSE, FALSE, sizeof(BigramPhraseItem));
+        BigramPhraseArray bigram_phrase_items = m_bigram_phrase_items;
 
         for (size_t i = 0; i < topresults->len; ++i) {
             trellis_value_t * value = (trellis_value_t *)
@@ -591,28 +972,30 @@ protected:
 
             phrase_token_t index_token = value->m_handles[1];
 
-            SingleGram * system = NULL, * user = NULL;
-            m_system_bigram->load(index_token, system);
-            m_user_bigram->load(index_token, user);
-
-            if ( !merge_single_gram(&m_merged_single_gram, system, user) )
+            const SingleGram * merged = NULL;
+            if ( !m_bigram_cache.load(index_token, merged) )
                 continue;
 
+            /* the candidates are the part of the span. */
+            m_batch.resize(m_span.size());
+            size_t size = 0;
+
             if ( CONSTRAINT_ONESTEP == constraint->m_type ){
                 phrase_token_t token = constraint->m_token;
 
                 guint32 freq;
-                if( m_merged_single_gram.get_freq(token, freq) ){
+                if( merged->get_freq(token, freq) ){
                     guint32 total_freq;
-                    m_merged_single_gram.get_total_freq(total_freq);
+                    merged->get_total_freq(total_freq);
                     gfloat bigram_poss = freq / (gfloat) total_freq;
-                    found = bigram_gen_next_step(start,
-                                                 constraint->m_constraint_step,
-                                                 value, token, bigram_poss) || found;
+                    gather_bigram(size, 0, bigram_poss);
                 }
             }
 
             if (NO_CONSTRAINT == constraint->m_type) {
+                /* the tokens of each range are continuous in the span. */
+                size_t offset = 0;
+
                 for( size_t m = 0; m < PHRASE_INDEX_LIBRARY_COUNT; ++m){
                     GArray * array = ranges[m];
                     if ( !array ) continue;
@@ -622,84 +1005,122 @@ protected:
                             &g_array_index(array, PhraseIndexRange, n);
 
                         g_array_set_size(bigram_phrase_items, 0);
-                        m_merged_single_gram.search(range, bigram_phrase_items);
+                        merged->search(range, bigram_phrase_items);
                         for( size_t k = 0; k < bigram_phrase_items->len; ++k) {
                             BigramPhraseItem * item = &g_array_index(bigram_phrase_items, BigramPhraseItem, k);
-                            found = bigram_gen_next_step(start, end, value, item->m_token, item->m_freq) || found;
+                            gather_bigram(size, offset + item->m_token - range->m_range_begin, item->m_freq);
                         }
+
+                        offset += range->m_range_end - range->m_range_begin;
                     }
                 }
             }
-            if (system)
-                delete system;
-            if (user)
-                delete user;
+
+            m_batch.resize(size);
+            m_scorer.score_bigrams(m_batch);
+            found = save_next_steps(start, end, value) || found;
         }
 
-        g_array_free(bigram_phrase_items, TRUE);
+        g_array_set_size(bigram_phrase_items, 0);
         return found;
     }
 
-    bool unigram_gen_next_step(int start, int end,
-                               trellis_value_t * cur_step,
-                               phrase_token_t token) {
-        if (m_phrase_index->get_phrase_item(token, m_cached_phrase_item))
-            return false;
+    void gather_bigram(size_t & size, size_t index, gfloat bigram_poss) {
+        gdouble unigram_poss = m_span.get_unigram_possibility(index);
+        if ( bigram_poss < FLT_EPSILON && unigram_poss < DBL_EPSILON )
+            return;
 
-        size_t phrase_length = m_cached_phrase_item.get_phrase_length();
-        gdouble elem_poss = m_cached_phrase_item.get_unigram_frequency() /
-            (gdouble) m_phrase_index->get_phrase_index_total_freq();
-        if ( elem_poss < DBL_EPSILON )
-            return false;
+        gfloat pinyin_log_poss = m_span.get_pinyin_log_possibility(index);
+        if ( pinyin_log_poss < min_pinyin_log_poss )
+            return;
 
-        gfloat pinyin_poss = compute_pronunciation_possibility
-            (m_matrix, start, end, m_cached_keys, m_cached_phrase_item);
-        if (pinyin_poss < FLT_EPSILON )
-            return false;
+        m_batch.set(size++, m_span.get_token(index), m_span.get_length(index),
+                    bigram_poss, unigram_poss, pinyin_log_poss);
+    }
 
-        trellis_value_t next_step;
-        next_step.m_handles[0] = cur_step->m_handles[1]; next_step.m_handles[1] = token;
-        next_step.m_sentence_length = cur_step->m_sentence_length + phrase_length;
-        next_step.m_poss = cur_step->m_poss + log(elem_poss * pinyin_poss * unigram_lambda);
-        next_step.m_last_step = start;
-        next_step.m_sub_index = cur_step->m_current_index;
+    /* insert the scored candidates of the batch into the trellis. */
+    bool save_next_steps(int start, int end, trellis_value_t * cur_step) {
+        bool found = false;
+
+        for (size_t i = 0; i < m_batch.size(); ++i) {
+            trellis_value_t next_step;
+            next_step.m_handles[0] = cur_step->m_handles[1];
+            next_step.m_handles[1] = m_batch.get_token(i);
+            next_step.m_sentence_length = cur_step->m_sentence_length +
+                m_batch.get_length(i);
+            next_step.m_poss = cur_step->m_poss + m_batch.get_score(i);
+            next_step.m_last_step = start;
+            next_step.m_sub_index = cur_step->m_current_index;
+
+            found = save_next_step(end, &next_step) || found;
+        }
 
-        return save_next_step(end, &next_step);
+        return found;
     }
 
-    bool bigram_gen_next_step(int start, int end,
-                              trellis_value_t * cur_step,
-                              phrase_token_t token,
-                              gfloat bigram_poss) {
-        if (m_phrase_index->get_phrase_item(token, m_cached_phrase_item))
-            return false;
+    bool save_next_step(int index, trellis_value_t * candidate) {
+        lookup_key_t token = candidate->m_handles[1];
+        return m_trellis.insert_candidate(index, token, candidate);
+    }
 
-        size_t phrase_length = m_cached_phrase_item.get_phrase_length();
-        gdouble unigram_poss = m_cached_phrase_item.get_unigram_frequency() /
-            (gdouble) m_phrase_index->get_phrase_index_total_freq();
-        if ( bigram_poss < FLT_EPSILON && unigram_poss < DBL_EPSILON )
+    static bool constraint_equal(const trellis_constraint_t * lhs,
+                                 const trellis_constraint_t * rhs) {
+        if (lhs->m_type != rhs->m_type)
             return false;
 
-        gfloat pinyin_poss = compute_pronunciation_possibility
-                           (m_matrix, start, end,
-                            m_cached_keys, m_cached_phrase_item);
-        if ( pinyin_poss < FLT_EPSILON )
-            return false;
+        if (CONSTRAINT_ONESTEP == lhs->m_type)
+            return lhs->m_token == rhs->m_token &&
+                lhs->m_constraint_step == rhs->m_constraint_step;
 
-        trellis_value_t next_step;
-        next_step.m_handles[0] = cur_step->m_handles[1]; next_step.m_handles[1] = token;
-        next_step.m_sentence_length = cur_step->m_sentence_length + phrase_length;
-        next_step.m_poss = cur_step->m_poss +
-            log((bigram_lambda * bigram_poss + unigram_lambda * unigram_poss) * pinyin_poss);
-        next_step.m_last_step = start;
-        next_step.m_sub_index = cur_step->m_current_index;
+        return true;
+    }
 
-        return save_next_step(end, &next_step);
+    /* compute the first step which needs to be searched again,
+       the nodes before the step only depend on the matrix columns
+       and the constraints before the step. */
+    int compute_start_step(TokenVector prefixes,
+                           const PhoneticKeyMatrix * matrix,
+                           const ForwardPhoneticConstraints * constraints,
+                           size_t dirty_offset) const {
+        if (!m_trellis_valid || matrix != m_matrix)
+            return 0;
+
+        if (prefixes->len != m_cached_prefixes->len ||
+            0 != memcmp(prefixes->data, m_cached_prefixes->data,
+                        prefixes->len * sizeof(phrase_token_t)))
+            return 0;
+
+        size_t start = std_lite::min(dirty_offset, m_trellis.size());
+        start = std_lite::min(start, matrix->size());
+
+        for (size_t i = 0; i < start; ++i) {
+            const trellis_constraint_t * constraint = NULL;
+            if (i >= m_cached_constraints->len ||
+                !constraints->get_constraint(i, constraint))
+                return i;
+
+            const trellis_constraint_t * cached = &g_array_index
+                (m_cached_constraints, trellis_constraint_t, i);
+            if (!constraint_equal(constraint, cached))
+                return i;
+        }
+
+        return start;
     }
 
-    bool save_next_step(int index, trellis_value_t * candidate) {
-        lookup_key_t token = candidate->m_handles[1];
-        return m_trellis.insert_candidate(index, token, candidate);
+    bool save_cached_variables(TokenVector prefixes,
+                               const ForwardPhoneticConstraints * constraints) {
+        g_array_set_size(m_cached_prefixes, 0);
+        g_array_append_vals(m_cached_prefixes, prefixes->data, prefixes->len);
+
+        g_array_set_size(m_cached_constraints, 0);
+        for (size_t i = 0; i < constraints->length(); ++i) {
+            const trellis_constraint_t * constraint = NULL;
+            check_result(constraints->get_constraint(i, constraint));
+            g_array_append_val(m_cached_constraints, *constraint);
+        }
+
+        return true;
     }
 
 public:
@@ -709,11 +1130,14 @@ public:
                    FacadePhraseIndex * phrase_index,
                    Bigram * system_bigram,
                    Bigram * user_bigram)
-        : bigram_lambda(lambda),
-          unigram_lambda(1. - lambda)
+        : m_scorer(lambda),
+          m_bigram_cache(system_bigram, user_bigram, bigram_cache_size)
     {
         assert(nstore <= nbest);
 
+        m_beam_size = nbeam;
+        m_beam_margin = FLT_MAX;
+
         /* store the pointer. */
         m_pinyin_table = pinyin_table;
         m_phrase_index = phrase_index;
@@ -722,6 +1146,21 @@ public:
 
         m_cached_keys = g_array_new(TRUE, TRUE, sizeof(ChewingKey));
 
+        m_trellis_valid = false;
+        m_cached_constraints = g_array_new
+            (TRUE, TRUE, sizeof(trellis_constraint_t));
+        m_cached_prefixes = g_array_new
+            (FALSE, FALSE, sizeof(phrase_token_t));
+        m_step_reaches = g_array_new(FALSE, FALSE, sizeof(gint32));
+        m_resume_step = 0;
+
+        m_candidates = g_ptr_array_new();
+        m_topresults = g_ptr_array_new();
+        m_tails = g_ptr_array_new();
+        m_result = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
+        m_bigram_phrase_items = g_array_new
+            (FALSE, FALSE, sizeof(BigramPhraseItem));
+
         /* the member variables below are saved in get_nbest_match call. */
         m_matrix = NULL;
         m_constraints = NULL;
@@ -730,6 +1169,85 @@ public:
     ~PhoneticLookup(){
         g_array_free(m_cached_keys, TRUE);
         m_cached_keys = NULL;
+
+        g_array_free(m_cached_constraints, TRUE);
+        m_cached_constraints = NULL;
+        g_array_free(m_cached_prefixes, TRUE);
+        m_cached_prefixes = NULL;
+        g_array_free(m_step_reaches, TRUE);
+        m_step_reaches = NULL;
+
+        g_ptr_array_free(m_candidates, TRUE);
+        m_candidates = NULL;
+        g_ptr_array_free(m_topresults, TRUE);
+        m_topresults = NULL;
+        g_ptr_array_free(m_tails, TRUE);
+        m_tails = NULL;
+        g_array_free(m_result, TRUE);
+        m_result = NULL;
+        g_array_free(m_bigram_phrase_items, TRUE);
+        m_bigram_phrase_items = NULL;
+    }
+
+    /**
+     * PhoneticLookup::invalidate_trellis:
+     * @returns: whether the invalidate operation is successful.
+     *
+     * Search the whole matrix in the next get_nbest_match call,
+     * must be called after the phrase index or bi-gram is changed.
+     *
+     */
+    bool invalidate_trellis() {
+        m_trellis_valid = false;
+        return true;
+    }
+
+    /**
+     * PhoneticLookup::get_bigram_cache_statistics:
+     * @hits: the number of the bi-gram cache hits.
+     * @misses: the number of the bi-gram cache misses.
+     * @returns: whether the get operation is successful.
+     *
+     * Get the statistics of the merged single gram cache.
+     *
+     */
+    bool get_bigram_cache_statistics(/* out */ guint32 & hits,
+                                     /* out */ guint32 & misses) const {
+        return m_bigram_cache.get_statistics(hits, misses);
+    }
+
+    /**
+     * PhoneticLookup::set_exact_scoring:
+     * @exact: whether to use the exact scoring.
+     * @returns: whether the set operation is successful.
+     *
+     * Use the exact log possibility instead of the fast approximation,
+     * mainly to evaluate the fast scoring.
+     *
+     */
+    bool set_exact_scoring(bool exact) {
+        m_scorer.set_exact_scoring(exact);
+        return invalidate_trellis();
+    }
+
+    /**
+     * PhoneticLookup::set_beam:
+     * @beam_size: the number of the expanded results of each step.
+     * @margin: the log possibility margin to the best result of each step,
+     *          FLT_MAX to disable.
+     * @returns: whether the set operation is successful.
+     *
+     * Prune the trellis nodes before they are expanded, the smaller beam
+     * trades the accuracy for the predictable latency.
+     *
+     */
+    bool set_beam(size_t beam_size, gfloat margin) {
+        if (0 == beam_size || margin < 0.)
+            return false;
+
+        m_beam_size = beam_size;
+        m_beam_margin = margin;
+        return invalidate_trellis();
     }
 
 
@@ -737,30 +1255,121 @@ public:
                          const PhoneticKeyMatrix * matrix,
                          const ForwardPhoneticConstraints * constraints,
                          NBestMatchResults * results) {
+        return get_nbest_match(prefixes, matrix, constraints, results, 0);
+    }
+
+    /**
+     * PhoneticLookup::get_nbest_match:
+     * @prefixes: the phrase tokens before the user input.
+     * @matrix: the phonetic key matrix.
+     * @constraints: the constraints on the matrix.
+     * @results: the n-best match results.
+     * @dirty_offset: the first matrix column changed since the previous call.
+     * @returns: whether the lookup operation is successful.
+     *
+     * Re-use the trellis of the previous call with the same matrix,
+     * only the steps from the first changed column or constraint
+     * are searched again.
+     *
+     */
+    bool get_nbest_match(TokenVector prefixes,
+                         const PhoneticKeyMatrix * matrix,
+                         const ForwardPhoneticConstraints * constraints,
+                         NBestMatchResults * results,
+                         size_t dirty_offset) {
+        bool finished = false;
+        return get_nbest_match(prefixes, matrix, constraints, results,
+                               dirty_offset, G_MAXINT64, finished);
+    }
+
+    /**
+     * PhoneticLookup::get_nbest_match:
+     * @prefixes: the phrase tokens before the user input.
+     * @matrix: the phonetic key matrix.
+     * @constraints: the constraints on the matrix.
+     * @results: the n-best match results.
+     * @dirty_offset: the first matrix column changed since the previous call.
+     * @deadline: the monotonic time in microseconds to stop the search.
+     * @finished: whether the whole matrix is searched.
+     * @returns: whether the lookup operation is successful.
+     *
+     * Stop the search at the deadline, and return the best results
+     * of the searched steps. The next call with the same matrix resumes
+     * the search from the first step not searched.
+     *
+     */
+    bool get_nbest_match(TokenVector prefixes,
+                         const PhoneticKeyMatrix * matrix,
+                         const ForwardPhoneticConstraints * constraints,
+                         NBestMatchResults * results,
+                         size_t dirty_offset,
+                         gint64 deadline,
+                         /* out */ bool & finished) {
+        finished = false;
+
+        const int start = compute_start_step
+            (prefixes, matrix, constraints, dirty_offset);
+        /* the steps before this step were searched in the previous calls. */
+        const int searched = std_lite::min(start, (int) m_resume_step);
+
         m_constraints = constraints;
         m_matrix = matrix;
 
         int nstep = m_matrix->size();
-        if (0 == nstep)
+        if (0 == nstep) {
+            m_trellis_valid = false;
             return false;
+        }
 
         /* free results */
         results->clear();
 
-        m_trellis.clear();
-        m_trellis.prepare(nstep);
+        if (0 == start) {
+            m_trellis.clear();
+            m_trellis.prepare(nstep);
+
+            m_trellis.fill_prefixes(prefixes);
+        } else {
+            m_trellis.rewind(start, nstep);
+        }
+
+        save_cached_variables(prefixes, constraints);
+        g_array_set_size(m_step_reaches, nstep);
+
+        m_scorer.prepare(m_phrase_index->get_phrase_index_total_freq());
 
-        m_trellis.fill_prefixes(prefixes);
+        ScopedPhraseIndexRanges ranges(m_phrase_index);
 
-        PhraseIndexRanges ranges;
-        memset(ranges, 0, sizeof(PhraseIndexRanges));
-        m_phrase_index->prepare_ranges(ranges);
+        GPtrArray * candidates = m_candidates;
+        GPtrArray * topresults = m_topresults;
 
-        GPtrArray * candidates = g_ptr_array_new();
-        GPtrArray * topresults = g_ptr_array_new();
+        m_resume_step = nstep;
+        bool expanded = false;
 
         /* begin the viterbi beam search. */
         for ( int i = 0; i < nstep - 1; ++i ){
+            gint32 * reach = &g_array_index(m_step_reaches, gint32, i);
+            int first = i + 1;
+
+            if (i < searched) {
+                /* the search from this step stopped before the start step. */
+                if (*reach < start)
+                    continue;
+
+                /* only search the steps from the start step. */
+                first = start;
+            } else {
+                /* search at least one step in each call,
+                   the nodes of this step are complete here. */
+                if (expanded && g_get_monotonic_time() >= deadline) {
+                    m_resume_step = i;
+                    break;
+                }
+                expanded = true;
+            }
+
+            *reach = -1;
+
             const trellis_constraint_t * cur_constraint = NULL;
             check_result(m_constraints->get_constraint(i, cur_constraint));
 
@@ -768,13 +1377,15 @@ public:
                 continue;
 
             m_trellis.get_candidates(i, candidates);
-            get_top_results<nstore>(nbeam, topresults, candidates);
+            get_top_results<nstore>(m_beam_size, topresults, candidates,
+                                    m_beam_margin);
 
             if (0 == topresults->len)
                 continue;
 
             if (CONSTRAINT_ONESTEP == cur_constraint->m_type) {
                 int m = cur_constraint->m_constraint_step;
+                *reach = m;
 
                 m_phrase_index->clear_ranges(ranges);
 
@@ -783,20 +1394,27 @@ public:
                                            i, m, ranges);
 
                 if (retval & SEARCH_OK) {
+                    gather_span(i, m, ranges);
+
                     /* assume topresults always contains items. */
                     search_bigram2(topresults, i, m, ranges),
-                        search_unigram2(topresults, i, m, ranges);
+                        search_unigram2(topresults, i, m);
                 }
 
                 continue;
             }
 
-            for ( int m = i + 1; m < nstep; ++m ){
+            /* the search may continue with the longer matrix. */
+            *reach = nstep;
+
+            for ( int m = first; m < nstep; ++m ){
                 const trellis_constraint_t * next_constraint = NULL;
                 check_result(m_constraints->get_constraint(m, next_constraint));
 
-                if (CONSTRAINT_NOSEARCH == next_constraint->m_type)
+                if (CONSTRAINT_NOSEARCH == next_constraint->m_type) {
+                    *reach = m;
                     break;
+                }
 
                 m_phrase_index->clear_ranges(ranges);
 
@@ -805,28 +1423,42 @@ public:
                                            i, m, ranges);
 
                 if (retval & SEARCH_OK) {
+                    gather_span(i, m, ranges);
+
                     /* assume topresults always contains items. */
                     search_bigram2(topresults, i, m, ranges),
-                        search_unigram2(topresults, i, m, ranges);
+                        search_unigram2(topresults, i, m);
                 }
 
                 /* no longer pinyin */
-                if (!(retval & SEARCH_CONTINUED))
+                if (!(retval & SEARCH_CONTINUED)) {
+                    *reach = m;
                     break;
+                }
             }
         }
 
-        m_phrase_index->destroy_ranges(ranges);
+        m_trellis_valid = true;
+
+        g_ptr_array_set_size(candidates, 0);
+        g_ptr_array_set_size(topresults, 0);
 
-        g_ptr_array_free(candidates, TRUE);
-        g_ptr_array_free(topresults, TRUE);
+        finished = (nstep == m_resume_step);
 
         /* extract every result. */
-        GPtrArray * tails = g_ptr_array_new();
-        m_trellis.get_tails(tails);
+        GPtrArray * tails = m_tails;
+        if (finished) {
+            m_trellis.get_tails(tails);
+        } else {
+            /* the partial results end at the last reached step. */
+            for (gint32 i = m_resume_step; i >= 0; --i) {
+                m_trellis.get_step_tails(i, tails);
+                if (tails->len)
+                    break;
+            }
+        }
 
-        MatchResult result = g_array_new
-            (TRUE, TRUE, sizeof(phrase_token_t));
+        MatchResult result = m_result;
         for (size_t i = 0; i < tails->len; ++i) {
             const trellis_value_t * tail = (const trellis_value_t *)
                 g_ptr_array_index(tails, i);
@@ -835,8 +1467,7 @@ public:
             results->add_result(result);
         }
 
-        g_array_free(result, TRUE);
-        g_ptr_array_free(tails, TRUE);
+        g_ptr_array_set_size(tails, 0);
 
         return true;
     }
@@ -921,7 +1552,8 @@ public:
                 next_pos = std_lite::min(next_pos, constraints->length() - 1);
 
                 /* train uni-gram */
-                m_phrase_index->get_phrase_item(token, m_cached_phrase_item);
+                m_phrase_index->get_writable_phrase_item
+                    (token, m_cached_phrase_item);
                 increase_pronunciation_possibility
                     (matrix, i, next_pos,
                      m_cached_keys, m_cached_phrase_item, seed * pinyin_factor);
@@ -932,6 +1564,8 @@ public:
             last_token = token;
         }
 
+        /* the bi-gram and uni-gram are changed. */
+        invalidate_trellis();
         return true;
     }
 
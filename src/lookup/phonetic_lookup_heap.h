@@ -28,20 +28,25 @@ static inline bool trellis_value_comp(const trellis_value_t &lhs,
     return trellis_value_less_than<nstore>(&lhs, &rhs);
 }
 
+/* the heap storage for the large nstore. */
 template <gint32 nstore>
-struct trellis_node {
+struct trellis_heap_node {
 private:
     gint32 m_nelem;
     /* invariant: min heap */
     trellis_value_t m_elements[nstore];
 
 public:
-    trellis_node(){
+    trellis_heap_node(){
+        clear();
+    }
+
+public:
+    void clear() {
         m_nelem = 0;
         /* always assume non-used m_elements contains random data. */
     }
 
-public:
     gint32 length() { return m_nelem; }
     const trellis_value_t * begin() { return m_elements; }
     const trellis_value_t * end() { return m_elements + m_nelem; }
@@ -86,15 +91,18 @@ public:
  * when the trellis node created, always put one element in it.
  * when no trellis node, it represents zero element.
  */
-template <>
-struct trellis_node <1> {
+struct trellis_single_node {
 private:
     trellis_value_t m_element;
 
 public:
-    trellis_node () : m_element(-FLT_MAX) {}
+    trellis_single_node () : m_element(-FLT_MAX) {}
 
 public:
+    void clear() {
+        m_element = trellis_value_t(-FLT_MAX);
+    }
+
     gint32 length() { return 1; }
     const trellis_value_t * begin() { return &m_element; }
     const trellis_value_t * end() { return &m_element + 1; }
@@ -21,19 +21,36 @@
 #ifndef PHONETIC_LOOKUP_LINEAR_H
 #define PHONETIC_LOOKUP_LINEAR_H
 
+/* the linear storage for the small nstore. */
 template <gint32 nstore>
-struct trellis_node {
+struct trellis_linear_node {
 private:
     gint32 m_nelem;
+    /* the minimum item when the node is full. */
+    gint32 m_min;
     trellis_value_t m_elements[nstore];
 
+    void find_min() {
+        m_min = 0;
+        for (gint32 i = 1; i < m_nelem; ++i) {
+            if (trellis_value_less_than<nstore>
+                (m_elements + i, m_elements + m_min))
+                m_min = i;
+        }
+    }
+
+public:
+    trellis_linear_node(){
+        clear();
+    }
+
 public:
-    trellis_node(){
+    void clear() {
         m_nelem = 0;
+        m_min = -1;
         /* always assume non-used m_elements contains random data. */
     }
 
-public:
     gint32 length() { return m_nelem; }
     const trellis_value_t * begin() { return m_elements; }
     const trellis_value_t * end() { return m_elements + m_nelem; }
@@ -51,19 +68,18 @@ public:
         if (m_nelem < nstore) {
             m_elements[m_nelem] = *item;
             m_nelem ++;
-            return true;
-        }
 
-        /* find minium item */
-        trellis_value_t * min = m_elements;
-        for (gint32 i = 1; i < m_nelem; ++i) {
-            if (trellis_value_less_than<nstore>(m_elements + i, min))
-                min = m_elements + i;
+            if (m_nelem == nstore)
+                find_min();
+            return true;
         }
 
-        /* compare new item */
+        /* compare new item with the minimum item,
+           only scan the node again when the item is stored. */
+        trellis_value_t * min = m_elements + m_min;
         if (trellis_value_less_than<nstore>(min, item)) {
             *min = *item;
+            find_min();
             return true;
         }
 
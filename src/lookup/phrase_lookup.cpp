@@ -46,14 +46,15 @@ static bool populate_prefixes(GPtrArray * steps_index,
 
     LookupStepIndex initial_step_index = (LookupStepIndex)
         g_ptr_array_index(steps_index, 0);
-    g_hash_table_insert(initial_step_index, GUINT_TO_POINTER(initial_key),
-                        GUINT_TO_POINTER(initial_step_content->len - 1));
+    initial_step_index->insert(initial_key, initial_step_content->len - 1);
 
     return true;
 }
 
 static bool init_steps(GPtrArray * steps_index,
                        GPtrArray * steps_content,
+                       GPtrArray * spare_index,
+                       GPtrArray * spare_content,
                        int nstep) {
 
     /* add null start step */
@@ -61,9 +62,17 @@ static bool init_steps(GPtrArray * steps_index,
     g_ptr_array_set_size(steps_content, nstep);
 
     for ( int i = 0; i < nstep; ++i ){
+        /* re-use the cleared steps first. */
+        if (spare_index->len) {
+            g_ptr_array_index(steps_index, i) =
+                g_ptr_array_remove_index(spare_index, spare_index->len - 1);
+            g_ptr_array_index(steps_content, i) =
+                g_ptr_array_remove_index(spare_content, spare_content->len - 1);
+            continue;
+        }
+
         /* initialize steps_index */
-        g_ptr_array_index(steps_index, i) = g_hash_table_new
-            (g_direct_hash, g_direct_equal);
+        g_ptr_array_index(steps_index, i) = new LookupStepTable;
         /* initialize steps_content */
         g_ptr_array_index(steps_content, i) = g_array_new
             (FALSE, FALSE, sizeof(lookup_value_t));
@@ -72,12 +81,34 @@ static bool init_steps(GPtrArray * steps_index,
     return true;
 }
 
+/* move the steps to the spare steps, without freeing them. */
 static void clear_steps(GPtrArray * steps_index,
-                        GPtrArray * steps_content){
-    /* clear steps_index */
+                        GPtrArray * steps_content,
+                        GPtrArray * spare_index,
+                        GPtrArray * spare_content){
     for ( size_t i = 0; i < steps_index->len; ++i){
-        GHashTable * table = (GHashTable *) g_ptr_array_index(steps_index, i);
-        g_hash_table_destroy(table);
+        LookupStepIndex table = (LookupStepIndex)
+            g_ptr_array_index(steps_index, i);
+        table->clear();
+        g_ptr_array_add(spare_index, table);
+    }
+    g_ptr_array_set_size(steps_index, 0);
+
+    for ( size_t i = 0; i < steps_content->len; ++i){
+        GArray * array = (GArray *) g_ptr_array_index(steps_content, i);
+        g_array_set_size(array, 0);
+        g_ptr_array_add(spare_content, array);
+    }
+    g_ptr_array_set_size(steps_content, 0);
+}
+
+static void free_steps(GPtrArray * steps_index,
+                       GPtrArray * steps_content){
+    /* free steps_index */
+    for ( size_t i = 0; i < steps_index->len; ++i){
+        LookupStepIndex table = (LookupStepIndex)
+            g_ptr_array_index(steps_index, i);
+        delete table;
         g_ptr_array_index(steps_index, i) = NULL;
     }
 
@@ -104,6 +135,8 @@ PhraseLookup::PhraseLookup(const gfloat lambda,
 
     m_steps_index = g_ptr_array_new();
     m_steps_content = g_ptr_array_new();
+    m_spare_steps_index = g_ptr_array_new();
+    m_spare_steps_content = g_ptr_array_new();
 
     /* the member variables below are saved in get_best_match call. */
     m_sentence = NULL;
@@ -111,9 +144,13 @@ PhraseLookup::PhraseLookup(const gfloat lambda,
 }
 
 PhraseLookup::~PhraseLookup(){
-    clear_steps(m_steps_index, m_steps_content);
+    free_steps(m_steps_index, m_steps_content);
     g_ptr_array_free(m_steps_index, TRUE);
     g_ptr_array_free(m_steps_content, TRUE);
+
+    free_steps(m_spare_steps_index, m_spare_steps_content);
+    g_ptr_array_free(m_spare_steps_index, TRUE);
+    g_ptr_array_free(m_spare_steps_content, TRUE);
 }
 
 bool PhraseLookup::get_best_match(int sentence_length, ucs4_t sentence[],
@@ -122,15 +159,15 @@ bool PhraseLookup::get_best_match(int sentence_length, ucs4_t sentence[],
     m_sentence = sentence;
     int nstep = m_sentence_length + 1;
 
-    clear_steps(m_steps_index, m_steps_content);
+    clear_steps(m_steps_index, m_steps_content,
+                m_spare_steps_index, m_spare_steps_content);
 
-    init_steps(m_steps_index, m_steps_content, nstep);
+    init_steps(m_steps_index, m_steps_content,
+               m_spare_steps_index, m_spare_steps_content, nstep);
 
     populate_prefixes(m_steps_index, m_steps_content);
 
-    PhraseTokens tokens;
-    memset(tokens, 0, sizeof(PhraseTokens));
-    m_phrase_index->prepare_tokens(tokens);
+    ScopedPhraseTokens tokens(m_phrase_index);
 
     for ( int i = 0; i < nstep - 1; ++i ){
         for ( int m = i + 1; m < nstep; ++m ){
@@ -152,8 +189,6 @@ bool PhraseLookup::get_best_match(int sentence_length, ucs4_t sentence[],
         }
     }
 
-    m_phrase_index->destroy_tokens(tokens);
-
     return final_step(result);
 }
 
@@ -307,11 +342,12 @@ bool PhraseLookup::search_bigram2(int nstep, PhraseTokens tokens){
 bool PhraseLookup::unigram_gen_next_step(int nstep, lookup_value_t * cur_value,
 phrase_token_t token){
 
-    if (m_phrase_index->get_phrase_item(token, m_cached_phrase_item))
+    PhraseItemView item;
+    if (m_phrase_index->get_phrase_item_view(token, item))
         return false;
 
-    size_t phrase_length = m_cached_phrase_item.get_phrase_length();
-    gdouble elem_poss = m_cached_phrase_item.get_unigram_frequency() / (gdouble)
+    size_t phrase_length = item.get_phrase_length();
+    gdouble elem_poss = item.get_unigram_frequency() / (gdouble)
         m_phrase_index->get_phrase_index_total_freq();
     if ( elem_poss < DBL_EPSILON )
         return false;
@@ -326,11 +362,12 @@ phrase_token_t token){
 
 bool PhraseLookup::bigram_gen_next_step(int nstep, lookup_value_t * cur_value, phrase_token_t token, gfloat bigram_poss){
 
-    if ( m_phrase_index->get_phrase_item(token, m_cached_phrase_item))
+    PhraseItemView item;
+    if (m_phrase_index->get_phrase_item_view(token, item))
         return false;
 
-    size_t phrase_length = m_cached_phrase_item.get_phrase_length();
-    gdouble unigram_poss = m_cached_phrase_item.get_unigram_frequency() /
+    size_t phrase_length = item.get_phrase_length();
+    gdouble unigram_poss = item.get_unigram_frequency() /
         (gdouble) m_phrase_index->get_phrase_index_total_freq();
 
     if ( bigram_poss < FLT_EPSILON && unigram_poss < DBL_EPSILON )
@@ -354,17 +391,15 @@ bool PhraseLookup::save_next_step(int next_step_pos, lookup_value_t * cur_value,
 
     lookup_key_t next_key = next_value->m_handles[1];
 
-    gpointer key = NULL, value = NULL;
-    gboolean lookup_result = g_hash_table_lookup_extended
-        (next_lookup_index, GUINT_TO_POINTER(next_key), &key, &value);
+    guint32 value = 0;
+    bool lookup_result = next_lookup_index->lookup(next_key, value);
 
     if (!lookup_result){
         g_array_append_val(next_lookup_content, *next_value);
-        g_hash_table_insert(next_lookup_index, GUINT_TO_POINTER(next_key),
-                            GUINT_TO_POINTER(next_lookup_content->len - 1));
+        next_lookup_index->insert(next_key, next_lookup_content->len - 1);
         return true;
     }else{
-        size_t step_index = GPOINTER_TO_UINT(value);
+        size_t step_index = value;
         lookup_value_t * orig_next_value = &g_array_index
             (next_lookup_content, lookup_value_t, step_index);
 
@@ -417,16 +452,14 @@ bool PhraseLookup::final_step(MatchResult & result){
         phrase_token_t last_token = max_value->m_handles[0];
         LookupStepIndex lookup_step_index = (LookupStepIndex) g_ptr_array_index(m_steps_index, cur_step_pos);
 
-        gpointer key = NULL, value = NULL;
-        gboolean result = g_hash_table_lookup_extended
-            (lookup_step_index, GUINT_TO_POINTER(last_token), &key, &value);
-        if ( !result )
+        guint32 value = 0;
+        if (!lookup_step_index->lookup(last_token, value))
             return false;
 
         LookupStepContent lookup_step_content = (LookupStepContent)
             g_ptr_array_index(m_steps_content, cur_step_pos);
         max_value = &g_array_index
-            (lookup_step_content, lookup_value_t, GPOINTER_TO_UINT(value));
+            (lookup_step_content, lookup_value_t, value);
     }
 
     /* no need to reverse the result */
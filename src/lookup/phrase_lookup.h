@@ -45,7 +45,6 @@ private:
     const gfloat bigram_lambda;
     const gfloat unigram_lambda;
 
-    PhraseItem m_cached_phrase_item;
     SingleGram m_merged_single_gram;
 protected:
     //saved varibles
@@ -60,6 +59,10 @@ protected:
     GPtrArray * m_steps_content;
     /* Array of LookupStepContent */
 
+    /* the cleared steps, re-used by the next get_best_match call. */
+    GPtrArray * m_spare_steps_index;
+    GPtrArray * m_spare_steps_content;
+
     /* Saved sentence */
     int m_sentence_length;
     ucs4_t * m_sentence;
@@ -143,9 +143,8 @@ static bool populate_prefixes(GPtrArray * steps_index,
 
         LookupStepIndex initial_step_index = (LookupStepIndex)
             g_ptr_array_index(steps_index, 0);
-        g_hash_table_insert(initial_step_index,
-                            GUINT_TO_POINTER(initial_key),
-                            GUINT_TO_POINTER(initial_step_content->len - 1));
+        initial_step_index->insert(initial_key,
+                                   initial_step_content->len - 1);
     }
 
     return true;
@@ -160,7 +159,7 @@ static bool init_steps(GPtrArray * steps_index,
 
     for (int i = 0; i < nstep; ++i) {
         /* initialize steps_index */
-        g_ptr_array_index(steps_index, i) = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_ptr_array_index(steps_index, i) = new LookupStepTable;
         /* initialize steps_content */
         g_ptr_array_index(steps_content, i) = g_array_new(FALSE, FALSE, sizeof(lookup_value_t));
     }
@@ -171,8 +170,9 @@ static bool init_steps(GPtrArray * steps_index,
 static void clear_steps(GPtrArray * steps_index, GPtrArray * steps_content){
     /* clear steps_index */
     for ( size_t i = 0; i < steps_index->len; ++i){
-        GHashTable * table = (GHashTable *) g_ptr_array_index(steps_index, i);
-        g_hash_table_destroy(table);
+        LookupStepIndex table = (LookupStepIndex)
+            g_ptr_array_index(steps_index, i);
+        delete table;
         g_ptr_array_index(steps_index, i) = NULL;
     }
 
@@ -233,9 +233,7 @@ bool PinyinLookup2::get_best_match(TokenVector prefixes,
 
     populate_prefixes(m_steps_index, m_steps_content, prefixes);
 
-    PhraseIndexRanges ranges;
-    memset(ranges, 0, sizeof(PhraseIndexRanges));
-    m_phrase_index->prepare_ranges(ranges);
+    ScopedPhraseIndexRanges ranges(m_phrase_index);
 
     GPtrArray * candidates = g_ptr_array_new();
     GPtrArray * topresults = g_ptr_array_new();
@@ -300,8 +298,6 @@ bool PinyinLookup2::get_best_match(TokenVector prefixes,
         }
     }
 
-    m_phrase_index->destroy_ranges(ranges);
-
     g_ptr_array_free(candidates, TRUE);
     g_ptr_array_free(topresults, TRUE);
 
@@ -417,24 +413,26 @@ bool PinyinLookup2::unigram_gen_next_step(int start, int end,
                                           lookup_value_t * cur_step,
                                           phrase_token_t token) {
 
-    if (m_phrase_index->get_phrase_item(token, m_cached_phrase_item))
+    PhraseItemView item;
+    if (m_phrase_index->get_phrase_item_view(token, item))
         return false;
 
-    size_t phrase_length = m_cached_phrase_item.get_phrase_length();
-    gdouble elem_poss = m_cached_phrase_item.get_unigram_frequency() / (gdouble)
+    size_t phrase_length = item.get_phrase_length();
+    gdouble elem_poss = item.get_unigram_frequency() / (gdouble)
         m_phrase_index->get_phrase_index_total_freq();
     if ( elem_poss < DBL_EPSILON )
         return false;
 
-    gfloat pinyin_poss = compute_pronunciation_possibility
-        (m_matrix, start, end, m_cached_keys, m_cached_phrase_item);
-    if (pinyin_poss < FLT_EPSILON )
+    gfloat pinyin_log_poss = compute_pronunciation_log_possibility
+        (m_matrix, start, end, m_cached_keys, item);
+    if (pinyin_log_poss < min_pinyin_log_poss)
         return false;
 
     lookup_value_t next_step;
     next_step.m_handles[0] = cur_step->m_handles[1]; next_step.m_handles[1] = token;
     next_step.m_length = cur_step->m_length + phrase_length;
-    next_step.m_poss = cur_step->m_poss + log(elem_poss * pinyin_poss * unigram_lambda);
+    next_step.m_poss = cur_step->m_poss + log(elem_poss * unigram_lambda) +
+        pinyin_log_poss;
     next_step.m_last_step = start;
 
     return save_next_step(end, cur_step, &next_step);
@@ -445,25 +443,27 @@ bool PinyinLookup2::bigram_gen_next_step(int start, int end,
                                          phrase_token_t token,
                                          gfloat bigram_poss) {
 
-    if (m_phrase_index->get_phrase_item(token, m_cached_phrase_item))
+    PhraseItemView item;
+    if (m_phrase_index->get_phrase_item_view(token, item))
         return false;
 
-    size_t phrase_length = m_cached_phrase_item.get_phrase_length();
-    gdouble unigram_poss = m_cached_phrase_item.get_unigram_frequency() /
+    size_t phrase_length = item.get_phrase_length();
+    gdouble unigram_poss = item.get_unigram_frequency() /
         (gdouble) m_phrase_index->get_phrase_index_total_freq();
     if ( bigram_poss < FLT_EPSILON && unigram_poss < DBL_EPSILON )
         return false;
 
-    gfloat pinyin_poss = compute_pronunciation_possibility
-                       (m_matrix, start, end, m_cached_keys, m_cached_phrase_item);
-    if ( pinyin_poss < FLT_EPSILON )
+    gfloat pinyin_log_poss = compute_pronunciation_log_possibility
+                       (m_matrix, start, end, m_cached_keys, item);
+    if ( pinyin_log_poss < min_pinyin_log_poss )
         return false;
 
     lookup_value_t next_step;
     next_step.m_handles[0] = cur_step->m_handles[1]; next_step.m_handles[1] = token;
     next_step.m_length = cur_step->m_length + phrase_length;
     next_step.m_poss = cur_step->m_poss +
-        log((bigram_lambda * bigram_poss + unigram_lambda * unigram_poss) * pinyin_poss);
+        log(bigram_lambda * bigram_poss + unigram_lambda * unigram_poss) +
+        pinyin_log_poss;
     next_step.m_last_step = start;
 
     return save_next_step(end, cur_step, &next_step);
@@ -479,16 +479,15 @@ bool PinyinLookup2::save_next_step(int next_step_pos,
     LookupStepContent next_lookup_content = (LookupStepContent)
         g_ptr_array_index(m_steps_content, next_step_pos);
 
-    gpointer key = NULL, value = NULL;
-    gboolean lookup_result = g_hash_table_lookup_extended
-        (next_lookup_index, GUINT_TO_POINTER(next_key), &key, &value);
+    guint32 value = 0;
+    bool lookup_result = next_lookup_index->lookup(next_key, value);
 
     if ( !lookup_result ){
         g_array_append_val(next_lookup_content, *next_step);
-        g_hash_table_insert(next_lookup_index, GUINT_TO_POINTER(next_key), GUINT_TO_POINTER(next_lookup_content->len - 1));
+        next_lookup_index->insert(next_key, next_lookup_content->len - 1);
         return true;
     }else{
-        size_t step_index = GPOINTER_TO_UINT(value);
+        size_t step_index = value;
         lookup_value_t * orig_next_value = &g_array_index
             (next_lookup_content, lookup_value_t, step_index);
 
@@ -547,16 +546,14 @@ bool PinyinLookup2::final_step(MatchResult & result){
         LookupStepIndex lookup_step_index = (LookupStepIndex)
             g_ptr_array_index(m_steps_index, cur_step_pos);
 
-        gpointer key = NULL, value = NULL;
-        gboolean result = g_hash_table_lookup_extended
-            (lookup_step_index, GUINT_TO_POINTER(last_token), &key, &value);
-        if (!result)
+        guint32 value = 0;
+        if (!lookup_step_index->lookup(last_token, value))
             return false;
 
         LookupStepContent lookup_step_content = (LookupStepContent)
             g_ptr_array_index(m_steps_content, cur_step_pos);
         max_value = &g_array_index
-            (lookup_step_content, lookup_value_t, GPOINTER_TO_UINT(value));
+            (lookup_step_content, lookup_value_t, value);
     }
 
     /* no need to reverse the result */
@@ -643,7 +640,8 @@ bool PinyinLookup2::train_result2(PhoneticKeyMatrix * matrix,
             next_pos = std_lite::min(next_pos, constraints->len - 1);
 
             /* train uni-gram */
-            m_phrase_index->get_phrase_item(token, m_cached_phrase_item);
+            m_phrase_index->get_writable_phrase_item
+                (token, m_cached_phrase_item);
             increase_pronunciation_possibility
                 (matrix, i, next_pos,
                  m_cached_keys, m_cached_phrase_item, seed * pinyin_factor);
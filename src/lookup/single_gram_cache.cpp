@@ -0,0 +1,191 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "single_gram_cache.h"
+#include <assert.h>
+
+using namespace pinyin;
+
+SingleGramCache::SingleGramCache(Bigram * system_bigram,
+                                 Bigram * user_bigram,
+                                 guint32 capacity)
+    : m_capacity(capacity)
+{
+    assert(capacity > 0);
+
+    m_system_bigram = system_bigram;
+    m_user_bigram = user_bigram;
+
+    m_system_generation = 0;
+    m_user_generation = 0;
+
+    m_items = g_array_sized_new
+        (FALSE, FALSE, sizeof(single_gram_cache_item_t), capacity);
+    m_index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    m_head = -1;
+    m_tail = -1;
+
+    m_hits = 0;
+    m_misses = 0;
+
+    check_generation();
+}
+
+SingleGramCache::~SingleGramCache(){
+    clear();
+
+    g_array_free(m_items, TRUE);
+    m_items = NULL;
+    g_hash_table_destroy(m_index);
+    m_index = NULL;
+}
+
+bool SingleGramCache::clear(){
+    for (size_t i = 0; i < m_items->len; ++i) {
+        single_gram_cache_item_t * item = get_item(i);
+        if (item->m_gram)
+            delete item->m_gram;
+        item->m_gram = NULL;
+    }
+    g_array_set_size(m_items, 0);
+    g_hash_table_remove_all(m_index);
+
+    m_head = -1;
+    m_tail = -1;
+    return true;
+}
+
+/* clear the cache when any bi-gram is changed. */
+bool SingleGramCache::check_generation(){
+    guint32 system_generation = 0, user_generation = 0;
+    if (m_system_bigram)
+        system_generation = m_system_bigram->get_generation();
+    if (m_user_bigram)
+        user_generation = m_user_bigram->get_generation();
+
+    if (system_generation == m_system_generation &&
+        user_generation == m_user_generation)
+        return true;
+
+    m_system_generation = system_generation;
+    m_user_generation = user_generation;
+    return clear();
+}
+
+void SingleGramCache::unlink_item(gint32 index){
+    single_gram_cache_item_t * item = get_item(index);
+
+    if (-1 == item->m_prev)
+        m_head = item->m_next;
+    else
+        get_item(item->m_prev)->m_next = item->m_next;
+
+    if (-1 == item->m_next)
+        m_tail = item->m_prev;
+    else
+        get_item(item->m_next)->m_prev = item->m_prev;
+
+    item->m_prev = item->m_next = -1;
+}
+
+void SingleGramCache::link_front(gint32 index){
+    single_gram_cache_item_t * item = get_item(index);
+
+    item->m_prev = -1;
+    item->m_next = m_head;
+
+    if (-1 == m_head)
+        m_tail = index;
+    else
+        get_item(m_head)->m_prev = index;
+
+    m_head = index;
+}
+
+bool SingleGramCache::load(phrase_token_t index,
+                           const SingleGram * & merged){
+    merged = NULL;
+
+    check_generation();
+
+    gpointer value = NULL;
+    gboolean found = g_hash_table_lookup_extended
+        (m_index, GUINT_TO_POINTER(index), NULL, &value);
+
+    if (found) {
+        ++m_hits;
+
+        gint32 pos = GPOINTER_TO_UINT(value) - 1;
+        if (pos != m_head) {
+            unlink_item(pos);
+            link_front(pos);
+        }
+
+        merged = get_item(pos)->m_gram;
+        return NULL != merged;
+    }
+
+    ++m_misses;
+
+    /* merge the system and user single gram. */
+    SingleGram * system = NULL, * user = NULL;
+    if (m_system_bigram)
+        m_system_bigram->load(index, system);
+    if (m_user_bigram)
+        m_user_bigram->load(index, user);
+
+    SingleGram * gram = NULL;
+    if (system || user) {
+        gram = new SingleGram;
+        check_result(merge_single_gram(gram, system, user));
+    }
+
+    if (system)
+        delete system;
+    if (user)
+        delete user;
+
+    /* evict the least recently used item when full. */
+    gint32 pos = -1;
+    if (m_items->len < m_capacity) {
+        pos = m_items->len;
+        g_array_set_size(m_items, m_items->len + 1);
+    } else {
+        pos = m_tail;
+        unlink_item(pos);
+
+        single_gram_cache_item_t * item = get_item(pos);
+        g_hash_table_remove(m_index, GUINT_TO_POINTER(item->m_token));
+        if (item->m_gram)
+            delete item->m_gram;
+    }
+
+    single_gram_cache_item_t * item = get_item(pos);
+    item->m_token = index;
+    item->m_gram = gram;
+    link_front(pos);
+
+    g_hash_table_insert(m_index, GUINT_TO_POINTER(index),
+                        GUINT_TO_POINTER(pos + 1));
+
+    merged = gram;
+    return NULL != merged;
+}
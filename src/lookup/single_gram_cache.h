@@ -0,0 +1,167 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SINGLE_GRAM_CACHE_H
+#define SINGLE_GRAM_CACHE_H
+
+#include <glib.h>
+#include "novel_types.h"
+#include "memory_chunk.h"
+#include "ngram.h"
+
+namespace pinyin{
+
+struct single_gram_cache_item_t{
+    /* the previous token in the bi-gram. */
+    phrase_token_t m_token;
+    /* NULL when neither the system nor the user bi-gram has the token. */
+    SingleGram * m_gram;
+    /* the neighbours in the LRU list, -1 for none. */
+    gint32 m_prev;
+    gint32 m_next;
+};
+
+/**
+ * SingleGramCache:
+ *
+ * The bounded LRU cache of the merged single grams,
+ * keyed by the previous token.
+ *
+ */
+class SingleGramCache{
+private:
+    Bigram * m_system_bigram;
+    Bigram * m_user_bigram;
+
+    /* the generations of the bi-grams when the cache is filled. */
+    guint32 m_system_generation;
+    guint32 m_user_generation;
+
+    const guint32 m_capacity;
+
+    /* Array of single_gram_cache_item_t */
+    GArray * m_items;
+    /* Key: phrase_token_t, Value: the index in m_items plus one. */
+    GHashTable * m_index;
+
+    /* the most and least recently used items. */
+    gint32 m_head;
+    gint32 m_tail;
+
+    guint32 m_hits;
+    guint32 m_misses;
+
+private:
+    single_gram_cache_item_t * get_item(gint32 index) {
+        return &g_array_index(m_items, single_gram_cache_item_t, index);
+    }
+
+    void unlink_item(gint32 index);
+    void link_front(gint32 index);
+    bool check_generation();
+
+public:
+    /**
+     * SingleGramCache::SingleGramCache:
+     * @system_bigram: the system bi-gram.
+     * @user_bigram: the user bi-gram.
+     * @capacity: the maximum number of the cached single grams.
+     *
+     * The constructor of the SingleGramCache.
+     *
+     */
+    SingleGramCache(Bigram * system_bigram, Bigram * user_bigram,
+                    guint32 capacity);
+
+    /**
+     * SingleGramCache::~SingleGramCache:
+     *
+     * The destructor of the SingleGramCache.
+     *
+     */
+    ~SingleGramCache();
+
+    /**
+     * SingleGramCache::load:
+     * @index: the previous token in the bi-gram.
+     * @merged: the merged single gram of the previous token.
+     * @returns: whether the system or the user bi-gram has the token.
+     *
+     * Load the merged single gram of the previous token,
+     * the merged single gram is owned by the cache,
+     * and only valid before the next load call.
+     *
+     */
+    bool load(/* in */ phrase_token_t index,
+              /* out */ const SingleGram * & merged);
+
+    /**
+     * SingleGramCache::clear:
+     * @returns: whether the clear operation is successful.
+     *
+     * Remove all the cached single grams.
+     *
+     */
+    bool clear();
+
+    /**
+     * SingleGramCache::get_capacity:
+     * @returns: the maximum number of the cached single grams.
+     *
+     * Get the capacity of this cache.
+     *
+     */
+    guint32 get_capacity() const {
+        return m_capacity;
+    }
+
+    /**
+     * SingleGramCache::get_statistics:
+     * @hits: the number of the cache hits.
+     * @misses: the number of the cache misses.
+     * @returns: whether the get operation is successful.
+     *
+     * Get the hit and miss counters to tune the capacity.
+     *
+     */
+    bool get_statistics(/* out */ guint32 & hits,
+                        /* out */ guint32 & misses) const {
+        hits = m_hits;
+        misses = m_misses;
+        return true;
+    }
+
+    /**
+     * SingleGramCache::reset_statistics:
+     * @returns: whether the reset operation is successful.
+     *
+     * Reset the hit and miss counters.
+     *
+     */
+    bool reset_statistics() {
+        m_hits = 0;
+        m_misses = 0;
+        return true;
+    }
+};
+
+};
+
+#endif
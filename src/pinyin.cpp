@@ -32,10 +32,38 @@ using namespace pinyin;
 /* reduce bigram frequency affects on candidates sorting */
 #define BIGRAM_FREQUENCY_DISCOUNT 0.1f
 
+/* compact the user journal into the full user files beyond this size. */
+#define USER_JOURNAL_MAX_SIZE (1024 * 1024)
+
 /* a glue layer for input method integration. */
 
 typedef GArray * CandidateVector; /* GArray of lookup_candidate_t */
 
+/* the system tables shared by the contexts of one system directory,
+   they are only read after loaded. */
+typedef struct _system_data_t system_data_t;
+
+struct _system_data_t{
+    gchar * m_system_dir;
+    guint m_ref_count;
+
+    /* the system parts of the default tables. */
+    FacadeChewingTable2 * m_pinyin_table;
+    FacadePhraseTable3 * m_phrase_table;
+    Bigram * m_system_bigram;
+
+    /* addon tables. */
+    FacadeChewingTable2 * m_addon_pinyin_table;
+    FacadePhraseTable3 * m_addon_phrase_table;
+
+    PunctTable * m_system_punct_table;
+
+    /* the loaded system phrase libraries by the file names, the sub
+       phrase indices keep their changes in the overlays. */
+    GHashTable * m_phrase_libraries;
+    GMutex m_phrase_mutex;
+};
+
 struct _pinyin_context_t{
     pinyin_option_t m_options;
 
@@ -44,18 +72,22 @@ struct _pinyin_context_t{
     DoublePinyinParser2 * m_double_pinyin_parser;
     ZhuyinParser2 * m_chewing_parser;
 
-    /* default tables. */
+    /* the shared system tables. */
+    system_data_t * m_system_data;
+
+    /* default tables, the system parts are shared. */
     FacadeChewingTable2 * m_pinyin_table;
     FacadePhraseTable3 * m_phrase_table;
     FacadePhraseIndex * m_phrase_index;
     Bigram * m_system_bigram;
     Bigram * m_user_bigram;
 
-    /* lookups. */
-    PhoneticLookup<2, 3> * m_pinyin_lookup;
-    PhraseLookup * m_phrase_lookup;
+    /* the lookups are allocated per instance, to share the tables. */
+    gfloat m_lambda;
+    size_t m_beam_size;
+    gfloat m_beam_margin;
 
-    /* addon tables. */
+    /* addon tables, the addon pinyin and phrase tables are shared. */
     FacadeChewingTable2 * m_addon_pinyin_table;
     FacadePhraseTable3 * m_addon_phrase_table;
     FacadePhraseIndex * m_addon_phrase_index;
@@ -64,16 +96,37 @@ struct _pinyin_context_t{
     char * m_user_dir;
     bool m_modified;
 
+    /* the changes of the user tables since the last compaction. */
+    UserJournal * m_journal;
+
     SystemTableInfo2 m_system_table_info;
     UserTableInfo m_user_table_info;
 
     PunctTable * m_system_punct_table;
+
+    /* the readers share the tables, the writers change them. */
+    GRWLock m_lock;
+    /* load the pending phrase libraries. */
+    GThread * m_prefetch_thread;
+    /* the background save, started and waited with the save mutex. */
+    GThread * m_save_thread;
+    GMutex m_save_mutex;
+    /* signaled when the background save is finished. */
+    GCond m_save_cond;
+    /* increased when the tables or the options are changed. */
+    guint m_generation;
 };
 
 struct _pinyin_instance_t{
     /* pointer of pinyin_context_t. */
     pinyin_context_t * m_context;
 
+    /* the lookups of this instance. */
+    PhoneticLookup<2, 3> * m_pinyin_lookup;
+    PhraseLookup * m_phrase_lookup;
+    /* the generation of the context seen by the lookups. */
+    guint m_generation;
+
     ucs4_t * m_prefix_ucs4;
     glong m_prefix_len;
     /* the tokens of phrases before the user input. */
@@ -84,6 +137,12 @@ struct _pinyin_instance_t{
     size_t m_parsed_len;
     size_t m_parsed_key_len;
 
+    /* the parsed keys to compute the changed matrix columns. */
+    ChewingKeyVector m_parsed_keys;
+    ChewingKeyRestVector m_parsed_key_rests;
+    /* the first matrix column changed since the last guess. */
+    size_t m_dirty_offset;
+
     /* cached pinyin lookup variables. */
     ForwardPhoneticConstraints * m_constraints;
     NBestMatchResults m_nbest_results;
@@ -146,6 +205,92 @@ struct _bigram_export_iterator_t{
     gint m_count;
 };
 
+/* the storage backends in the startup trace. */
+#ifdef LIBPINYIN_USE_MMAP
+#define TRACE_CHUNK_BACKEND "mmap"
+#else
+#define TRACE_CHUNK_BACKEND "chunk"
+#endif
+
+#if defined(HAVE_BERKELEY_DB)
+#define TRACE_DB_BACKEND "bdb"
+#elif defined(HAVE_KYOTO_CABINET)
+#define TRACE_DB_BACKEND "kyotodb"
+#elif defined(HAVE_TKRZW)
+#define TRACE_DB_BACKEND "tkrzw"
+#else
+#define TRACE_DB_BACKEND "db"
+#endif
+
+/* the startup trace callback. */
+static GMutex trace_mutex;
+static pinyin_trace_func_t trace_func = NULL;
+static gpointer trace_user_data = NULL;
+
+void pinyin_set_trace_func(pinyin_trace_func_t func, gpointer user_data){
+    MutexLocker locker(&trace_mutex);
+    trace_func = func;
+    trace_user_data = user_data;
+}
+
+/* print the JSON string member, escape the quotes, the backslashes
+   and the control characters. */
+static void _trace_json_string(const char * name, const char * value){
+    fprintf(stderr, "\"%s\": \"", name);
+    for (const char * p = value; *p; ++p) {
+        const guchar ch = *p;
+        if ('"' == ch || '\\' == ch)
+            fprintf(stderr, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(stderr, "\\u%04x", ch);
+        else
+            fputc(ch, stderr);
+    }
+    fprintf(stderr, "\", ");
+}
+
+/* report the phase since the begin time, with the size of the file. */
+static void _trace_phase(const char * phase, const char * filename,
+                         const char * backend, gint64 begin){
+    guint64 duration = g_get_monotonic_time() - begin;
+
+    pinyin_trace_func_t func = NULL;
+    gpointer user_data = NULL;
+    {
+        MutexLocker locker(&trace_mutex);
+        func = trace_func;
+        user_data = trace_user_data;
+    }
+
+    if (NULL == func && NULL == g_getenv("LIBPINYIN_TRACE"))
+        return;
+
+    guint64 bytes = 0;
+    gchar * table = NULL;
+    if (filename) {
+        GStatBuf buf;
+        if (0 == g_stat(filename, &buf))
+            bytes = buf.st_size;
+        table = g_path_get_basename(filename);
+    }
+
+    if (func) {
+        func(phase, table, backend, duration, bytes, user_data);
+    } else {
+        /* one JSON object per line. */
+        fprintf(stderr, "{");
+        _trace_json_string("phase", phase);
+        if (table)
+            _trace_json_string("table", table);
+        if (backend)
+            _trace_json_string("backend", backend);
+        fprintf(stderr, "\"duration\": %" G_GUINT64_FORMAT ", "
+                "\"bytes\": %" G_GUINT64_FORMAT "}\n", duration, bytes);
+    }
+
+    g_free(table);
+}
+
 static bool _clean_user_files(const char * user_dir,
                               const pinyin_table_info_t * phrase_files){
     /* clean up files, if version mis-matches. */
@@ -214,6 +359,11 @@ static bool check_format(pinyin_context_t * context){
     unlink(filename);
     g_free(filename);
 
+    filename = g_build_filename
+        (user_dir, USER_JOURNAL, NULL);
+    unlink(filename);
+    g_free(filename);
+
     return exists;
 }
 
@@ -231,10 +381,63 @@ static bool mark_version(pinyin_context_t * context){
     return retval;
 }
 
-static bool _load_phrase_library (const char * system_dir,
+/* wait for the previous background save, with the save mutex,
+   the callback of the save doesn't wait for its own save thread. */
+static void _join_save_thread(pinyin_context_t * context){
+    while (context->m_save_thread &&
+           g_thread_self() != context->m_save_thread)
+        g_cond_wait(&context->m_save_cond, &context->m_save_mutex);
+}
+
+/* load the system phrase library once for the contexts,
+   return the memory chunk which refers to the shared content. */
+static MemoryChunk * _load_shared_phrase_library(guint8 index,
+                                                 const char * filename,
+                                                 gpointer user_data){
+    system_data_t * data = (system_data_t *) user_data;
+    MutexLocker locker(&data->m_phrase_mutex);
+
+    MemoryChunk * shared = (MemoryChunk *)
+        g_hash_table_lookup(data->m_phrase_libraries, filename);
+    if (NULL == shared) {
+        shared = new MemoryChunk;
+#ifdef LIBPINYIN_USE_MMAP
+        bool retval = shared->mmap(filename);
+#else
+        bool retval = shared->load(filename);
+#endif
+        if (!retval) {
+            delete shared;
+            return NULL;
+        }
+
+        g_hash_table_insert(data->m_phrase_libraries,
+                            g_strdup(filename), shared);
+    }
+
+    MemoryChunk * chunk = new MemoryChunk;
+    chunk->set_chunk(shared->begin(), shared->size(), NULL);
+    return chunk;
+}
+
+/* load the pending system phrase library when its phrases are used. */
+static MemoryChunk * _load_pending_phrase_library(guint8 index,
+                                                  const char * filename,
+                                                  gpointer user_data){
+    gint64 begin = g_get_monotonic_time();
+    MemoryChunk * chunk = _load_shared_phrase_library
+        (index, filename, user_data);
+    if (chunk)
+        _trace_phase("lazy_library", filename,
+                     TRACE_CHUNK_BACKEND, begin);
+    return chunk;
+}
+
+static bool _load_phrase_library (system_data_t * system_data,
                                   const char * user_dir,
                                   FacadePhraseIndex * phrase_index,
                                   const pinyin_table_info_t * table_info){
+    const char * system_dir = system_data->m_system_dir;
     /* check whether the sub phrase index is already loaded. */
     PhraseIndexRange range;
     guint8 index = table_info->m_dict_index;
@@ -243,26 +446,28 @@ static bool _load_phrase_library (const char * system_dir,
     if (ERROR_OK == retval)
         return false;
 
+    gint64 begin = g_get_monotonic_time();
+
     if (SYSTEM_FILE == table_info->m_file_type) {
         /* system phrase library */
-        MemoryChunk * chunk = new MemoryChunk;
-
         const char * systemfilename = table_info->m_system_filename;
         /* check bin file in system dir. */
         gchar * chunkfilename = g_build_filename(system_dir,
                                                  systemfilename, NULL);
-#ifdef LIBPINYIN_USE_MMAP
-        if (!chunk->mmap(chunkfilename))
-            fprintf(stderr, "mmap %s failed!\n", chunkfilename);
-#else
-        if (!chunk->load(chunkfilename))
+        MemoryChunk * chunk = _load_shared_phrase_library
+            (index, chunkfilename, system_data);
+        if (NULL == chunk) {
             fprintf(stderr, "open %s failed!\n", chunkfilename);
-#endif
-
-        g_free(chunkfilename);
+            g_free(chunkfilename);
+            return false;
+        }
 
         phrase_index->load(index, chunk);
+        _trace_phase("phrase_library", chunkfilename,
+                     TRACE_CHUNK_BACKEND, begin);
+        g_free(chunkfilename);
 
+        begin = g_get_monotonic_time();
         const char * userfilename = table_info->m_user_filename;
 
         chunkfilename = g_build_filename(user_dir,
@@ -270,32 +475,32 @@ static bool _load_phrase_library (const char * system_dir,
 
         MemoryChunk * log = new MemoryChunk;
         log->load(chunkfilename);
-        g_free(chunkfilename);
 
         /* merge the chunk log. */
         phrase_index->merge(index, log);
+        _trace_phase("phrase_log", chunkfilename, "chunk", begin);
+        g_free(chunkfilename);
         return true;
     }
 
     if (DICTIONARY == table_info->m_file_type) {
         /* addon dictionary. */
-        MemoryChunk * chunk = new MemoryChunk;
-
         const char * systemfilename = table_info->m_system_filename;
         /* check bin file in system dir. */
         gchar * chunkfilename = g_build_filename(system_dir,
                                                  systemfilename, NULL);
-#ifdef LIBPINYIN_USE_MMAP
-        if (!chunk->mmap(chunkfilename))
-            fprintf(stderr, "mmap %s failed!\n", chunkfilename);
-#else
-        if (!chunk->load(chunkfilename))
+        MemoryChunk * chunk = _load_shared_phrase_library
+            (index, chunkfilename, system_data);
+        if (NULL == chunk) {
             fprintf(stderr, "open %s failed!\n", chunkfilename);
-#endif
-
-        g_free(chunkfilename);
+            g_free(chunkfilename);
+            return false;
+        }
 
         phrase_index->load(index, chunk);
+        _trace_phase("phrase_library", chunkfilename,
+                     TRACE_CHUNK_BACKEND, begin);
+        g_free(chunkfilename);
 
         return true;
     }
@@ -316,6 +521,7 @@ static bool _load_phrase_library (const char * system_dir,
             phrase_index->create_sub_phrase(index);
         }
 
+        _trace_phase("phrase_library", chunkfilename, "chunk", begin);
         g_free(chunkfilename);
         return true;
     }
@@ -323,55 +529,253 @@ static bool _load_phrase_library (const char * system_dir,
     return false;
 }
 
+/* defer loading the system phrase library until its phrases are used. */
+static bool _load_phrase_library_on_demand(system_data_t * system_data,
+                                           const char * user_dir,
+                                           FacadePhraseIndex * phrase_index,
+                                           const pinyin_table_info_t * table_info){
+    if (SYSTEM_FILE != table_info->m_file_type)
+        return _load_phrase_library(system_data, user_dir,
+                                    phrase_index, table_info);
+
+    const char * system_dir = system_data->m_system_dir;
+
+    gint64 begin = g_get_monotonic_time();
+    guint8 index = table_info->m_dict_index;
+    gchar * chunkfilename = g_build_filename
+        (system_dir, table_info->m_system_filename, NULL);
+    gchar * logfilename = g_build_filename
+        (user_dir, table_info->m_user_filename, NULL);
+
+    bool retval = phrase_index->load_on_demand
+        (index, chunkfilename, logfilename);
+    if (retval)
+        _trace_phase("pending_library", chunkfilename,
+                     TRACE_CHUNK_BACKEND, begin);
+
+    g_free(logfilename);
+    g_free(chunkfilename);
+
+    if (retval)
+        return true;
+
+    /* report the missing file as before. */
+    return _load_phrase_library(system_data, user_dir,
+                                phrase_index, table_info);
+}
+
+/* load the pending phrase libraries in the background. */
+static gpointer _prefetch_phrase_libraries(gpointer data){
+    pinyin_context_t * context = (pinyin_context_t *) data;
+
+    for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
+        /* the searches continue between the libraries. */
+        ReaderLocker locker(&context->m_lock);
+        context->m_phrase_index->load_pending(i);
+    }
+
+    return NULL;
+}
+
+static void _free_memory_chunk(gpointer data){
+    delete (MemoryChunk *) data;
+}
+
+/* the system data of the system directories. */
+static GMutex system_data_mutex;
+static GHashTable * system_data_table = NULL;
+
+static system_data_t * _ref_system_data(const char * system_dir){
+    MutexLocker locker(&system_data_mutex);
+
+    if (NULL == system_data_table)
+        system_data_table = g_hash_table_new(g_str_hash, g_str_equal);
+
+    gint64 begin = g_get_monotonic_time();
+    system_data_t * data = (system_data_t *)
+        g_hash_table_lookup(system_data_table, system_dir);
+    if (data) {
+        ++data->m_ref_count;
+        _trace_phase("system_table", NULL, "shared", begin);
+        return data;
+    }
+
+    data = new system_data_t;
+    data->m_system_dir = g_strdup(system_dir);
+    data->m_ref_count = 1;
+
+    /* load chewing table. */
+    data->m_pinyin_table = new FacadeChewingTable2;
+    gchar * filename = g_build_filename
+        (system_dir, SYSTEM_PINYIN_INDEX, NULL);
+    data->m_pinyin_table->load(filename, NULL);
+    _trace_phase("system_table", filename,
+                 data->m_pinyin_table->is_system_sorted() ?
+                 TRACE_CHUNK_BACKEND : TRACE_DB_BACKEND, begin);
+    g_free(filename);
+
+    /* load phrase table */
+    begin = g_get_monotonic_time();
+    data->m_phrase_table = new FacadePhraseTable3;
+    filename = g_build_filename(system_dir, SYSTEM_PHRASE_INDEX, NULL);
+    data->m_phrase_table->load(filename, NULL);
+    _trace_phase("system_table", filename,
+                 data->m_phrase_table->is_system_hashed() ?
+                 TRACE_CHUNK_BACKEND : TRACE_DB_BACKEND, begin);
+    g_free(filename);
+
+    begin = g_get_monotonic_time();
+    data->m_system_bigram = new Bigram;
+    filename = g_build_filename(system_dir, SYSTEM_BIGRAM, NULL);
+    data->m_system_bigram->attach(filename, ATTACH_READONLY);
+    _trace_phase("system_table", filename, TRACE_DB_BACKEND, begin);
+    g_free(filename);
+
+    /* load addon chewing table. */
+    begin = g_get_monotonic_time();
+    data->m_addon_pinyin_table = new FacadeChewingTable2;
+    filename = g_build_filename(system_dir, ADDON_SYSTEM_PINYIN_INDEX, NULL);
+    data->m_addon_pinyin_table->load(filename, NULL);
+    _trace_phase("system_table", filename,
+                 data->m_addon_pinyin_table->is_system_sorted() ?
+                 TRACE_CHUNK_BACKEND : TRACE_DB_BACKEND, begin);
+    g_free(filename);
+
+    /* load addon phrase table */
+    begin = g_get_monotonic_time();
+    data->m_addon_phrase_table = new FacadePhraseTable3;
+    filename = g_build_filename(system_dir, ADDON_SYSTEM_PHRASE_INDEX, NULL);
+    data->m_addon_phrase_table->load(filename, NULL);
+    _trace_phase("system_table", filename,
+                 data->m_addon_phrase_table->is_system_hashed() ?
+                 TRACE_CHUNK_BACKEND : TRACE_DB_BACKEND, begin);
+    g_free(filename);
+
+    /* load system punct table. */
+    begin = g_get_monotonic_time();
+    data->m_system_punct_table = new PunctTable;
+    filename = g_build_filename(system_dir, SYSTEM_PUNCT_TABLE, NULL);
+    data->m_system_punct_table->attach(filename, ATTACH_READONLY);
+    _trace_phase("system_table", filename, TRACE_DB_BACKEND, begin);
+    g_free(filename);
+
+    /* the system phrase libraries are loaded when used. */
+    data->m_phrase_libraries = g_hash_table_new_full
+        (g_str_hash, g_str_equal, g_free, _free_memory_chunk);
+    g_mutex_init(&data->m_phrase_mutex);
+
+    g_hash_table_insert(system_data_table, data->m_system_dir, data);
+    return data;
+}
+
+static void _unref_system_data(system_data_t * data){
+    MutexLocker locker(&system_data_mutex);
+
+    if (--data->m_ref_count)
+        return;
+
+    g_hash_table_remove(system_data_table, data->m_system_dir);
+
+    delete data->m_pinyin_table;
+    delete data->m_phrase_table;
+    delete data->m_system_bigram;
+    delete data->m_addon_pinyin_table;
+    delete data->m_addon_phrase_table;
+    delete data->m_system_punct_table;
+
+    g_hash_table_destroy(data->m_phrase_libraries);
+    g_mutex_clear(&data->m_phrase_mutex);
+
+    g_free(data->m_system_dir);
+    delete data;
+}
+
+/* the shared tables are changed, must be called with the writer lock. */
+static void _invalidate_lookups(pinyin_context_t * context){
+    ++context->m_generation;
+}
+
+/* sync the lookups of the instance with the shared tables,
+   must be called with the reader lock. */
+static void _sync_lookups(pinyin_instance_t * instance){
+    pinyin_context_t * context = instance->m_context;
+    if (instance->m_generation == context->m_generation)
+        return;
+
+    instance->m_pinyin_lookup->invalidate_trellis();
+    if (context->m_beam_size)
+        check_result(instance->m_pinyin_lookup->set_beam
+                     (context->m_beam_size, context->m_beam_margin));
+    instance->m_generation = context->m_generation;
+}
+
 pinyin_context_t * pinyin_init(const char * systemdir, const char * userdir){
+    const gint64 init_begin = g_get_monotonic_time();
     pinyin_context_t * context = new pinyin_context_t;
 
     context->m_options = USE_TONE;
+    g_rw_lock_init(&context->m_lock);
+    context->m_prefetch_thread = NULL;
+    context->m_save_thread = NULL;
+    g_mutex_init(&context->m_save_mutex);
+    g_cond_init(&context->m_save_cond);
+    context->m_generation = 0;
 
     context->m_system_dir = g_strdup(systemdir);
     context->m_user_dir = g_strdup(userdir);
     context->m_modified = false;
 
+    gint64 begin = g_get_monotonic_time();
     gchar * filename = g_build_filename
         (context->m_system_dir, SYSTEM_TABLE_INFO, NULL);
     if (!context->m_system_table_info.load(filename)) {
         fprintf(stderr, "load %s failed!\n", filename);
         return NULL;
     }
+    _trace_phase("table_info", filename, "conf", begin);
     g_free(filename);
 
 
+    begin = g_get_monotonic_time();
     check_format(context);
+    filename = g_build_filename
+        (context->m_user_dir, USER_TABLE_INFO, NULL);
+    _trace_phase("check_format", filename, "conf", begin);
+    g_free(filename);
 
     context->m_full_pinyin_parser = new FullPinyinParser2;
     context->m_double_pinyin_parser = new DoublePinyinParser2;
     context->m_chewing_parser = new ZhuyinSimpleParser2;
 
+    /* share the system tables with the other contexts. */
+    system_data_t * system_data = _ref_system_data(context->m_system_dir);
+    context->m_system_data = system_data;
+
     /* load chewing table. */
     context->m_pinyin_table = new FacadeChewingTable2;
 
-    gchar * system_filename = g_build_filename
-        (context->m_system_dir, SYSTEM_PINYIN_INDEX, NULL);
+    begin = g_get_monotonic_time();
     gchar * user_filename = g_build_filename
         (context->m_user_dir, USER_PINYIN_INDEX, NULL);
-    context->m_pinyin_table->load(system_filename, user_filename);
+    context->m_pinyin_table->load(system_data->m_pinyin_table, user_filename);
+    _trace_phase("user_table", user_filename, TRACE_DB_BACKEND, begin);
     g_free(user_filename);
-    g_free(system_filename);
 
 
     /* load phrase table */
     context->m_phrase_table = new FacadePhraseTable3;
 
-    system_filename = g_build_filename
-        (context->m_system_dir, SYSTEM_PHRASE_INDEX, NULL);
+    begin = g_get_monotonic_time();
     user_filename = g_build_filename
         (context->m_user_dir, USER_PHRASE_INDEX, NULL);
-    context->m_phrase_table->load(system_filename, user_filename);
+    context->m_phrase_table->load(system_data->m_phrase_table, user_filename);
+    _trace_phase("user_table", user_filename, TRACE_DB_BACKEND, begin);
     g_free(user_filename);
-    g_free(system_filename);
 
 
     context->m_phrase_index = new FacadePhraseIndex;
+    context->m_phrase_index->set_loader
+        (_load_pending_phrase_library, system_data);
 
     /* load all default tables. */
     for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i){
@@ -387,59 +791,51 @@ pinyin_context_t * pinyin_init(const char * systemdir, const char * userdir){
         /* addon dictionary should not in default tables. */
         assert(DICTIONARY != table_info->m_file_type);
 
-        _load_phrase_library(context->m_system_dir, context->m_user_dir,
-                             context->m_phrase_index, table_info);
+        _load_phrase_library_on_demand
+            (system_data, context->m_user_dir,
+             context->m_phrase_index, table_info);
     }
 
-    context->m_system_bigram = new Bigram;
-    filename = g_build_filename(context->m_system_dir, SYSTEM_BIGRAM, NULL);
-    context->m_system_bigram->attach(filename, ATTACH_READONLY);
-    g_free(filename);
+    context->m_system_bigram = system_data->m_system_bigram;
 
+    begin = g_get_monotonic_time();
     context->m_user_bigram = new Bigram;
     filename = g_build_filename(context->m_user_dir, USER_BIGRAM, NULL);
     context->m_user_bigram->load_db(filename);
+    _trace_phase("user_table", filename, TRACE_DB_BACKEND, begin);
     g_free(filename);
 
-    gfloat lambda = context->m_system_table_info.get_lambda();
-
-    context->m_pinyin_lookup = new PhoneticLookup<2, 3>
-        (lambda,
-         context->m_pinyin_table, context->m_phrase_index,
-         context->m_system_bigram, context->m_user_bigram);
-
-    context->m_phrase_lookup = new PhraseLookup
-        (lambda,
-         context->m_phrase_table, context->m_phrase_index,
-         context->m_system_bigram, context->m_user_bigram);
-
-    /* load addon chewing table. */
-    context->m_addon_pinyin_table = new FacadeChewingTable2;
+    /* replay the saved changes since the last compaction. */
+    begin = g_get_monotonic_time();
+    context->m_journal = new UserJournal;
+    filename = g_build_filename(context->m_user_dir, USER_JOURNAL, NULL);
+    if (context->m_journal->load(filename))
+        context->m_journal->replay
+            (context->m_pinyin_table, context->m_phrase_table,
+             context->m_phrase_index, context->m_user_bigram);
+    _trace_phase("user_journal", filename, "journal", begin);
+    g_free(filename);
 
-    system_filename = g_build_filename
-        (context->m_system_dir, ADDON_SYSTEM_PINYIN_INDEX, NULL);
-    context->m_addon_pinyin_table->load(system_filename, NULL);
-    g_free(system_filename);
+    context->m_pinyin_table->set_journal(context->m_journal);
+    context->m_phrase_table->set_journal(context->m_journal);
+    context->m_phrase_index->set_journal(context->m_journal);
+    context->m_user_bigram->set_journal(context->m_journal);
 
-    /* load addon phrase table */
-    context->m_addon_phrase_table = new FacadePhraseTable3;
+    context->m_lambda = context->m_system_table_info.get_lambda();
+    /* use the default beam of the lookups. */
+    context->m_beam_size = 0;
+    context->m_beam_margin = FLT_MAX;
 
-    system_filename = g_build_filename
-        (context->m_system_dir, ADDON_SYSTEM_PHRASE_INDEX, NULL);
-    context->m_addon_phrase_table->load(system_filename, NULL);
-    g_free(system_filename);
+    context->m_addon_pinyin_table = system_data->m_addon_pinyin_table;
+    context->m_addon_phrase_table = system_data->m_addon_phrase_table;
 
     context->m_addon_phrase_index = new FacadePhraseIndex;
 
     /* don't load addon phrase libraries. */
 
-    /* load system punct table. */
-    context->m_system_punct_table = new PunctTable;
-    system_filename = g_build_filename
-        (context->m_system_dir, SYSTEM_PUNCT_TABLE, NULL);
-    context->m_system_punct_table->attach(system_filename, ATTACH_READONLY);
-    g_free(system_filename);
+    context->m_system_punct_table = system_data->m_system_punct_table;
 
+    _trace_phase("init", NULL, NULL, init_begin);
     return context;
 }
 
@@ -457,8 +853,28 @@ bool pinyin_load_phrase_library(pinyin_context_t * context,
     assert(SYSTEM_FILE == table_info->m_file_type
            || USER_FILE == table_info->m_file_type);
 
-    return _load_phrase_library(context->m_system_dir, context->m_user_dir,
-                                phrase_index, table_info);
+    /* the journal is re-read after the previous save. */
+    MutexLocker save_locker(&context->m_save_mutex);
+    _join_save_thread(context);
+
+    WriterLocker locker(&context->m_lock);
+    _invalidate_lookups(context);
+    if (!_load_phrase_library(context->m_system_data, context->m_user_dir,
+                              phrase_index, table_info))
+        return false;
+
+    /* the user log doesn't contain the changes in the journal. */
+    context->m_journal->replay_phrase_library(phrase_index, index);
+    return true;
+}
+
+bool pinyin_prefetch_phrase_libraries(pinyin_context_t * context){
+    if (context->m_prefetch_thread)
+        return false;
+
+    context->m_prefetch_thread = g_thread_new
+        ("prefetch", _prefetch_phrase_libraries, context);
+    return NULL != context->m_prefetch_thread;
 }
 
 bool pinyin_unload_phrase_library(pinyin_context_t * context,
@@ -470,7 +886,9 @@ bool pinyin_unload_phrase_library(pinyin_context_t * context,
     if (GBK_DICTIONARY != index)
         return false;
 
+    WriterLocker locker(&context->m_lock);
     context->m_phrase_index->unload(index);
+    _invalidate_lookups(context);
     return true;
 }
 
@@ -490,7 +908,8 @@ bool pinyin_load_addon_phrase_library(pinyin_context_t * context,
     /* Only DICTIONARY is allowed here. */
     assert(DICTIONARY == table_info->m_file_type);
 
-    return _load_phrase_library(context->m_system_dir, context->m_user_dir,
+    WriterLocker locker(&context->m_lock);
+    return _load_phrase_library(context->m_system_data, context->m_user_dir,
                                 phrase_index, table_info);
 }
 
@@ -499,6 +918,7 @@ bool pinyin_unload_addon_phrase_library(pinyin_context_t * context,
     assert(index < PHRASE_INDEX_LIBRARY_COUNT);
 
     /* addon table. */
+    WriterLocker locker(&context->m_lock);
     context->m_addon_phrase_index->unload(index);
     return true;
 }
@@ -534,12 +954,9 @@ static bool _add_phrase(pinyin_context_t * context,
     GArray * tokenarray = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
 
     /* do phrase table search. */
-    PhraseTokens tokens;
-    memset(tokens, 0, sizeof(PhraseTokens));
-    phrase_index->prepare_tokens(tokens);
+    ScopedPhraseTokens tokens(phrase_index);
     int retval = phrase_table->search(phrase_length, phrase, tokens);
     int num = reduce_tokens(tokens, tokenarray);
-    phrase_index->destroy_tokens(tokens);
 
     /* find the best token candidate. */
     for (size_t i = 0; i < tokenarray->len; ++i) {
@@ -608,6 +1025,9 @@ static bool _add_phrase(pinyin_context_t * context,
         }
     }
 
+    if (result)
+        _invalidate_lookups(context);
+
     return result;
 }
 
@@ -643,8 +1063,11 @@ bool pinyin_iterator_add_phrase(import_iterator_t * iter,
     if (0 == phrase_length || phrase_length >= MAX_PHRASE_LENGTH)
         return result;
 
-    result = _add_phrase(context, index, keys,
-                         ucs4_phrase, phrase_length, count);
+    {
+        WriterLocker locker(&context->m_lock);
+        result = _add_phrase(context, index, keys,
+                             ucs4_phrase, phrase_length, count);
+    }
 
     g_array_free(key_rests, TRUE);
     g_array_free(keys, TRUE);
@@ -653,9 +1076,12 @@ bool pinyin_iterator_add_phrase(import_iterator_t * iter,
 }
 
 void pinyin_end_add_phrases(import_iterator_t * iter){
-    /* compact the content memory chunk of phrase index. */
-    iter->m_context->m_phrase_index->compact();
-    iter->m_context->m_modified = true;
+    {
+        WriterLocker locker(&iter->m_context->m_lock);
+        /* compact the content memory chunk of phrase index. */
+        iter->m_context->m_phrase_index->compact();
+        iter->m_context->m_modified = true;
+    }
     delete iter;
 }
 
@@ -667,6 +1093,8 @@ export_iterator_t * pinyin_begin_get_phrases(pinyin_context_t * context,
     iter->m_next_token = null_token;
     iter->m_next_pronunciation = 0;
 
+    ReaderLocker locker(&context->m_lock);
+
     /* probe next token. */
     PhraseIndexRange range;
     int retval = iter->m_context->m_phrase_index->get_range
@@ -702,6 +1130,8 @@ bool pinyin_iterator_get_next_phrase(export_iterator_t * iter,
     /* count "-1" means default count. */
     *phrase = NULL; *pinyin = NULL; *count = -1;
 
+    ReaderLocker locker(&iter->m_context->m_lock);
+
     PhraseItem item;
     int retval = iter->m_context->m_phrase_index->get_phrase_item
         (iter->m_next_token, item);
@@ -776,7 +1206,10 @@ bigram_export_iterator_t * pinyin_begin_get_bigram_phrases(pinyin_context_t * co
     bigram_export_iterator_t * iter = new bigram_export_iterator_t;
     iter->m_context = context;
     iter->m_items = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
-    context->m_user_bigram->get_all_items(iter->m_items);
+    {
+        ReaderLocker locker(&context->m_lock);
+        context->m_user_bigram->get_all_items(iter->m_items);
+    }
     iter->m_index_token = null_token;
     iter->m_phrase_tokens = g_array_new(TRUE, TRUE, sizeof(BigramPhraseItemWithCount));
     iter->m_phrase = NULL;
@@ -795,6 +1228,8 @@ bool pinyin_bigram_iterator_has_next_phrase(bigram_export_iterator_t * iter){
     if (iter->m_phrase && iter->m_pinyin_index < iter->m_pinyins->len)
         return true;
 
+    ReaderLocker locker(&iter->m_context->m_lock);
+
     /* clean up old values. */
     iter->m_pinyin_index = 0;
     g_ptr_array_free(iter->m_pinyins, TRUE);
@@ -885,7 +1320,7 @@ bool pinyin_bigram_iterator_has_next_phrase(bigram_export_iterator_t * iter){
         iter->m_index_token = g_array_index(iter->m_items, phrase_token_t, 0);
         g_array_remove_index(iter->m_items, 0);
         SingleGram * user_gram = NULL;
-        iter->m_context->m_user_bigram->load(iter->m_index_token, user_gram, true);
+        iter->m_context->m_user_bigram->load(iter->m_index_token, user_gram);
         user_gram->retrieve_all(iter->m_phrase_tokens);
         delete user_gram;
     } while (iter->m_items->len);
@@ -925,10 +1360,10 @@ static bool _write_files(pinyin_context_t * context){
 
     /* skip the reserved zero phrase library. */
     for (size_t i = 1; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
-        PhraseIndexRange range;
-        int retval = context->m_phrase_index->get_range(i, range);
-
-        if (ERROR_NO_SUB_PHRASE_INDEX == retval)
+        /* only write the changed sub phrase index,
+           don't load the pending sub phrase index here. */
+        if (!context->m_phrase_index->is_dirty(i) ||
+            !context->m_phrase_index->is_loaded(i))
             continue;
 
         const pinyin_table_info_t * table_info = phrase_files + i;
@@ -944,20 +1379,18 @@ static bool _write_files(pinyin_context_t * context){
         if (SYSTEM_FILE == table_info->m_file_type ||
             DICTIONARY == table_info->m_file_type) {
             /* system phrase library */
-            MemoryChunk * chunk = new MemoryChunk;
             MemoryChunk * log = new MemoryChunk;
             const char * systemfilename = table_info->m_system_filename;
 
             /* check bin file in system dir. */
             gchar * chunkfilename = g_build_filename(context->m_system_dir,
                                                      systemfilename, NULL);
-#ifdef LIBPINYIN_USE_MMAP
-            if (!chunk->mmap(chunkfilename))
-                fprintf(stderr, "mmap %s failed!\n", chunkfilename);
-#else
-            if (!chunk->load(chunkfilename))
+            MemoryChunk * chunk = _load_shared_phrase_library
+                (i, chunkfilename, context->m_system_data);
+            if (NULL == chunk) {
                 fprintf(stderr, "open %s failed!\n", chunkfilename);
-#endif
+                chunk = new MemoryChunk;
+            }
 
             g_free(chunkfilename);
             context->m_phrase_index->diff(i, chunk, log);
@@ -994,30 +1427,36 @@ static bool _write_files(pinyin_context_t * context){
     }
 
     /* save user pinyin table */
-    gchar * tmpfilename = g_build_filename
-        (context->m_user_dir, USER_PINYIN_INDEX ".tmp", NULL);
-    unlink(tmpfilename);
+    if (context->m_pinyin_table->is_dirty()) {
+        gchar * tmpfilename = g_build_filename
+            (context->m_user_dir, USER_PINYIN_INDEX ".tmp", NULL);
+        unlink(tmpfilename);
 
-    context->m_pinyin_table->store(tmpfilename);
+        context->m_pinyin_table->store(tmpfilename);
 
-    g_free(tmpfilename);
+        g_free(tmpfilename);
+    }
 
     /* save user phrase table */
-    tmpfilename = g_build_filename
-        (context->m_user_dir, USER_PHRASE_INDEX ".tmp", NULL);
-    unlink(tmpfilename);
+    if (context->m_phrase_table->is_dirty()) {
+        gchar * tmpfilename = g_build_filename
+            (context->m_user_dir, USER_PHRASE_INDEX ".tmp", NULL);
+        unlink(tmpfilename);
 
-    context->m_phrase_table->store(tmpfilename);
+        context->m_phrase_table->store(tmpfilename);
 
-    g_free(tmpfilename);
+        g_free(tmpfilename);
+    }
 
     /* save user bi-gram */
-    tmpfilename = g_build_filename
-        (context->m_user_dir, USER_BIGRAM ".tmp", NULL);
-    unlink(tmpfilename);
-    context->m_user_bigram->save_db(tmpfilename);
+    if (context->m_user_bigram->is_dirty()) {
+        gchar * tmpfilename = g_build_filename
+            (context->m_user_dir, USER_BIGRAM ".tmp", NULL);
+        unlink(tmpfilename);
+        context->m_user_bigram->save_db(tmpfilename);
 
-    g_free(tmpfilename);
+        g_free(tmpfilename);
+    }
 
     return true;
 }
@@ -1028,10 +1467,10 @@ static bool _rename_files(pinyin_context_t * context){
 
     /* skip the reserved zero phrase library. */
     for (size_t i = 1; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
-        PhraseIndexRange range;
-        int retval = context->m_phrase_index->get_range(i, range);
-
-        if (ERROR_NO_SUB_PHRASE_INDEX == retval)
+        /* only write the changed sub phrase index,
+           don't load the pending sub phrase index here. */
+        if (!context->m_phrase_index->is_dirty(i) ||
+            !context->m_phrase_index->is_loaded(i))
             continue;
 
         const pinyin_table_info_t * table_info = phrase_files + i;
@@ -1086,59 +1525,99 @@ static bool _rename_files(pinyin_context_t * context){
     }
 
     /* save user pinyin table */
-    gchar * tmpfilename = g_build_filename
-        (context->m_user_dir, USER_PINYIN_INDEX ".tmp", NULL);
-    gchar * filename = g_build_filename
-        (context->m_user_dir, USER_PINYIN_INDEX, NULL);
-
-    int result = rename(tmpfilename, filename);
-    if (0 != result)
-        fprintf(stderr, "rename %s to %s failed.\n",
-                tmpfilename, filename);
-
-    g_free(tmpfilename);
-    g_free(filename);
+    if (context->m_pinyin_table->is_dirty()) {
+        gchar * tmpfilename = g_build_filename
+            (context->m_user_dir, USER_PINYIN_INDEX ".tmp", NULL);
+        gchar * filename = g_build_filename
+            (context->m_user_dir, USER_PINYIN_INDEX, NULL);
+
+        int result = rename(tmpfilename, filename);
+        if (0 != result)
+            fprintf(stderr, "rename %s to %s failed.\n",
+                    tmpfilename, filename);
+
+        g_free(tmpfilename);
+        g_free(filename);
+    }
 
     /* save user phrase table */
-    tmpfilename = g_build_filename
-        (context->m_user_dir, USER_PHRASE_INDEX ".tmp", NULL);
-    filename = g_build_filename
-        (context->m_user_dir, USER_PHRASE_INDEX, NULL);
-
-    result = rename(tmpfilename, filename);
-    if (0 != result)
-        fprintf(stderr, "rename %s to %s failed.\n",
-                tmpfilename, filename);
-
-    g_free(tmpfilename);
-    g_free(filename);
+    if (context->m_phrase_table->is_dirty()) {
+        gchar * tmpfilename = g_build_filename
+            (context->m_user_dir, USER_PHRASE_INDEX ".tmp", NULL);
+        gchar * filename = g_build_filename
+            (context->m_user_dir, USER_PHRASE_INDEX, NULL);
+
+        int result = rename(tmpfilename, filename);
+        if (0 != result)
+            fprintf(stderr, "rename %s to %s failed.\n",
+                    tmpfilename, filename);
+
+        g_free(tmpfilename);
+        g_free(filename);
+    }
 
     /* save user bi-gram */
-    tmpfilename = g_build_filename
-        (context->m_user_dir, USER_BIGRAM ".tmp", NULL);
-    filename = g_build_filename(context->m_user_dir, USER_BIGRAM, NULL);
+    if (context->m_user_bigram->is_dirty()) {
+        gchar * tmpfilename = g_build_filename
+            (context->m_user_dir, USER_BIGRAM ".tmp", NULL);
+        gchar * filename = g_build_filename
+            (context->m_user_dir, USER_BIGRAM, NULL);
+
+        int result = rename(tmpfilename, filename);
+        if (0 != result)
+            fprintf(stderr, "rename %s to %s failed.\n",
+                    tmpfilename, filename);
+
+        g_free(tmpfilename);
+        g_free(filename);
+    }
 
-    result = rename(tmpfilename, filename);
-    if (0 != result)
-        fprintf(stderr, "rename %s to %s failed.\n",
-                tmpfilename, filename);
+    return true;
+}
 
-    g_free(tmpfilename);
-    g_free(filename);
+/* re-write the full user files, and clear the journal,
+   the phrase index is compacted by the caller with the writer lock. */
+static bool _compact_files(pinyin_context_t * context){
+    bool retval = _write_files(context) && _rename_files(context);
+    if (!retval)
+        return retval;
 
-    return true;
+    /* the user files contain the changes now. */
+    for (size_t i = 1; i < PHRASE_INDEX_LIBRARY_COUNT; ++i)
+        context->m_phrase_index->clear_dirty(i);
+    context->m_pinyin_table->clear_dirty();
+    context->m_phrase_table->clear_dirty();
+    context->m_user_bigram->clear_dirty();
+
+    return context->m_journal->truncate();
 }
 
 bool pinyin_save(pinyin_context_t * context){
     if (!context->m_user_dir)
         return false;
 
+    MutexLocker save_locker(&context->m_save_mutex);
+    _join_save_thread(context);
+
+    WriterLocker locker(&context->m_lock);
+
     if (!context->m_modified)
         return false;
 
-    context->m_phrase_index->compact();
+    UserJournal * journal = context->m_journal;
+    bool retval = false;
 
-    bool retval = _write_files(context) && _rename_files(context);
+    /* only append the changes to the journal,
+       until the journal grows too large. */
+    if (!journal->need_compact() &&
+        journal->get_size() < USER_JOURNAL_MAX_SIZE)
+        retval = journal->flush(context->m_phrase_index,
+                                context->m_user_bigram);
+
+    if (!retval) {
+        context->m_phrase_index->compact();
+        retval = _compact_files(context);
+    }
 
     mark_version(context);
 
@@ -1146,20 +1625,104 @@ bool pinyin_save(pinyin_context_t * context){
     return retval;
 }
 
+typedef struct {
+    pinyin_context_t * m_context;
+    /* the snapshot of the changes, NULL to compact the journal. */
+    MemoryChunk * m_batch;
+    pinyin_save_callback_t m_callback;
+    gpointer m_user_data;
+} save_task_t;
+
+static gpointer _save_user_files(gpointer data){
+    save_task_t * task = (save_task_t *) data;
+    pinyin_context_t * context = task->m_context;
+
+    bool retval = false;
+    if (task->m_batch)
+        retval = context->m_journal->append_batch(task->m_batch);
+
+    {
+        /* the searches continue during the compaction. */
+        ReaderLocker locker(&context->m_lock);
+
+        if (!retval)
+            retval = _compact_files(context);
+
+        mark_version(context);
+    }
+
+    delete task->m_batch;
+
+    /* the callback may save the context again. */
+    if (task->m_callback)
+        task->m_callback(context, retval, task->m_user_data);
+    delete task;
+
+    /* the save is finished, unless the callback started the next one. */
+    MutexLocker save_locker(&context->m_save_mutex);
+    if (g_thread_self() == context->m_save_thread)
+        context->m_save_thread = NULL;
+    g_cond_broadcast(&context->m_save_cond);
+    return GINT_TO_POINTER(retval);
+}
+
+bool pinyin_save_async(pinyin_context_t * context,
+                       pinyin_save_callback_t callback,
+                       gpointer user_data){
+    if (!context->m_user_dir)
+        return false;
+
+    MutexLocker save_locker(&context->m_save_mutex);
+    _join_save_thread(context);
+
+    WriterLocker locker(&context->m_lock);
+
+    if (!context->m_modified)
+        return false;
+
+    UserJournal * journal = context->m_journal;
+    save_task_t * task = new save_task_t;
+    task->m_context = context;
+    task->m_batch = NULL;
+    task->m_callback = callback;
+    task->m_user_data = user_data;
+
+    /* take the snapshot of the changes with the writer lock. */
+    if (!journal->need_compact() &&
+        journal->get_size() < USER_JOURNAL_MAX_SIZE) {
+        task->m_batch = new MemoryChunk;
+        journal->prepare_batch(context->m_phrase_index,
+                               context->m_user_bigram, task->m_batch);
+    } else {
+        context->m_phrase_index->compact();
+    }
+
+    context->m_modified = false;
+
+    /* the save thread is waited by the save condition. */
+    context->m_save_thread = g_thread_new
+        ("save", _save_user_files, task);
+    g_thread_unref(context->m_save_thread);
+    return true;
+}
+
 bool pinyin_set_full_pinyin_scheme(pinyin_context_t * context,
                                    FullPinyinScheme scheme){
+    WriterLocker locker(&context->m_lock);
     context->m_full_pinyin_parser->set_scheme(scheme);
     return true;
 }
 
 bool pinyin_set_double_pinyin_scheme(pinyin_context_t * context,
                                      DoublePinyinScheme scheme){
+    WriterLocker locker(&context->m_lock);
     context->m_double_pinyin_parser->set_scheme(scheme);
     return true;
 }
 
 bool pinyin_set_zhuyin_scheme(pinyin_context_t * context,
                                ZhuyinScheme scheme){
+    WriterLocker locker(&context->m_lock);
     delete context->m_chewing_parser;
     context->m_chewing_parser = NULL;
 
@@ -1192,6 +1755,21 @@ bool pinyin_set_zhuyin_scheme(pinyin_context_t * context,
 }
 
 void pinyin_fini(pinyin_context_t * context){
+    if (context->m_prefetch_thread)
+        g_thread_join(context->m_prefetch_thread);
+
+    {
+        MutexLocker save_locker(&context->m_save_mutex);
+        _join_save_thread(context);
+    }
+
+    /* compact the journal when all the changes are saved. */
+    if (context->m_user_dir && context->m_journal->get_size() &&
+        !context->m_modified && !context->m_journal->has_changes()) {
+        context->m_phrase_index->compact();
+        _compact_files(context);
+    }
+
     /* decrease the open counter */
     int counter = context->m_user_table_info.get_open_counter();
     counter = counter > 1 ? counter - 1 : 0;
@@ -1205,19 +1783,19 @@ void pinyin_fini(pinyin_context_t * context){
     delete context->m_pinyin_table;
     delete context->m_phrase_table;
     delete context->m_phrase_index;
-    delete context->m_system_bigram;
     delete context->m_user_bigram;
-    delete context->m_pinyin_lookup;
-    delete context->m_phrase_lookup;
-    delete context->m_addon_pinyin_table;
-    delete context->m_addon_phrase_table;
+    delete context->m_journal;
     delete context->m_addon_phrase_index;
-    delete context->m_system_punct_table;
+    /* the system tables are freed with the last context. */
+    _unref_system_data(context->m_system_data);
 
     g_free(context->m_system_dir);
     g_free(context->m_user_dir);
     context->m_modified = false;
 
+    g_cond_clear(&context->m_save_cond);
+    g_mutex_clear(&context->m_save_mutex);
+    g_rw_lock_clear(&context->m_lock);
     delete context;
 }
 
@@ -1225,9 +1803,16 @@ bool pinyin_mask_out(pinyin_context_t * context,
                      phrase_token_t mask,
                      phrase_token_t value) {
 
+    /* the journal is re-read after the previous save. */
+    MutexLocker save_locker(&context->m_save_mutex);
+    _join_save_thread(context);
+
+    WriterLocker locker(&context->m_lock);
+
     context->m_pinyin_table->mask_out(mask, value);
     context->m_phrase_table->mask_out(mask, value);
     context->m_user_bigram->mask_out(mask, value);
+    _invalidate_lookups(context);
 
     const pinyin_table_info_t * phrase_files =
         context->m_system_table_info.get_default_tables();
@@ -1253,20 +1838,17 @@ bool pinyin_mask_out(pinyin_context_t * context,
         if (SYSTEM_FILE == table_info->m_file_type ||
             DICTIONARY == table_info->m_file_type) {
             /* system phrase library */
-            MemoryChunk * chunk = new MemoryChunk;
-
             const char * systemfilename = table_info->m_system_filename;
             /* check bin file in system dir. */
             gchar * chunkfilename = g_build_filename(context->m_system_dir,
                                                      systemfilename, NULL);
 
-#ifdef LIBPINYIN_USE_MMAP
-            if (!chunk->mmap(chunkfilename))
-                fprintf(stderr, "mmap %s failed!\n", chunkfilename);
-#else
-            if (!chunk->load(chunkfilename))
+            MemoryChunk * chunk = _load_shared_phrase_library
+                (index, chunkfilename, context->m_system_data);
+            if (NULL == chunk) {
                 fprintf(stderr, "open %s failed!\n", chunkfilename);
-#endif
+                chunk = new MemoryChunk;
+            }
 
             g_free(chunkfilename);
 
@@ -1283,6 +1865,10 @@ bool pinyin_mask_out(pinyin_context_t * context,
 
             /* merge the chunk log with mask. */
             context->m_phrase_index->merge_with_mask(index, log, mask, value);
+
+            /* merge the journal with mask. */
+            context->m_journal->replay_phrase_library
+                (context->m_phrase_index, index, mask, value);
         }
 
         if (USER_FILE == table_info->m_file_type) {
@@ -1298,7 +1884,9 @@ bool pinyin_mask_out(pinyin_context_t * context,
 /* copy from options to context->m_options. */
 bool pinyin_set_options(pinyin_context_t * context,
                         pinyin_option_t options){
+    WriterLocker locker(&context->m_lock);
     context->m_options = options;
+    _invalidate_lookups(context);
 #if 0
     context->m_pinyin_table->set_options(context->m_options);
     context->m_pinyin_lookup->set_options(context->m_options);
@@ -1306,11 +1894,53 @@ bool pinyin_set_options(pinyin_context_t * context,
     return true;
 }
 
+bool pinyin_set_beam(pinyin_context_t * context,
+                     guint beam_size,
+                     gfloat margin){
+    if (0 == beam_size || margin < 0.)
+        return false;
+
+    WriterLocker locker(&context->m_lock);
+    /* the lookups of the instances are synced in the next search. */
+    context->m_beam_size = beam_size;
+    context->m_beam_margin = margin;
+    _invalidate_lookups(context);
+    return true;
+}
+
+bool pinyin_get_bigram_cache_statistics(pinyin_instance_t * instance,
+                                        guint * hits,
+                                        guint * misses){
+    guint32 cache_hits = 0, cache_misses = 0;
+    bool retval = instance->m_pinyin_lookup->get_bigram_cache_statistics
+        (cache_hits, cache_misses);
+
+    *hits = cache_hits;
+    *misses = cache_misses;
+    return retval;
+}
+
 
 pinyin_instance_t * pinyin_alloc_instance(pinyin_context_t * context){
     pinyin_instance_t * instance = new pinyin_instance_t;
     instance->m_context = context;
 
+    ReaderLocker locker(&context->m_lock);
+
+    /* the lookups share the tables of the context. */
+    instance->m_pinyin_lookup = new PhoneticLookup<2, 3>
+        (context->m_lambda,
+         context->m_pinyin_table, context->m_phrase_index,
+         context->m_system_bigram, context->m_user_bigram);
+
+    instance->m_phrase_lookup = new PhraseLookup
+        (context->m_lambda,
+         context->m_phrase_table, context->m_phrase_index,
+         context->m_system_bigram, context->m_user_bigram);
+
+    /* apply the beam of the context in the first search. */
+    instance->m_generation = context->m_generation - 1;
+
     instance->m_prefix_ucs4 = NULL;
     instance->m_prefix_len = 0;
     instance->m_prefixes = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
@@ -1318,6 +1948,11 @@ pinyin_instance_t * pinyin_alloc_instance(pinyin_context_t * context){
     instance->m_parsed_len = 0;
     instance->m_parsed_key_len = 0;
 
+    instance->m_parsed_keys = g_array_new(TRUE, TRUE, sizeof(ChewingKey));
+    instance->m_parsed_key_rests =
+        g_array_new(TRUE, TRUE, sizeof(ChewingKeyRest));
+    instance->m_dirty_offset = 0;
+
     instance->m_constraints = new ForwardPhoneticConstraints
         (context->m_phrase_index);
 
@@ -1347,10 +1982,14 @@ static bool _free_candidates(CandidateVector candidates) {
 void pinyin_free_instance(pinyin_instance_t * instance){
     g_free(instance->m_prefix_ucs4);
     g_array_free(instance->m_prefixes, TRUE);
+    g_array_free(instance->m_parsed_keys, TRUE);
+    g_array_free(instance->m_parsed_key_rests, TRUE);
     delete instance->m_constraints;
     g_array_free(instance->m_phrase_result, TRUE);
     _free_candidates(instance->m_candidates);
     g_array_free(instance->m_candidates, TRUE);
+    delete instance->m_pinyin_lookup;
+    delete instance->m_phrase_lookup;
 
     delete instance;
 }
@@ -1373,16 +2012,51 @@ bool pinyin_guess_sentence(pinyin_instance_t * instance){
     pinyin_context_t * & context = instance->m_context;
     PhoneticKeyMatrix & matrix = instance->m_matrix;
 
+    ReaderLocker locker(&context->m_lock);
+
     g_array_set_size(instance->m_prefixes, 0);
     g_array_append_val(instance->m_prefixes, sentence_start);
 
     pinyin_update_constraints(instance);
-    bool retval = context->m_pinyin_lookup->get_nbest_match
+    _sync_lookups(instance);
+    bool retval = instance->m_pinyin_lookup->get_nbest_match
         (instance->m_prefixes,
          &matrix,
          instance->m_constraints,
-         &instance->m_nbest_results);
+         &instance->m_nbest_results,
+         instance->m_dirty_offset);
 
+    /* the trellis is updated to the current matrix. */
+    instance->m_dirty_offset = matrix.size();
+    return retval;
+}
+
+bool pinyin_guess_sentence_with_budget(pinyin_instance_t * instance,
+                                       guint budget,
+                                       bool * finished){
+    pinyin_context_t * & context = instance->m_context;
+    PhoneticKeyMatrix & matrix = instance->m_matrix;
+
+    ReaderLocker locker(&context->m_lock);
+
+    const gint64 deadline = g_get_monotonic_time() + budget;
+
+    g_array_set_size(instance->m_prefixes, 0);
+    g_array_append_val(instance->m_prefixes, sentence_start);
+
+    pinyin_update_constraints(instance);
+    _sync_lookups(instance);
+    bool retval = instance->m_pinyin_lookup->get_nbest_match
+        (instance->m_prefixes,
+         &matrix,
+         instance->m_constraints,
+         &instance->m_nbest_results,
+         instance->m_dirty_offset,
+         deadline, *finished);
+
+    /* the trellis is updated to the current matrix,
+       the rest steps are resumed by the next call. */
+    instance->m_dirty_offset = matrix.size();
     return retval;
 }
 
@@ -1408,12 +2082,9 @@ static void _compute_prefixes(pinyin_instance_t * instance,
 
             const ucs4_t * start = ucs4_str + len_str - i;
 
-            PhraseTokens tokens;
-            memset(tokens, 0, sizeof(tokens));
-            phrase_index->prepare_tokens(tokens);
+            ScopedPhraseTokens tokens(phrase_index);
             int result = context->m_phrase_table->search(i, start, tokens);
             int num = reduce_tokens(tokens, tokenarray);
-            phrase_index->destroy_tokens(tokens);
 
             if (result & SEARCH_OK)
                 g_array_append_vals(instance->m_prefixes,
@@ -1428,18 +2099,24 @@ bool pinyin_guess_sentence_with_prefix(pinyin_instance_t * instance,
     pinyin_context_t * & context = instance->m_context;
     PhoneticKeyMatrix & matrix = instance->m_matrix;
 
+    ReaderLocker locker(&context->m_lock);
+
     g_array_set_size(instance->m_prefixes, 0);
     g_array_append_val(instance->m_prefixes, sentence_start);
 
     _compute_prefixes(instance, prefix);
 
     pinyin_update_constraints(instance);
-    bool retval = context->m_pinyin_lookup->get_nbest_match
+    _sync_lookups(instance);
+    bool retval = instance->m_pinyin_lookup->get_nbest_match
         (instance->m_prefixes,
          &matrix,
          instance->m_constraints,
-         &instance->m_nbest_results);
+         &instance->m_nbest_results,
+         instance->m_dirty_offset);
 
+    /* the trellis is updated to the current matrix. */
+    instance->m_dirty_offset = matrix.size();
     return retval;
 }
 
@@ -1453,7 +2130,8 @@ bool pinyin_phrase_segment(pinyin_instance_t * instance,
 
     g_return_val_if_fail(num_of_chars == ucs4_len, FALSE);
 
-    bool retval = context->m_phrase_lookup->get_best_match
+    ReaderLocker locker(&context->m_lock);
+    bool retval = instance->m_phrase_lookup->get_best_match
         (ucs4_len, ucs4_str, instance->m_phrase_result);
 
     g_free(ucs4_str);
@@ -1474,6 +2152,7 @@ bool pinyin_get_sentence(pinyin_instance_t * instance,
     assert(index < results.size());
     check_result(results.get_result(index, result));
 
+    ReaderLocker locker(&context->m_lock);
     bool retval = pinyin::convert_to_utf8
         (context->m_phrase_index, result,
          NULL, false, *sentence);
@@ -1481,10 +2160,54 @@ bool pinyin_get_sentence(pinyin_instance_t * instance,
     return retval;
 }
 
+/* compute the first changed matrix column from the parsed keys. */
+static bool _update_dirty_offset(pinyin_instance_t * instance,
+                                 ChewingKeyVector keys,
+                                 ChewingKeyRestVector key_rests,
+                                 size_t parsed_len){
+    ChewingKeyVector old_keys = instance->m_parsed_keys;
+    ChewingKeyRestVector old_key_rests = instance->m_parsed_key_rests;
+
+    size_t i = 0;
+    for (; i < keys->len && i < old_keys->len; ++i) {
+        const ChewingKey & key = g_array_index(keys, ChewingKey, i);
+        const ChewingKey & old_key = g_array_index(old_keys, ChewingKey, i);
+        const ChewingKeyRest & key_rest = g_array_index
+            (key_rests, ChewingKeyRest, i);
+        const ChewingKeyRest & old_key_rest = g_array_index
+            (old_key_rests, ChewingKeyRest, i);
+
+        if (!(key == old_key) ||
+            key_rest.m_raw_begin != old_key_rest.m_raw_begin ||
+            key_rest.m_raw_end != old_key_rest.m_raw_end)
+            break;
+    }
+
+    size_t offset = std_lite::min(instance->m_parsed_len, parsed_len) + 1;
+    if (i < keys->len || i < old_keys->len) {
+        /* the resplit step changes the column of the previous key. */
+        offset = 0;
+        if (i > 0)
+            offset = g_array_index(key_rests, ChewingKeyRest, i - 1).m_raw_begin;
+    } else if (instance->m_parsed_len != parsed_len) {
+        /* the last column is moved. */
+        offset = std_lite::min(instance->m_parsed_len, parsed_len);
+    }
+
+    instance->m_dirty_offset = std_lite::min(instance->m_dirty_offset, offset);
+
+    g_array_set_size(old_keys, 0);
+    g_array_append_vals(old_keys, keys->data, keys->len);
+    g_array_set_size(old_key_rests, 0);
+    g_array_append_vals(old_key_rests, key_rests->data, key_rests->len);
+    return true;
+}
+
 bool pinyin_parse_full_pinyin(pinyin_instance_t * instance,
                               const char * onepinyin,
                               ChewingKey * onekey){
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
 
     gint16 distance = 0;
@@ -1497,6 +2220,7 @@ bool pinyin_parse_full_pinyin(pinyin_instance_t * instance,
 size_t pinyin_parse_more_full_pinyins(pinyin_instance_t * instance,
                                       const char * pinyins){
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
     PhoneticKeyMatrix & matrix = instance->m_matrix;
 
@@ -1508,6 +2232,8 @@ size_t pinyin_parse_more_full_pinyins(pinyin_instance_t * instance,
         (options, keys,
          key_rests, pinyins, strlen(pinyins));
 
+    _update_dirty_offset(instance, keys, key_rests, parsed_len);
+
     instance->m_parsed_len = parsed_len;
     instance->m_parsed_key_len = keys->len;
 
@@ -1528,6 +2254,7 @@ bool pinyin_parse_double_pinyin(pinyin_instance_t * instance,
                                 const char * onepinyin,
                                 ChewingKey * onekey){
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
 
     gint16 distance = 0;
@@ -1540,6 +2267,7 @@ bool pinyin_parse_double_pinyin(pinyin_instance_t * instance,
 size_t pinyin_parse_more_double_pinyins(pinyin_instance_t * instance,
                                         const char * pinyins){
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
     PhoneticKeyMatrix & matrix = instance->m_matrix;
 
@@ -1551,6 +2279,8 @@ size_t pinyin_parse_more_double_pinyins(pinyin_instance_t * instance,
         (options, keys,
          key_rests, pinyins, strlen(pinyins));
 
+    _update_dirty_offset(instance, keys, key_rests, parsed_len);
+
     instance->m_parsed_len = parsed_len;
     instance->m_parsed_key_len = keys->len;
 
@@ -1567,6 +2297,7 @@ bool pinyin_parse_chewing(pinyin_instance_t * instance,
                           const char * onechewing,
                           ChewingKey * onekey){
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
 
     /* disable the zhuyin correction options. */
@@ -1582,6 +2313,7 @@ bool pinyin_parse_chewing(pinyin_instance_t * instance,
 size_t pinyin_parse_more_chewings(pinyin_instance_t * instance,
                                   const char * chewings){
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
     PhoneticKeyMatrix & matrix = instance->m_matrix;
 
@@ -1596,6 +2328,8 @@ size_t pinyin_parse_more_chewings(pinyin_instance_t * instance,
         (options, keys,
          key_rests, chewings, strlen(chewings));
 
+    _update_dirty_offset(instance, keys, key_rests, parsed_len);
+
     instance->m_parsed_len = parsed_len;
     instance->m_parsed_key_len = keys->len;
 
@@ -1615,6 +2349,7 @@ size_t pinyin_get_parsed_input_length(pinyin_instance_t * instance) {
 bool pinyin_in_chewing_keyboard(pinyin_instance_t * instance,
                                 const char key, gchar *** symbols) {
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t options = context->m_options;
 
     /* disable the zhuyin correction options. */
@@ -1877,13 +2612,10 @@ static bool _prepend_longer_candidates(pinyin_instance_t * instance,
 
     GArray * tokenarray = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
 
-    PhraseTokens tokens;
-    memset(tokens, 0, sizeof(tokens));
-    phrase_index->prepare_tokens(tokens);
+    ScopedPhraseTokens tokens(phrase_index);
     int result = search_suggestion_with_matrix
         (context->m_pinyin_table, &matrix, prefix_len, tokens);
     int num = reduce_tokens(tokens, tokenarray, false);
-    phrase_index->destroy_tokens(tokens);
 
     phrase_token_t longer_token = null_token;
     PhraseItem longer_item, item;
@@ -2184,6 +2916,7 @@ bool pinyin_guess_candidates(pinyin_instance_t * instance,
                              guint sort_option) {
 
     pinyin_context_t * & context = instance->m_context;
+    ReaderLocker locker(&context->m_lock);
     pinyin_option_t & options = context->m_options;
     PhoneticKeyMatrix & matrix = instance->m_matrix;
     CandidateVector candidates = instance->m_candidates;
@@ -2213,13 +2946,8 @@ bool pinyin_guess_candidates(pinyin_instance_t * instance,
         }
     }
 
-    PhraseIndexRanges ranges;
-    memset(ranges, 0, sizeof(ranges));
-    context->m_phrase_index->prepare_ranges(ranges);
-
-    PhraseIndexRanges addon_ranges;
-    memset(addon_ranges, 0, sizeof(addon_ranges));
-    context->m_addon_phrase_index->prepare_ranges(addon_ranges);
+    ScopedPhraseIndexRanges ranges(context->m_phrase_index);
+    ScopedPhraseIndexRanges addon_ranges(context->m_addon_phrase_index);
 
     _check_offset(matrix, offset);
 
@@ -2272,8 +3000,6 @@ bool pinyin_guess_candidates(pinyin_instance_t * instance,
         }
     }
 
-    context->m_phrase_index->destroy_ranges(ranges);
-
     /* post process to sort the candidates */
 
     _compute_phrase_length(context, candidates);
@@ -2376,13 +3102,10 @@ bool _compute_predicted_prefix_candidates(pinyin_instance_t * instance) {
     /* search prefix candidate. */
     GArray * tokenarray = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
 
-    PhraseTokens phrase_tokens;
-    memset(phrase_tokens, 0, sizeof(phrase_tokens));
-    phrase_index->prepare_tokens(phrase_tokens);
+    ScopedPhraseTokens phrase_tokens(phrase_index);
     int result = context->m_phrase_table->search_suggestion
         (instance->m_prefix_len, instance->m_prefix_ucs4, phrase_tokens);
     int num = reduce_tokens(phrase_tokens, tokenarray, false);
-    phrase_index->destroy_tokens(phrase_tokens);
 
     PhraseItem item;
     for (size_t i = 0; i < tokenarray->len; ++i) {
@@ -2415,6 +3138,8 @@ bool pinyin_guess_predicted_candidates(pinyin_instance_t * instance,
     TokenVector prefixes = instance->m_prefixes;
     phrase_token_t prev_token = null_token;
 
+    ReaderLocker locker(&context->m_lock);
+
     _free_candidates(candidates);
 
     /* search bigram candidate. */
@@ -2462,6 +3187,8 @@ bool pinyin_guess_predicted_candidates_with_punctuations(pinyin_instance_t * ins
     phrase_token_t prev_token = null_token;
     PunctTable * punct_table = context->m_system_punct_table;
 
+    ReaderLocker locker(&context->m_lock);
+
     /* prepend the punctuations */
     GArray * punct_array = g_array_new(TRUE, TRUE, sizeof(gchar *));
     for (guint index = 0; index < prefixes->len; ++index) {
@@ -2519,6 +3246,10 @@ int pinyin_choose_candidate(pinyin_instance_t * instance,
     }
 
     if (LONGER_CANDIDATE == candidate->m_candidate_type) {
+        /* the phrase index is changed. */
+        WriterLocker locker(&context->m_lock);
+        _invalidate_lookups(context);
+
         /* only train uni-gram for longer candidate. */
         phrase_token_t token = candidate->m_token;
         int error = context->m_phrase_index->add_unigram_frequency
@@ -2530,6 +3261,10 @@ int pinyin_choose_candidate(pinyin_instance_t * instance,
     }
 
     if (ADDON_CANDIDATE == candidate->m_candidate_type) {
+        /* the tables and the phrase index are changed. */
+        WriterLocker locker(&context->m_lock);
+        _invalidate_lookups(context);
+
         PhraseItem item;
         context->m_addon_phrase_index->get_phrase_item
             (candidate->m_token, item);
@@ -2563,6 +3298,10 @@ int pinyin_choose_candidate(pinyin_instance_t * instance,
     if (instance->m_sort_option & SORT_WITHOUT_SENTENCE_CANDIDATE) {
         assert(0 == offset);
 
+        /* the phrase index is changed. */
+        WriterLocker locker(&context->m_lock);
+        _invalidate_lookups(context);
+
         /* only train uni-gram. */
         phrase_token_t token = candidate->m_token;
         int error = context->m_phrase_index->add_unigram_frequency
@@ -2573,6 +3312,10 @@ int pinyin_choose_candidate(pinyin_instance_t * instance,
         return true;
     }
 
+    /* only the constraints of this instance are changed,
+       the phrase items are read to validate them. */
+    ReaderLocker locker(&context->m_lock);
+
     /* sync m_constraints to the length of m_pinyin_keys. */
     bool retval = constraints->validate_constraint(&matrix);
 
@@ -2602,6 +3345,9 @@ bool pinyin_choose_predicted_candidate(pinyin_instance_t * instance,
     if (PREDICTED_PUNCTUATION_CANDIDATE == candidate->m_candidate_type)
         return true;
 
+    WriterLocker locker(&context->m_lock);
+    _invalidate_lookups(context);
+
     /* train uni-gram */
     phrase_token_t token = candidate->m_token;
     int error = phrase_index->add_unigram_frequency
@@ -2655,12 +3401,11 @@ bool pinyin_lookup_tokens(pinyin_instance_t * instance,
     glong ucs4_len = 0;
     ucs4_t * ucs4_phrase = g_utf8_to_ucs4(phrase, -1, NULL, &ucs4_len, NULL);
 
-    PhraseTokens tokens;
-    memset(tokens, 0, sizeof(PhraseTokens));
-    phrase_index->prepare_tokens(tokens);
+    ReaderLocker locker(&context->m_lock);
+
+    ScopedPhraseTokens tokens(phrase_index);
     int retval = context->m_phrase_table->search(ucs4_len, ucs4_phrase, tokens);
     int num = reduce_tokens(tokens, tokenarray);
-    phrase_index->destroy_tokens(tokens);
 
     return SEARCH_OK & retval;
 }
@@ -2676,14 +3421,17 @@ bool pinyin_train(pinyin_instance_t * instance, guint8 index){
     if (0 == results.size())
         return false;
 
+    WriterLocker locker(&context->m_lock);
     context->m_modified = true;
 
     MatchResult result = NULL;
     assert(index < results.size());
     check_result(results.get_result(index, result));
 
-    bool retval = context->m_pinyin_lookup->train_result3
+    _sync_lookups(instance);
+    bool retval = instance->m_pinyin_lookup->train_result3
         (&matrix, instance->m_constraints, result);
+    _invalidate_lookups(context);
 
     return retval;
 }
@@ -2692,6 +3440,10 @@ bool pinyin_reset(pinyin_instance_t * instance){
     instance->m_parsed_len = 0;
     instance->m_matrix.clear_all();
 
+    g_array_set_size(instance->m_parsed_keys, 0);
+    g_array_set_size(instance->m_parsed_key_rests, 0);
+    instance->m_dirty_offset = 0;
+
     g_array_set_size(instance->m_prefixes, 0);
 
     instance->m_constraints->clear();
@@ -2777,6 +3529,7 @@ bool pinyin_token_get_phrase(pinyin_instance_t * instance,
                              gchar ** utf8_str) {
     pinyin_context_t * & context = instance->m_context;
 
+    ReaderLocker locker(&context->m_lock);
     return _token_get_phrase(context->m_phrase_index,
                              token, 0, len, utf8_str);
 }
@@ -2788,6 +3541,7 @@ bool pinyin_token_get_n_pronunciation(pinyin_instance_t * instance,
     pinyin_context_t * & context = instance->m_context;
     PhraseItem item;
 
+    ReaderLocker locker(&context->m_lock);
     int retval = context->m_phrase_index->get_phrase_item(token, item);
     if (ERROR_OK != retval)
         return false;
@@ -2806,6 +3560,7 @@ bool pinyin_token_get_nth_pronunciation(pinyin_instance_t * instance,
     ChewingKey buffer[MAX_PHRASE_LENGTH];
     guint32 freq = 0;
 
+    ReaderLocker locker(&context->m_lock);
     int retval = context->m_phrase_index->get_phrase_item(token, item);
     if (ERROR_OK != retval)
         return false;
@@ -2823,6 +3578,7 @@ bool pinyin_token_get_unigram_frequency(pinyin_instance_t * instance,
     pinyin_context_t * & context = instance->m_context;
     PhraseItem item;
 
+    ReaderLocker locker(&context->m_lock);
     int retval = context->m_phrase_index->get_phrase_item(token, item);
     if (ERROR_OK != retval)
         return false;
@@ -2835,8 +3591,10 @@ bool pinyin_token_add_unigram_frequency(pinyin_instance_t * instance,
                                         phrase_token_t token,
                                         guint delta){
     pinyin_context_t * & context = instance->m_context;
+    WriterLocker locker(&context->m_lock);
     int retval = context->m_phrase_index->add_unigram_frequency
         (token, delta);
+    _invalidate_lookups(context);
     return ERROR_OK == retval;
 }
 
@@ -3101,9 +3859,7 @@ static bool _pre_compute_tokens(pinyin_context_t * context,
     FacadePhraseTable3 * phrase_table = context->m_phrase_table;
 
     /* do phrase table search. */
-    PhraseTokens tokens;
-    memset(tokens, 0, sizeof(PhraseTokens));
-    phrase_index->prepare_tokens(tokens);
+    ScopedPhraseTokens tokens(phrase_index);
 
     for (size_t i = 0; i < phrase_length; ++i) {
         phrase_token_t token = null_token;
@@ -3114,16 +3870,12 @@ static bool _pre_compute_tokens(pinyin_context_t * context,
 
         int num = get_first_token(tokens, token);
         /* en-counter un-known character, such as the emoji unicode. */
-        if (0 == num) {
-            phrase_index->destroy_tokens(tokens);
+        if (0 == num)
             return false;
-        }
 
         g_array_append_val(cached_tokens, token);
     }
 
-    phrase_index->destroy_tokens(tokens);
-
     return true;
 }
 
@@ -3213,6 +3965,8 @@ bool pinyin_get_character_offset(pinyin_instance_t * instance,
     size_t length = 0;
     const size_t start = 0;
 
+    ReaderLocker locker(&context->m_lock);
+
     /* pre-compute the tokens vector from phrase. */
     TokenVector cached_tokens = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
 
@@ -3680,6 +4434,8 @@ bool pinyin_remember_user_input(pinyin_instance_t * instance,
 
     const size_t start = 0;
 
+    WriterLocker locker(&context->m_lock);
+
     /* pre-compute the tokens vector from phrase. */
     TokenVector cached_tokens = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
 
@@ -3735,6 +4491,8 @@ bool pinyin_remove_user_candidate(pinyin_instance_t * instance,
     guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
     assert(USER_DICTIONARY == index);
 
+    WriterLocker locker(&context->m_lock);
+
     /* remove from phrase index */
     PhraseItem * item = NULL;
     int retval = phrase_index->remove_phrase_item(token, item);
@@ -3763,6 +4521,8 @@ bool pinyin_remove_user_candidate(pinyin_instance_t * instance,
     phrase_token_t mask = PHRASE_INDEX_LIBRARY_MASK | PHRASE_MASK;
     user_bigram->mask_out(mask, token);
 
+    _invalidate_lookups(context);
+
     return true;
 }
 
@@ -65,6 +65,43 @@ typedef enum _sort_option_t{
     SORT_WITHOUT_LONGER_CANDIDATE | SORT_BY_PHRASE_LENGTH | SORT_BY_PINYIN_LENGTH | SORT_BY_FREQUENCY,
 } sort_option_t;
 
+/**
+ * pinyin_trace_func_t:
+ * @phase: the startup phase, like "system_table" or "phrase_library".
+ * @table: the file name of the table, NULL for the whole phase.
+ * @backend: the storage backend of the table, like "mmap" or "bdb".
+ * @duration: the duration of the phase in microseconds.
+ * @bytes: the size of the table file, zero if unknown.
+ * @user_data: the user data passed to pinyin_set_trace_func.
+ *
+ * The callback to receive the startup trace.
+ *
+ */
+typedef void (* pinyin_trace_func_t) (const char * phase,
+                                      const char * table,
+                                      const char * backend,
+                                      guint64 duration,
+                                      guint64 bytes,
+                                      gpointer user_data);
+
+/**
+ * pinyin_save_callback_t:
+ * @context: the saved pinyin context.
+ * @result: whether the save succeeded.
+ * @user_data: the user data passed to pinyin_save_async.
+ *
+ * The callback when the background save is finished,
+ * it is called in the save thread without the locks of the context.
+ *
+ * The callback may call the functions of the context, including
+ * pinyin_save and pinyin_save_async, but must not call pinyin_fini,
+ * the save thread still uses the context after the callback returns.
+ *
+ */
+typedef void (* pinyin_save_callback_t) (pinyin_context_t * context,
+                                         gboolean result,
+                                         gpointer user_data);
+
 /**
  * pinyin_init:
  * @systemdir: the system wide language model data directory.
@@ -73,9 +110,34 @@ typedef enum _sort_option_t{
  *
  * Create a new pinyin context.
  *
+ * The context can be shared by the instances in several threads,
+ * the searches run concurrently and the training is serialized.
+ * Each instance should be used by one thread at a time.
+ *
+ * The contexts of the same system directory share the system tables,
+ * each context only loads the user tables.
+ *
+ * The system phrase libraries are loaded when their phrases are
+ * first used, see pinyin_prefetch_phrase_libraries.
+ *
  */
 pinyin_context_t * pinyin_init(const char * systemdir, const char * userdir);
 
+/**
+ * pinyin_set_trace_func:
+ * @func: the trace callback, NULL to disable.
+ * @user_data: the user data passed to the callback.
+ *
+ * Trace the phases of the following pinyin_init calls, with the duration
+ * and the file size of each table. The system phrase libraries loaded
+ * on demand later are traced as the "lazy_library" phase.
+ *
+ * Without the callback, the trace is printed to the standard error as
+ * the JSON lines when the LIBPINYIN_TRACE environment variable is set.
+ *
+ */
+void pinyin_set_trace_func(pinyin_trace_func_t func, gpointer user_data);
+
 /**
  * pinyin_load_phrase_library:
  * @context: the pinyin context.
@@ -88,6 +150,17 @@ pinyin_context_t * pinyin_init(const char * systemdir, const char * userdir);
 bool pinyin_load_phrase_library(pinyin_context_t * context,
                                 guint8 index);
 
+/**
+ * pinyin_prefetch_phrase_libraries:
+ * @context: the pinyin context.
+ * @returns: whether the prefetch is started.
+ *
+ * Load the system phrase libraries not used yet in a background thread,
+ * the searches are not blocked by the prefetch.
+ *
+ */
+bool pinyin_prefetch_phrase_libraries(pinyin_context_t * context);
+
 /**
  * pinyin_unload_phrase_library:
  * @context: the pinyin context.
@@ -260,9 +333,31 @@ void pinyin_end_get_bigram_phrases(bigram_export_iterator_t * iter);
  *
  * Save the user's self-learning information of the pinyin context.
  *
+ * The changes are appended to the user journal, the changed user files
+ * are re-written when the journal grows large, or in pinyin_fini.
+ *
  */
 bool pinyin_save(pinyin_context_t * context);
 
+/**
+ * pinyin_save_async:
+ * @context: the pinyin context to be saved into user directory.
+ * @callback: the callback when the save is finished, or NULL.
+ * @user_data: the user data passed to the callback.
+ * @returns: whether the background save is started.
+ *
+ * Save the user's self-learning information of the pinyin context
+ * in the background, the changes until now are saved.
+ *
+ * The searches continue during the save, the training waits
+ * until the full user files are written when compacting.
+ * The next save waits for the previous save to finish.
+ *
+ */
+bool pinyin_save_async(pinyin_context_t * context,
+                       pinyin_save_callback_t callback,
+                       gpointer user_data);
+
 /**
  * pinyin_set_full_pinyin_scheme:
  * @context: the pinyin context.
@@ -303,7 +398,8 @@ bool pinyin_set_zhuyin_scheme(pinyin_context_t * context,
  * pinyin_fini:
  * @context: the pinyin context.
  *
- * Finalize the pinyin context.
+ * Finalize the pinyin context, the saved user journal is compacted
+ * into the full user files.
  *
  */
 void pinyin_fini(pinyin_context_t * context);
@@ -336,6 +432,37 @@ bool pinyin_mask_out(pinyin_context_t * context,
 bool pinyin_set_options(pinyin_context_t * context,
                         pinyin_option_t options);
 
+/**
+ * pinyin_set_beam:
+ * @context: the pinyin context.
+ * @beam_size: the number of the expanded results of each step.
+ * @margin: the log possibility margin to the best result of each step,
+ *          G_MAXFLOAT to disable.
+ * @returns: whether the set beam operation succeeded.
+ *
+ * Prune the sentence guessing, to bound the latency on the slow devices
+ * with a little accuracy loss.
+ *
+ */
+bool pinyin_set_beam(pinyin_context_t * context,
+                     guint beam_size,
+                     gfloat margin);
+
+/**
+ * pinyin_get_bigram_cache_statistics:
+ * @instance: the pinyin instance.
+ * @hits: the number of the bi-gram cache hits.
+ * @misses: the number of the bi-gram cache misses.
+ * @returns: whether the get operation is successful.
+ *
+ * Get the hit and miss counters of the bi-gram cache used by
+ * the sentence guessing, to tune the cache size.
+ *
+ */
+bool pinyin_get_bigram_cache_statistics(pinyin_instance_t * instance,
+                                        guint * hits,
+                                        guint * misses);
+
 /**
  * pinyin_alloc_instance:
  * @context: the pinyin context.
@@ -375,6 +502,22 @@ pinyin_context_t * pinyin_get_context (pinyin_instance_t * instance);
  */
 bool pinyin_guess_sentence(pinyin_instance_t * instance);
 
+/**
+ * pinyin_guess_sentence_with_budget:
+ * @instance: the pinyin instance.
+ * @budget: the time budget in microseconds.
+ * @finished: whether the whole sentence is guessed.
+ * @returns: whether the sentence are guessed successfully.
+ *
+ * Guess a sentence within the time budget. When the budget runs out,
+ * the best partial sentence is guessed and @finished is false,
+ * the next call continues the guessing of the same pinyin keys.
+ *
+ */
+bool pinyin_guess_sentence_with_budget(pinyin_instance_t * instance,
+                                       guint budget,
+                                       bool * finished);
+
 /**
  * pinyin_guess_sentence_with_prefix:
  * @instance: the pinyin instance.
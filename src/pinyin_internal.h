@@ -28,6 +28,7 @@
 #include "pinyin_custom2.h"
 #include "chewing_key.h"
 #include "pinyin_utils.h"
+#include "pinyin_locker.h"
 #include "pinyin_parser2.h"
 #include "zhuyin_parser2.h"
 #include "phonetic_key_matrix.h"
@@ -45,6 +46,7 @@
 #include "tag_utility.h"
 #include "table_info.h"
 #include "punct_table.h"
+#include "user_journal.h"
 
 
 /* training module */
@@ -61,6 +63,7 @@
 #define USER_PINYIN_INDEX "user_pinyin_index.bin"
 #define SYSTEM_PHRASE_INDEX "phrase_index.bin"
 #define USER_PHRASE_INDEX "user_phrase_index.bin"
+#define USER_JOURNAL "user_journal.bin"
 #define ADDON_SYSTEM_PINYIN_INDEX "addon_pinyin_index.bin"
 #define ADDON_SYSTEM_PHRASE_INDEX "addon_phrase_index.bin"
 #define SYSTEM_PUNCT_TABLE "punct.bin"
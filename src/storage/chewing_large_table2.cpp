@@ -19,6 +19,7 @@
  */
 
 #include "chewing_large_table2.h"
+#include "pinyin_locker.h"
 #include "pinyin_parser2.h"
 #include "zhuyin_parser2.h"
 
@@ -172,6 +173,7 @@ bool ChewingLargeTable2::load_text(FILE * infile, TABLE_PHONETIC_TYPE type) {
 int ChewingLargeTable2::search(int phrase_length,
                                /* in */ const ChewingKey keys[],
                                /* out */ PhraseIndexRanges ranges) const {
+    MutexLocker locker(&m_mutex);
     ChewingKey index[MAX_PHRASE_LENGTH];
     assert(NULL != m_db);
 
@@ -42,6 +42,7 @@ namespace pinyin{
 
 class MaskOutVisitor2;
 class MaskOutProcessor2;
+class ChewingSortedTable2;
 
 template<int phrase_length>
 class PrefixLessThanWithTones{
@@ -75,6 +76,7 @@ class ChewingTableEntry{
     friend class ChewingLargeTable2;
     friend class MaskOutVisitor2;
     friend class MaskOutProcessor2;
+    friend class ChewingSortedTable2;
 protected:
     typedef PinyinIndexItem2<phrase_length> IndexItem;
 
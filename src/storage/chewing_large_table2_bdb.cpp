@@ -19,6 +19,7 @@
  */
 
 #include "chewing_large_table2.h"
+#include "pinyin_locker.h"
 #include <errno.h>
 #include "bdb_utils.h"
 
@@ -50,6 +51,8 @@ static bool bdb_chewing_continue_search(const DBT *dbt1,
 }
 
 ChewingLargeTable2::ChewingLargeTable2() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = NULL;
     int ret = db_create(&m_db, NULL, 0);
@@ -133,6 +136,7 @@ bool ChewingLargeTable2::load_db(const char * filename) {
 }
 
 bool ChewingLargeTable2::save_db(const char * new_filename) {
+    MutexLocker locker(&m_mutex);
     DB * tmp_db = NULL;
 
     int ret = unlink(new_filename);
@@ -551,6 +555,7 @@ int ChewingLargeTable2::search_suggestion
 (int prefix_len,
  /* in */ const ChewingKey prefix_keys[],
  /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     ChewingKey index[MAX_PHRASE_LENGTH];
     int result = SEARCH_NONE;
 
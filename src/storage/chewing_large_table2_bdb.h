@@ -41,6 +41,9 @@ protected:
        all elements are always available. */
     GPtrArray * m_entries;
 
+    /* serialize the searches from the threads sharing this table. */
+    mutable GMutex m_mutex;
+
     void init_entries();
 
     void fini_entries();
@@ -96,6 +99,7 @@ public:
 
     ~ChewingLargeTable2() {
         reset();
+        g_mutex_clear(&m_mutex);
     }
 
     /* attach method */
@@ -19,6 +19,7 @@
  */
 
 #include "chewing_large_table2.h"
+#include "pinyin_locker.h"
 #include <kchashdb.h>
 #include <kccachedb.h>
 #include "pinyin_utils.h"
@@ -54,6 +55,8 @@ bool kyotodb_chewing_continue_search(const char* akbuf, size_t aksiz,
 }
 
 ChewingLargeTable2::ChewingLargeTable2() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = new ProtoTreeDB;
     check_result(m_db->open("-", BasicDB::OREADER|BasicDB::OWRITER|BasicDB::OCREATE));
@@ -122,6 +125,7 @@ bool ChewingLargeTable2::load_db(const char * filename) {
 }
 
 bool ChewingLargeTable2::save_db(const char * new_filename) {
+    MutexLocker locker(&m_mutex);
     int ret = unlink(new_filename);
     if ( ret != 0 && errno != ENOENT)
         return false;
@@ -525,6 +529,7 @@ int ChewingLargeTable2::search_suggestion
 (int prefix_len,
  /* in */ const ChewingKey prefix_keys[],
  /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     ChewingKey index[MAX_PHRASE_LENGTH];
     int result = SEARCH_NONE;
 
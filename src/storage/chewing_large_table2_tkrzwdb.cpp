@@ -19,6 +19,7 @@
  */
 
 #include "chewing_large_table2.h"
+#include "pinyin_locker.h"
 #include <tkrzw_dbm_baby.h>
 #include <tkrzw_dbm_tree.h>
 #include <tkrzw_str_util.h>
@@ -54,6 +55,8 @@ bool tkrzw_chewing_continue_search(const std::string_view& query_key,
 }
 
 ChewingLargeTable2::ChewingLargeTable2() {
+    g_mutex_init(&m_mutex);
+
     m_db = new BabyDBM;
 
     m_entries = NULL;
@@ -109,6 +112,7 @@ bool ChewingLargeTable2::load_db(const char * filename) {
 }
 
 bool ChewingLargeTable2::save_db(const char * new_filename) {
+    MutexLocker locker(&m_mutex);
     if (!m_db)
         return false;
 
@@ -495,6 +499,7 @@ int ChewingLargeTable2::search_suggestion
 (int prefix_len,
  /* in */ const ChewingKey prefix_keys[],
  /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     ChewingKey index[MAX_PHRASE_LENGTH];
     int result = SEARCH_NONE;
 
@@ -0,0 +1,631 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chewing_sorted_table2.h"
+#include <assert.h>
+#include <string.h>
+#include "chewing_large_table2.h"
+#include "pinyin_parser2.h"
+#include "zhuyin_parser2.h"
+
+namespace pinyin{
+
+struct chewing_sorted_table_build_item_t{
+    ChewingKey m_index[MAX_PHRASE_LENGTH];
+    ChewingKey m_keys[MAX_PHRASE_LENGTH];
+    /* null_token for the empty entry of the prefix. */
+    phrase_token_t m_token;
+};
+
+/* pack all the fields of the pinyin key to sort the indexes,
+   so the indexes with the same prefix are adjacent. */
+static inline int pack_chewing_key(const ChewingKey & key) {
+    return key.m_initial | (key.m_middle << 5) |
+        (key.m_final << 7) | (key.m_tone << 12);
+}
+
+static inline int compare_chewing_index(const ChewingKey * lhs,
+                                        const ChewingKey * rhs,
+                                        int phrase_length) {
+    for (int i = 0; i < phrase_length; ++i) {
+        int result = pack_chewing_key(lhs[i]) - pack_chewing_key(rhs[i]);
+        if (0 != result)
+            return result;
+    }
+
+    return 0;
+}
+
+/* sort by the index, then by the order in the ChewingTableEntry. */
+static gint compare_build_item(gconstpointer lhs, gconstpointer rhs,
+                               gpointer data) {
+    const chewing_sorted_table_build_item_t * lhs_item =
+        (const chewing_sorted_table_build_item_t *) lhs;
+    const chewing_sorted_table_build_item_t * rhs_item =
+        (const chewing_sorted_table_build_item_t *) rhs;
+    int phrase_length = GPOINTER_TO_INT(data);
+
+    int result = compare_chewing_index
+        (lhs_item->m_index, rhs_item->m_index, phrase_length);
+    if (0 != result)
+        return result;
+
+    result = pinyin_exact_compare2
+        (lhs_item->m_keys, rhs_item->m_keys, phrase_length);
+    if (0 != result)
+        return result;
+
+    if (lhs_item->m_token < rhs_item->m_token)
+        return -1;
+    if (lhs_item->m_token > rhs_item->m_token)
+        return 1;
+    return 0;
+}
+
+static inline table_offset_t align_offset(table_offset_t offset) {
+    return (offset + sizeof(guint32) - 1) & ~(sizeof(guint32) - 1);
+}
+
+ChewingSortedTable2::ChewingSortedTable2() {
+    m_chunk = NULL;
+    m_header = NULL;
+
+    m_build_items[0] = NULL;
+    for (size_t len = 1; len <= MAX_PHRASE_LENGTH; ++len)
+        m_build_items[len] = g_array_new
+            (FALSE, TRUE, sizeof(chewing_sorted_table_build_item_t));
+}
+
+ChewingSortedTable2::~ChewingSortedTable2() {
+    reset();
+
+    for (size_t len = 1; len <= MAX_PHRASE_LENGTH; ++len) {
+        g_array_free(m_build_items[len], TRUE);
+        m_build_items[len] = NULL;
+    }
+}
+
+void ChewingSortedTable2::reset() {
+    if (m_chunk) {
+        delete m_chunk;
+        m_chunk = NULL;
+    }
+
+    m_header = NULL;
+}
+
+bool ChewingSortedTable2::is_sorted_table(const char * filename) {
+    FILE * file = fopen(filename, "rb");
+    if (NULL == file)
+        return false;
+
+    /* the length and checksum saved by the memory chunk,
+       then the magic number and version of the table header. */
+    guint32 header[4] = {0, 0, 0, 0};
+    size_t num = fread(header, sizeof(guint32), G_N_ELEMENTS(header), file);
+    fclose(file);
+
+    return G_N_ELEMENTS(header) == num &&
+        chewing_sorted_table_magic == header[2] &&
+        chewing_sorted_table_version == header[3];
+}
+
+bool ChewingSortedTable2::load(MemoryChunk * chunk) {
+    reset();
+
+    m_chunk = chunk;
+
+    table_offset_t size = chunk->size();
+    if (size < sizeof(chewing_sorted_table_header_t))
+        return false;
+
+    const chewing_sorted_table_header_t * header =
+        (const chewing_sorted_table_header_t *) chunk->begin();
+    if (chewing_sorted_table_magic != header->m_magic ||
+        chewing_sorted_table_version != header->m_version)
+        return false;
+
+    /* check the layout written by store_internal. */
+    for (size_t len = 1; len <= MAX_PHRASE_LENGTH; ++len) {
+        const chewing_sorted_table_length_t & length =
+            header->m_lengths[len];
+
+        if (length.m_offsets_offset +
+            (length.m_num_indexes + 1) * sizeof(guint32) >
+            length.m_items_offset)
+            return false;
+
+        if (length.m_items_offset > length.m_indexes_offset)
+            return false;
+
+        if (length.m_indexes_offset +
+            length.m_num_indexes * len * sizeof(ChewingKey) > size)
+            return false;
+    }
+
+    m_header = header;
+    return true;
+}
+
+const ChewingKey * ChewingSortedTable2::get_index(int phrase_length,
+                                                  guint32 pos) const {
+    const chewing_sorted_table_length_t & length =
+        m_header->m_lengths[phrase_length];
+
+    const ChewingKey * indexes = (const ChewingKey *)
+        ((const char *) m_chunk->begin() + length.m_indexes_offset);
+    return indexes + pos * phrase_length;
+}
+
+bool ChewingSortedTable2::find_index(int phrase_length,
+                                     /* in */ const ChewingKey index[],
+                                     /* out */ guint32 & pos) const {
+    guint32 low = 0;
+    guint32 high = m_header->m_lengths[phrase_length].m_num_indexes;
+
+    while (low < high) {
+        guint32 mid = low + (high - low) / 2;
+        int result = compare_chewing_index
+            (get_index(phrase_length, mid), index, phrase_length);
+
+        if (0 == result) {
+            pos = mid;
+            return true;
+        }
+
+        if (result < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return false;
+}
+
+template<int phrase_length>
+int ChewingSortedTable2::search_internal(guint32 pos,
+                                         /* in */ const ChewingKey keys[],
+                                         /* out */ PhraseIndexRanges ranges) const {
+    typedef PinyinIndexItem2<phrase_length> IndexItem;
+
+    const chewing_sorted_table_length_t & length =
+        m_header->m_lengths[phrase_length];
+    const char * begin = (const char *) m_chunk->begin();
+
+    const guint32 * offsets = (const guint32 *)
+        (begin + length.m_offsets_offset);
+    const IndexItem * items = (const IndexItem *)
+        (begin + length.m_items_offset);
+
+    /* the empty entry of the prefix. */
+    if (offsets[pos] == offsets[pos + 1])
+        return SEARCH_NONE;
+
+    ChewingTableEntry<phrase_length> entry;
+    entry.m_chunk.set_chunk((void *) (items + offsets[pos]),
+                            (offsets[pos + 1] - offsets[pos]) *
+                            sizeof(IndexItem), NULL);
+
+    return entry.search(keys, ranges);
+}
+
+int ChewingSortedTable2::search_internal(int phrase_length, guint32 pos,
+                                         /* in */ const ChewingKey keys[],
+                                         /* out */ PhraseIndexRanges ranges) const {
+#define CASE(len) case len:                                     \
+    {                                                           \
+        return search_internal<len>(pos, keys, ranges);         \
+    }
+
+    switch(phrase_length) {
+        CASE(1);
+        CASE(2);
+        CASE(3);
+        CASE(4);
+        CASE(5);
+        CASE(6);
+        CASE(7);
+        CASE(8);
+        CASE(9);
+        CASE(10);
+        CASE(11);
+        CASE(12);
+        CASE(13);
+        CASE(14);
+        CASE(15);
+        CASE(16);
+    default:
+        abort();
+    }
+
+#undef CASE
+
+    return SEARCH_NONE;
+}
+
+template<int phrase_length>
+int ChewingSortedTable2::search_suggestion_internal
+(guint32 pos,
+ int prefix_len,
+ /* in */ const ChewingKey prefix_keys[],
+ /* out */ PhraseTokens tokens) const {
+    typedef PinyinIndexItem2<phrase_length> IndexItem;
+
+    const chewing_sorted_table_length_t & length =
+        m_header->m_lengths[phrase_length];
+    const char * begin = (const char *) m_chunk->begin();
+
+    const guint32 * offsets = (const guint32 *)
+        (begin + length.m_offsets_offset);
+    const IndexItem * items = (const IndexItem *)
+        (begin + length.m_items_offset);
+
+    if (offsets[pos] == offsets[pos + 1])
+        return SEARCH_NONE;
+
+    ChewingTableEntry<phrase_length> entry;
+    entry.m_chunk.set_chunk((void *) (items + offsets[pos]),
+                            (offsets[pos + 1] - offsets[pos]) *
+                            sizeof(IndexItem), NULL);
+
+    return entry.search_suggestion(prefix_len, prefix_keys, tokens);
+}
+
+int ChewingSortedTable2::search_suggestion_internal
+(int phrase_length, guint32 pos,
+ int prefix_len,
+ /* in */ const ChewingKey prefix_keys[],
+ /* out */ PhraseTokens tokens) const {
+    assert(prefix_len < phrase_length);
+
+#define CASE(len) case len:                            \
+    {                                                  \
+        return search_suggestion_internal<len>         \
+            (pos, prefix_len, prefix_keys, tokens);    \
+    }
+
+    switch(phrase_length) {
+        CASE(1);
+        CASE(2);
+        CASE(3);
+        CASE(4);
+        CASE(5);
+        CASE(6);
+        CASE(7);
+        CASE(8);
+        CASE(9);
+        CASE(10);
+        CASE(11);
+        CASE(12);
+        CASE(13);
+        CASE(14);
+        CASE(15);
+        CASE(16);
+    default:
+        abort();
+    }
+
+#undef CASE
+
+    return SEARCH_NONE;
+}
+
+/* search method */
+int ChewingSortedTable2::search(int phrase_length,
+                                /* in */ const ChewingKey keys[],
+                                /* out */ PhraseIndexRanges ranges) const {
+    ChewingKey index[MAX_PHRASE_LENGTH];
+
+    if (NULL == m_header)
+        return SEARCH_NONE;
+
+    if (contains_incomplete_pinyin(keys, phrase_length))
+        compute_incomplete_chewing_index(keys, index, phrase_length);
+    else
+        compute_chewing_index(keys, index, phrase_length);
+
+    guint32 pos = 0;
+    if (!find_index(phrase_length, index, pos))
+        return SEARCH_NONE;
+
+    /* the longer indexes always have the entries of the prefixes. */
+    int result = SEARCH_CONTINUED;
+    result |= search_internal(phrase_length, pos, keys, ranges);
+    return result;
+}
+
+/* search_suggesion method */
+int ChewingSortedTable2::search_suggestion
+(int prefix_len,
+ /* in */ const ChewingKey prefix_keys[],
+ /* out */ PhraseTokens tokens) const {
+    ChewingKey index[MAX_PHRASE_LENGTH];
+    int result = SEARCH_NONE;
+
+    if (NULL == m_header)
+        return result;
+
+    if (contains_incomplete_pinyin(prefix_keys, prefix_len))
+        compute_incomplete_chewing_index(prefix_keys, index, prefix_len);
+    else
+        compute_chewing_index(prefix_keys, index, prefix_len);
+
+    guint32 pos = 0;
+    if (!find_index(prefix_len, index, pos))
+        return result;
+
+    for (int len = prefix_len + 1; len <= MAX_PHRASE_LENGTH; ++len) {
+        /* find the first index with the prefix. */
+        guint32 low = 0;
+        guint32 high = m_header->m_lengths[len].m_num_indexes;
+        while (low < high) {
+            guint32 mid = low + (high - low) / 2;
+            if (compare_chewing_index
+                (get_index(len, mid), index, prefix_len) < 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        guint32 num_indexes = m_header->m_lengths[len].m_num_indexes;
+        for (pos = low; pos < num_indexes; ++pos) {
+            if (0 != compare_chewing_index
+                (get_index(len, pos), index, prefix_len))
+                break;
+
+            result = search_suggestion_internal
+                (len, pos, prefix_len, prefix_keys, tokens) | result;
+        }
+    }
+
+    return result;
+}
+
+/* add index method */
+int ChewingSortedTable2::add_index(int phrase_length,
+                                   /* in */ const ChewingKey keys[],
+                                   /* in */ phrase_token_t token) {
+    assert(0 < phrase_length && phrase_length <= MAX_PHRASE_LENGTH);
+
+    /* for in-complete chewing index and chewing index */
+    ChewingKey indexes[2][MAX_PHRASE_LENGTH];
+    compute_incomplete_chewing_index(keys, indexes[0], phrase_length);
+    compute_chewing_index(keys, indexes[1], phrase_length);
+
+    for (size_t i = 0; i < G_N_ELEMENTS(indexes); ++i) {
+        chewing_sorted_table_build_item_t item =
+            chewing_sorted_table_build_item_t();
+        memcpy(item.m_index, indexes[i], phrase_length * sizeof(ChewingKey));
+        memcpy(item.m_keys, keys, phrase_length * sizeof(ChewingKey));
+        item.m_token = token;
+        g_array_append_val(m_build_items[phrase_length], item);
+
+        /* add the empty entries for continued information. */
+        for (int len = phrase_length - 1; len > 0; --len) {
+            chewing_sorted_table_build_item_t prefix =
+                chewing_sorted_table_build_item_t();
+            memcpy(prefix.m_index, indexes[i], len * sizeof(ChewingKey));
+            prefix.m_token = null_token;
+            g_array_append_val(m_build_items[len], prefix);
+        }
+    }
+
+    return ERROR_OK;
+}
+
+template<int phrase_length>
+bool ChewingSortedTable2::store_internal
+(/* in */ GArray * build_items,
+ /* in */ MemoryChunk * new_chunk,
+ /* in */ table_offset_t offset,
+ /* out */ chewing_sorted_table_length_t & length,
+ /* out */ table_offset_t & end) {
+    typedef PinyinIndexItem2<phrase_length> IndexItem;
+
+    g_array_sort_with_data(build_items, compare_build_item,
+                           GINT_TO_POINTER(phrase_length));
+
+    GArray * offsets = g_array_new(FALSE, FALSE, sizeof(guint32));
+    GArray * items = g_array_new(FALSE, FALSE, sizeof(IndexItem));
+    GArray * indexes = g_array_new(FALSE, FALSE, sizeof(ChewingKey));
+
+    const chewing_sorted_table_build_item_t * prev = NULL;
+    for (size_t i = 0; i < build_items->len; ++i) {
+        const chewing_sorted_table_build_item_t * item =
+            &g_array_index(build_items, chewing_sorted_table_build_item_t, i);
+
+        bool new_index = NULL == prev || 0 != compare_chewing_index
+            (prev->m_index, item->m_index, phrase_length);
+
+        if (new_index) {
+            guint32 first = items->len;
+            g_array_append_val(offsets, first);
+            g_array_append_vals(indexes, item->m_index, phrase_length);
+        }
+
+        /* skip the empty entries and the duplicated items. */
+        bool duplicated = !new_index &&
+            0 == compare_build_item(prev, item,
+                                    GINT_TO_POINTER(phrase_length));
+        if (null_token != item->m_token && !duplicated) {
+            IndexItem index_item(item->m_keys, item->m_token);
+            g_array_append_val(items, index_item);
+        }
+
+        prev = item;
+    }
+
+    length.m_num_indexes = offsets->len;
+    guint32 last = items->len;
+    g_array_append_val(offsets, last);
+
+    /* offsets, items and indexes are aligned to guint32. */
+    offset = align_offset(offset);
+    length.m_offsets_offset = offset;
+    new_chunk->set_content(offset, offsets->data,
+                           offsets->len * sizeof(guint32));
+    offset += offsets->len * sizeof(guint32);
+
+    length.m_items_offset = offset;
+    new_chunk->set_content(offset, items->data,
+                           items->len * sizeof(IndexItem));
+    offset += items->len * sizeof(IndexItem);
+
+    length.m_indexes_offset = offset;
+    new_chunk->set_content(offset, indexes->data,
+                           indexes->len * sizeof(ChewingKey));
+    offset += indexes->len * sizeof(ChewingKey);
+
+    g_array_free(offsets, TRUE);
+    g_array_free(items, TRUE);
+    g_array_free(indexes, TRUE);
+
+    end = offset;
+    return true;
+}
+
+bool ChewingSortedTable2::store_internal
+(int phrase_length,
+ /* in */ GArray * build_items,
+ /* in */ MemoryChunk * new_chunk,
+ /* in */ table_offset_t offset,
+ /* out */ chewing_sorted_table_length_t & length,
+ /* out */ table_offset_t & end) {
+#define CASE(len) case len:                                     \
+    {                                                           \
+        return store_internal<len>                              \
+            (build_items, new_chunk, offset, length, end);      \
+    }
+
+    switch(phrase_length) {
+        CASE(1);
+        CASE(2);
+        CASE(3);
+        CASE(4);
+        CASE(5);
+        CASE(6);
+        CASE(7);
+        CASE(8);
+        CASE(9);
+        CASE(10);
+        CASE(11);
+        CASE(12);
+        CASE(13);
+        CASE(14);
+        CASE(15);
+        CASE(16);
+    default:
+        abort();
+    }
+
+#undef CASE
+
+    return false;
+}
+
+bool ChewingSortedTable2::store(MemoryChunk * new_chunk) {
+    chewing_sorted_table_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.m_magic = chewing_sorted_table_magic;
+    header.m_version = chewing_sorted_table_version;
+
+    new_chunk->set_size(0);
+
+    table_offset_t offset = sizeof(header);
+    header.m_lengths[0].m_offsets_offset = offset;
+    header.m_lengths[0].m_items_offset = offset;
+    header.m_lengths[0].m_indexes_offset = offset;
+
+    for (size_t len = 1; len <= MAX_PHRASE_LENGTH; ++len) {
+        table_offset_t end = 0;
+        if (!store_internal(len, m_build_items[len], new_chunk,
+                            offset, header.m_lengths[len], end))
+            return false;
+        offset = end;
+    }
+
+    new_chunk->set_content(0, &header, sizeof(header));
+    return true;
+}
+
+/* load text method */
+bool ChewingSortedTable2::load_text(FILE * infile, TABLE_PHONETIC_TYPE type) {
+    char pinyin[256];
+    char phrase[256];
+    phrase_token_t token;
+    size_t freq;
+
+    while (!feof(infile)) {
+#ifdef __APPLE__
+        int num = fscanf(infile, "%255s %255[^ \t] %u %ld",
+                         pinyin, phrase, &token, &freq);
+#else
+        int num = fscanf(infile, "%255s %255s %u %ld",
+                         pinyin, phrase, &token, &freq);
+#endif
+
+        if (4 != num)
+            continue;
+
+        if(feof(infile))
+            break;
+
+        glong len = g_utf8_strlen(phrase, -1);
+
+        ChewingKeyVector keys;
+        ChewingKeyRestVector key_rests;
+
+        keys = g_array_new(FALSE, FALSE, sizeof(ChewingKey));
+        key_rests = g_array_new(FALSE, FALSE, sizeof(ChewingKeyRest));
+
+        switch (type) {
+        case PINYIN_TABLE: {
+            PinyinDirectParser2 parser;
+            pinyin_option_t options = USE_TONE;
+            parser.parse(options, keys, key_rests, pinyin, strlen(pinyin));
+            break;
+        }
+
+        case ZHUYIN_TABLE: {
+            ZhuyinDirectParser2 parser;
+            pinyin_option_t options = USE_TONE | FORCE_TONE;
+            parser.parse(options, keys, key_rests, pinyin, strlen(pinyin));
+            break;
+        }
+        };
+
+        if (len != keys->len) {
+            fprintf(stderr, "ChewingSortedTable2::load_text:%s\t%s\t%u\t%ld\n",
+                    pinyin, phrase, token, freq);
+            g_array_free(keys, TRUE);
+            g_array_free(key_rests, TRUE);
+            continue;
+        }
+
+        add_index(keys->len, (ChewingKey *)keys->data, token);
+
+        g_array_free(keys, TRUE);
+        g_array_free(key_rests, TRUE);
+    }
+
+    return true;
+}
+
+};
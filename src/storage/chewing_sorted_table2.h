@@ -0,0 +1,219 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHEWING_SORTED_TABLE2_H
+#define CHEWING_SORTED_TABLE2_H
+
+#include <stdio.h>
+#include <glib.h>
+#include "novel_types.h"
+#include "memory_chunk.h"
+#include "chewing_key.h"
+#include "table_info.h"
+
+namespace pinyin{
+
+/* "CST2" in little endian. */
+static const guint32 chewing_sorted_table_magic = 0x32545343;
+static const guint32 chewing_sorted_table_version = 1;
+
+/* the sorted entries of one phrase length. */
+struct chewing_sorted_table_length_t{
+    /* the number of the distinct chewing indexes. */
+    guint32 m_num_indexes;
+    /* guint32[m_num_indexes + 1], the first item of each index. */
+    table_offset_t m_offsets_offset;
+    /* PinyinIndexItem2<phrase_length>[], grouped by the index. */
+    table_offset_t m_items_offset;
+    /* ChewingKey[m_num_indexes * phrase_length], sorted. */
+    table_offset_t m_indexes_offset;
+};
+
+struct chewing_sorted_table_header_t{
+    guint32 m_magic;
+    guint32 m_version;
+    chewing_sorted_table_length_t m_lengths[MAX_PHRASE_LENGTH + 1];
+};
+
+/**
+ * ChewingSortedTable2:
+ *
+ * The read-only chewing table stored in one sorted memory chunk,
+ * which can be mmapped and shared between processes.
+ *
+ * The search results are the same as the ChewingLargeTable2
+ * with the same phrases.
+ *
+ */
+class ChewingSortedTable2{
+protected:
+    /* the loaded sorted table. */
+    MemoryChunk * m_chunk;
+    const chewing_sorted_table_header_t * m_header;
+
+    /* Array of chewing_sorted_table_build_item_t,
+       the added indexes before storing. */
+    GArray * m_build_items[MAX_PHRASE_LENGTH + 1];
+
+    void reset();
+
+protected:
+    const ChewingKey * get_index(int phrase_length, guint32 pos) const;
+
+    bool find_index(int phrase_length, /* in */ const ChewingKey index[],
+                    /* out */ guint32 & pos) const;
+
+    template<int phrase_length>
+    int search_internal(guint32 pos,
+                        /* in */ const ChewingKey keys[],
+                        /* out */ PhraseIndexRanges ranges) const;
+
+    int search_internal(int phrase_length, guint32 pos,
+                        /* in */ const ChewingKey keys[],
+                        /* out */ PhraseIndexRanges ranges) const;
+
+    template<int phrase_length>
+    int search_suggestion_internal(guint32 pos,
+                                   int prefix_len,
+                                   /* in */ const ChewingKey prefix_keys[],
+                                   /* out */ PhraseTokens tokens) const;
+
+    int search_suggestion_internal(int phrase_length, guint32 pos,
+                                   int prefix_len,
+                                   /* in */ const ChewingKey prefix_keys[],
+                                   /* out */ PhraseTokens tokens) const;
+
+    template<int phrase_length>
+    bool store_internal(/* in */ GArray * build_items,
+                        /* in */ MemoryChunk * new_chunk,
+                        /* in */ table_offset_t offset,
+                        /* out */ chewing_sorted_table_length_t & length,
+                        /* out */ table_offset_t & end);
+
+    bool store_internal(int phrase_length,
+                        /* in */ GArray * build_items,
+                        /* in */ MemoryChunk * new_chunk,
+                        /* in */ table_offset_t offset,
+                        /* out */ chewing_sorted_table_length_t & length,
+                        /* out */ table_offset_t & end);
+
+public:
+    /**
+     * ChewingSortedTable2::ChewingSortedTable2:
+     *
+     * The constructor of the ChewingSortedTable2.
+     *
+     */
+    ChewingSortedTable2();
+
+    /**
+     * ChewingSortedTable2::~ChewingSortedTable2:
+     *
+     * The destructor of the ChewingSortedTable2.
+     *
+     */
+    ~ChewingSortedTable2();
+
+    /**
+     * ChewingSortedTable2::load:
+     * @chunk: the memory chunk of the sorted table.
+     * @returns: whether the load operation is successful.
+     *
+     * Load the sorted table, the chunk is owned by this table.
+     *
+     */
+    bool load(MemoryChunk * chunk);
+
+    /**
+     * ChewingSortedTable2::is_sorted_table:
+     * @filename: the file name of the system table.
+     * @returns: whether the file is the sorted table.
+     *
+     * Check the magic number and version of the file header,
+     * without reading the whole file.
+     *
+     */
+    static bool is_sorted_table(const char * filename);
+
+    /**
+     * ChewingSortedTable2::store:
+     * @new_chunk: the memory chunk to store the sorted table.
+     * @returns: whether the store operation is successful.
+     *
+     * Sort and store the added indexes.
+     *
+     */
+    bool store(MemoryChunk * new_chunk);
+
+    /**
+     * ChewingSortedTable2::load_text:
+     * @infile: the text file of the phrase table.
+     * @type: the phonetic type of the phrase table.
+     * @returns: whether the load operation is successful.
+     *
+     * Add the indexes of the phrases in the text file.
+     *
+     */
+    bool load_text(FILE * infile, TABLE_PHONETIC_TYPE type);
+
+    /**
+     * ChewingSortedTable2::add_index:
+     * @phrase_length: the length of the phrase to be added.
+     * @keys: the pinyin keys of the phrase to be added.
+     * @token: the token of the phrase to be added.
+     * @returns: the add result of enum ErrorResult.
+     *
+     * Add the phrase token before storing the sorted table.
+     *
+     */
+    int add_index(int phrase_length, /* in */ const ChewingKey keys[],
+                  /* in */ phrase_token_t token);
+
+    /**
+     * ChewingSortedTable2::search:
+     * @phrase_length: the length of the phrase to be searched.
+     * @keys: the pinyin key of the phrase to be searched.
+     * @ranges: the array of GArrays to store the matched phrase token.
+     * @returns: the search result of enum SearchResult.
+     *
+     * Search the phrase tokens according to the pinyin keys.
+     *
+     */
+    int search(int phrase_length, /* in */ const ChewingKey keys[],
+               /* out */ PhraseIndexRanges ranges) const;
+
+    /**
+     * ChewingSortedTable2::search_suggestion:
+     * @prefix_len: the length of the prefix to be searched.
+     * @prefix_keys: the pinyin key of the prefix to be searched.
+     * @tokens: the array of GArrays to store the matched prefix token.
+     * @returns: the search result of enum SearchResult.
+     *
+     * Search the phrase tokens according to the prefix pinyin keys.
+     *
+     */
+    int search_suggestion(int prefix_len,
+                          /* in */ const ChewingKey prefix_keys[],
+                          /* out */ PhraseTokens tokens) const;
+};
+
+};
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chewing_table_cache.h"
+#include <assert.h>
+#include <string.h>
+#include "chewing_large_table2.h"
+#include "chewing_sorted_table2.h"
+
+using namespace pinyin;
+
+/* pack all the fields of the pinyin key, including the tone. */
+static inline guint32 pack_chewing_key(const ChewingKey & key) {
+    return key.m_initial | (key.m_middle << 5) |
+        (key.m_final << 7) | (key.m_tone << 12);
+}
+
+static guint chewing_table_cache_hash(gconstpointer data) {
+    const chewing_table_cache_item_t * item =
+        (const chewing_table_cache_item_t *) data;
+
+    guint hash = item->m_length;
+    for (gint32 i = 0; i < item->m_length; ++i)
+        hash = hash * 31 + pack_chewing_key(item->m_keys[i]);
+    return hash;
+}
+
+static gboolean chewing_table_cache_equal(gconstpointer lhs,
+                                          gconstpointer rhs) {
+    const chewing_table_cache_item_t * lhs_item =
+        (const chewing_table_cache_item_t *) lhs;
+    const chewing_table_cache_item_t * rhs_item =
+        (const chewing_table_cache_item_t *) rhs;
+
+    if (lhs_item->m_length != rhs_item->m_length)
+        return FALSE;
+
+    for (gint32 i = 0; i < lhs_item->m_length; ++i) {
+        if (pack_chewing_key(lhs_item->m_keys[i]) !=
+            pack_chewing_key(rhs_item->m_keys[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* compute the index used by ChewingLargeTable2::search. */
+static void compute_search_index(const ChewingKey * keys,
+                                 ChewingKey * index,
+                                 int phrase_length) {
+    if (contains_incomplete_pinyin(keys, phrase_length))
+        compute_incomplete_chewing_index(keys, index, phrase_length);
+    else
+        compute_chewing_index(keys, index, phrase_length);
+}
+
+ChewingTableCache::ChewingTableCache(ChewingSortedTable2 * system_sorted_table,
+                                     ChewingLargeTable2 * system_chewing_table,
+                                     ChewingLargeTable2 * user_chewing_table,
+                                     guint32 capacity, guint32 num_shards)
+    : m_num_shards(num_shards)
+{
+    assert(capacity > 0);
+    assert(num_shards > 0);
+
+    m_system_sorted_table = system_sorted_table;
+    m_system_chewing_table = system_chewing_table;
+    m_user_chewing_table = user_chewing_table;
+
+    m_capacity = (capacity + num_shards - 1) / num_shards;
+
+    m_shards = g_new0(chewing_table_cache_shard_t, num_shards);
+    for (size_t i = 0; i < m_num_shards; ++i) {
+        chewing_table_cache_shard_t * shard = &m_shards[i];
+
+        shard->m_index = g_hash_table_new(chewing_table_cache_hash,
+                                          chewing_table_cache_equal);
+
+        shard->m_head = NULL;
+        shard->m_tail = NULL;
+
+        for (size_t m = 0; m < PHRASE_INDEX_LIBRARY_COUNT; ++m)
+            shard->m_ranges[m] = g_array_new
+                (FALSE, FALSE, sizeof(PhraseIndexRange));
+
+        shard->m_hits = 0;
+        shard->m_misses = 0;
+
+        g_mutex_init(&shard->m_mutex);
+    }
+}
+
+ChewingTableCache::~ChewingTableCache(){
+    clear();
+
+    for (size_t i = 0; i < m_num_shards; ++i) {
+        chewing_table_cache_shard_t * shard = &m_shards[i];
+
+        g_mutex_clear(&shard->m_mutex);
+
+        g_hash_table_destroy(shard->m_index);
+        shard->m_index = NULL;
+
+        for (size_t m = 0; m < PHRASE_INDEX_LIBRARY_COUNT; ++m) {
+            g_array_free(shard->m_ranges[m], TRUE);
+            shard->m_ranges[m] = NULL;
+        }
+    }
+
+    g_free(m_shards);
+    m_shards = NULL;
+}
+
+chewing_table_cache_shard_t * ChewingTableCache::get_shard
+(const chewing_table_cache_item_t * item) const {
+    return &m_shards[chewing_table_cache_hash(item) % m_num_shards];
+}
+
+void ChewingTableCache::unlink_item(chewing_table_cache_shard_t * shard,
+                                    chewing_table_cache_item_t * item){
+    if (NULL == item->m_prev)
+        shard->m_head = item->m_next;
+    else
+        item->m_prev->m_next = item->m_next;
+
+    if (NULL == item->m_next)
+        shard->m_tail = item->m_prev;
+    else
+        item->m_next->m_prev = item->m_prev;
+
+    item->m_prev = item->m_next = NULL;
+}
+
+void ChewingTableCache::link_front(chewing_table_cache_shard_t * shard,
+                                   chewing_table_cache_item_t * item){
+    item->m_prev = NULL;
+    item->m_next = shard->m_head;
+
+    if (NULL == shard->m_head)
+        shard->m_tail = item;
+    else
+        shard->m_head->m_prev = item;
+
+    shard->m_head = item;
+}
+
+void ChewingTableCache::remove_item(chewing_table_cache_shard_t * shard,
+                                    chewing_table_cache_item_t * item){
+    unlink_item(shard, item);
+    g_hash_table_remove(shard->m_index, item);
+
+    g_array_free(item->m_ranges, TRUE);
+    g_free(item);
+}
+
+bool ChewingTableCache::clear(){
+    for (size_t i = 0; i < m_num_shards; ++i) {
+        chewing_table_cache_shard_t * shard = &m_shards[i];
+        MutexLocker locker(&shard->m_mutex);
+
+        while (shard->m_head)
+            remove_item(shard, shard->m_head);
+
+        assert(0 == g_hash_table_size(shard->m_index));
+    }
+
+    return true;
+}
+
+bool ChewingTableCache::get_statistics(/* out */ guint32 & hits,
+                                       /* out */ guint32 & misses) const {
+    hits = 0;
+    misses = 0;
+
+    for (size_t i = 0; i < m_num_shards; ++i) {
+        chewing_table_cache_shard_t * shard = &m_shards[i];
+        MutexLocker locker(&shard->m_mutex);
+
+        hits += shard->m_hits;
+        misses += shard->m_misses;
+    }
+
+    return true;
+}
+
+/* only append the ranges of the phrase libraries requested by the caller. */
+int ChewingTableCache::fill_ranges(const chewing_table_cache_item_t * item,
+                                   PhraseIndexRanges ranges) const {
+    int result = item->m_result;
+
+    for (size_t i = 0; i < item->m_ranges->len; ++i) {
+        PhraseIndexRange * range = &g_array_index
+            (item->m_ranges, PhraseIndexRange, i);
+
+        GArray * head =
+            ranges[PHRASE_INDEX_LIBRARY_INDEX(range->m_range_begin)];
+        if (NULL == head)
+            continue;
+
+        result |= SEARCH_OK;
+        g_array_append_val(head, *range);
+    }
+
+    return result;
+}
+
+int ChewingTableCache::search(int phrase_length,
+                              /* in */ const ChewingKey keys[],
+                              /* out */ PhraseIndexRanges ranges){
+    assert(0 < phrase_length && phrase_length <= MAX_PHRASE_LENGTH);
+
+    chewing_table_cache_item_t probe;
+    probe.m_length = phrase_length;
+    memcpy(probe.m_keys, keys, phrase_length * sizeof(ChewingKey));
+
+    chewing_table_cache_shard_t * shard = get_shard(&probe);
+    MutexLocker locker(&shard->m_mutex);
+
+    chewing_table_cache_item_t * item = (chewing_table_cache_item_t *)
+        g_hash_table_lookup(shard->m_index, &probe);
+
+    if (item) {
+        ++shard->m_hits;
+
+        if (item != shard->m_head) {
+            unlink_item(shard, item);
+            link_front(shard, item);
+        }
+
+        return fill_ranges(item, ranges);
+    }
+
+    ++shard->m_misses;
+
+    /* search the chewing tables with all the phrase libraries. */
+    PhraseIndexRanges & all_ranges = shard->m_ranges;
+    for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i)
+        g_array_set_size(all_ranges[i], 0);
+
+    int result = SEARCH_NONE;
+    if (m_system_sorted_table)
+        result |= m_system_sorted_table->search
+            (phrase_length, keys, all_ranges);
+    if (m_system_chewing_table)
+        result |= m_system_chewing_table->search
+            (phrase_length, keys, all_ranges);
+    if (m_user_chewing_table)
+        result |= m_user_chewing_table->search
+            (phrase_length, keys, all_ranges);
+
+    /* evict the least recently used item when full. */
+    if (g_hash_table_size(shard->m_index) >= m_capacity)
+        remove_item(shard, shard->m_tail);
+
+    item = g_new0(chewing_table_cache_item_t, 1);
+    item->m_length = phrase_length;
+    memcpy(item->m_keys, keys, phrase_length * sizeof(ChewingKey));
+    item->m_result = result & SEARCH_CONTINUED;
+
+    item->m_ranges = g_array_new(FALSE, FALSE, sizeof(PhraseIndexRange));
+    for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i)
+        g_array_append_vals(item->m_ranges,
+                            all_ranges[i]->data, all_ranges[i]->len);
+
+    link_front(shard, item);
+    g_hash_table_insert(shard->m_index, item, item);
+
+    return fill_ranges(item, ranges);
+}
+
+bool ChewingTableCache::invalidate(int phrase_length,
+                                   /* in */ const ChewingKey keys[]){
+    /* add_index and remove_index change the entries of both indexes,
+       and add_index also creates the empty entries of their prefixes
+       for the SEARCH_CONTINUED flag. */
+    ChewingKey incomplete_index[MAX_PHRASE_LENGTH];
+    ChewingKey complete_index[MAX_PHRASE_LENGTH];
+    compute_incomplete_chewing_index(keys, incomplete_index, phrase_length);
+    compute_chewing_index(keys, complete_index, phrase_length);
+
+    for (size_t i = 0; i < m_num_shards; ++i) {
+        chewing_table_cache_shard_t * shard = &m_shards[i];
+        MutexLocker locker(&shard->m_mutex);
+
+        chewing_table_cache_item_t * item = shard->m_head;
+        while (item) {
+            chewing_table_cache_item_t * next = item->m_next;
+
+            if (item->m_length <= phrase_length) {
+                ChewingKey index[MAX_PHRASE_LENGTH];
+                compute_search_index(item->m_keys, index, item->m_length);
+
+                size_t size = item->m_length * sizeof(ChewingKey);
+                if (0 == memcmp(index, incomplete_index, size) ||
+                    0 == memcmp(index, complete_index, size))
+                    remove_item(shard, item);
+            }
+
+            item = next;
+        }
+    }
+
+    return true;
+}
+
+bool ChewingTableCache::mask_out(phrase_token_t mask,
+                                 phrase_token_t value){
+    for (size_t n = 0; n < m_num_shards; ++n) {
+        chewing_table_cache_shard_t * shard = &m_shards[n];
+        MutexLocker locker(&shard->m_mutex);
+
+        chewing_table_cache_item_t * item = shard->m_head;
+        while (item) {
+            chewing_table_cache_item_t * next = item->m_next;
+
+            bool matched = false;
+            for (size_t i = 0; i < item->m_ranges->len && !matched; ++i) {
+                PhraseIndexRange * range = &g_array_index
+                    (item->m_ranges, PhraseIndexRange, i);
+
+                for (phrase_token_t token = range->m_range_begin;
+                     token < range->m_range_end; ++token) {
+                    if ((token & mask) == value) {
+                        matched = true;
+                        break;
+                    }
+                }
+            }
+
+            if (matched)
+                remove_item(shard, item);
+
+            item = next;
+        }
+    }
+
+    return true;
+}
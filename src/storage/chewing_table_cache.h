@@ -0,0 +1,193 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHEWING_TABLE_CACHE_H
+#define CHEWING_TABLE_CACHE_H
+
+#include <glib.h>
+#include "novel_types.h"
+#include "chewing_key.h"
+#include "pinyin_locker.h"
+
+namespace pinyin{
+
+class ChewingLargeTable2;
+class ChewingSortedTable2;
+
+struct chewing_table_cache_item_t{
+    /* the searched pinyin keys, with tones. */
+    gint32 m_length;
+    ChewingKey m_keys[MAX_PHRASE_LENGTH];
+
+    /* the SEARCH_CONTINUED flag of the search result. */
+    int m_result;
+    /* Array of PhraseIndexRange of all the phrase libraries,
+       grouped by the phrase library index. */
+    GArray * m_ranges;
+
+    /* the neighbours in the LRU list, NULL for none. */
+    chewing_table_cache_item_t * m_prev;
+    chewing_table_cache_item_t * m_next;
+};
+
+/* the part of the cache chosen by the hash of the pinyin keys,
+   with its own lock and LRU list. */
+struct chewing_table_cache_shard_t{
+    /* Key and Value: chewing_table_cache_item_t *. */
+    GHashTable * m_index;
+
+    /* the most and least recently used items. */
+    chewing_table_cache_item_t * m_head;
+    chewing_table_cache_item_t * m_tail;
+
+    /* the search ranges of all the phrase libraries. */
+    PhraseIndexRanges m_ranges;
+
+    guint32 m_hits;
+    guint32 m_misses;
+
+    /* serialize the searches of the keys in this shard. */
+    GMutex m_mutex;
+};
+
+/**
+ * ChewingTableCache:
+ *
+ * The bounded LRU cache of the search results of the system and
+ * user chewing tables, keyed by the pinyin keys.
+ *
+ * The cache is split into the shards by the pinyin keys, the threads
+ * sharing this cache only wait for each other in the same shard.
+ *
+ */
+class ChewingTableCache{
+private:
+    ChewingSortedTable2 * m_system_sorted_table;
+    ChewingLargeTable2 * m_system_chewing_table;
+    ChewingLargeTable2 * m_user_chewing_table;
+
+    /* the capacity of each shard. */
+    guint32 m_capacity;
+
+    const guint32 m_num_shards;
+    chewing_table_cache_shard_t * m_shards;
+
+private:
+    chewing_table_cache_shard_t * get_shard
+    (const chewing_table_cache_item_t * item) const;
+
+    static void unlink_item(chewing_table_cache_shard_t * shard,
+                            chewing_table_cache_item_t * item);
+    static void link_front(chewing_table_cache_shard_t * shard,
+                           chewing_table_cache_item_t * item);
+    static void remove_item(chewing_table_cache_shard_t * shard,
+                            chewing_table_cache_item_t * item);
+
+    int fill_ranges(const chewing_table_cache_item_t * item,
+                    PhraseIndexRanges ranges) const;
+
+public:
+    /**
+     * ChewingTableCache::ChewingTableCache:
+     * @system_sorted_table: the sorted system chewing table.
+     * @system_chewing_table: the system chewing table.
+     * @user_chewing_table: the user chewing table.
+     * @capacity: the maximum number of the cached search results.
+     * @num_shards: the number of the shards.
+     *
+     * The constructor of the ChewingTableCache, the capacity is divided
+     * between the shards.
+     *
+     */
+    ChewingTableCache(ChewingSortedTable2 * system_sorted_table,
+                      ChewingLargeTable2 * system_chewing_table,
+                      ChewingLargeTable2 * user_chewing_table,
+                      guint32 capacity, guint32 num_shards = 1);
+
+    /**
+     * ChewingTableCache::~ChewingTableCache:
+     *
+     * The destructor of the ChewingTableCache.
+     *
+     */
+    ~ChewingTableCache();
+
+    /**
+     * ChewingTableCache::search:
+     * @phrase_length: the length of the phrase to be searched.
+     * @keys: the pinyin key of the phrase to be searched.
+     * @ranges: the array of GArrays to store the matched phrase token.
+     * @returns: the search result of enum SearchResult.
+     *
+     * Search the phrase tokens according to the pinyin keys,
+     * the chewing tables are only searched when the keys are not cached.
+     *
+     */
+    int search(int phrase_length, /* in */ const ChewingKey keys[],
+               /* out */ PhraseIndexRanges ranges);
+
+    /**
+     * ChewingTableCache::invalidate:
+     * @phrase_length: the length of the added or removed phrase.
+     * @keys: the pinyin keys of the added or removed phrase.
+     * @returns: whether the invalidate operation is successful.
+     *
+     * Remove the cached search results which read the chewing table
+     * entries changed by the add_index or remove_index call.
+     *
+     */
+    bool invalidate(int phrase_length, /* in */ const ChewingKey keys[]);
+
+    /**
+     * ChewingTableCache::mask_out:
+     * @mask: the mask.
+     * @value: the value.
+     * @returns: whether the mask out operation is successful.
+     *
+     * Remove the cached search results which contain the matched token.
+     *
+     */
+    bool mask_out(phrase_token_t mask, phrase_token_t value);
+
+    /**
+     * ChewingTableCache::clear:
+     * @returns: whether the clear operation is successful.
+     *
+     * Remove all the cached search results.
+     *
+     */
+    bool clear();
+
+    /**
+     * ChewingTableCache::get_statistics:
+     * @hits: the number of the cache hits.
+     * @misses: the number of the cache misses.
+     * @returns: whether the get operation is successful.
+     *
+     * Get the hit and miss counters to tune the capacity.
+     *
+     */
+    bool get_statistics(/* out */ guint32 & hits,
+                        /* out */ guint32 & misses) const;
+};
+
+};
+
+#endif
@@ -23,9 +23,15 @@
 
 #include "novel_types.h"
 #include "chewing_large_table2.h"
+#include "chewing_sorted_table2.h"
+#include "chewing_table_cache.h"
+#include "user_journal.h"
 
 namespace pinyin{
 
+static const guint32 chewing_table_cache_size = 1024;
+static const guint32 chewing_table_cache_shards = 16;
+
 /**
  * FacadeChewingTable2:
  *
@@ -35,10 +41,41 @@ namespace pinyin{
 
 class FacadeChewingTable2{
 private:
+    /* the system table is either sorted or in the DBM. */
+    ChewingSortedTable2 * m_system_sorted_table;
     ChewingLargeTable2 * m_system_chewing_table;
     ChewingLargeTable2 * m_user_chewing_table;
 
+    /* the system table is owned by another facade. */
+    bool m_shared_system;
+
+    /* the search results of the hot pinyin keys. */
+    ChewingTableCache * m_cache;
+
+    /* record the changes of the user chewing table. */
+    UserJournal * m_journal;
+    /* the user chewing table differs from the user file. */
+    bool m_dirty;
+
     void reset() {
+        m_dirty = false;
+
+        if (m_cache) {
+            delete m_cache;
+            m_cache = NULL;
+        }
+
+        if (m_shared_system) {
+            m_system_sorted_table = NULL;
+            m_system_chewing_table = NULL;
+            m_shared_system = false;
+        }
+
+        if (m_system_sorted_table) {
+            delete m_system_sorted_table;
+            m_system_sorted_table = NULL;
+        }
+
         if (m_system_chewing_table) {
             delete m_system_chewing_table;
             m_system_chewing_table = NULL;
@@ -58,8 +95,13 @@ public:
      *
      */
     FacadeChewingTable2() {
+        m_system_sorted_table = NULL;
         m_system_chewing_table = NULL;
         m_user_chewing_table = NULL;
+        m_shared_system = false;
+        m_cache = NULL;
+        m_journal = NULL;
+        m_dirty = false;
     }
 
     /**
@@ -78,24 +120,107 @@ public:
 
         bool result = false;
         if (system_filename) {
-            m_system_chewing_table = new ChewingLargeTable2;
-            result = m_system_chewing_table->attach
-                (system_filename, ATTACH_READONLY) || result;
+            /* try the sorted table first, only read the whole file
+               when the header matches. */
+            if (ChewingSortedTable2::is_sorted_table(system_filename)) {
+                MemoryChunk * chunk = new MemoryChunk;
+#ifdef LIBPINYIN_USE_MMAP
+                chunk->mmap(system_filename);
+#else
+                chunk->load(system_filename);
+#endif
+                /* the chunk is owned by the sorted table. */
+                m_system_sorted_table = new ChewingSortedTable2;
+                if (m_system_sorted_table->load(chunk)) {
+                    result = true;
+                } else {
+                    delete m_system_sorted_table;
+                    m_system_sorted_table = NULL;
+                }
+            }
+
+            if (NULL == m_system_sorted_table) {
+                m_system_chewing_table = new ChewingLargeTable2;
+                result = m_system_chewing_table->attach
+                    (system_filename, ATTACH_READONLY) || result;
+            }
         }
+        return load_user(user_filename) || result;
+    }
+
+    /**
+     * FacadeChewingTable2::load:
+     * @system_table: the facade to share the system table from.
+     * @user_filename: the user table file name.
+     * @returns: whether the load operation is successful.
+     *
+     * Share the system table of another facade, and load the user table,
+     * the other facade must outlive this facade.
+     *
+     */
+    bool load(const FacadeChewingTable2 * system_table,
+              const char * user_filename) {
+        reset();
+
+        m_system_sorted_table = system_table->m_system_sorted_table;
+        m_system_chewing_table = system_table->m_system_chewing_table;
+        m_shared_system = true;
+
+        bool result = m_system_sorted_table || m_system_chewing_table;
+        return load_user(user_filename) || result;
+    }
+
+private:
+    bool load_user(const char * user_filename) {
+        bool result = false;
         if (user_filename) {
             m_user_chewing_table = new ChewingLargeTable2;
-            result = m_user_chewing_table->load_db
-                (user_filename) || result;
+            result = m_user_chewing_table->load_db(user_filename);
         }
+
+        m_cache = new ChewingTableCache
+            (m_system_sorted_table, m_system_chewing_table,
+             m_user_chewing_table,
+             chewing_table_cache_size, chewing_table_cache_shards);
         return result;
     }
 
+public:
+
     bool store(const char * new_user_filename) {
         if (NULL == m_user_chewing_table)
             return false;
         return m_user_chewing_table->save_db(new_user_filename);
     }
 
+    /**
+     * FacadeChewingTable2::is_system_sorted:
+     * @returns: whether the system table is the sorted table.
+     *
+     * Check whether the system table is loaded as the sorted table,
+     * otherwise it is attached from the database.
+     *
+     */
+    bool is_system_sorted() const {
+        return NULL != m_system_sorted_table;
+    }
+
+    /**
+     * FacadeChewingTable2::get_cache_statistics:
+     * @hits: the number of the search cache hits.
+     * @misses: the number of the search cache misses.
+     * @returns: whether the get operation is successful.
+     *
+     * Get the hit and miss counters of the search cache.
+     *
+     */
+    bool get_cache_statistics(/* out */ guint32 & hits,
+                              /* out */ guint32 & misses) const {
+        if (NULL == m_cache)
+            return false;
+        return m_cache->get_statistics(hits, misses);
+    }
+
     /**
      * FacadeChewingTable2::search:
      * @phrase_length: the length of the phrase to be searched.
@@ -115,17 +240,10 @@ public:
                 g_array_set_size(ranges[i], 0);
         }
 #endif
-        int result = SEARCH_NONE;
+        if (NULL == m_cache)
+            return SEARCH_NONE;
 
-        if (NULL != m_system_chewing_table)
-            result |= m_system_chewing_table->search
-                (phrase_length, keys, ranges);
-
-        if (NULL != m_user_chewing_table)
-            result |= m_user_chewing_table->search
-                (phrase_length, keys, ranges);
-
-        return result;
+        return m_cache->search(phrase_length, keys, ranges);
     }
 
     /**
@@ -143,6 +261,10 @@ public:
                           /* out */ PhraseTokens tokens) const {
         int result = SEARCH_NONE;
 
+        if (NULL != m_system_sorted_table)
+            result |= m_system_sorted_table->search_suggestion
+                (prefix_len, prefix_keys, tokens);
+
         if (NULL != m_system_chewing_table)
             result |= m_system_chewing_table->search_suggestion
                 (prefix_len, prefix_keys, tokens);
@@ -168,7 +290,15 @@ public:
                   /* in */ phrase_token_t token) {
         if (NULL == m_user_chewing_table)
             return ERROR_NO_USER_TABLE;
-        return m_user_chewing_table->add_index(phrase_length, keys, token);
+        m_cache->invalidate(phrase_length, keys);
+        int result = m_user_chewing_table->add_index
+            (phrase_length, keys, token);
+        if (ERROR_OK == result)
+            m_dirty = true;
+        if (ERROR_OK == result && m_journal)
+            m_journal->append_pinyin_index
+                (JOURNAL_ADD_PINYIN_INDEX, phrase_length, keys, token);
+        return result;
     }
 
     /**
@@ -185,7 +315,15 @@ public:
                      /* in */ phrase_token_t token) {
         if (NULL == m_user_chewing_table)
             return ERROR_NO_USER_TABLE;
-        return m_user_chewing_table->remove_index(phrase_length, keys, token);
+        m_cache->invalidate(phrase_length, keys);
+        int result = m_user_chewing_table->remove_index
+            (phrase_length, keys, token);
+        if (ERROR_OK == result)
+            m_dirty = true;
+        if (ERROR_OK == result && m_journal)
+            m_journal->append_pinyin_index
+                (JOURNAL_REMOVE_PINYIN_INDEX, phrase_length, keys, token);
+        return result;
     }
 
     /**
@@ -200,9 +338,44 @@ public:
     bool mask_out(phrase_token_t mask, phrase_token_t value) {
         if (NULL == m_user_chewing_table)
             return false;
+        m_cache->mask_out(mask, value);
+        m_dirty = true;
+        if (m_journal)
+            m_journal->invalidate();
         return m_user_chewing_table->mask_out(mask, value);
     }
 
+    /**
+     * FacadeChewingTable2::set_journal:
+     * @journal: the journal to record the changes, or NULL.
+     *
+     * Record the changes of the user chewing table in the journal.
+     *
+     */
+    void set_journal(UserJournal * journal) {
+        m_journal = journal;
+    }
+
+    /**
+     * FacadeChewingTable2::is_dirty:
+     * @returns: whether the user chewing table is changed since it is
+     * loaded or stored.
+     *
+     */
+    bool is_dirty() const {
+        return m_dirty;
+    }
+
+    /**
+     * FacadeChewingTable2::clear_dirty:
+     *
+     * The user chewing table is stored into the user file.
+     *
+     */
+    void clear_dirty() {
+        m_dirty = false;
+    }
+
 };
 
 };
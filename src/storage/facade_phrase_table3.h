@@ -22,6 +22,8 @@
 #define FACADE_PHRASE_TABLE3_H
 
 #include "phrase_large_table3.h"
+#include "phrase_hash_table3.h"
+#include "user_journal.h"
 
 namespace pinyin{
 
@@ -34,10 +36,32 @@ namespace pinyin{
 
 class FacadePhraseTable3{
 private:
+    PhraseHashTable3 * m_system_hash_table;
     PhraseLargeTable3 * m_system_phrase_table;
     PhraseLargeTable3 * m_user_phrase_table;
 
+    /* the system table is owned by another facade. */
+    bool m_shared_system;
+
+    /* record the changes of the user phrase table. */
+    UserJournal * m_journal;
+    /* the user phrase table differs from the user file. */
+    bool m_dirty;
+
     void reset(){
+        m_dirty = false;
+
+        if (m_shared_system) {
+            m_system_hash_table = NULL;
+            m_system_phrase_table = NULL;
+            m_shared_system = false;
+        }
+
+        if (m_system_hash_table) {
+            delete m_system_hash_table;
+            m_system_hash_table = NULL;
+        }
+
         if (m_system_phrase_table) {
             delete m_system_phrase_table;
             m_system_phrase_table = NULL;
@@ -57,8 +81,12 @@ public:
      *
      */
     FacadePhraseTable3() {
+        m_system_hash_table = NULL;
         m_system_phrase_table = NULL;
         m_user_phrase_table = NULL;
+        m_shared_system = false;
+        m_journal = NULL;
+        m_dirty = false;
     }
 
     /**
@@ -77,10 +105,58 @@ public:
 
         bool result = false;
         if (system_filename) {
-            m_system_phrase_table = new PhraseLargeTable3;
-            result = m_system_phrase_table->attach
-                (system_filename, ATTACH_READONLY) || result;
+            /* try the hash table first, only read the whole file
+               when the header matches. */
+            if (PhraseHashTable3::is_hash_table(system_filename)) {
+                MemoryChunk * chunk = new MemoryChunk;
+#ifdef LIBPINYIN_USE_MMAP
+                chunk->mmap(system_filename);
+#else
+                chunk->load(system_filename);
+#endif
+                /* the chunk is owned by the hash table. */
+                m_system_hash_table = new PhraseHashTable3;
+                if (m_system_hash_table->load(chunk)) {
+                    result = true;
+                } else {
+                    delete m_system_hash_table;
+                    m_system_hash_table = NULL;
+                }
+            }
+
+            if (NULL == m_system_hash_table) {
+                m_system_phrase_table = new PhraseLargeTable3;
+                result = m_system_phrase_table->attach
+                    (system_filename, ATTACH_READONLY) || result;
+            }
+        }
+        if (user_filename) {
+            m_user_phrase_table = new PhraseLargeTable3;
+            result = m_user_phrase_table->load_db
+                (user_filename) || result;
         }
+        return result;
+    }
+
+    /**
+     * FacadePhraseTable3::load:
+     * @system_table: the facade to share the system table from.
+     * @user_filename: the user table file name.
+     * @returns: whether the load operation is successful.
+     *
+     * Share the system table of another facade, and load the user table,
+     * the other facade must outlive this facade.
+     *
+     */
+    bool load(const FacadePhraseTable3 * system_table,
+              const char * user_filename) {
+        reset();
+
+        m_system_hash_table = system_table->m_system_hash_table;
+        m_system_phrase_table = system_table->m_system_phrase_table;
+        m_shared_system = true;
+
+        bool result = m_system_hash_table || m_system_phrase_table;
         if (user_filename) {
             m_user_phrase_table = new PhraseLargeTable3;
             result = m_user_phrase_table->load_db
@@ -89,6 +165,18 @@ public:
         return result;
     }
 
+    /**
+     * FacadePhraseTable3::is_system_hashed:
+     * @returns: whether the system table is the hash table.
+     *
+     * Check whether the system table is loaded as the hash table,
+     * otherwise it is attached from the database.
+     *
+     */
+    bool is_system_hashed() const {
+        return NULL != m_system_hash_table;
+    }
+
     bool store(const char * new_user_filename) {
         if (NULL == m_user_phrase_table)
             return false;
@@ -117,6 +205,10 @@ public:
 
         int result = SEARCH_NONE;
 
+        if (NULL != m_system_hash_table)
+            result |= m_system_hash_table->search
+                (phrase_length, phrase, tokens);
+
         if (NULL != m_system_phrase_table)
             result |= m_system_phrase_table->search
                 (phrase_length, phrase, tokens);
@@ -142,6 +234,10 @@ public:
                           /* out */ PhraseTokens tokens) const {
         int result = SEARCH_NONE;
 
+        if (NULL != m_system_hash_table)
+            result |= m_system_hash_table->search_suggestion
+                (phrase_length, phrase, tokens);
+
         if (NULL != m_system_phrase_table)
             result |= m_system_phrase_table->search_suggestion
                 (phrase_length, phrase, tokens);
@@ -168,8 +264,14 @@ public:
         if (NULL == m_user_phrase_table)
             return ERROR_NO_USER_TABLE;
 
-        return m_user_phrase_table->add_index
+        int result = m_user_phrase_table->add_index
             (phrase_length, phrase, token);
+        if (ERROR_OK == result)
+            m_dirty = true;
+        if (ERROR_OK == result && m_journal)
+            m_journal->append_phrase_index
+                (JOURNAL_ADD_PHRASE_INDEX, phrase_length, phrase, token);
+        return result;
     }
 
     /**
@@ -187,8 +289,14 @@ public:
         if (NULL == m_user_phrase_table)
             return ERROR_NO_USER_TABLE;
 
-        return m_user_phrase_table->remove_index
+        int result = m_user_phrase_table->remove_index
             (phrase_length, phrase, token);
+        if (ERROR_OK == result)
+            m_dirty = true;
+        if (ERROR_OK == result && m_journal)
+            m_journal->append_phrase_index
+                (JOURNAL_REMOVE_PHRASE_INDEX, phrase_length, phrase, token);
+        return result;
     }
 
     /**
@@ -204,10 +312,44 @@ public:
         if (NULL == m_user_phrase_table)
             return false;
 
+        m_dirty = true;
+        if (m_journal)
+            m_journal->invalidate();
         return m_user_phrase_table->mask_out
             (mask, value);
     }
 
+    /**
+     * FacadePhraseTable3::set_journal:
+     * @journal: the journal to record the changes, or NULL.
+     *
+     * Record the changes of the user phrase table in the journal.
+     *
+     */
+    void set_journal(UserJournal * journal) {
+        m_journal = journal;
+    }
+
+    /**
+     * FacadePhraseTable3::is_dirty:
+     * @returns: whether the user phrase table is changed since it is
+     * loaded or stored.
+     *
+     */
+    bool is_dirty() const {
+        return m_dirty;
+    }
+
+    /**
+     * FacadePhraseTable3::clear_dirty:
+     *
+     * The user phrase table is stored into the user file.
+     *
+     */
+    void clear_dirty() {
+        m_dirty = false;
+    }
+
 };
 
 };
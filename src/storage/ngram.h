@@ -41,6 +41,7 @@
 namespace pinyin{
 
 class Bigram;
+class UserJournal;
 
 /** Note:
  *  The system single gram contains the trained freqs.
@@ -58,6 +59,7 @@ class Bigram;
  */
 class SingleGram{
     friend class Bigram;
+    friend class UserJournal;
     friend bool merge_single_gram(SingleGram * merged,
                                   const SingleGram * system,
                                   const SingleGram * user);
@@ -23,6 +23,8 @@
 #include "memory_chunk.h"
 #include "novel_types.h"
 #include "ngram.h"
+#include "pinyin_locker.h"
+#include "user_journal.h"
 #include "bdb_utils.h"
 
 using namespace pinyin;
@@ -30,13 +32,21 @@ using namespace pinyin;
 
 Bigram::Bigram(){
 	m_db = NULL;
+	m_generation = 0;
+	m_journal = NULL;
+	m_dirty = false;
+	g_mutex_init(&m_mutex);
 }
 
 Bigram::~Bigram(){
 	reset();
+	g_mutex_clear(&m_mutex);
 }
 
 void Bigram::reset(){
+    ++m_generation;
+    m_dirty = false;
+
     if ( m_db ){
         m_db->sync(m_db, 0);
         m_db->close(m_db, 0);
@@ -79,6 +89,7 @@ bool Bigram::load_db(const char * dbfile){
 }
 
 bool Bigram::save_db(const char * dbfile){
+    MutexLocker locker(&m_mutex);
     DB * tmp_db = NULL;
 
     int ret = unlink(dbfile);
@@ -124,9 +135,9 @@ bool Bigram::attach(const char * dbfile, guint32 flags){
     return true;
 }
 
-bool Bigram::load(phrase_token_t index, SingleGram * & single_gram,
-                  bool copy){
+bool Bigram::load(phrase_token_t index, SingleGram * & single_gram){
     single_gram = NULL;
+    MutexLocker locker(&m_mutex);
     if ( !m_db )
         return false;
 
@@ -141,11 +152,16 @@ bool Bigram::load(phrase_token_t index, SingleGram * & single_gram,
     if ( ret != 0 )
         return false;
 
-    single_gram = new SingleGram(db_data.data, db_data.size, copy);
+    single_gram = new SingleGram(db_data.data, db_data.size, true);
     return true;
 }
 
 bool Bigram::store(phrase_token_t index, SingleGram * single_gram){
+    ++m_generation;
+    m_dirty = true;
+    if (m_journal)
+        m_journal->touch_single_gram(index);
+
     if ( !m_db )
         return false;
 
@@ -163,6 +179,11 @@ bool Bigram::store(phrase_token_t index, SingleGram * single_gram){
 }
 
 bool Bigram::remove(/* in */ phrase_token_t index){
+    ++m_generation;
+    m_dirty = true;
+    if (m_journal)
+        m_journal->touch_single_gram(index);
+
     if ( !m_db )
         return false;
 
@@ -19,6 +19,8 @@
  */
 
 #include "ngram.h"
+#include "pinyin_locker.h"
+#include "user_journal.h"
 #include <assert.h>
 #include <errno.h>
 #include <kchashdb.h>
@@ -34,13 +36,21 @@ using namespace kyotocabinet;
 
 Bigram::Bigram(){
 	m_db = NULL;
+	m_generation = 0;
+	m_journal = NULL;
+	m_dirty = false;
+	g_mutex_init(&m_mutex);
 }
 
 Bigram::~Bigram(){
 	reset();
+	g_mutex_clear(&m_mutex);
 }
 
 void Bigram::reset(){
+    ++m_generation;
+    m_dirty = false;
+
     if ( m_db ){
         m_db->synchronize();
         m_db->close();
@@ -80,6 +90,7 @@ bool Bigram::load_db(const char * dbfile){
 }
 
 bool Bigram::save_db(const char * dbfile){
+    MutexLocker locker(&m_mutex);
     if (!m_db)
         return false;
 
@@ -121,9 +132,9 @@ bool Bigram::attach(const char * dbfile, guint32 flags){
 
 /* Use DB interface, first check, second reserve the memory chunk,
    third get value into the chunk. */
-bool Bigram::load(phrase_token_t index, SingleGram * & single_gram,
-                  bool copy){
+bool Bigram::load(phrase_token_t index, SingleGram * & single_gram){
     single_gram = NULL;
+    MutexLocker locker(&m_mutex);
     if ( !m_db )
         return false;
 
@@ -138,11 +149,16 @@ bool Bigram::load(phrase_token_t index, SingleGram * & single_gram,
     check_result (vsiz == m_db->get(kbuf, sizeof(phrase_token_t),
                               vbuf, vsiz));
 
-    single_gram = new SingleGram(m_chunk.begin(), vsiz, copy);
+    single_gram = new SingleGram(m_chunk.begin(), vsiz, true);
     return true;
 }
 
 bool Bigram::store(phrase_token_t index, SingleGram * single_gram){
+    ++m_generation;
+    m_dirty = true;
+    if (m_journal)
+        m_journal->touch_single_gram(index);
+
     if ( !m_db )
         return false;
 
@@ -153,6 +169,11 @@ bool Bigram::store(phrase_token_t index, SingleGram * single_gram){
 }
 
 bool Bigram::remove(/* in */ phrase_token_t index){
+    ++m_generation;
+    m_dirty = true;
+    if (m_journal)
+        m_journal->touch_single_gram(index);
+
     if ( !m_db )
         return false;
 
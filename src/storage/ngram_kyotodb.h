@@ -27,6 +27,7 @@
 namespace pinyin{
 
 class SingleGram;
+class UserJournal;
 
 /**
  * Bigram:
@@ -38,6 +39,17 @@ class Bigram{
 private:
     kyotocabinet::BasicDB * m_db;
 
+    /* increased when the bi-gram is changed. */
+    guint32 m_generation;
+
+    /* serialize the loads from the threads sharing this bi-gram. */
+    GMutex m_mutex;
+
+    /* record the stored single grams. */
+    UserJournal * m_journal;
+    /* the bi-gram differs from the user file. */
+    bool m_dirty;
+
     /* memory chunk for Kyoto Cabinet. */
     MemoryChunk m_chunk;
 
@@ -95,15 +107,14 @@ public:
      * Bigram::load:
      * @index: the previous token in the bi-gram.
      * @single_gram: the single gram of the previous token.
-     * @copy: whether copy content to the single gram.
      * @returns: whether the load operation is successful.
      *
-     * Load the single gram of the previous token.
+     * Load the single gram of the previous token, the content is
+     * always copied, as the bi-gram may be shared by the threads.
      *
      */
     bool load(/* in */ phrase_token_t index,
-              /* out */ SingleGram * & single_gram,
-              bool copy=false);
+              /* out */ SingleGram * & single_gram);
 
     /**
      * Bigram::store:
@@ -137,6 +148,49 @@ public:
      */
     bool get_all_items(/* out */ GArray * items);
 
+    /**
+     * Bigram::get_generation:
+     * @returns: the generation of this bi-gram.
+     *
+     * The generation is increased when this bi-gram is changed,
+     * used to invalidate the cached single grams.
+     *
+     */
+    guint32 get_generation() const {
+        return m_generation;
+    }
+
+    /**
+     * Bigram::set_journal:
+     * @journal: the journal to record the changes, or NULL.
+     *
+     * Record the stored and removed single grams in the journal.
+     *
+     */
+    void set_journal(UserJournal * journal) {
+        m_journal = journal;
+    }
+
+    /**
+     * Bigram::is_dirty:
+     * @returns: whether the bi-gram is changed since it is
+     * loaded or saved.
+     *
+     */
+    bool is_dirty() const {
+        return m_dirty;
+    }
+
+    /**
+     * Bigram::clear_dirty:
+     *
+     * The bi-gram is saved into the user file.
+     *
+     */
+    void clear_dirty() {
+        m_dirty = false;
+    }
+
     /**
      * Bigram::mask_out:
      * @mask: the mask.
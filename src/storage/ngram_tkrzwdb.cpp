@@ -19,6 +19,8 @@
  */
 
 #include "ngram.h"
+#include "pinyin_locker.h"
+#include "user_journal.h"
 #include <assert.h>
 #include <errno.h>
 #include <tkrzw_dbm_hash.h>
@@ -31,13 +33,21 @@ using namespace tkrzw;
 
 Bigram::Bigram(){
     m_db = NULL;
+    m_generation = 0;
+    m_journal = NULL;
+    m_dirty = false;
+    g_mutex_init(&m_mutex);
 }
 
 Bigram::~Bigram(){
     reset();
+    g_mutex_clear(&m_mutex);
 }
 
 void Bigram::reset(){
+    ++m_generation;
+    m_dirty = false;
+
     if ( m_db ){
         m_db->Close();
         delete m_db;
@@ -63,6 +73,7 @@ bool Bigram::load_db(const char * dbfile){
 }
 
 bool Bigram::save_db(const char * dbfile){
+    MutexLocker locker(&m_mutex);
     if (!m_db)
         return false;
 
@@ -99,9 +110,9 @@ bool Bigram::attach(const char * dbfile, guint32 flags){
 }
 
 /* Use DB interface. */
-bool Bigram::load(phrase_token_t index, SingleGram * & single_gram,
-                  bool copy){
+bool Bigram::load(phrase_token_t index, SingleGram * & single_gram){
     single_gram = NULL;
+    MutexLocker locker(&m_mutex);
     if ( !m_db )
         return false;
 
@@ -117,11 +128,16 @@ bool Bigram::load(phrase_token_t index, SingleGram * & single_gram,
     m_chunk.set_size(vsiz);
     memcpy(m_chunk.begin(), value.data(), vsiz);
 
-    single_gram = new SingleGram(m_chunk.begin(), vsiz, copy);
+    single_gram = new SingleGram(m_chunk.begin(), vsiz, true);
     return true;
 }
 
 bool Bigram::store(phrase_token_t index, SingleGram * single_gram){
+    ++m_generation;
+    m_dirty = true;
+    if (m_journal)
+        m_journal->touch_single_gram(index);
+
     if ( !m_db )
         return false;
 
@@ -133,6 +149,11 @@ bool Bigram::store(phrase_token_t index, SingleGram * single_gram){
 }
 
 bool Bigram::remove(/* in */ phrase_token_t index){
+    ++m_generation;
+    m_dirty = true;
+    if (m_journal)
+        m_journal->touch_single_gram(index);
+
     if ( !m_db )
         return false;
 
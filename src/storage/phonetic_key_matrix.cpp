@@ -534,7 +534,7 @@ int search_suggestion_with_matrix(const FacadeChewingTable2 * table,
 gfloat compute_pronunciation_possibility_recur(const PhoneticKeyMatrix * matrix,
                                                size_t start, size_t end,
                                                GArray * cached_keys,
-                                               PhraseItem & item){
+                                               const PhraseItemView & item){
     if (start > end)
         return 0.;
 
@@ -587,7 +587,7 @@ gfloat compute_pronunciation_possibility_recur(const PhoneticKeyMatrix * matrix,
 gfloat compute_pronunciation_possibility(const PhoneticKeyMatrix * matrix,
                                          size_t start, size_t end,
                                          GArray * cached_keys,
-                                         PhraseItem & item){
+                                         const PhraseItemView & item){
     assert(end < matrix->size());
 
     if(matrix->get_column_size(start) <= 0)
@@ -600,6 +600,60 @@ gfloat compute_pronunciation_possibility(const PhoneticKeyMatrix * matrix,
         (matrix, start, end, cached_keys, item);
 }
 
+gfloat compute_pronunciation_log_possibility(const PhoneticKeyMatrix * matrix,
+                                             size_t start, size_t end,
+                                             GArray * cached_keys,
+                                             const PhraseItemView & item){
+    assert(end < matrix->size());
+
+    if(matrix->get_column_size(start) <= 0)
+        return -FLT_MAX;
+    if(matrix->get_column_size(end) <= 0)
+        return -FLT_MAX;
+
+    const size_t phrase_length = item.get_phrase_length();
+    g_array_set_size(cached_keys, 0);
+
+    /* the common case, only one pinyin key sequence from 'start' to 'end',
+       use the precomputed log possibility of the phrase item. */
+    size_t pos = start;
+    while (pos < end) {
+        if (1 != matrix->get_column_size(pos))
+            break;
+
+        ChewingKey key; ChewingKeyRest key_rest;
+        matrix->get_item(pos, 0, key, key_rest);
+
+        const ChewingKey zero_key;
+        if (zero_key != key) {
+            if (phrase_length == cached_keys->len)
+                return -FLT_MAX;
+            g_array_append_val(cached_keys, key);
+        }
+
+        pos = key_rest.m_raw_end;
+    }
+
+    if (pos > end)
+        return -FLT_MAX;
+
+    if (pos == end) {
+        if (phrase_length != cached_keys->len)
+            return -FLT_MAX;
+
+        return item.get_pronunciation_log_possibility
+            ((ChewingKey *) cached_keys->data);
+    }
+
+    /* sum the possibilities of the pinyin key sequences. */
+    gfloat poss = compute_pronunciation_possibility
+        (matrix, start, end, cached_keys, item);
+    if (poss <= 0.)
+        return -FLT_MAX;
+
+    return log(poss);
+}
+
 bool increase_pronunciation_possibility_recur(const PhoneticKeyMatrix * matrix,
                                               size_t start, size_t end,
                                               GArray * cached_keys,
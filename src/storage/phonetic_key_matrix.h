@@ -220,7 +220,23 @@ int search_suggestion_with_matrix(const FacadeChewingTable2 * table,
 gfloat compute_pronunciation_possibility(const PhoneticKeyMatrix * matrix,
                                          size_t start, size_t end,
                                          GArray * cached_keys,
-                                         PhraseItem & item);
+                                         const PhraseItemView & item);
+
+static inline gfloat compute_pronunciation_possibility
+(const PhoneticKeyMatrix * matrix, size_t start, size_t end,
+ GArray * cached_keys, PhraseItem & item) {
+    return compute_pronunciation_possibility
+        (matrix, start, end, cached_keys, item.get_view());
+}
+
+/* the log of FLT_EPSILON, the less pronunciation possibility is ignored. */
+const gfloat min_pinyin_log_poss = -23 * M_LN2;
+
+/* the log possibility of the pronunciation, or -FLT_MAX. */
+gfloat compute_pronunciation_log_possibility(const PhoneticKeyMatrix * matrix,
+                                             size_t start, size_t end,
+                                             GArray * cached_keys,
+                                             const PhraseItemView & item);
 
 bool increase_pronunciation_possibility(const PhoneticKeyMatrix * matrix,
                                         size_t start, size_t end,
@@ -0,0 +1,567 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "phrase_hash_table3.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include "phrase_large_table3.h"
+
+namespace pinyin{
+
+struct phrase_hash_table_build_item_t{
+    ucs4_t m_phrase[MAX_PHRASE_LENGTH];
+    gint32 m_phrase_length;
+    /* null_token for the empty entry of the prefix. */
+    phrase_token_t m_token;
+};
+
+/* the average number of the phrases in one bucket. */
+static const guint32 phrase_hash_table_bucket_size = 4;
+
+/* give up when one bucket can't be placed. */
+static const guint32 phrase_hash_table_max_bucket_size = 64;
+static const guint32 phrase_hash_table_max_displacement = 1 << 24;
+
+/* the fingerprint and the bucket use the fixed seeds,
+   the slot uses the displacement of the bucket as the seed. */
+enum {
+    FINGERPRINT_SEED = 0,
+    BUCKET_SEED = 1,
+    SLOT_SEED = 2
+};
+
+static inline guint32 hash_phrase(int phrase_length, const ucs4_t phrase[],
+                                  guint32 seed) {
+    /* FNV-1a with the finalizer of MurmurHash3. */
+    guint32 hash = 2166136261U ^ (seed * 0x9e3779b9U);
+    for (int i = 0; i < phrase_length; ++i) {
+        hash ^= phrase[i];
+        hash *= 16777619U;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/* the prefix is before the longer phrases, so the phrases
+   with the same prefix are adjacent to the prefix. */
+static inline int compare_phrase_prefix(int lhs_length, const ucs4_t lhs[],
+                                        int rhs_length, const ucs4_t rhs[]) {
+    int min_length = std::min(lhs_length, rhs_length);
+    for (int i = 0; i < min_length; ++i) {
+        if (lhs[i] != rhs[i])
+            return lhs[i] < rhs[i] ? -1 : 1;
+    }
+
+    return lhs_length - rhs_length;
+}
+
+static gint compare_build_item(gconstpointer lhs, gconstpointer rhs) {
+    const phrase_hash_table_build_item_t * lhs_item =
+        (const phrase_hash_table_build_item_t *) lhs;
+    const phrase_hash_table_build_item_t * rhs_item =
+        (const phrase_hash_table_build_item_t *) rhs;
+
+    int result = compare_phrase_prefix
+        (lhs_item->m_phrase_length, lhs_item->m_phrase,
+         rhs_item->m_phrase_length, rhs_item->m_phrase);
+    if (0 != result)
+        return result;
+
+    if (lhs_item->m_token < rhs_item->m_token)
+        return -1;
+    if (lhs_item->m_token > rhs_item->m_token)
+        return 1;
+    return 0;
+}
+
+/* sort the buckets by the number of the phrases, descending. */
+static gint compare_bucket_size(gconstpointer lhs, gconstpointer rhs,
+                                gpointer data) {
+    GArray ** buckets = (GArray **) data;
+    guint32 lhs_size = buckets[*(const guint32 *) lhs]->len;
+    guint32 rhs_size = buckets[*(const guint32 *) rhs]->len;
+
+    if (lhs_size > rhs_size)
+        return -1;
+    if (lhs_size < rhs_size)
+        return 1;
+    return 0;
+}
+
+static inline table_offset_t align_offset(table_offset_t offset) {
+    return (offset + sizeof(guint32) - 1) & ~(sizeof(guint32) - 1);
+}
+
+PhraseHashTable3::PhraseHashTable3() {
+    m_chunk = NULL;
+    m_header = NULL;
+
+    m_build_items = g_array_new
+        (FALSE, TRUE, sizeof(phrase_hash_table_build_item_t));
+}
+
+PhraseHashTable3::~PhraseHashTable3() {
+    reset();
+
+    g_array_free(m_build_items, TRUE);
+    m_build_items = NULL;
+}
+
+void PhraseHashTable3::reset() {
+    if (m_chunk) {
+        delete m_chunk;
+        m_chunk = NULL;
+    }
+
+    m_header = NULL;
+}
+
+bool PhraseHashTable3::is_hash_table(const char * filename) {
+    FILE * file = fopen(filename, "rb");
+    if (NULL == file)
+        return false;
+
+    /* the length and checksum saved by the memory chunk,
+       then the magic number and version of the table header. */
+    guint32 header[4] = {0, 0, 0, 0};
+    size_t num = fread(header, sizeof(guint32), G_N_ELEMENTS(header), file);
+    fclose(file);
+
+    return G_N_ELEMENTS(header) == num &&
+        phrase_hash_table_magic == header[2] &&
+        phrase_hash_table_version == header[3];
+}
+
+bool PhraseHashTable3::load(MemoryChunk * chunk) {
+    reset();
+
+    m_chunk = chunk;
+
+    table_offset_t size = chunk->size();
+    if (size < sizeof(phrase_hash_table_header_t))
+        return false;
+
+    const phrase_hash_table_header_t * header =
+        (const phrase_hash_table_header_t *) chunk->begin();
+    if (phrase_hash_table_magic != header->m_magic ||
+        phrase_hash_table_version != header->m_version)
+        return false;
+
+    /* check the layout written by store. */
+    if (0 == header->m_num_buckets)
+        return false;
+
+    if (header->m_displacements_offset +
+        header->m_num_buckets * sizeof(guint32) > header->m_slots_offset)
+        return false;
+
+    if (header->m_slots_offset + header->m_num_records *
+        sizeof(phrase_hash_table_slot_t) > header->m_records_offset)
+        return false;
+
+    if (header->m_records_offset + header->m_num_records *
+        sizeof(phrase_hash_table_record_t) > header->m_phrases_offset)
+        return false;
+
+    if (header->m_phrases_offset > header->m_tokens_offset ||
+        header->m_tokens_offset > header->m_end_offset ||
+        header->m_end_offset > size)
+        return false;
+
+    m_header = header;
+    return true;
+}
+
+const phrase_hash_table_record_t * PhraseHashTable3::get_record
+(guint32 index) const {
+    const phrase_hash_table_record_t * records =
+        (const phrase_hash_table_record_t *)
+        ((const char *) m_chunk->begin() + m_header->m_records_offset);
+    return records + index;
+}
+
+const ucs4_t * PhraseHashTable3::get_phrase
+(const phrase_hash_table_record_t * record) const {
+    const ucs4_t * phrases = (const ucs4_t *)
+        ((const char *) m_chunk->begin() + m_header->m_phrases_offset);
+    return phrases + record->m_phrase_offset;
+}
+
+bool PhraseHashTable3::find_record(int phrase_length,
+                                   /* in */ const ucs4_t phrase[],
+                                   /* out */ guint32 & index) const {
+    const guint32 num_records = m_header->m_num_records;
+    if (0 == num_records)
+        return false;
+
+    const char * begin = (const char *) m_chunk->begin();
+    const guint32 * displacements = (const guint32 *)
+        (begin + m_header->m_displacements_offset);
+    const phrase_hash_table_slot_t * slots =
+        (const phrase_hash_table_slot_t *)
+        (begin + m_header->m_slots_offset);
+
+    guint32 bucket = hash_phrase(phrase_length, phrase, BUCKET_SEED) %
+        m_header->m_num_buckets;
+    guint32 seed = SLOT_SEED + displacements[bucket];
+    const phrase_hash_table_slot_t & slot =
+        slots[hash_phrase(phrase_length, phrase, seed) % num_records];
+
+    /* the missing phrase is hashed to the slot of another phrase. */
+    if (hash_phrase(phrase_length, phrase, FINGERPRINT_SEED) !=
+        slot.m_fingerprint)
+        return false;
+
+    /* compare the phrase when the fingerprints collide. */
+    const phrase_hash_table_record_t * record = get_record(slot.m_record);
+    if (phrase_length != (int) record->m_phrase_length)
+        return false;
+
+    if (0 != memcmp(get_phrase(record), phrase,
+                    phrase_length * sizeof(ucs4_t)))
+        return false;
+
+    index = slot.m_record;
+    return true;
+}
+
+int PhraseHashTable3::search_record(const phrase_hash_table_record_t * record,
+                                    /* out */ PhraseTokens tokens) const {
+    /* the empty entry of the prefix. */
+    if (0 == record->m_num_tokens)
+        return SEARCH_NONE;
+
+    const phrase_token_t * begin = (const phrase_token_t *)
+        ((const char *) m_chunk->begin() + m_header->m_tokens_offset);
+
+    PhraseTableEntry entry;
+    entry.m_chunk.set_chunk((void *) (begin + record->m_tokens_offset),
+                            record->m_num_tokens * sizeof(phrase_token_t),
+                            NULL);
+
+    return entry.search(tokens);
+}
+
+/* search method */
+int PhraseHashTable3::search(int phrase_length,
+                             /* in */ const ucs4_t phrase[],
+                             /* out */ PhraseTokens tokens) const {
+    int result = SEARCH_NONE;
+
+    if (NULL == m_header)
+        return result;
+
+    guint32 index = 0;
+    if (!find_record(phrase_length, phrase, index))
+        return result;
+
+    /* the longer phrases always have the entries of the prefixes. */
+    result |= SEARCH_CONTINUED;
+
+    result = search_record(get_record(index), tokens) | result;
+    return result;
+}
+
+/* search_suggestion method */
+int PhraseHashTable3::search_suggestion(int phrase_length,
+                                        /* in */ const ucs4_t phrase[],
+                                        /* out */ PhraseTokens tokens) const {
+    int result = SEARCH_NONE;
+
+    if (NULL == m_header)
+        return result;
+
+    guint32 index = 0;
+    if (!find_record(phrase_length, phrase, index))
+        return result;
+
+    /* the longer phrases with the prefix follow the prefix. */
+    for (++index; index < m_header->m_num_records; ++index) {
+        const phrase_hash_table_record_t * record = get_record(index);
+
+        if ((int) record->m_phrase_length <= phrase_length)
+            break;
+
+        if (0 != memcmp(get_phrase(record), phrase,
+                        phrase_length * sizeof(ucs4_t)))
+            break;
+
+        result = search_record(record, tokens) | result;
+    }
+
+    return result;
+}
+
+/* add_index method */
+int PhraseHashTable3::add_index(int phrase_length,
+                                /* in */ const ucs4_t phrase[],
+                                /* in */ phrase_token_t token) {
+    assert(0 < phrase_length && phrase_length <= MAX_PHRASE_LENGTH);
+
+    phrase_hash_table_build_item_t item;
+    memset(&item, 0, sizeof(item));
+    memcpy(item.m_phrase, phrase, phrase_length * sizeof(ucs4_t));
+    item.m_phrase_length = phrase_length;
+    item.m_token = token;
+    g_array_append_val(m_build_items, item);
+
+    /* add the empty entries for continued information. */
+    for (int len = phrase_length - 1; len > 0; --len) {
+        item.m_phrase_length = len;
+        item.m_token = null_token;
+        g_array_append_val(m_build_items, item);
+    }
+
+    return ERROR_OK;
+}
+
+/* store method */
+bool PhraseHashTable3::store(MemoryChunk * new_chunk) {
+    g_array_sort(m_build_items, compare_build_item);
+
+    GArray * records = g_array_new
+        (FALSE, TRUE, sizeof(phrase_hash_table_record_t));
+    GArray * phrases = g_array_new(FALSE, FALSE, sizeof(ucs4_t));
+    GArray * tokens = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+
+    /* merge the sorted items into the records. */
+    const phrase_hash_table_build_item_t * prev = NULL;
+    for (size_t i = 0; i < m_build_items->len; ++i) {
+        const phrase_hash_table_build_item_t * item =
+            &g_array_index(m_build_items, phrase_hash_table_build_item_t, i);
+
+        bool new_record = NULL == prev || 0 != compare_phrase_prefix
+            (prev->m_phrase_length, prev->m_phrase,
+             item->m_phrase_length, item->m_phrase);
+
+        if (new_record) {
+            phrase_hash_table_record_t record;
+            record.m_phrase_length = item->m_phrase_length;
+            record.m_phrase_offset = phrases->len;
+            record.m_tokens_offset = tokens->len;
+            record.m_num_tokens = 0;
+            g_array_append_val(records, record);
+            g_array_append_vals(phrases, item->m_phrase,
+                                item->m_phrase_length);
+        }
+
+        /* skip the empty entries and the duplicated items. */
+        bool duplicated = !new_record && prev->m_token == item->m_token;
+        if (null_token != item->m_token && !duplicated) {
+            g_array_append_val(tokens, item->m_token);
+            g_array_index(records, phrase_hash_table_record_t,
+                          records->len - 1).m_num_tokens ++;
+        }
+
+        prev = item;
+    }
+
+    const guint32 num_records = records->len;
+    const guint32 num_buckets =
+        std::max(num_records / phrase_hash_table_bucket_size, 1U);
+
+    /* group the records by the buckets. */
+    GArray ** buckets = g_new0(GArray *, num_buckets);
+    for (guint32 index = 0; index < num_records; ++index) {
+        const phrase_hash_table_record_t & record =
+            g_array_index(records, phrase_hash_table_record_t, index);
+        const ucs4_t * phrase = &g_array_index
+            (phrases, ucs4_t, record.m_phrase_offset);
+
+        guint32 bucket = hash_phrase
+            (record.m_phrase_length, phrase, BUCKET_SEED) % num_buckets;
+        if (NULL == buckets[bucket])
+            buckets[bucket] = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_array_append_val(buckets[bucket], index);
+    }
+
+    /* place the larger buckets first, when more slots are free. */
+    GArray * order = g_array_new(FALSE, FALSE, sizeof(guint32));
+    for (guint32 bucket = 0; bucket < num_buckets; ++bucket) {
+        if (buckets[bucket])
+            g_array_append_val(order, bucket);
+    }
+    g_array_sort_with_data(order, compare_bucket_size, buckets);
+
+    GArray * displacements = g_array_new(FALSE, TRUE, sizeof(guint32));
+    g_array_set_size(displacements, num_buckets);
+    GArray * slots = g_array_new(FALSE, TRUE,
+                                 sizeof(phrase_hash_table_slot_t));
+    g_array_set_size(slots, num_records);
+    guint8 * used = g_new0(guint8, num_records);
+
+    bool retval = true;
+    for (size_t i = 0; i < order->len && retval; ++i) {
+        guint32 bucket = g_array_index(order, guint32, i);
+        GArray * members = buckets[bucket];
+
+        /* the buckets are small, unless the hash is broken. */
+        guint32 candidates[phrase_hash_table_max_bucket_size];
+        if (members->len > G_N_ELEMENTS(candidates)) {
+            retval = false;
+            break;
+        }
+
+        guint32 displacement = 0;
+        for (; displacement < phrase_hash_table_max_displacement;
+             ++displacement) {
+            size_t reserved = 0;
+            for (; reserved < members->len; ++reserved) {
+                const phrase_hash_table_record_t & record = g_array_index
+                    (records, phrase_hash_table_record_t,
+                     g_array_index(members, guint32, reserved));
+                const ucs4_t * phrase = &g_array_index
+                    (phrases, ucs4_t, record.m_phrase_offset);
+
+                guint32 slot = hash_phrase
+                    (record.m_phrase_length, phrase,
+                     SLOT_SEED + displacement) % num_records;
+                if (used[slot])
+                    break;
+
+                /* reserve the slot until the bucket is placed. */
+                used[slot] = 1;
+                candidates[reserved] = slot;
+            }
+
+            if (reserved == members->len)
+                break;
+
+            /* release the slots of the partial placement. */
+            for (size_t j = 0; j < reserved; ++j)
+                used[candidates[j]] = 0;
+        }
+
+        if (phrase_hash_table_max_displacement == displacement) {
+            retval = false;
+            break;
+        }
+
+        g_array_index(displacements, guint32, bucket) = displacement;
+        for (size_t j = 0; j < members->len; ++j) {
+            guint32 index = g_array_index(members, guint32, j);
+            const phrase_hash_table_record_t & record =
+                g_array_index(records, phrase_hash_table_record_t, index);
+            const ucs4_t * phrase = &g_array_index
+                (phrases, ucs4_t, record.m_phrase_offset);
+
+            phrase_hash_table_slot_t & slot = g_array_index
+                (slots, phrase_hash_table_slot_t, candidates[j]);
+            slot.m_fingerprint = hash_phrase
+                (record.m_phrase_length, phrase, FINGERPRINT_SEED);
+            slot.m_record = index;
+        }
+    }
+
+    if (retval) {
+        phrase_hash_table_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.m_magic = phrase_hash_table_magic;
+        header.m_version = phrase_hash_table_version;
+        header.m_num_records = num_records;
+        header.m_num_buckets = num_buckets;
+
+        new_chunk->set_size(0);
+
+        /* all the arrays are aligned to guint32. */
+        table_offset_t offset = align_offset(sizeof(header));
+        header.m_displacements_offset = offset;
+        new_chunk->set_content(offset, displacements->data,
+                               num_buckets * sizeof(guint32));
+        offset += num_buckets * sizeof(guint32);
+
+        header.m_slots_offset = offset;
+        new_chunk->set_content(offset, slots->data, num_records *
+                               sizeof(phrase_hash_table_slot_t));
+        offset += num_records * sizeof(phrase_hash_table_slot_t);
+
+        header.m_records_offset = offset;
+        new_chunk->set_content(offset, records->data, num_records *
+                               sizeof(phrase_hash_table_record_t));
+        offset += num_records * sizeof(phrase_hash_table_record_t);
+
+        header.m_phrases_offset = offset;
+        new_chunk->set_content(offset, phrases->data,
+                               phrases->len * sizeof(ucs4_t));
+        offset += phrases->len * sizeof(ucs4_t);
+
+        header.m_tokens_offset = offset;
+        new_chunk->set_content(offset, tokens->data,
+                               tokens->len * sizeof(phrase_token_t));
+        offset += tokens->len * sizeof(phrase_token_t);
+
+        header.m_end_offset = offset;
+        new_chunk->set_content(0, &header, sizeof(header));
+    }
+
+    g_free(used);
+    g_array_free(slots, TRUE);
+    g_array_free(displacements, TRUE);
+    g_array_free(order, TRUE);
+    for (guint32 bucket = 0; bucket < num_buckets; ++bucket) {
+        if (buckets[bucket])
+            g_array_free(buckets[bucket], TRUE);
+    }
+    g_free(buckets);
+
+    g_array_free(tokens, TRUE);
+    g_array_free(phrases, TRUE);
+    g_array_free(records, TRUE);
+    return retval;
+}
+
+/* load text method */
+bool PhraseHashTable3::load_text(FILE * infile) {
+    char pinyin[256];
+    char phrase[256];
+    phrase_token_t token;
+    size_t freq;
+
+    while (!feof(infile)) {
+#ifdef __APPLE__
+        int num = fscanf(infile, "%255s %255[^ \t] %u %ld",
+                         pinyin, phrase, &token, &freq);
+#else
+        int num = fscanf(infile, "%255s %255s %u %ld",
+                         pinyin, phrase, &token, &freq);
+#endif
+
+        if (4 != num)
+            continue;
+
+        if (feof(infile))
+            break;
+
+        glong phrase_len = g_utf8_strlen(phrase, -1);
+        ucs4_t * new_phrase = g_utf8_to_ucs4(phrase, -1, NULL, NULL, NULL);
+        add_index(phrase_len, new_phrase, token);
+
+        g_free(new_phrase);
+    }
+    return true;
+}
+
+};
@@ -0,0 +1,208 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHRASE_HASH_TABLE3_H
+#define PHRASE_HASH_TABLE3_H
+
+#include <stdio.h>
+#include <glib.h>
+#include "novel_types.h"
+#include "memory_chunk.h"
+
+namespace pinyin{
+
+/* "PHT3" in little endian. */
+static const guint32 phrase_hash_table_magic = 0x33544850;
+static const guint32 phrase_hash_table_version = 1;
+
+struct phrase_hash_table_header_t{
+    guint32 m_magic;
+    guint32 m_version;
+
+    guint32 m_num_records;
+    guint32 m_num_buckets;
+
+    /* guint32[m_num_buckets], the displacement of each bucket. */
+    table_offset_t m_displacements_offset;
+    /* phrase_hash_table_slot_t[m_num_records]. */
+    table_offset_t m_slots_offset;
+    /* phrase_hash_table_record_t[m_num_records], sorted by the phrase. */
+    table_offset_t m_records_offset;
+    /* ucs4_t[], the phrases of the records. */
+    table_offset_t m_phrases_offset;
+    /* phrase_token_t[], the tokens of the records. */
+    table_offset_t m_tokens_offset;
+    table_offset_t m_end_offset;
+};
+
+/* the slot of the minimal perfect hash. */
+struct phrase_hash_table_slot_t{
+    /* reject most of the missing phrases without the record. */
+    guint32 m_fingerprint;
+    guint32 m_record;
+};
+
+struct phrase_hash_table_record_t{
+    guint32 m_phrase_length;
+    /* the index of the first ucs4 character. */
+    guint32 m_phrase_offset;
+    /* the index of the first token. */
+    guint32 m_tokens_offset;
+    /* zero for the empty entry of the prefix. */
+    guint32 m_num_tokens;
+};
+
+/**
+ * PhraseHashTable3:
+ *
+ * The read-only phrase table stored in one memory chunk,
+ * which can be mmapped and shared between processes.
+ *
+ * The phrases are searched by the minimal perfect hash,
+ * and the suggestions are searched in the sorted records.
+ *
+ * The search results are the same as the PhraseLargeTable3
+ * with the same phrases.
+ *
+ */
+class PhraseHashTable3{
+protected:
+    /* the loaded hash table. */
+    MemoryChunk * m_chunk;
+    const phrase_hash_table_header_t * m_header;
+
+    /* Array of phrase_hash_table_build_item_t,
+       the added phrases before storing. */
+    GArray * m_build_items;
+
+    void reset();
+
+protected:
+    const phrase_hash_table_record_t * get_record(guint32 index) const;
+
+    const ucs4_t * get_phrase(const phrase_hash_table_record_t * record) const;
+
+    bool find_record(int phrase_length, /* in */ const ucs4_t phrase[],
+                     /* out */ guint32 & index) const;
+
+    int search_record(const phrase_hash_table_record_t * record,
+                      /* out */ PhraseTokens tokens) const;
+
+public:
+    /**
+     * PhraseHashTable3::PhraseHashTable3:
+     *
+     * The constructor of the PhraseHashTable3.
+     *
+     */
+    PhraseHashTable3();
+
+    /**
+     * PhraseHashTable3::~PhraseHashTable3:
+     *
+     * The destructor of the PhraseHashTable3.
+     *
+     */
+    ~PhraseHashTable3();
+
+    /**
+     * PhraseHashTable3::load:
+     * @chunk: the memory chunk of the hash table.
+     * @returns: whether the load operation is successful.
+     *
+     * Load the hash table, the chunk is owned by this table.
+     *
+     */
+    bool load(MemoryChunk * chunk);
+
+    /**
+     * PhraseHashTable3::is_hash_table:
+     * @filename: the file name of the system table.
+     * @returns: whether the file is the hash table.
+     *
+     * Check the magic number and version of the file header,
+     * without reading the whole file.
+     *
+     */
+    static bool is_hash_table(const char * filename);
+
+    /**
+     * PhraseHashTable3::store:
+     * @new_chunk: the memory chunk to store the hash table.
+     * @returns: whether the store operation is successful.
+     *
+     * Build the minimal perfect hash and store the added phrases.
+     *
+     */
+    bool store(MemoryChunk * new_chunk);
+
+    /**
+     * PhraseHashTable3::load_text:
+     * @infile: the text file of the phrase table.
+     * @returns: whether the load operation is successful.
+     *
+     * Add the phrases in the text file.
+     *
+     */
+    bool load_text(FILE * infile);
+
+    /**
+     * PhraseHashTable3::add_index:
+     * @phrase_length: the length of the phrase to be added.
+     * @phrase: the ucs4 characters of the phrase to be added.
+     * @token: the token of the phrase to be added.
+     * @returns: the add result of enum ErrorResult.
+     *
+     * Add the phrase token before storing the hash table.
+     *
+     */
+    int add_index(int phrase_length, /* in */ const ucs4_t phrase[],
+                  /* in */ phrase_token_t token);
+
+    /**
+     * PhraseHashTable3::search:
+     * @phrase_length: the length of the phrase to be searched.
+     * @phrase: the ucs4 characters of the phrase to be searched.
+     * @tokens: the GArray of tokens to store the matched phrases.
+     * @returns: the search result of enum SearchResult.
+     *
+     * Search the phrase tokens according to the ucs4 characters.
+     *
+     */
+    int search(int phrase_length, /* in */ const ucs4_t phrase[],
+               /* out */ PhraseTokens tokens) const;
+
+    /**
+     * PhraseHashTable3::search_suggestion:
+     * @phrase_length: the length of the prefix to be searched.
+     * @phrase: the ucs4 characters of the prefix to be searched.
+     * @tokens: the GArray of tokens to store the matched phrases.
+     * @returns: the search result of enum SearchResult.
+     *
+     * Search the phrase tokens according to the ucs4 prefix characters.
+     *
+     */
+    int search_suggestion(int phrase_length, /* in */ const ucs4_t phrase[],
+                          /* out */ PhraseTokens tokens) const;
+};
+
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "phrase_index.h"
 #include "pinyin_custom2.h"
 #include "unaligned_memory.h"
+#include "pinyin_locker.h"
 
 namespace pinyin{
 
@@ -31,72 +32,85 @@ bool PhraseItem::set_n_pronunciation(guint8 n_prouns){
 
 bool PhraseItem::get_nth_pronunciation(size_t index, ChewingKey * keys,
                                        guint32 & freq){
-    guint8 phrase_length = get_phrase_length();
-    table_offset_t offset = phrase_item_header + phrase_length * sizeof( ucs4_t) + index * ( phrase_length * sizeof (ChewingKey) + sizeof(guint32));
-
-    bool retval = m_chunk.get_content
-        (offset, keys, phrase_length * sizeof(ChewingKey));
-    if ( !retval )
-        return retval;
-    return m_chunk.get_content
-        (offset + phrase_length * sizeof(ChewingKey), &freq , sizeof(guint32));
+    return get_view().get_nth_pronunciation(index, keys, freq);
 }
 
-#if 0
-void PhraseItem::append_pronunciation(ChewingKey * keys, guint32 freq){
+void PhraseItem::update_pronunciation_possibility(){
     guint8 phrase_length = get_phrase_length();
-    set_n_pronunciation(get_n_pronunciation() + 1);
-    m_chunk.set_content(m_chunk.size(), keys,
-                        phrase_length * sizeof(ChewingKey));
-    m_chunk.set_content(m_chunk.size(), &freq, sizeof(guint32));
+    guint8 npron = get_n_pronunciation();
+    const size_t stride = phrase_item_pronunciation_size(phrase_length);
+    size_t offset = phrase_item_header + phrase_length * sizeof(ucs4_t);
+    char * buf_begin = (char *) m_chunk.begin();
+
+    guint32 total_freq = 0;
+    for (int i = 0; i < npron; ++i) {
+        char * pronunciation = buf_begin + offset + i * stride;
+        total_freq += *(guint32 *) pronunciation;
+    }
+
+    m_chunk.set_content(phrase_item_total_offset,
+                        &total_freq, sizeof(guint32));
+
+    for (int i = 0; i < npron; ++i) {
+        char * pronunciation = buf_begin + offset + i * stride;
+        guint16 log_poss = quantize_log_possibility
+            (*(guint32 *) pronunciation, total_freq);
+        *(guint16 *) (pronunciation + phrase_item_log_poss_offset) = log_poss;
+    }
 }
-#endif
 
 bool PhraseItem::add_pronunciation(ChewingKey * keys, guint32 delta){
     guint8 phrase_length = get_phrase_length();
     guint8 npron = get_n_pronunciation();
+    const size_t stride = phrase_item_pronunciation_size(phrase_length);
     size_t offset = phrase_item_header + phrase_length * sizeof(ucs4_t);
     char * buf_begin = (char *) m_chunk.begin();
     guint32 total_freq = 0;
 
     for (int i = 0; i < npron; ++i) {
-        char * chewing_begin = buf_begin + offset +
-            i * (phrase_length * sizeof(ChewingKey) + sizeof(guint32));
-
-        guint32 * pfreq = (guint32 *)(chewing_begin +
-                                      phrase_length * sizeof(ChewingKey));
-        guint32 freq = UnalignedMemory<guint32>::load(pfreq);
+        char * pronunciation = buf_begin + offset + i * stride;
+        guint32 * pfreq = (guint32 *) pronunciation;
 
-        total_freq += freq;
+        total_freq += *pfreq;
 
         if (0 == pinyin_exact_compare2
-            (keys, (ChewingKey *)chewing_begin, phrase_length)) {
+            (keys, (ChewingKey *)(pronunciation + phrase_item_keys_offset),
+             phrase_length)) {
             /* found the exact match pinyin keys. */
 
             /* protect against total_freq overflow. */
             if (delta > 0 && total_freq > total_freq + delta)
                 return false;
 
-            freq += delta;
-            total_freq += delta;
-            UnalignedMemory<guint32>::store(freq, pfreq);
+            *pfreq += delta;
+            update_pronunciation_possibility();
             return true;
         }
     }
 
     set_n_pronunciation(npron + 1);
-    m_chunk.set_content(m_chunk.size(), keys,
-                        phrase_length * sizeof(ChewingKey));
-    m_chunk.set_content(m_chunk.size(), &delta, sizeof(guint32));
+
+    /* zero the padding to keep the phrase items comparable. */
+    char pronunciation[phrase_item_keys_offset +
+                       MAX_PHRASE_LENGTH * sizeof(ChewingKey) +
+                       sizeof(guint16)];
+    memset(pronunciation, 0, sizeof(pronunciation));
+    memcpy(pronunciation, &delta, sizeof(guint32));
+    memcpy(pronunciation + phrase_item_keys_offset, keys,
+           phrase_length * sizeof(ChewingKey));
+    m_chunk.append_content(pronunciation, stride);
+    update_pronunciation_possibility();
     return true;
 }
 
 void PhraseItem::remove_nth_pronunciation(size_t index){
     guint8 phrase_length = get_phrase_length();
+    const size_t stride = phrase_item_pronunciation_size(phrase_length);
     set_n_pronunciation(get_n_pronunciation() - 1);
     size_t offset = phrase_item_header + phrase_length * sizeof(ucs4_t) +
-        index * (phrase_length * sizeof(ChewingKey) + sizeof(guint32));
-    m_chunk.remove_content(offset, phrase_length * sizeof(ChewingKey) + sizeof(guint32));
+        index * stride;
+    m_chunk.remove_content(offset, stride);
+    update_pronunciation_possibility();
 }
 
 bool PhraseItem::get_phrase_string(ucs4_t * phrase){
@@ -114,31 +128,30 @@ void PhraseItem::increase_pronunciation_possibility(ChewingKey * keys,
                                                     gint32 delta){
     guint8 phrase_length = get_phrase_length();
     guint8 npron = get_n_pronunciation();
+    const size_t stride = phrase_item_pronunciation_size(phrase_length);
     size_t offset = phrase_item_header + phrase_length * sizeof(ucs4_t);
     char * buf_begin = (char *) m_chunk.begin();
     guint32 total_freq = 0;
 
     for (int i = 0; i < npron; ++i) {
-        char * chewing_begin = buf_begin + offset +
-            i * (phrase_length * sizeof(ChewingKey) + sizeof(guint32));
-
-        guint32 * pfreq = (guint32 *)(chewing_begin +
-                                      phrase_length * sizeof(ChewingKey));
-        guint32 freq = UnalignedMemory<guint32>::load(pfreq);
-        total_freq += freq;
+        char * pronunciation = buf_begin + offset + i * stride;
+        guint32 * pfreq = (guint32 *) pronunciation;
+        total_freq += *pfreq;
 
-        if (0 == pinyin_compare_with_tones(keys, (ChewingKey *)chewing_begin,
-                                           phrase_length)) {
+        if (0 == pinyin_compare_with_tones
+            (keys, (ChewingKey *)(pronunciation + phrase_item_keys_offset),
+             phrase_length)) {
 
             /* protect against total_freq overflow. */
             if (delta > 0 && total_freq > total_freq + delta)
-                return;
+                break;
 
-            freq += delta;
+            *pfreq += delta;
             total_freq += delta;
-            UnalignedMemory<guint32>::store(freq, pfreq);
         }
     }
+
+    update_pronunciation_possibility();
 }
 
 
@@ -146,7 +159,52 @@ guint32 SubPhraseIndex::get_phrase_index_total_freq(){
     return m_total_freq;
 }
 
+void SubPhraseIndex::set_overlay(phrase_token_t token,
+                                 const PhraseItem * item){
+    PhraseItem * copied = NULL;
+    if ( item ){
+        copied = new PhraseItem;
+        copied->m_chunk.set_content(0, item->m_chunk.begin(),
+                                    item->m_chunk.size());
+    }
+
+    g_hash_table_insert(m_overlay, GUINT_TO_POINTER(token & PHRASE_MASK),
+                        copied);
+}
+
+int SubPhraseIndex::copy_on_write(phrase_token_t token, PhraseItem * & item){
+    if ( lookup_overlay(token, item) )
+        return item ? ERROR_OK : ERROR_NO_ITEM;
+
+    PhraseItem base_item;
+    int result = get_base_phrase_item(token, base_item);
+    if ( result != ERROR_OK )
+        return result;
+
+    set_overlay(token, &base_item);
+    check_result(lookup_overlay(token, item));
+    return ERROR_OK;
+}
+
 int SubPhraseIndex::add_unigram_frequency(phrase_token_t token, guint32 delta){
+    if ( has_overlay() ){
+        /* the loaded content is read-only, change the copy. */
+        PhraseItem * item = NULL;
+        int result = copy_on_write(token, item);
+        if ( result != ERROR_OK )
+            return result;
+
+        //protect total_freq overflow
+        if ( delta > 0 && m_total_freq > m_total_freq + delta )
+            return ERROR_INTEGER_OVERFLOW;
+
+        guint32 freq = item->get_unigram_frequency() + delta;
+        m_total_freq += delta;
+        item->m_chunk.set_content(phrase_item_frequency_offset,
+                                  &freq, sizeof(guint32));
+        return ERROR_OK;
+    }
+
     table_offset_t offset;
     guint32 freq;
     bool result = m_phrase_index.get_content
@@ -160,7 +218,7 @@ int SubPhraseIndex::add_unigram_frequency(phrase_token_t token, guint32 delta){
         return ERROR_NO_ITEM;
 
     result = m_phrase_content.get_content
-        (offset + sizeof(guint8) + sizeof(guint8), &freq, sizeof(guint32));
+        (offset + phrase_item_frequency_offset, &freq, sizeof(guint32));
 
     if ( !result )
         return ERROR_FILE_CORRUPTION;
@@ -171,12 +229,43 @@ int SubPhraseIndex::add_unigram_frequency(phrase_token_t token, guint32 delta){
 
     freq += delta;
     m_total_freq += delta;
-    m_phrase_content.set_content(offset + sizeof(guint8) + sizeof(guint8), &freq, sizeof(guint32));
+    m_phrase_content.set_content(offset + phrase_item_frequency_offset, &freq, sizeof(guint32));
 
     return ERROR_OK;
 }
 
 int SubPhraseIndex::get_phrase_item(phrase_token_t token, PhraseItem & item){
+    PhraseItem * overlay_item = NULL;
+    if ( lookup_overlay(token, overlay_item) ){
+        if ( !overlay_item )
+            return ERROR_NO_ITEM;
+
+        item.m_chunk.set_chunk(overlay_item->m_chunk.begin(),
+                               overlay_item->m_chunk.size(), NULL);
+        return ERROR_OK;
+    }
+
+    return get_base_phrase_item(token, item);
+}
+
+int SubPhraseIndex::get_writable_phrase_item(phrase_token_t token,
+                                             PhraseItem & item){
+    if ( !has_overlay() )
+        return get_phrase_item(token, item);
+
+    /* the loaded content is read-only, change the copy. */
+    PhraseItem * overlay_item = NULL;
+    int result = copy_on_write(token, overlay_item);
+    if ( result != ERROR_OK )
+        return result;
+
+    item.m_chunk.set_chunk(overlay_item->m_chunk.begin(),
+                           overlay_item->m_chunk.size(), NULL);
+    return ERROR_OK;
+}
+
+int SubPhraseIndex::get_base_phrase_item(phrase_token_t token,
+                                         PhraseItem & item){
     table_offset_t offset;
     guint8 phrase_length;
     guint8 n_prons;
@@ -199,19 +288,59 @@ int SubPhraseIndex::get_phrase_item(phrase_token_t token, PhraseItem & item){
     if ( !result ) 
         return ERROR_FILE_CORRUPTION;
 
-    size_t length = phrase_item_header + phrase_length * sizeof ( ucs4_t ) + n_prons * ( phrase_length * sizeof (ChewingKey) + sizeof(guint32) );
+    size_t length = phrase_item_size(phrase_length, n_prons);
     item.m_chunk.set_chunk((char *)m_phrase_content.begin() + offset, length, NULL);
     return ERROR_OK;
 }
 
+int SubPhraseIndex::get_phrase_item_view(phrase_token_t token,
+                                         PhraseItemView & view){
+    PhraseItem * overlay_item = NULL;
+    if ( lookup_overlay(token, overlay_item) ){
+        if ( !overlay_item )
+            return ERROR_NO_ITEM;
+
+        view = PhraseItemView((const char *)overlay_item->m_chunk.begin());
+        return ERROR_OK;
+    }
+
+    const table_offset_t * begin =
+        (const table_offset_t *) m_phrase_index.begin();
+    const table_offset_t * end =
+        (const table_offset_t *) m_phrase_index.end();
+
+    /* the same checks as get_phrase_item, without the memory chunk. */
+    const table_offset_t * poffset = begin + (token & PHRASE_MASK);
+    if ( poffset >= end )
+        return ERROR_OUT_OF_RANGE;
+
+    table_offset_t offset = UnalignedMemory<table_offset_t>::load(poffset);
+    if ( 0 == offset )
+        return ERROR_NO_ITEM;
+
+    if ( offset + phrase_item_header > m_phrase_content.size() )
+        return ERROR_FILE_CORRUPTION;
+
+    view = PhraseItemView((const char *)m_phrase_content.begin() + offset);
+    return ERROR_OK;
+}
+
 int SubPhraseIndex::add_phrase_item(phrase_token_t token, PhraseItem * item){
-    table_offset_t offset = m_phrase_content.size();
+    m_total_freq += item->get_unigram_frequency();
+
+    if ( has_overlay() ){
+        /* avoid to re-allocate the loaded content. */
+        set_overlay(token, item);
+        return ERROR_OK;
+    }
+
+    /* keep the phrase items aligned. */
+    table_offset_t offset = phrase_item_align(m_phrase_content.size());
     if ( 0 == offset )
         offset = 8;
     m_phrase_content.set_content(offset, item->m_chunk.begin(), item->m_chunk.size());
     m_phrase_index.set_content((token & PHRASE_MASK) 
                                * sizeof(table_offset_t), &offset, sizeof(table_offset_t));
-    m_total_freq += item->get_unigram_frequency();
     return ERROR_OK;
 }
 
@@ -225,15 +354,24 @@ int SubPhraseIndex::remove_phrase_item(phrase_token_t token, PhraseItem * & item
     item = new PhraseItem;
     //implictly copy data from m_chunk_content.
     item->m_chunk.set_content(0, (char *) old_item.m_chunk.begin() , old_item.m_chunk.size());
+    m_total_freq -= item->get_unigram_frequency();
+
+    if ( has_overlay() ){
+        /* mark the phrase item as removed. */
+        set_overlay(token, NULL);
+        return ERROR_OK;
+    }
 
     const table_offset_t zero_const = 0;
     m_phrase_index.set_content((token & PHRASE_MASK)
                                * sizeof(table_offset_t), &zero_const, sizeof(table_offset_t));
-    m_total_freq -= item->get_unigram_frequency();
     return ERROR_OK;
 }
 
 bool FacadePhraseIndex::load(guint8 phrase_index, MemoryChunk * chunk){
+    /* the chunk replaces the pending sub phrase index. */
+    drop_pending(phrase_index);
+
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases ){
         sub_phrases = new SubPhraseIndex;
@@ -249,6 +387,7 @@ bool FacadePhraseIndex::load(guint8 phrase_index, MemoryChunk * chunk){
 
 bool FacadePhraseIndex::store(guint8 phrase_index, MemoryChunk * new_chunk){
     table_offset_t end;
+    get_sub_phrase(phrase_index);
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases )
         return false;
@@ -258,17 +397,158 @@ bool FacadePhraseIndex::store(guint8 phrase_index, MemoryChunk * new_chunk){
 }
 
 bool FacadePhraseIndex::unload(guint8 phrase_index){
+    if (is_pending(phrase_index)) {
+        drop_pending(phrase_index);
+        return true;
+    }
+
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases )
         return false;
     m_total_freq -= sub_phrases->get_phrase_index_total_freq();
     delete sub_phrases;
     sub_phrases = NULL;
+    m_dirty[phrase_index] = false;
+    return true;
+}
+
+void FacadePhraseIndex::drop_pending(guint8 phrase_index){
+    pending_phrase_library_t & library = m_pending_libraries[phrase_index];
+    gchar * filename = library.m_filename;
+    if (NULL == filename)
+        return;
+
+    g_atomic_int_add((gint *) &m_total_freq, - (gint) library.m_total_freq);
+    g_atomic_pointer_set(&library.m_filename, (gchar *) NULL);
+    g_free(filename);
+    g_free(library.m_log_filename);
+    library.m_log_filename = NULL;
+    library.m_total_freq = 0;
+}
+
+static bool _peek_total_freq(PhraseIndexLogger * logger,
+                             guint32 & old_total_freq,
+                             guint32 & new_total_freq);
+
+bool FacadePhraseIndex::load_on_demand(guint8 phrase_index,
+                                       const char * filename,
+                                       const char * log_filename){
+    if (has_sub_phrase(phrase_index))
+        return false;
+
+    /* the memory chunk file starts with the length and the checksum,
+       the total frequency is the first field of the sub phrase index. */
+    guint32 header[3] = {0, 0, 0};
+    FILE * file = fopen(filename, "rb");
+    if (NULL == file)
+        return false;
+    size_t num = fread(header, sizeof(guint32), 3, file);
+    fclose(file);
+    if (3 != num)
+        return false;
+    guint32 total_freq = header[2];
+
+    /* the log header records the total frequency after merged. */
+    if (log_filename) {
+        MemoryChunk * log = new MemoryChunk;
+        PhraseIndexLogger logger;
+        if (log->load(log_filename)) {
+            logger.load(log);
+
+            guint32 old_total_freq = 0, new_total_freq = 0;
+            if (_peek_total_freq(&logger, old_total_freq, new_total_freq) &&
+                old_total_freq == total_freq)
+                total_freq = new_total_freq;
+        } else {
+            delete log;
+        }
+    }
+
+    pending_phrase_library_t & library = m_pending_libraries[phrase_index];
+    library.m_filename = g_strdup(filename);
+    library.m_log_filename = g_strdup(log_filename);
+    library.m_total_freq = total_freq;
+
+    m_total_freq += total_freq;
+    return true;
+}
+
+bool FacadePhraseIndex::load_pending(guint8 phrase_index){
+    MutexLocker locker(&m_pending_mutex);
+
+    /* loaded by another reader. */
+    if (g_atomic_pointer_get(&m_sub_phrase_indices[phrase_index]) ||
+        !is_pending(phrase_index))
+        return false;
+
+    pending_phrase_library_t & library = m_pending_libraries[phrase_index];
+
+    MemoryChunk * chunk = NULL;
+    if (m_loader) {
+        chunk = m_loader(phrase_index, library.m_filename, m_loader_data);
+    } else {
+        chunk = new MemoryChunk;
+#ifdef LIBPINYIN_USE_MMAP
+        bool loaded = chunk->mmap(library.m_filename);
+#else
+        bool loaded = chunk->load(library.m_filename);
+#endif
+        if (!loaded) {
+            delete chunk;
+            chunk = NULL;
+        }
+    }
+
+    if (NULL == chunk) {
+        fprintf(stderr, "open %s failed!\n", library.m_filename);
+        drop_pending(phrase_index);
+        return false;
+    }
+
+    SubPhraseIndex * sub_phrases = new SubPhraseIndex;
+    bool retval = sub_phrases->load(chunk, 0, chunk->size());
+
+    if (retval && library.m_log_filename) {
+        MemoryChunk * log = new MemoryChunk;
+        PhraseIndexLogger logger;
+        if (log->load(library.m_log_filename)) {
+            /* merge the chunk log. */
+            logger.load(log);
+            sub_phrases->merge(&logger);
+        } else {
+            delete log;
+        }
+    }
+
+    if (!retval) {
+        delete sub_phrases;
+        drop_pending(phrase_index);
+        return false;
+    }
+
+    /* correct the total frequency read from the headers,
+       the other readers may get the total frequency. */
+    guint32 total_freq = sub_phrases->get_phrase_index_total_freq();
+    if (total_freq != library.m_total_freq)
+        g_atomic_int_add((gint *) &m_total_freq,
+                         (gint) (total_freq - library.m_total_freq));
+
+    /* publish the sub phrase index after it is loaded,
+       then clear the pending library. */
+    g_atomic_pointer_set(&m_sub_phrase_indices[phrase_index], sub_phrases);
+
+    gchar * filename = library.m_filename;
+    g_atomic_pointer_set(&library.m_filename, (gchar *) NULL);
+    g_free(filename);
+    g_free(library.m_log_filename);
+    library.m_log_filename = NULL;
+    library.m_total_freq = 0;
     return true;
 }
 
 bool FacadePhraseIndex::diff(guint8 phrase_index, MemoryChunk * oldchunk,
                              MemoryChunk * newlog){
+    get_sub_phrase(phrase_index);
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases )
         return false;
@@ -283,6 +563,7 @@ bool FacadePhraseIndex::diff(guint8 phrase_index, MemoryChunk * oldchunk,
 }
 
 bool FacadePhraseIndex::merge(guint8 phrase_index, MemoryChunk * log){
+    get_sub_phrase(phrase_index);
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases )
         return false;
@@ -301,6 +582,7 @@ bool FacadePhraseIndex::merge_with_mask(guint8 phrase_index,
                                         MemoryChunk * log,
                                         phrase_token_t mask,
                                         phrase_token_t value){
+    get_sub_phrase(phrase_index);
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases )
         return false;
@@ -327,6 +609,9 @@ bool FacadePhraseIndex::merge_with_mask(guint8 phrase_index,
     m_total_freq += sub_phrases->get_phrase_index_total_freq();
     delete newlogger;
 
+    /* the masked out items are still in the user file. */
+    m_dirty[phrase_index] = true;
+
     return retval;
 }
 
@@ -350,32 +635,65 @@ bool SubPhraseIndex::load(MemoryChunk * chunk,
     offset += sizeof(table_offset_t);
     chunk->get_content(offset, &index_three, sizeof(table_offset_t));
     offset += sizeof(table_offset_t);
-    g_return_val_if_fail(*(buf_begin + offset) == c_separate, FALSE);
+    g_return_val_if_fail(*(buf_begin + index_one - 1) == c_separate, FALSE);
     g_return_val_if_fail(*(buf_begin + index_two - 1) == c_separate, FALSE);
     g_return_val_if_fail(*(buf_begin + index_three - 1) == c_separate, FALSE);
-    m_phrase_index.set_chunk(buf_begin + index_one, 
-                             index_two - 1 - index_one, NULL);
+    /* skip the padding before the separator. */
+    table_offset_t index_size = (index_two - 1 - index_one) /
+        sizeof(table_offset_t) * sizeof(table_offset_t);
+    m_phrase_index.set_chunk(buf_begin + index_one, index_size, NULL);
     m_phrase_content.set_chunk(buf_begin + index_two, 
                                index_three - 1 - index_two, NULL);
     g_return_val_if_fail( index_three <= end, FALSE);
+
+    /* keep the changes in the overlay. */
+    g_hash_table_remove_all(m_overlay);
     return true;
 }
 
+/* write the padding before the separator,
+   so the data after the separator is aligned. */
+static table_offset_t _store_separator(MemoryChunk * new_chunk,
+                                       table_offset_t offset){
+    const char padding[sizeof(guint32)] = {0};
+    table_offset_t aligned = phrase_item_align(offset + sizeof(char));
+    new_chunk->set_content(offset, padding,
+                           aligned - sizeof(char) - offset);
+    new_chunk->set_content(aligned - sizeof(char),
+                           &c_separate, sizeof(char));
+    return aligned;
+}
+
 bool SubPhraseIndex::store(MemoryChunk * new_chunk, 
                            table_offset_t offset, table_offset_t& end){
+    if ( g_hash_table_size(m_overlay) ){
+        /* store the loaded content with the overlay. */
+        PhraseIndexRange range;
+        get_range(range);
+
+        SubPhraseIndex merged;
+        PhraseItem item;
+        for ( phrase_token_t token = range.m_range_begin;
+              token < range.m_range_end; ++token ){
+            if ( ERROR_OK == get_phrase_item(token, item) )
+                merged.add_phrase_item(token, &item);
+        }
+
+        merged.m_total_freq = m_total_freq;
+        return merged.store(new_chunk, offset, end);
+    }
+
     new_chunk->set_content(offset, &m_total_freq, sizeof(guint32));
     table_offset_t index = offset + sizeof(guint32);
         
     offset = index + sizeof(table_offset_t) * 3 ;
-    new_chunk->set_content(offset, &c_separate, sizeof(char));
-    offset += sizeof(char);
+    offset = _store_separator(new_chunk, offset);
     
     new_chunk->set_content(index, &offset, sizeof(table_offset_t));
     index += sizeof(table_offset_t);
     new_chunk->set_content(offset, m_phrase_index.begin(), m_phrase_index.size());
     offset += m_phrase_index.size();
-    new_chunk->set_content(offset, &c_separate, sizeof(char));
-    offset += sizeof(char);
+    offset = _store_separator(new_chunk, offset);
 
     new_chunk->set_content(index, &offset, sizeof(table_offset_t));
     index += sizeof(table_offset_t);
@@ -388,6 +706,18 @@ bool SubPhraseIndex::store(MemoryChunk * new_chunk,
     return true;
 }
 
+static void _collect_token(gpointer key, gpointer value, gpointer data) {
+    GArray * tokens = (GArray *) data;
+    phrase_token_t token = GPOINTER_TO_UINT(key);
+    g_array_append_val(tokens, token);
+}
+
+static gint _compare_token(gconstpointer lhs, gconstpointer rhs) {
+    phrase_token_t token_lhs = *(const phrase_token_t *) lhs;
+    phrase_token_t token_rhs = *(const phrase_token_t *) rhs;
+    return token_lhs < token_rhs ? -1 : (token_lhs > token_rhs ? 1 : 0);
+}
+
 bool SubPhraseIndex::diff(SubPhraseIndex * oldone, PhraseIndexLogger * logger){
     /* diff the header */
     MemoryChunk oldheader, newheader;
@@ -398,6 +728,23 @@ bool SubPhraseIndex::diff(SubPhraseIndex * oldone, PhraseIndexLogger * logger){
     logger->append_record(LOG_MODIFY_HEADER, null_token,
                           &oldheader, &newheader);
 
+    /* only diff the changed phrase items in the overlay. */
+    if (has_overlay()) {
+        GArray * tokens = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+
+        g_hash_table_foreach(m_overlay, _collect_token, tokens);
+        /* keep the same order as the full diff. */
+        g_array_sort(tokens, _compare_token);
+
+        for (size_t i = 0; i < tokens->len; ++i) {
+            phrase_token_t token = g_array_index(tokens, phrase_token_t, i);
+            diff_phrase_item(oldone, token, logger);
+        }
+
+        g_array_free(tokens, TRUE);
+        return true;
+    }
+
     /* diff phrase items */
     PhraseIndexRange oldrange, currange, range;
     oldone->get_range(oldrange); get_range(currange);
@@ -405,30 +752,38 @@ bool SubPhraseIndex::diff(SubPhraseIndex * oldone, PhraseIndexLogger * logger){
                                         currange.m_range_begin);
     range.m_range_end = std_lite::max(oldrange.m_range_end,
                                       currange.m_range_end);
-    PhraseItem olditem, newitem;
 
     for (phrase_token_t token = range.m_range_begin;
          token < range.m_range_end; ++token ){
-        bool oldretval = ERROR_OK == oldone->get_phrase_item(token, olditem);
-        bool newretval = ERROR_OK == get_phrase_item(token, newitem);
-
-        if ( oldretval ){
-            if ( newretval ) { /* compare phrase item. */
-                if ( olditem == newitem )
-                    continue;
-                logger->append_record(LOG_MODIFY_RECORD, token,
-                                      &(olditem.m_chunk), &(newitem.m_chunk));
-            } else { /* remove phrase item. */
-                logger->append_record(LOG_REMOVE_RECORD, token,
-                                      &(olditem.m_chunk), NULL);
-            }
-        } else {
-            if ( newretval ){ /* add phrase item. */
-                logger->append_record(LOG_ADD_RECORD, token,
-                                      NULL, &(newitem.m_chunk));
-            } else { /* both empty. */
-                /* do nothing. */
-            }
+        diff_phrase_item(oldone, token, logger);
+    }
+
+    return true;
+}
+
+bool SubPhraseIndex::diff_phrase_item(SubPhraseIndex * oldone,
+                                      phrase_token_t token,
+                                      PhraseIndexLogger * logger){
+    PhraseItem olditem, newitem;
+    bool oldretval = ERROR_OK == oldone->get_phrase_item(token, olditem);
+    bool newretval = ERROR_OK == get_phrase_item(token, newitem);
+
+    if ( oldretval ){
+        if ( newretval ) { /* compare phrase item. */
+            if ( olditem == newitem )
+                return false;
+            logger->append_record(LOG_MODIFY_RECORD, token,
+                                  &(olditem.m_chunk), &(newitem.m_chunk));
+        } else { /* remove phrase item. */
+            logger->append_record(LOG_REMOVE_RECORD, token,
+                                  &(olditem.m_chunk), NULL);
+        }
+    } else {
+        if ( newretval ){ /* add phrase item. */
+            logger->append_record(LOG_ADD_RECORD, token,
+                                  NULL, &(newitem.m_chunk));
+        } else { /* both empty. */
+            return false;
         }
     }
 
@@ -488,6 +843,8 @@ bool SubPhraseIndex::merge(PhraseIndexLogger * logger){
                 assert(olditem == *tmpitem);
                 add_phrase_item(token, &newitem);
                 delete tmpitem;
+            } else if (has_overlay()) { /* the loaded content is read-only. */
+                set_overlay(token, &newitem);
             } else { /* in place editing. */
                 /* newchunk.size() <= item.m_chunk.size() */
                 /* Hack here: we assume the behaviour of get_phrase_item
@@ -520,6 +877,8 @@ bool SubPhraseIndex::merge(PhraseIndexLogger * logger){
 
 bool FacadePhraseIndex::load_text(guint8 phrase_index, FILE * infile,
                                   TABLE_PHONETIC_TYPE type){
+    drop_pending(phrase_index);
+
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if ( !sub_phrases ){
         sub_phrases = new SubPhraseIndex;
@@ -611,7 +970,7 @@ int FacadePhraseIndex::get_sub_phrase_range(guint8 & min_index,
                                             guint8 & max_index){
     min_index = PHRASE_INDEX_LIBRARY_COUNT; max_index = 0;
     for ( guint8 i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i ){
-        if ( m_sub_phrase_indices[i] ) {
+        if ( has_sub_phrase(i) ) {
             min_index = std_lite::min(min_index, i);
             max_index = std_lite::max(max_index, i);
         }
@@ -620,7 +979,7 @@ int FacadePhraseIndex::get_sub_phrase_range(guint8 & min_index,
 }
 
 int FacadePhraseIndex::get_range(guint8 phrase_index, /* out */ PhraseIndexRange & range){
-    SubPhraseIndex * sub_phrase = m_sub_phrase_indices[phrase_index];
+    SubPhraseIndex * sub_phrase = get_sub_phrase(phrase_index);
     if ( !sub_phrase )
         return ERROR_NO_SUB_PHRASE_INDEX;
 
@@ -633,11 +992,22 @@ int FacadePhraseIndex::get_range(guint8 phrase_index, /* out */ PhraseIndexRange
     return ERROR_OK;
 }
 
+static void _max_token(gpointer key, gpointer value, gpointer data) {
+    phrase_token_t * range_end = (phrase_token_t *) data;
+    phrase_token_t token = GPOINTER_TO_UINT(key);
+    if (value && token >= *range_end)
+        *range_end = token + 1;
+}
+
 int SubPhraseIndex::get_range(/* out */ PhraseIndexRange & range){
     const table_offset_t * begin = (const table_offset_t *)m_phrase_index.begin();
     const table_offset_t * end = (const table_offset_t *)m_phrase_index.end();
 
-    if (begin == end) {
+    phrase_token_t range_end = end - begin;
+    /* the phrase items added in the overlay. */
+    g_hash_table_foreach(m_overlay, _max_token, &range_end);
+
+    if (0 == range_end) {
         /* skip empty sub phrase index. */
         range.m_range_begin = 1;
         range.m_range_end = 1;
@@ -645,14 +1015,14 @@ int SubPhraseIndex::get_range(/* out */ PhraseIndexRange & range){
     }
 
     /* remove trailing zeros. */
-    const table_offset_t * poffset = NULL;
-    for (poffset = end; poffset > begin + 1; --poffset) {
-        if (0 !=  UnalignedMemory<table_offset_t>::load(poffset - 1))
+    PhraseItemView view;
+    for (; range_end > 1; --range_end) {
+        if (ERROR_OK == get_phrase_item_view(range_end - 1, view))
             break;
     }
 
     range.m_range_begin = 1; /* token starts with 1 in gen_pinyin_table. */
-    range.m_range_end = poffset - begin; /* removed zeros. */
+    range.m_range_end = range_end; /* removed zeros. */
 
     return ERROR_OK;
 }
@@ -663,6 +1033,10 @@ bool FacadePhraseIndex::compact(){
         if ( !sub_phrase )
             continue;
 
+        /* the loaded content is read-only, nothing to compact. */
+        if ( sub_phrase->has_overlay() )
+            continue;
+
         PhraseIndexRange range;
         int result = sub_phrase->get_range(range);
         if ( result != ERROR_OK )
@@ -711,6 +1085,7 @@ bool SubPhraseIndex::mask_out(phrase_token_t mask, phrase_token_t value){
 bool FacadePhraseIndex::mask_out(guint8 phrase_index,
                                  phrase_token_t mask,
                                  phrase_token_t value){
+    get_sub_phrase(phrase_index);
     SubPhraseIndex * & sub_phrases = m_sub_phrase_indices[phrase_index];
     if (!sub_phrases)
         return false;
@@ -726,6 +1101,9 @@ bool FacadePhraseIndex::mask_out(guint8 phrase_index,
     bool retval = sub_phrases->mask_out(mask, value);
     m_total_freq += sub_phrases->get_phrase_index_total_freq();
 
+    m_dirty[phrase_index] = true;
+    if (m_journal)
+        m_journal->invalidate();
     return retval;
 }
 
@@ -759,6 +1137,32 @@ static bool _peek_header(PhraseIndexLogger * logger,
     return  1 == header_count? true : false;
 }
 
+static bool _peek_total_freq(PhraseIndexLogger * logger,
+                             guint32 & old_total_freq,
+                             guint32 & new_total_freq){
+    old_total_freq = 0; new_total_freq = 0;
+
+    LOG_TYPE log_type; phrase_token_t token;
+    MemoryChunk oldchunk, newchunk;
+
+    while (logger->has_next_record()) {
+        bool retval = logger->next_record
+            (log_type, token, &oldchunk, &newchunk);
+
+        if (!retval)
+            break;
+
+        if (LOG_MODIFY_HEADER != log_type)
+            continue;
+
+        oldchunk.get_content(0, &old_total_freq, sizeof(guint32));
+        newchunk.get_content(0, &new_total_freq, sizeof(guint32));
+        return true;
+    }
+
+    return false;
+}
+
 bool _compute_new_header(PhraseIndexLogger * logger,
                          phrase_token_t mask,
                          phrase_token_t value,
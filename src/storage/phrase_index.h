@@ -22,6 +22,8 @@
 #define PHRASE_INDEX_H
 
 #include <stdio.h>
+#include <float.h>
+#include <math.h>
 #include <glib.h>
 #include "novel_types.h"
 #include "chewing_key.h"
@@ -32,6 +34,8 @@
 #include "phrase_index_logger.h"
 #include "table_info.h"
 #include "unaligned_memory.h"
+#include "pinyin_locker.h"
+#include "user_journal.h"
 
 /**
  * Phrase Index File Format
@@ -40,12 +44,18 @@
  * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
  * + Phrase Offset + Phrase Offset + Phrase Offset + ......  +
  * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
- * Phrase Content:
- * ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
- * + Phrase Length + number of  Pronunciations  + Uni-gram Frequency+
- * ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * Phrase Content (each phrase item is aligned to guint32):
+ * ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * + Phrase Length + number of  Pronunciations + Padding + Uni-gram Frequency +
+ * ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * + Total Frequency of Pronunciations +
+ * +++++++++++++++++++++++++++++++++++++
  * + Phrase String(UCS4) + n Pronunciations with Frequency +
  * +++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * Pronunciation with Frequency:
+ * ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ * + Frequency + Quantized Log Possibility + Pinyin Keys(padded to guint32)+
+ * ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
  */
 
 namespace pinyin{
@@ -53,7 +63,235 @@ namespace pinyin{
 /* Store delta info by phrase index logger in user home directory.
  */
 
-const size_t phrase_item_header = sizeof(guint8) + sizeof(guint8) + sizeof(guint32);
+const size_t phrase_item_frequency_offset =
+    sizeof(guint8) + sizeof(guint8) + sizeof(guint16);
+const size_t phrase_item_total_offset =
+    phrase_item_frequency_offset + sizeof(guint32);
+const size_t phrase_item_header = phrase_item_total_offset + sizeof(guint32);
+
+/* the pronunciation starts with the frequency. */
+const size_t phrase_item_log_poss_offset = sizeof(guint32);
+const size_t phrase_item_keys_offset =
+    phrase_item_log_poss_offset + sizeof(guint16);
+
+/* the quantized log possibility is -log(possibility) * scale. */
+const gfloat phrase_item_log_poss_scale = 2048.;
+const guint16 phrase_item_zero_log_poss = G_MAXUINT16;
+
+static inline size_t phrase_item_align(size_t size) {
+    return (size + sizeof(guint32) - 1) & ~(sizeof(guint32) - 1);
+}
+
+/* the fixed stride of the pronunciations in the phrase item. */
+static inline size_t phrase_item_pronunciation_size(guint8 phrase_length) {
+    return phrase_item_align(phrase_item_keys_offset +
+                             phrase_length * sizeof(ChewingKey));
+}
+
+static inline size_t phrase_item_size(guint8 phrase_length, guint8 n_prons) {
+    return phrase_item_header + phrase_length * sizeof(ucs4_t) +
+        n_prons * phrase_item_pronunciation_size(phrase_length);
+}
+
+static inline guint16 quantize_log_possibility(guint32 freq,
+                                               guint32 total_freq) {
+    if (0 == freq || 0 == total_freq)
+        return phrase_item_zero_log_poss;
+
+    gdouble log_poss = -log(freq / (gdouble) total_freq);
+    gdouble quantized = log_poss * phrase_item_log_poss_scale + 0.5;
+    if (quantized >= phrase_item_zero_log_poss)
+        return phrase_item_zero_log_poss - 1;
+    return (guint16) quantized;
+}
+
+/**
+ * PhraseItemView:
+ *
+ * The read-only view of the phrase item in the phrase index,
+ * which is cheap to copy and needs no memory chunk.
+ *
+ * Note: the view is invalid after the phrase item is added, removed or
+ * resized in the phrase index.
+ *
+ */
+class PhraseItemView{
+private:
+    const char * m_item;
+
+    const char * get_pronunciation(size_t index) const {
+        guint8 phrase_length = get_phrase_length();
+        return m_item + phrase_item_header + phrase_length * sizeof(ucs4_t) +
+            index * phrase_item_pronunciation_size(phrase_length);
+    }
+
+public:
+    /**
+     * PhraseItemView::PhraseItemView:
+     * @item: the begin of the aligned phrase item.
+     *
+     * The constructor of the PhraseItemView.
+     *
+     */
+    PhraseItemView(const void * item = NULL){
+        m_item = (const char *) item;
+    }
+
+    /**
+     * PhraseItemView::get_phrase_length:
+     * @returns: the length of this phrase item.
+     *
+     * Get the length of this phrase item.
+     *
+     */
+    guint8 get_phrase_length() const {
+        return *(const guint8 *) m_item;
+    }
+
+    /**
+     * PhraseItemView::get_n_pronunciation:
+     * @returns: the number of the pronunciations.
+     *
+     * Get the number of the pronunciations.
+     *
+     */
+    guint8 get_n_pronunciation() const {
+        return *(const guint8 *) (m_item + sizeof(guint8));
+    }
+
+    /**
+     * PhraseItemView::get_unigram_frequency:
+     * @returns: the uni-gram frequency of this phrase item.
+     *
+     * Get the uni-gram frequency of this phrase item.
+     *
+     */
+    guint32 get_unigram_frequency() const {
+        return *(const guint32 *) (m_item + phrase_item_frequency_offset);
+    }
+
+    /**
+     * PhraseItemView::get_pronunciation_total_frequency:
+     * @returns: the sum of the frequencies of all the pronunciations.
+     *
+     * Get the precomputed total frequency of the pronunciations.
+     *
+     */
+    guint32 get_pronunciation_total_frequency() const {
+        return *(const guint32 *) (m_item + phrase_item_total_offset);
+    }
+
+    /**
+     * PhraseItemView::get_phrase_string:
+     * @phrase: the ucs4 character buffer.
+     * @returns: whether the get operation is successful.
+     *
+     * Get the ucs4 characters of this phrase item.
+     *
+     */
+    bool get_phrase_string(ucs4_t * phrase) const {
+        memcpy(phrase, m_item + phrase_item_header,
+               get_phrase_length() * sizeof(ucs4_t));
+        return true;
+    }
+
+    /**
+     * PhraseItemView::get_nth_pronunciation:
+     * @index: the pronunciation index.
+     * @keys: the pronunciation keys.
+     * @freq: the frequency of the pronunciation.
+     * @returns: whether the get operation is successful.
+     *
+     * Get the nth pronunciation of this phrase item.
+     *
+     */
+    bool get_nth_pronunciation(size_t index,
+                               /* out */ ChewingKey * keys,
+                               /* out */ guint32 & freq) const {
+        if (index >= get_n_pronunciation())
+            return false;
+
+        const char * pronunciation = get_pronunciation(index);
+        memcpy(keys, pronunciation + phrase_item_keys_offset,
+               get_phrase_length() * sizeof(ChewingKey));
+        freq = *(const guint32 *) pronunciation;
+        return true;
+    }
+
+    /**
+     * PhraseItemView::get_pronunciation_possibility:
+     * @keys: the pronunciation keys.
+     * @returns: the possibility of this phrase item pronounces the pinyin.
+     *
+     * Get the possibility of this phrase item pronounces the pinyin.
+     *
+     */
+    gfloat get_pronunciation_possibility(const ChewingKey * keys) const {
+        const guint8 phrase_length = get_phrase_length();
+        const guint8 npron = get_n_pronunciation();
+        const size_t stride = phrase_item_pronunciation_size(phrase_length);
+        const guint32 total_freq = get_pronunciation_total_frequency();
+
+        /* an additional safe guard for chewing. */
+        if ( 0 == total_freq )
+            return 0;
+
+        const char * pronunciation = get_pronunciation(0);
+        guint32 matched = 0;
+        for (int i = 0; i < npron; ++i, pronunciation += stride) {
+            if (0 == pinyin_compare_with_tones
+                (keys, (const ChewingKey *)
+                 (pronunciation + phrase_item_keys_offset), phrase_length)) {
+                matched += *(const guint32 *) pronunciation;
+            }
+        }
+
+        /* used preprocessor to avoid zero freq, in gen_pinyin_table. */
+        gfloat retval = matched / (gfloat) total_freq;
+        return retval;
+    }
+
+    /**
+     * PhraseItemView::get_pronunciation_log_possibility:
+     * @keys: the pronunciation keys.
+     * @returns: the log possibility of this phrase item pronounces the pinyin,
+     *           or -FLT_MAX when no pronunciation matches.
+     *
+     * Get the log possibility from the precomputed quantized value,
+     * when only one pronunciation matches the pinyin.
+     *
+     */
+    gfloat get_pronunciation_log_possibility(const ChewingKey * keys) const {
+        const guint8 phrase_length = get_phrase_length();
+        const guint8 npron = get_n_pronunciation();
+        const size_t stride = phrase_item_pronunciation_size(phrase_length);
+
+        const char * pronunciation = get_pronunciation(0);
+        const char * found = NULL;
+        guint32 matched = 0; size_t n_matched = 0;
+        for (int i = 0; i < npron; ++i, pronunciation += stride) {
+            if (0 == pinyin_compare_with_tones
+                (keys, (const ChewingKey *)
+                 (pronunciation + phrase_item_keys_offset), phrase_length)) {
+                found = pronunciation;
+                matched += *(const guint32 *) pronunciation;
+                ++n_matched;
+            }
+        }
+
+        if (0 == n_matched || 0 == matched)
+            return -FLT_MAX;
+
+        /* the common case. */
+        if (1 == n_matched) {
+            guint16 log_poss = *(const guint16 *)
+                (found + phrase_item_log_poss_offset);
+            return -log_poss / phrase_item_log_poss_scale;
+        }
+
+        return log(matched / (gfloat) get_pronunciation_total_frequency());
+    }
+};
 
 /**
  * PhraseItem:
@@ -63,6 +301,7 @@ const size_t phrase_item_header = sizeof(guint8) + sizeof(guint8) + sizeof(guint
  */
 class PhraseItem{
     friend class SubPhraseIndex;
+    friend class UserJournal;
     friend bool _compute_new_header(PhraseIndexLogger * logger,
                                     phrase_token_t mask,
                                     phrase_token_t value,
@@ -71,6 +310,8 @@ class PhraseItem{
 private:
     MemoryChunk m_chunk;
     bool set_n_pronunciation(guint8 n_prouns);
+    /* refresh the total frequency and the quantized log possibilities. */
+    void update_pronunciation_possibility();
 public:
     /**
      * PhraseItem::PhraseItem:
@@ -90,6 +331,17 @@ public:
     }
 #endif
 
+    /**
+     * PhraseItem::get_view:
+     * @returns: the read-only view of this phrase item.
+     *
+     * Get the read-only view of this phrase item.
+     *
+     */
+    PhraseItemView get_view() const {
+        return PhraseItemView(m_chunk.begin());
+    }
+
     /**
      * PhraseItem::get_phrase_length:
      * @returns: the length of this phrase item.
@@ -98,8 +350,7 @@ public:
      *
      */
     guint8 get_phrase_length(){
-        char * buf_begin = (char *)m_chunk.begin();
-        return (*(guint8 *)buf_begin);
+        return get_view().get_phrase_length();
     }
 
     /**
@@ -110,8 +361,7 @@ public:
      *
      */
     guint8 get_n_pronunciation(){
-        char * buf_begin = ( char *) m_chunk.begin();
-        return (*(guint8 *)(buf_begin + sizeof(guint8)));
+        return get_view().get_n_pronunciation();
     }
 
     /**
@@ -122,7 +372,7 @@ public:
      *
      */
     guint32 get_unigram_frequency(){
-        return m_chunk.get_content<guint32>(sizeof(guint8) + sizeof(guint8));
+        return get_view().get_unigram_frequency();
     }
 
     /**
@@ -134,33 +384,19 @@ public:
      *
      */
     gfloat get_pronunciation_possibility(ChewingKey * keys){
-        guint8 phrase_length = get_phrase_length();
-        guint8 npron = get_n_pronunciation();
-        size_t offset = phrase_item_header + phrase_length * sizeof (ucs4_t);
-        char * buf_begin = (char *)m_chunk.begin();
-        guint32 matched = 0, total_freq =0;
-        for ( int i = 0 ; i < npron ; ++i){
-            char * chewing_begin = buf_begin + offset +
-                i * (phrase_length * sizeof(ChewingKey) + sizeof(guint32));
-
-            guint32 freq = UnalignedMemory<guint32>::load(chewing_begin +
-                                                          phrase_length * sizeof(ChewingKey));
-            total_freq += freq;
-            if ( 0 == pinyin_compare_with_tones(keys, (ChewingKey *)chewing_begin,
-                                                phrase_length) ){
-                matched += freq;
-            }
-        }
-
-#if 1
-        /* an additional safe guard for chewing. */
-        if ( 0 == total_freq )
-            return 0;
-#endif
+        return get_view().get_pronunciation_possibility(keys);
+    }
 
-        /* used preprocessor to avoid zero freq, in gen_pinyin_table. */
-        gfloat retval = matched / (gfloat) total_freq;
-        return retval;
+    /**
+     * PhraseItem::get_pronunciation_log_possibility:
+     * @keys: the pronunciation keys.
+     * @returns: the log possibility of this phrase item pronounces the pinyin.
+     *
+     * Get the log possibility of this phrase item pronounces the pinyin.
+     *
+     */
+    gfloat get_pronunciation_log_possibility(ChewingKey * keys){
+        return get_view().get_pronunciation_log_possibility(keys);
     }
 
     /**
@@ -261,6 +497,10 @@ private:
     MemoryChunk m_phrase_content;
     MemoryChunk * m_chunk;
 
+    /* the phrase items changed since loaded from the memory chunk,
+       NULL for the removed phrase item, the loaded content is read-only. */
+    GHashTable * m_overlay;
+
     void reset(){
         m_total_freq = 0;
         m_phrase_index.set_size(0);
@@ -269,8 +509,35 @@ private:
             delete m_chunk;
             m_chunk = NULL;
         }
+        g_hash_table_remove_all(m_overlay);
     }
 
+    bool lookup_overlay(phrase_token_t token, PhraseItem * & item){
+        if ( 0 == g_hash_table_size(m_overlay) )
+            return false;
+
+        gpointer value = NULL;
+        if (!g_hash_table_lookup_extended
+            (m_overlay, GUINT_TO_POINTER(token & PHRASE_MASK), NULL, &value))
+            return false;
+
+        item = (PhraseItem *) value;
+        return true;
+    }
+
+    static void free_overlay_item(gpointer data){
+        delete (PhraseItem *) data;
+    }
+
+    void set_overlay(phrase_token_t token, const PhraseItem * item);
+
+    int get_base_phrase_item(phrase_token_t token, PhraseItem & item);
+
+    int copy_on_write(phrase_token_t token, PhraseItem * & item);
+
+    bool diff_phrase_item(SubPhraseIndex * oldone, phrase_token_t token,
+                          PhraseIndexLogger * logger);
+
 public:
     /**
      * SubPhraseIndex::SubPhraseIndex:
@@ -280,6 +547,8 @@ public:
      */
     SubPhraseIndex():m_total_freq(0){
         m_chunk = NULL;
+        m_overlay = g_hash_table_new_full
+            (g_direct_hash, g_direct_equal, NULL, free_overlay_item);
     }
 
     /**
@@ -290,6 +559,8 @@ public:
      */
     ~SubPhraseIndex(){
         reset();
+        g_hash_table_destroy(m_overlay);
+        m_overlay = NULL;
     }
     
     /**
@@ -327,6 +598,9 @@ public:
      * Compare this sub phrase index with the original content of the system
      * sub phrase index to generate the logger of difference.
      *
+     * Only the phrase items in the overlay are compared when this
+     * sub phrase index is loaded from the same content as the original one.
+     *
      * Note: Switch to logger format to reduce user space storage.
      *
      */
@@ -385,12 +659,38 @@ public:
      *
      * Get the phrase item from this sub phrase index.
      *
-     * Note:get_phrase_item function can't modify the phrase item size,
+     * Note: the phrase item may refer to the read-only loaded content,
+     * use get_writable_phrase_item for the changes in place.
+     *
+     */
+    int get_phrase_item(phrase_token_t token, PhraseItem & item);
+
+    /**
+     * SubPhraseIndex::get_writable_phrase_item:
+     * @token: the phrase token.
+     * @item: the phrase item of the token.
+     * @returns: the status of the get operation.
+     *
+     * Get the phrase item to be changed in place, the phrase item of
+     * the loaded content is copied into the overlay first.
+     *
+     * Note: the changes in place can't modify the phrase item size,
      * but can increment the freq of the special pronunciation,
      * or change the content without size increasing.
      *
      */
-    int get_phrase_item(phrase_token_t token, PhraseItem & item);
+    int get_writable_phrase_item(phrase_token_t token, PhraseItem & item);
+
+    /**
+     * SubPhraseIndex::get_phrase_item_view:
+     * @token: the phrase token.
+     * @view: the read-only view of the phrase item of the token.
+     * @returns: the status of the get operation.
+     *
+     * Get the read-only view of the phrase item from this sub phrase index.
+     *
+     */
+    int get_phrase_item_view(phrase_token_t token, PhraseItemView & view);
 
     /**
      * SubPhraseIndex::add_phrase_item:
@@ -427,8 +727,33 @@ public:
      *
      */
     bool mask_out(phrase_token_t mask, phrase_token_t value);
+
+    /**
+     * SubPhraseIndex::has_overlay:
+     * @returns: whether the changes are kept in the overlay.
+     *
+     * The sub phrase index loaded from the memory chunk keeps the loaded
+     * content read-only, and keeps the changed phrase items in the overlay.
+     *
+     */
+    bool has_overlay() const{
+        return NULL != m_chunk;
+    }
 };
 
+/* the phrase library to be loaded on demand. */
+typedef struct {
+    gchar * m_filename;
+    gchar * m_log_filename;
+    /* the total frequency after the log is merged. */
+    guint32 m_total_freq;
+} pending_phrase_library_t;
+
+/* load the memory chunk of the pending sub phrase index,
+   returns NULL when the file can't be loaded. */
+typedef MemoryChunk * (* phrase_library_loader_t)
+    (guint8 phrase_index, const char * filename, gpointer user_data);
+
 /**
  * FacadePhraseIndex:
  *
@@ -439,6 +764,77 @@ class FacadePhraseIndex{
 private:
     guint32 m_total_freq;
     SubPhraseIndex * m_sub_phrase_indices[PHRASE_INDEX_LIBRARY_COUNT];
+
+    /* the sub phrase indices not loaded yet. */
+    pending_phrase_library_t m_pending_libraries[PHRASE_INDEX_LIBRARY_COUNT];
+    /* serialize the loads on demand from the readers. */
+    GMutex m_pending_mutex;
+    /* load the pending sub phrase indices, or NULL to load the files. */
+    phrase_library_loader_t m_loader;
+    gpointer m_loader_data;
+
+    /* the destroyed arrays of the ranges and the tokens,
+       re-used by prepare_ranges and prepare_tokens. */
+    GPtrArray * m_range_pool;
+    GPtrArray * m_token_pool;
+    GMutex m_pool_mutex;
+
+    /* record the changed phrase items. */
+    UserJournal * m_journal;
+    /* the sub phrase indices differ from the user files. */
+    bool m_dirty[PHRASE_INDEX_LIBRARY_COUNT];
+
+    /* take one array from the pool, must hold the pool mutex. */
+    static GArray * take_array(GPtrArray * pool, guint element_size) {
+        if (0 == pool->len)
+            return g_array_new(FALSE, FALSE, element_size);
+
+        GArray * array = (GArray *) g_ptr_array_index(pool, pool->len - 1);
+        g_ptr_array_set_size(pool, pool->len - 1);
+        return array;
+    }
+
+    /* give the array back to the pool, must hold the pool mutex. */
+    static void give_array(GPtrArray * pool, GArray * array) {
+        g_array_set_size(array, 0);
+        g_ptr_array_add(pool, array);
+    }
+
+    static void free_pool(GPtrArray * pool) {
+        for (size_t i = 0; i < pool->len; ++i)
+            g_array_free((GArray *) g_ptr_array_index(pool, i), TRUE);
+        g_ptr_array_free(pool, TRUE);
+    }
+
+    bool is_pending(guint8 phrase_index) const {
+        return NULL != g_atomic_pointer_get
+            (&m_pending_libraries[phrase_index].m_filename);
+    }
+
+    /* the sub phrase index is published before the pending library
+       is cleared, so check the pending library first. */
+    bool has_sub_phrase(guint8 phrase_index) const {
+        return is_pending(phrase_index) ||
+            NULL != g_atomic_pointer_get(&m_sub_phrase_indices[phrase_index]);
+    }
+
+    void drop_pending(guint8 phrase_index);
+
+    /* get the sub phrase index, and load it on demand. */
+    SubPhraseIndex * get_sub_phrase(guint8 phrase_index) {
+        SubPhraseIndex * sub_phrase = (SubPhraseIndex *)
+            g_atomic_pointer_get(&m_sub_phrase_indices[phrase_index]);
+        if (NULL == sub_phrase) {
+            if (is_pending(phrase_index))
+                load_pending(phrase_index);
+
+            /* loaded here or by another reader. */
+            sub_phrase = (SubPhraseIndex *) g_atomic_pointer_get
+                (&m_sub_phrase_indices[phrase_index]);
+        }
+        return sub_phrase;
+    }
+
 public:
     /**
      * FacadePhraseIndex::FacadePhraseIndex:
@@ -449,6 +845,17 @@ public:
     FacadePhraseIndex(){
         m_total_freq = 0;
         memset(m_sub_phrase_indices, 0, sizeof(m_sub_phrase_indices));
+        memset(m_pending_libraries, 0, sizeof(m_pending_libraries));
+        g_mutex_init(&m_pending_mutex);
+        m_loader = NULL;
+        m_loader_data = NULL;
+
+        m_range_pool = g_ptr_array_new();
+        m_token_pool = g_ptr_array_new();
+        g_mutex_init(&m_pool_mutex);
+
+        m_journal = NULL;
+        memset(m_dirty, 0, sizeof(m_dirty));
     }
 
     /**
@@ -463,7 +870,15 @@ public:
                 delete m_sub_phrase_indices[i];
                 m_sub_phrase_indices[i] = NULL;
             }
+            drop_pending(i);
         }
+        g_mutex_clear(&m_pending_mutex);
+
+        free_pool(m_range_pool);
+        m_range_pool = NULL;
+        free_pool(m_token_pool);
+        m_token_pool = NULL;
+        g_mutex_clear(&m_pool_mutex);
     }
 
     /**
@@ -491,6 +906,45 @@ public:
      */
     bool load(guint8 phrase_index, MemoryChunk * chunk);
 
+    /**
+     * FacadePhraseIndex::load_on_demand:
+     * @phrase_index: the index of sub phrase index to be loaded.
+     * @filename: the file name of sub phrase index.
+     * @log_filename: the file name of the log to be merged, or NULL.
+     * @returns: whether the load operation is successful.
+     *
+     * Defer loading one sub phrase index until its phrase items are
+     * used, only the total frequency is read from the file headers.
+     *
+     */
+    bool load_on_demand(guint8 phrase_index, const char * filename,
+                        const char * log_filename);
+
+    /**
+     * FacadePhraseIndex::load_pending:
+     * @phrase_index: the index of sub phrase index to be loaded.
+     * @returns: whether the sub phrase index is loaded in this call.
+     *
+     * Load the sub phrase index deferred by load_on_demand now,
+     * can be called from the readers or the prefetch thread.
+     *
+     */
+    bool load_pending(guint8 phrase_index);
+
+    /**
+     * FacadePhraseIndex::set_loader:
+     * @loader: the loader of the pending sub phrase indices, or NULL.
+     * @user_data: the user data passed to the loader.
+     *
+     * Load the memory chunks of the pending sub phrase indices with
+     * the loader, which may share the read-only chunks with others.
+     *
+     */
+    void set_loader(phrase_library_loader_t loader, gpointer user_data) {
+        m_loader = loader;
+        m_loader_data = user_data;
+    }
+
     /**
      * FacadePhraseIndex::store:
      * @phrase_index: the index of sub phrase index to be stored.
@@ -613,7 +1067,8 @@ public:
      *
      */
     guint32 get_phrase_index_total_freq(){
-        return m_total_freq;
+        /* changed by the loads on demand from the readers. */
+        return (guint32) g_atomic_int_get((gint *) &m_total_freq);
     }
 
     /**
@@ -627,10 +1082,13 @@ public:
      */
     int add_unigram_frequency(phrase_token_t token, guint32 delta){
         guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
-        SubPhraseIndex * sub_phrase = m_sub_phrase_indices[index];
+        SubPhraseIndex * sub_phrase = get_sub_phrase(index);
         if ( !sub_phrase )
             return ERROR_NO_SUB_PHRASE_INDEX;
         m_total_freq += delta;
+        m_dirty[index] = true;
+        if (m_journal)
+            m_journal->touch_phrase_item(token);
         return sub_phrase->add_unigram_frequency(token, delta);
     }
 
@@ -645,12 +1103,53 @@ public:
      */
     int get_phrase_item(phrase_token_t token, PhraseItem & item){
         guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
-        SubPhraseIndex * sub_phrase = m_sub_phrase_indices[index];
+        SubPhraseIndex * sub_phrase = get_sub_phrase(index);
         if ( !sub_phrase )
             return ERROR_NO_SUB_PHRASE_INDEX;
         return sub_phrase->get_phrase_item(token, item);
     }
 
+    /**
+     * FacadePhraseIndex::get_writable_phrase_item:
+     * @token: the phrase token.
+     * @item: the phrase item of the token.
+     * @returns: the status of the get operation.
+     *
+     * Get the phrase item to be changed in place from the facade
+     * phrase index, the loaded content is never changed.
+     *
+     */
+    int get_writable_phrase_item(phrase_token_t token, PhraseItem & item){
+        guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
+        SubPhraseIndex * sub_phrase = get_sub_phrase(index);
+        if ( !sub_phrase )
+            return ERROR_NO_SUB_PHRASE_INDEX;
+        int result = sub_phrase->get_writable_phrase_item(token, item);
+        if ( result )
+            return result;
+        m_dirty[index] = true;
+        if (m_journal)
+            m_journal->touch_phrase_item(token);
+        return result;
+    }
+
+    /**
+     * FacadePhraseIndex::get_phrase_item_view:
+     * @token: the phrase token.
+     * @view: the read-only view of the phrase item of the token.
+     * @returns: the status of the get operation.
+     *
+     * Get the read-only view of the phrase item from the facade phrase index.
+     *
+     */
+    int get_phrase_item_view(phrase_token_t token, PhraseItemView & view){
+        guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
+        SubPhraseIndex * sub_phrase = get_sub_phrase(index);
+        if ( !sub_phrase )
+            return ERROR_NO_SUB_PHRASE_INDEX;
+        return sub_phrase->get_phrase_item_view(token, view);
+    }
+
     /**
      * FacadePhraseIndex::add_phrase_item:
      * @token: the phrase token.
@@ -662,11 +1161,15 @@ public:
      */
     int add_phrase_item(phrase_token_t token, PhraseItem * item){
         guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
+        get_sub_phrase(index);
         SubPhraseIndex * & sub_phrase = m_sub_phrase_indices[index];
         if ( !sub_phrase ){
             sub_phrase = new SubPhraseIndex;
         }   
         m_total_freq += item->get_unigram_frequency();
+        m_dirty[index] = true;
+        if (m_journal)
+            m_journal->touch_phrase_item(token);
         return sub_phrase->add_phrase_item(token, item);
     }
 
@@ -681,7 +1184,7 @@ public:
      */
     int remove_phrase_item(phrase_token_t token, PhraseItem * & item){
         guint8 index = PHRASE_INDEX_LIBRARY_INDEX(token);
-        SubPhraseIndex * & sub_phrase = m_sub_phrase_indices[index];
+        SubPhraseIndex * sub_phrase = get_sub_phrase(index);
         if ( !sub_phrase ){
             return ERROR_NO_SUB_PHRASE_INDEX;
         }
@@ -689,26 +1192,78 @@ public:
         if ( result )
             return result;
         m_total_freq -= item->get_unigram_frequency();
+        m_dirty[index] = true;
+        if (m_journal)
+            m_journal->touch_phrase_item(token);
         return result;
     }
 
+    /**
+     * FacadePhraseIndex::set_journal:
+     * @journal: the journal to record the changes, or NULL.
+     *
+     * Record the changed phrase items in the journal.
+     *
+     * Note: the pronunciation frequencies changed in place are recorded
+     * by get_writable_phrase_item.
+     *
+     */
+    void set_journal(UserJournal * journal) {
+        m_journal = journal;
+    }
+
+    /**
+     * FacadePhraseIndex::is_dirty:
+     * @phrase_index: the index of sub phrase index.
+     * @returns: whether the sub phrase index is changed since it is
+     * loaded or stored.
+     *
+     */
+    bool is_dirty(guint8 phrase_index) const {
+        return m_dirty[phrase_index];
+    }
+
+    /**
+     * FacadePhraseIndex::is_loaded:
+     * @phrase_index: the index of sub phrase index.
+     * @returns: whether the sub phrase index is loaded,
+     * the pending sub phrase index is not loaded.
+     *
+     */
+    bool is_loaded(guint8 phrase_index) const {
+        return NULL != g_atomic_pointer_get(&m_sub_phrase_indices[phrase_index]);
+    }
+
+    /**
+     * FacadePhraseIndex::clear_dirty:
+     * @phrase_index: the index of sub phrase index.
+     *
+     * The sub phrase index is stored into the user file.
+     *
+     */
+    void clear_dirty(guint8 phrase_index) {
+        m_dirty[phrase_index] = false;
+    }
+
     /**
      * FacadePhraseIndex::prepare_ranges:
      * @ranges: the ranges to be prepared.
      * @returns: whether the prepare operation is successful.
      *
-     * Prepare the ranges.
+     * Prepare the ranges, the arrays are taken from the pool.
      *
      */
     bool prepare_ranges(PhraseIndexRanges ranges) {
+        MutexLocker locker(&m_pool_mutex);
+
         /* assume memset(ranges, 0, sizeof(ranges)); */
         for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
             GArray * & range = ranges[i];
             assert(NULL == range);
 
-            SubPhraseIndex * sub_phrase = m_sub_phrase_indices[i];
-            if (sub_phrase) {
-                range = g_array_new(FALSE, FALSE, sizeof(PhraseIndexRange));
+            /* the pending sub phrase index is loaded when resolved. */
+            if (has_sub_phrase(i)) {
+                range = take_array(m_range_pool, sizeof(PhraseIndexRange));
             }
         }
         return true;
@@ -737,14 +1292,16 @@ public:
      * @ranges: the ranges to be destroyed.
      * @returns: whether the destroy operation is successful.
      *
-     * Destroy the ranges.
+     * Destroy the ranges, the arrays are given back to the pool.
      *
      */
     bool destroy_ranges(PhraseIndexRanges ranges) {
+        MutexLocker locker(&m_pool_mutex);
+
         for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
             GArray * & range = ranges[i];
             if (range) {
-                g_array_free(range, TRUE);
+                give_array(m_range_pool, range);
                 range = NULL;
             }
         }
@@ -756,18 +1313,19 @@ public:
      * @tokens: the tokens to be prepared.
      * @returns: whether the prepare operation is successful.
      *
-     * Prepare the tokens.
+     * Prepare the tokens, the arrays are taken from the pool.
      *
      */
     bool prepare_tokens(PhraseTokens tokens) {
+        MutexLocker locker(&m_pool_mutex);
+
         /* assume memset(tokens, 0, sizeof(tokens)); */
         for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
             GArray * & token = tokens[i];
             assert(NULL == token);
 
-            SubPhraseIndex * sub_phrase = m_sub_phrase_indices[i];
-            if (sub_phrase) {
-                token = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+            if (has_sub_phrase(i)) {
+                token = take_array(m_token_pool, sizeof(phrase_token_t));
             }
         }
         return true;
@@ -796,14 +1354,16 @@ public:
      * @tokens: the tokens to be destroyed.
      * @returns: whether the destroy operation is successful.
      *
-     * Destroy the tokens.
+     * Destroy the tokens, the arrays are given back to the pool.
      *
      */
     bool destroy_tokens(PhraseTokens tokens) {
+        MutexLocker locker(&m_pool_mutex);
+
         for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
             GArray * & token = tokens[i];
             if (token) {
-                g_array_free(token, TRUE);
+                give_array(m_token_pool, token);
                 token = NULL;
             }
         }
@@ -820,7 +1380,7 @@ public:
      */
     int create_sub_phrase(guint8 index) {
         SubPhraseIndex * & sub_phrase = m_sub_phrase_indices[index];
-        if (sub_phrase) {
+        if (sub_phrase || is_pending(index)) {
             return ERROR_ALREADY_EXISTS;
         }
 
@@ -830,6 +1390,70 @@ public:
     }
 };
 
+/**
+ * ScopedPhraseIndexRanges:
+ *
+ * Prepare the ranges from the phrase index, and destroy them
+ * at the end of the scope.
+ *
+ */
+class ScopedPhraseIndexRanges{
+private:
+    FacadePhraseIndex * m_phrase_index;
+    PhraseIndexRanges m_ranges;
+
+    /* Disallow copy. */
+    ScopedPhraseIndexRanges(const ScopedPhraseIndexRanges &);
+    ScopedPhraseIndexRanges & operator=(const ScopedPhraseIndexRanges &);
+
+public:
+    ScopedPhraseIndexRanges(FacadePhraseIndex * phrase_index) :
+        m_phrase_index(phrase_index) {
+        memset(m_ranges, 0, sizeof(m_ranges));
+        m_phrase_index->prepare_ranges(m_ranges);
+    }
+
+    ~ScopedPhraseIndexRanges() {
+        m_phrase_index->destroy_ranges(m_ranges);
+    }
+
+    operator GArray ** () {
+        return m_ranges;
+    }
+};
+
+/**
+ * ScopedPhraseTokens:
+ *
+ * Prepare the tokens from the phrase index, and destroy them
+ * at the end of the scope.
+ *
+ */
+class ScopedPhraseTokens{
+private:
+    FacadePhraseIndex * m_phrase_index;
+    PhraseTokens m_tokens;
+
+    /* Disallow copy. */
+    ScopedPhraseTokens(const ScopedPhraseTokens &);
+    ScopedPhraseTokens & operator=(const ScopedPhraseTokens &);
+
+public:
+    ScopedPhraseTokens(FacadePhraseIndex * phrase_index) :
+        m_phrase_index(phrase_index) {
+        memset(m_tokens, 0, sizeof(m_tokens));
+        m_phrase_index->prepare_tokens(m_tokens);
+    }
+
+    ~ScopedPhraseTokens() {
+        m_phrase_index->destroy_tokens(m_tokens);
+    }
+
+    operator GArray ** () {
+        return m_tokens;
+    }
+};
+
 PhraseIndexLogger * mask_out_phrase_index_logger
 (PhraseIndexLogger * oldlogger, phrase_token_t mask, phrase_token_t value);
 
@@ -36,6 +36,14 @@
  *  Remove Record: remove/token/len/data chunk
  *  Modify Record: modify/token/old len/new len/old data chunk/new data chunk
  *
+ *  Compact Format: magic/records
+ *
+ *  The compact logs start with the magic, the record type is one byte,
+ *  the token is stored as the varint of the zigzag encoded delta from
+ *  the token of the previous record, and the lengths are varints.
+ *  The new logs are written in the compact format,
+ *  the logs without the magic are still readable.
+ *
  */
 
 namespace pinyin{
@@ -48,6 +56,9 @@ enum LOG_TYPE{
     LOG_MODIFY_HEADER
 };
 
+/* the old format starts with the log type, which never matches. */
+static const char c_compact_log_magic[4] = {'P', 'I', 'L', 'C'};
+
 
 /**
  * PhraseIndexLogger:
@@ -61,6 +72,15 @@ protected:
     size_t m_offset;
     bool m_error;
 
+    /* whether the logs are in the compact format. */
+    bool m_compact;
+    /* the offset of the first record, after the magic. */
+    size_t m_begin;
+    /* the tokens of the previous records for the deltas. */
+    phrase_token_t m_read_token;
+    phrase_token_t m_written_token;
+    bool m_written_token_valid;
+
     void reset(){
         if ( m_chunk ){
             delete m_chunk;
@@ -68,7 +88,116 @@ protected:
         }
         m_offset = 0;
         m_error = false;
+        m_compact = true;
+        m_begin = 0;
+        m_read_token = null_token;
+        m_written_token = null_token;
+        m_written_token_valid = true;
+    }
+
+    static void append_varint(MemoryChunk * chunk, guint32 value){
+        guint8 buf[5];
+        size_t len = 0;
+        while (value >= 0x80) {
+            buf[len++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        buf[len++] = value;
+        chunk->set_content(chunk->size(), buf, len);
+    }
+
+    bool read_varint(size_t & offset, guint32 & value) const {
+        const guint8 * data = (const guint8 *) m_chunk->begin();
+        const size_t size = m_chunk->size();
+
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (offset >= size)
+                return false;
+            guint8 byte = data[offset++];
+            value |= (guint32)(byte & 0x7F) << shift;
+            if (0 == (byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool read_content(size_t & offset, guint32 len,
+                      MemoryChunk * content) const {
+        if (offset + len > m_chunk->size())
+            return false;
+        content->set_content(0, ((char *)m_chunk->begin()) + offset, len);
+        offset += len;
+        return true;
+    }
+
+    /* read one record in the compact format from the offset. */
+    bool read_compact_record(size_t & offset, phrase_token_t & last_token,
+                             LOG_TYPE & log_type, phrase_token_t & token,
+                             MemoryChunk * oldone, MemoryChunk * newone) const {
+        guint8 type = LOG_INVALID_RECORD;
+        if (!m_chunk->get_content(offset, &type, sizeof(guint8)))
+            return false;
+        offset += sizeof(guint8);
+        log_type = (LOG_TYPE) type;
+
+        guint32 delta = 0;
+        if (!read_varint(offset, delta))
+            return false;
+        /* zigzag decode. */
+        token = last_token + (gint32)((delta >> 1) ^ -(gint32)(delta & 1));
+
+        guint32 oldlen = 0, newlen = 0;
+        switch(log_type){
+        case LOG_ADD_RECORD:
+            if (!read_varint(offset, newlen))
+                return false;
+            if (!read_content(offset, newlen, newone))
+                return false;
+            break;
+        case LOG_REMOVE_RECORD:
+            if (!read_varint(offset, oldlen))
+                return false;
+            if (!read_content(offset, oldlen, oldone))
+                return false;
+            break;
+        case LOG_MODIFY_RECORD:
+            if (!read_varint(offset, oldlen) || !read_varint(offset, newlen))
+                return false;
+            if (!read_content(offset, oldlen, oldone) ||
+                !read_content(offset, newlen, newone))
+                return false;
+            break;
+        case LOG_MODIFY_HEADER:
+            if (null_token != token)
+                return false;
+            if (!read_varint(offset, oldlen))
+                return false;
+            if (!read_content(offset, oldlen, oldone) ||
+                !read_content(offset, oldlen, newone))
+                return false;
+            break;
+        default:
+            return false;
+        }
+
+        last_token = token;
+        return true;
     }
+
+    /* find the token of the last record for the deltas of the appends. */
+    void seek_written_token(){
+        LOG_TYPE log_type; phrase_token_t token;
+        MemoryChunk oldone, newone;
+
+        size_t offset = m_begin;
+        m_written_token = null_token;
+        while (offset < m_chunk->size() &&
+               read_compact_record(offset, m_written_token,
+                                   log_type, token, &oldone, &newone));
+        m_written_token_valid = true;
+    }
+
 public:
     /**
      * PhraseIndexLogger::PhraseIndexLogger:
@@ -76,7 +205,8 @@ public:
      * The constructor of the PhraseIndexLogger.
      *
      */
-    PhraseIndexLogger():m_offset(0), m_error(false){
+    PhraseIndexLogger():m_chunk(NULL){
+        reset();
         m_chunk = new MemoryChunk;
     }
 
@@ -101,6 +231,19 @@ public:
     bool load(MemoryChunk * chunk) {
         reset();
         m_chunk = chunk;
+
+        /* the empty logs are appended in the compact format. */
+        if (0 == chunk->size())
+            return true;
+
+        m_compact = chunk->size() >= sizeof(c_compact_log_magic) &&
+            0 == memcmp(chunk->begin(), c_compact_log_magic,
+                        sizeof(c_compact_log_magic));
+        if (m_compact) {
+            m_begin = sizeof(c_compact_log_magic);
+            m_written_token_valid = false;
+        }
+        m_offset = m_begin;
         return true;
     }
 
@@ -139,7 +282,8 @@ public:
      *
      */
     bool rewind(){
-        m_offset = 0;
+        m_offset = m_begin;
+        m_read_token = null_token;
         return true;
     }
 
@@ -160,6 +304,19 @@ public:
         log_type = LOG_INVALID_RECORD;
         token = null_token;
 
+        if (m_compact) {
+            oldone->set_size(0); newone->set_size(0);
+
+            size_t offset = m_offset;
+            if (!read_compact_record(offset, m_read_token,
+                                     log_type, token, oldone, newone)) {
+                m_error = true;
+                return false;
+            }
+            m_offset = offset;
+            return true;
+        }
+
         size_t offset = m_offset;
         m_chunk->get_content(offset, &log_type, sizeof(LOG_TYPE));
         offset += sizeof(LOG_TYPE);
@@ -233,6 +390,9 @@ public:
     bool append_record(LOG_TYPE log_type, phrase_token_t token,
                        MemoryChunk * oldone, MemoryChunk * newone){
 
+        if (m_compact)
+            return append_compact_record(log_type, token, oldone, newone);
+
         MemoryChunk chunk;
         size_t offset = 0;
         chunk.set_content(offset, &log_type, sizeof(LOG_TYPE));
@@ -301,6 +461,69 @@ public:
         m_chunk->set_content(m_chunk->size(), chunk.begin(), chunk.size());
         return true;
     }
+
+private:
+    bool append_compact_record(LOG_TYPE log_type, phrase_token_t token,
+                               MemoryChunk * oldone, MemoryChunk * newone){
+        if (0 == m_chunk->size()) {
+            m_chunk->set_content(0, c_compact_log_magic,
+                                 sizeof(c_compact_log_magic));
+            m_begin = m_offset = sizeof(c_compact_log_magic);
+        }
+
+        if (!m_written_token_valid)
+            seek_written_token();
+
+        MemoryChunk chunk;
+        guint8 type = log_type;
+        chunk.set_content(0, &type, sizeof(guint8));
+        /* zigzag encode. */
+        gint32 delta = (gint32)(token - m_written_token);
+        append_varint(&chunk, ((guint32)delta << 1) ^ (guint32)(delta >> 31));
+
+        switch(log_type){
+        case LOG_ADD_RECORD:{
+            assert( NULL == oldone );
+            assert( NULL != newone );
+            append_varint(&chunk, newone->size());
+            chunk.set_content(chunk.size(), newone->begin(), newone->size());
+            break;
+        }
+        case LOG_REMOVE_RECORD:{
+            assert(NULL != oldone);
+            assert(NULL == newone);
+            append_varint(&chunk, oldone->size());
+            chunk.set_content(chunk.size(), oldone->begin(), oldone->size());
+            break;
+        }
+        case LOG_MODIFY_RECORD:{
+            assert(NULL != oldone);
+            assert(NULL != newone);
+            append_varint(&chunk, oldone->size());
+            append_varint(&chunk, newone->size());
+            chunk.set_content(chunk.size(), oldone->begin(), oldone->size());
+            chunk.set_content(chunk.size(), newone->begin(), newone->size());
+            break;
+        }
+        case LOG_MODIFY_HEADER:{
+            assert(NULL != oldone);
+            assert(NULL != newone);
+            assert(null_token == token);
+            assert(oldone->size() == newone->size());
+            append_varint(&chunk, oldone->size());
+            chunk.set_content(chunk.size(), oldone->begin(), oldone->size());
+            chunk.set_content(chunk.size(), newone->begin(), newone->size());
+            break;
+        }
+        default:
+            abort();
+        }
+
+        /* store log record. */
+        m_chunk->set_content(m_chunk->size(), chunk.begin(), chunk.size());
+        m_written_token = token;
+        return true;
+    }
 };
 
 };
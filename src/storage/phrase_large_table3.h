@@ -49,6 +49,7 @@ class MaskOutProcessor;
 
 class PhraseTableEntry{
     friend class PhraseLargeTable3;
+    friend class PhraseHashTable3;
     friend class MaskOutVisitor;
     friend class MaskOutProcessor;
 protected:
@@ -19,6 +19,7 @@
  */
 
 #include "phrase_large_table3.h"
+#include "pinyin_locker.h"
 #include <errno.h>
 #include "bdb_utils.h"
 
@@ -63,6 +64,8 @@ static bool bdb_phrase_continue_search(const DBT *dbt1,
 }
 
 PhraseLargeTable3::PhraseLargeTable3() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = NULL;
     int ret = db_create(&m_db, NULL, 0);
@@ -148,6 +151,7 @@ bool PhraseLargeTable3::load_db(const char * filename) {
 }
 
 bool PhraseLargeTable3::save_db(const char * new_filename) {
+    MutexLocker locker(&m_mutex);
     DB * tmp_db = NULL;
 
     int ret = unlink(new_filename);
@@ -180,6 +184,7 @@ bool PhraseLargeTable3::save_db(const char * new_filename) {
 int PhraseLargeTable3::search(int phrase_length,
                               /* in */ const ucs4_t phrase[],
                               /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     int result = SEARCH_NONE;
 
     if (NULL == m_db)
@@ -210,6 +215,7 @@ int PhraseLargeTable3::search(int phrase_length,
 int PhraseLargeTable3::search_suggestion(int phrase_length,
                                          /* in */ const ucs4_t phrase[],
                                          /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     int result = SEARCH_NONE;
 
     if (NULL == m_db)
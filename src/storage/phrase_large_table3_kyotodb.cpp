@@ -19,6 +19,7 @@
  */
 
 #include "phrase_large_table3.h"
+#include "pinyin_locker.h"
 #include <kchashdb.h>
 #include <kccachedb.h>
 #include "kyotodb_utils.h"
@@ -66,6 +67,8 @@ bool kyotodb_phrase_continue_search(const char* akbuf, size_t aksiz,
 }
 
 PhraseLargeTable3::PhraseLargeTable3() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = new ProtoTreeDB;
     check_result(m_db->open("-", BasicDB::OREADER|BasicDB::OWRITER|BasicDB::OCREATE));
@@ -137,6 +140,7 @@ bool PhraseLargeTable3::load_db(const char * filename) {
 }
 
 bool PhraseLargeTable3::save_db(const char * new_filename){
+    MutexLocker locker(&m_mutex);
     int ret = unlink(new_filename);
     if ( ret != 0 && errno != ENOENT)
         return false;
@@ -164,6 +168,7 @@ bool PhraseLargeTable3::save_db(const char * new_filename){
 int PhraseLargeTable3::search(int phrase_length,
                               /* in */ const ucs4_t phrase[],
                               /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     int result = SEARCH_NONE;
 
     if (NULL == m_db)
@@ -195,6 +200,7 @@ int PhraseLargeTable3::search(int phrase_length,
 int PhraseLargeTable3::search_suggestion(int phrase_length,
                                          /* in */ const ucs4_t phrase[],
                                          /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     int result = SEARCH_NONE;
 
     if (NULL == m_db)
@@ -37,6 +37,9 @@ private:
 protected:
     PhraseTableEntry * m_entry;
 
+    /* serialize the searches from the threads sharing this table. */
+    mutable GMutex m_mutex;
+
     void reset();
 
 public:
@@ -44,6 +47,7 @@ public:
 
     ~PhraseLargeTable3(){
         reset();
+        g_mutex_clear(&m_mutex);
     }
 
     /* attach method */
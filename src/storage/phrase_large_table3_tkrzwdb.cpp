@@ -19,6 +19,7 @@
  */
 
 #include "phrase_large_table3.h"
+#include "pinyin_locker.h"
 #include <tkrzw_dbm_baby.h>
 #include <tkrzw_dbm_tree.h>
 #include <tkrzw_str_util.h>
@@ -43,6 +44,8 @@ bool tkrzw_phrase_continue_search(const std::string_view& query_key,
 }
 
 PhraseLargeTable3::PhraseLargeTable3() {
+    g_mutex_init(&m_mutex);
+
     m_db = new BabyDBM;
     m_entry = new PhraseTableEntry;
 }
@@ -100,6 +103,7 @@ bool PhraseLargeTable3::load_db(const char * filename) {
 }
 
 bool PhraseLargeTable3::save_db(const char * new_filename){
+    MutexLocker locker(&m_mutex);
     if (!m_db)
         return false;
 
@@ -124,6 +128,7 @@ bool PhraseLargeTable3::save_db(const char * new_filename){
 int PhraseLargeTable3::search(int phrase_length,
                               /* in */ const ucs4_t phrase[],
                               /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     int result = SEARCH_NONE;
 
     if (NULL == m_db)
@@ -155,6 +160,7 @@ int PhraseLargeTable3::search(int phrase_length,
 int PhraseLargeTable3::search_suggestion(int phrase_length,
                                          /* in */ const ucs4_t phrase[],
                                          /* out */ PhraseTokens tokens) const {
+    MutexLocker locker(&m_mutex);
     int result = SEARCH_NONE;
 
     if (NULL == m_db)
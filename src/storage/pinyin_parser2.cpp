@@ -31,6 +31,7 @@
 #include "pinyin_parser_table.h"
 #include "double_pinyin_table.h"
 #include "phonetic_key_matrix.h"
+#include "pinyin_locker.h"
 
 
 namespace pinyin{
@@ -157,6 +158,7 @@ static inline bool search_pinyin_index2(pinyin_option_t options,
 FullPinyinParser2::FullPinyinParser2 (){
     m_pinyin_index = NULL; m_pinyin_index_len = 0;
     m_parse_steps = g_array_new(TRUE, FALSE, sizeof(parse_value_t));
+    g_mutex_init(&m_mutex);
 
     set_scheme(FULL_PINYIN_DEFAULT);
 }
@@ -217,6 +219,8 @@ bool FullPinyinParser2::parse_one_key (pinyin_option_t options,
 int FullPinyinParser2::parse (pinyin_option_t options, ChewingKeyVector & keys,
                               ChewingKeyRestVector & key_rests,
                               const char *str, int len) const {
+    MutexLocker locker(&m_mutex);
+
     int i;
     /* clear arrays. */
     g_array_set_size(keys, 0);
@@ -147,6 +147,8 @@ class FullPinyinParser2 : public PhoneticParser2
 
 protected:
     ParseValueVector m_parse_steps;
+    /* serialize the parses from the threads sharing this parser. */
+    mutable GMutex m_mutex;
 
     int final_step(size_t step_len, ChewingKeyVector & keys,
                    ChewingKeyRestVector & key_rests) const;
@@ -155,6 +157,7 @@ public:
     FullPinyinParser2();
     virtual ~FullPinyinParser2() {
         g_array_free(m_parse_steps, TRUE);
+        g_mutex_clear(&m_mutex);
     }
 
     virtual bool parse_one_key(pinyin_option_t options, ChewingKey & key, gint16 & distance, const char *str, int len) const;
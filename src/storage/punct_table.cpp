@@ -20,6 +20,7 @@
 
 
 #include "punct_table.h"
+#include "pinyin_locker.h"
 
 using namespace pinyin;
 
@@ -146,6 +147,7 @@ bool PunctTableEntry::remove_punctuation(const gchar * punct) {
 
 bool PunctTable::get_all_punctuations(/* in */ phrase_token_t index,
                                       /* out */ gchar ** & puncts) {
+    MutexLocker locker(&m_mutex);
     assert(NULL == puncts);
 
     if (!load_entry(index))
@@ -20,12 +20,15 @@
 
 
 #include "punct_table.h"
+#include "pinyin_locker.h"
 #include <errno.h>
 #include "bdb_utils.h"
 
 using namespace pinyin;
 
 PunctTable::PunctTable() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = NULL;
     int ret = db_create(&m_db, NULL, 0);
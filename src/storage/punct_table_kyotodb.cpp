@@ -19,6 +19,7 @@
  */
 
 #include "punct_table.h"
+#include "pinyin_locker.h"
 #include <kchashdb.h>
 #include <kccachedb.h>
 #include "kyotodb_utils.h"
@@ -27,6 +28,8 @@ using namespace kyotocabinet;
 using namespace pinyin;
 
 PunctTable::PunctTable() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = new ProtoTreeDB;
     check_result(m_db->open("-", BasicDB::OREADER|BasicDB::OWRITER|BasicDB::OCREATE));
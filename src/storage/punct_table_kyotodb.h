@@ -35,6 +35,9 @@ private:
 protected:
     PunctTableEntry * m_entry;
 
+    /* serialize the reads from the threads sharing this table. */
+    mutable GMutex m_mutex;
+
     void reset();
 
 public:
@@ -42,6 +45,7 @@ public:
 
     ~PunctTable(){
         reset();
+        g_mutex_clear(&m_mutex);
     }
 
 protected:
@@ -19,6 +19,7 @@
  */
 
 #include "punct_table.h"
+#include "pinyin_locker.h"
 #include <tkrzw_dbm.h>
 #include <tkrzw_dbm_tree.h>
 #include <tkrzw_file_util.h>
@@ -34,6 +35,8 @@ using namespace tkrzw;
 using namespace pinyin;
 
 PunctTable::PunctTable() {
+    g_mutex_init(&m_mutex);
+
     /* create in-memory db. */
     m_db = new BabyDBM;
 
@@ -37,6 +37,9 @@ private:
 protected:
     PunctTableEntry * m_entry;
 
+    /* serialize the reads from the threads sharing this table. */
+    mutable GMutex m_mutex;
+
     void reset();
 
 public:
@@ -44,6 +47,7 @@ public:
 
     ~PunctTable(){
         reset();
+        g_mutex_clear(&m_mutex);
     }
 
 protected:
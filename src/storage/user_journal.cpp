@@ -0,0 +1,444 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "user_journal.h"
+#include <errno.h>
+#include "pinyin_phrase3.h"
+#include "chewing_large_table2.h"
+#include "phrase_large_table3.h"
+#include "facade_chewing_table2.h"
+#include "facade_phrase_table3.h"
+#include "phrase_index.h"
+#include "ngram.h"
+
+namespace pinyin{
+
+/* the batch header, the same as the header of MemoryChunk::save. */
+static const size_t batch_header = sizeof(guint32) * 2;
+
+UserJournal::UserJournal() {
+    m_filename = NULL;
+    m_size = 0;
+    m_phrase_tokens = g_hash_table_new(g_direct_hash, g_direct_equal);
+    m_gram_tokens = g_hash_table_new(g_direct_hash, g_direct_equal);
+    m_need_compact = false;
+    m_replaying = false;
+}
+
+UserJournal::~UserJournal() {
+    g_free(m_filename);
+    m_filename = NULL;
+    g_hash_table_destroy(m_phrase_tokens);
+    m_phrase_tokens = NULL;
+    g_hash_table_destroy(m_gram_tokens);
+    m_gram_tokens = NULL;
+}
+
+void UserJournal::reset() {
+    g_hash_table_remove_all(m_phrase_tokens);
+    g_hash_table_remove_all(m_gram_tokens);
+    m_index_records.set_size(0);
+}
+
+void UserJournal::append_record(MemoryChunk * chunk, JOURNAL_TYPE type,
+                                phrase_token_t token,
+                                const void * data, guint32 len) {
+    guint32 record_type = type;
+    chunk->set_content(chunk->size(), &record_type, sizeof(guint32));
+    chunk->set_content(chunk->size(), &token, sizeof(phrase_token_t));
+    chunk->set_content(chunk->size(), &len, sizeof(guint32));
+    if (len)
+        chunk->set_content(chunk->size(), data, len);
+}
+
+bool UserJournal::load(const char * filename) {
+    g_free(m_filename);
+    m_filename = g_strdup(filename);
+    m_size = 0;
+    m_need_compact = false;
+    reset();
+
+    /* check the batches. */
+    MemoryChunk records;
+    size_t size = 0;
+    if (!read_records(&records, size))
+        return false;
+
+    /* drop the incomplete batch written before the crash. */
+    struct stat buf;
+    if (0 == stat(m_filename, &buf) && size < (size_t) buf.st_size) {
+        if (0 != ::truncate(m_filename, size))
+            return false;
+    }
+
+    m_size = size;
+    return true;
+}
+
+bool UserJournal::read_records(MemoryChunk * records, size_t & size) {
+    records->set_size(0);
+    size = 0;
+
+    int fd = open(m_filename, O_RDONLY);
+    if (-1 == fd)
+        return ENOENT == errno;
+
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+
+    MemoryChunk content;
+    content.set_size(file_size);
+    ssize_t ret_len = read(fd, content.begin(), file_size);
+    close(fd);
+
+    if (ret_len != file_size)
+        return false;
+
+    const char * data = (const char *) content.begin();
+    size_t offset = 0;
+    while (offset + batch_header <= (size_t) file_size) {
+        guint32 length = 0, checksum = 0;
+        memcpy(&length, data + offset, sizeof(guint32));
+        memcpy(&checksum, data + offset + sizeof(guint32), sizeof(guint32));
+
+        if (offset + batch_header + length > (size_t) file_size)
+            break;
+
+        MemoryChunk batch;
+        batch.set_chunk((char *) data + offset + batch_header, length, NULL);
+        if (checksum != batch.get_check_sum())
+            break;
+
+        records->set_content(records->size(), batch.begin(), batch.size());
+        offset += batch_header + length;
+    }
+
+    size = offset;
+    return true;
+}
+
+bool UserJournal::replay_records(MemoryChunk * records,
+                                 FacadeChewingTable2 * pinyin_table,
+                                 FacadePhraseTable3 * phrase_table,
+                                 FacadePhraseIndex * phrase_index,
+                                 Bigram * bigram,
+                                 guint8 library, bool use_mask,
+                                 phrase_token_t mask, phrase_token_t value) {
+    const char * data = (const char *) records->begin();
+    const size_t size = records->size();
+    const size_t record_header =
+        sizeof(guint32) + sizeof(phrase_token_t) + sizeof(guint32);
+
+    m_replaying = true;
+
+    PhraseItem item, newitem;
+    size_t offset = 0;
+    while (offset + record_header <= size) {
+        guint32 type = JOURNAL_INVALID_RECORD;
+        phrase_token_t token = null_token;
+        guint32 len = 0;
+        memcpy(&type, data + offset, sizeof(guint32));
+        offset += sizeof(guint32);
+        memcpy(&token, data + offset, sizeof(phrase_token_t));
+        offset += sizeof(phrase_token_t);
+        memcpy(&len, data + offset, sizeof(guint32));
+        offset += sizeof(guint32);
+
+        if (offset + len > size)
+            break;
+
+        const char * content = data + offset;
+        offset += len;
+
+        if (PHRASE_INDEX_LIBRARY_COUNT != library &&
+            PHRASE_INDEX_LIBRARY_INDEX(token) != library)
+            continue;
+
+        if (use_mask && (token & mask) == value)
+            continue;
+
+        switch(type) {
+        case JOURNAL_PHRASE_ITEM: {
+            if (NULL == phrase_index)
+                break;
+
+            newitem.m_chunk.set_chunk((char *) content, len, NULL);
+
+            int retval = phrase_index->get_phrase_item(token, item);
+            if (ERROR_NO_SUB_PHRASE_INDEX == retval)
+                break;
+
+            if (ERROR_OK == retval) {
+                if (item == newitem)
+                    break;
+
+                PhraseItem * removed_item = NULL;
+                phrase_index->remove_phrase_item(token, removed_item);
+                delete removed_item;
+            }
+
+            phrase_index->add_phrase_item(token, &newitem);
+            break;
+        }
+        case JOURNAL_REMOVE_PHRASE_ITEM: {
+            if (NULL == phrase_index)
+                break;
+
+            if (ERROR_OK != phrase_index->get_phrase_item(token, item))
+                break;
+
+            PhraseItem * removed_item = NULL;
+            phrase_index->remove_phrase_item(token, removed_item);
+            delete removed_item;
+            break;
+        }
+        case JOURNAL_SINGLE_GRAM: {
+            if (NULL == bigram)
+                break;
+
+            SingleGram gram((void *) content, len, true);
+            bigram->store(token, &gram);
+            break;
+        }
+        case JOURNAL_REMOVE_SINGLE_GRAM: {
+            if (NULL == bigram)
+                break;
+
+            bigram->remove(token);
+            break;
+        }
+        case JOURNAL_ADD_PINYIN_INDEX:
+        case JOURNAL_REMOVE_PINYIN_INDEX: {
+            if (NULL == pinyin_table)
+                break;
+
+            int phrase_length = len / sizeof(ChewingKey);
+            if (0 == phrase_length || phrase_length > MAX_PHRASE_LENGTH)
+                break;
+
+            ChewingKey keys[MAX_PHRASE_LENGTH];
+            memcpy(keys, content, phrase_length * sizeof(ChewingKey));
+
+            if (JOURNAL_ADD_PINYIN_INDEX == type)
+                pinyin_table->add_index(phrase_length, keys, token);
+            else
+                pinyin_table->remove_index(phrase_length, keys, token);
+            break;
+        }
+        case JOURNAL_ADD_PHRASE_INDEX:
+        case JOURNAL_REMOVE_PHRASE_INDEX: {
+            if (NULL == phrase_table)
+                break;
+
+            int phrase_length = len / sizeof(ucs4_t);
+            if (0 == phrase_length || phrase_length > MAX_PHRASE_LENGTH)
+                break;
+
+            ucs4_t phrase[MAX_PHRASE_LENGTH];
+            memcpy(phrase, content, phrase_length * sizeof(ucs4_t));
+
+            if (JOURNAL_ADD_PHRASE_INDEX == type)
+                phrase_table->add_index(phrase_length, phrase, token);
+            else
+                phrase_table->remove_index(phrase_length, phrase, token);
+            break;
+        }
+        default:
+            /* the unknown records are skipped. */
+            break;
+        }
+    }
+
+    m_replaying = false;
+    return offset == size;
+}
+
+bool UserJournal::replay(FacadeChewingTable2 * pinyin_table,
+                         FacadePhraseTable3 * phrase_table,
+                         FacadePhraseIndex * phrase_index,
+                         Bigram * bigram) {
+    MemoryChunk records;
+    size_t size = 0;
+    if (!read_records(&records, size))
+        return false;
+
+    return replay_records(&records, pinyin_table, phrase_table,
+                          phrase_index, bigram,
+                          PHRASE_INDEX_LIBRARY_COUNT, false,
+                          null_token, null_token);
+}
+
+bool UserJournal::replay_phrase_library(FacadePhraseIndex * phrase_index,
+                                        guint8 library) {
+    MemoryChunk records;
+    size_t size = 0;
+    if (!read_records(&records, size))
+        return false;
+
+    return replay_records(&records, NULL, NULL, phrase_index, NULL,
+                          library, false, null_token, null_token);
+}
+
+bool UserJournal::replay_phrase_library(FacadePhraseIndex * phrase_index,
+                                        guint8 library,
+                                        phrase_token_t mask,
+                                        phrase_token_t value) {
+    MemoryChunk records;
+    size_t size = 0;
+    if (!read_records(&records, size))
+        return false;
+
+    return replay_records(&records, NULL, NULL, phrase_index, NULL,
+                          library, true, mask, value);
+}
+
+static void _collect_token(gpointer key, gpointer value, gpointer data) {
+    GArray * tokens = (GArray *) data;
+    phrase_token_t token = GPOINTER_TO_UINT(key);
+    g_array_append_val(tokens, token);
+}
+
+static gint _compare_token(gconstpointer lhs, gconstpointer rhs) {
+    phrase_token_t token_lhs = *(const phrase_token_t *) lhs;
+    phrase_token_t token_rhs = *(const phrase_token_t *) rhs;
+    return token_lhs < token_rhs ? -1 : (token_lhs > token_rhs ? 1 : 0);
+}
+
+bool UserJournal::prepare_batch(FacadePhraseIndex * phrase_index,
+                                Bigram * bigram, MemoryChunk * batch) {
+    batch->set_size(0);
+
+    GArray * tokens = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+
+    /* write the current phrase items. */
+    g_hash_table_foreach(m_phrase_tokens, _collect_token, tokens);
+    g_array_sort(tokens, _compare_token);
+
+    PhraseItem item;
+    for (size_t i = 0; i < tokens->len; ++i) {
+        phrase_token_t token = g_array_index(tokens, phrase_token_t, i);
+        int retval = phrase_index->get_phrase_item(token, item);
+
+        /* the sub phrase index is unloaded. */
+        if (ERROR_NO_SUB_PHRASE_INDEX == retval)
+            continue;
+
+        if (ERROR_OK == retval)
+            append_record(batch, JOURNAL_PHRASE_ITEM, token,
+                          item.m_chunk.begin(), item.m_chunk.size());
+        else
+            append_record(batch, JOURNAL_REMOVE_PHRASE_ITEM, token,
+                          NULL, 0);
+    }
+
+    /* write the current single grams. */
+    g_array_set_size(tokens, 0);
+    g_hash_table_foreach(m_gram_tokens, _collect_token, tokens);
+    g_array_sort(tokens, _compare_token);
+
+    for (size_t i = 0; i < tokens->len; ++i) {
+        phrase_token_t token = g_array_index(tokens, phrase_token_t, i);
+        SingleGram * gram = NULL;
+        bigram->load(token, gram);
+
+        if (gram)
+            append_record(batch, JOURNAL_SINGLE_GRAM, token,
+                          gram->m_chunk.begin(), gram->m_chunk.size());
+        else
+            append_record(batch, JOURNAL_REMOVE_SINGLE_GRAM, token,
+                          NULL, 0);
+        delete gram;
+    }
+    g_array_free(tokens, TRUE);
+
+    /* the index records are kept in order. */
+    batch->set_content(batch->size(), m_index_records.begin(),
+                       m_index_records.size());
+
+    reset();
+    return true;
+}
+
+bool UserJournal::append_batch(MemoryChunk * batch) {
+    if (NULL == m_filename) {
+        m_need_compact = true;
+        return false;
+    }
+
+    if (0 == batch->size())
+        return true;
+
+    int fd = open(m_filename, O_CREAT|O_WRONLY|O_APPEND, 0644);
+    if (-1 == fd) {
+        m_need_compact = true;
+        return false;
+    }
+
+    guint32 header[2];
+    header[0] = batch->size();
+    header[1] = batch->get_check_sum();
+
+    ssize_t ret_len = write(fd, header, sizeof(header));
+    if (ret_len == (ssize_t) sizeof(header))
+        ret_len = write(fd, batch->begin(), batch->size());
+    else
+        ret_len = -1;
+
+    if (ret_len != (ssize_t) batch->size() || 0 != fsync(fd)) {
+        /* remove the partial batch, the changes are only
+           saved by the compaction now. */
+        if (0 != ftruncate(fd, m_size))
+            fprintf(stderr, "truncate %s failed.\n", m_filename);
+        close(fd);
+        m_need_compact = true;
+        return false;
+    }
+
+    close(fd);
+
+    m_size += batch_header + batch->size();
+    return true;
+}
+
+bool UserJournal::flush(FacadePhraseIndex * phrase_index, Bigram * bigram) {
+    MemoryChunk batch;
+    prepare_batch(phrase_index, bigram, &batch);
+    return append_batch(&batch);
+}
+
+bool UserJournal::truncate() {
+    reset();
+    m_need_compact = false;
+
+    if (NULL == m_filename)
+        return false;
+
+    int fd = open(m_filename, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if (-1 == fd)
+        return false;
+
+    fsync(fd);
+    close(fd);
+
+    m_size = 0;
+    return true;
+}
+
+};
@@ -0,0 +1,343 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USER_JOURNAL_H
+#define USER_JOURNAL_H
+
+#include <glib.h>
+#include "novel_types.h"
+#include "chewing_key.h"
+#include "memory_chunk.h"
+
+/**
+ * Journal File Format
+ *
+ * The journal is a sequence of batches, one batch is appended
+ * by each flush, the batch uses the same header as MemoryChunk::save:
+ *
+ * Batch:  length/checksum/records
+ *
+ * Phrase Item Record:         phrase item/token/len/phrase item chunk
+ * Remove Phrase Item Record:  remove phrase item/token/0
+ * Single Gram Record:         single gram/token/len/single gram chunk
+ * Remove Single Gram Record:  remove single gram/token/0
+ * Pinyin Index Record:        add or remove/token/len/chewing keys
+ * Phrase Index Record:        add or remove/token/len/ucs4 phrase
+ *
+ * The phrase item and single gram records keep the whole content,
+ * so the replay of the records is idempotent.
+ */
+
+namespace pinyin{
+
+class FacadeChewingTable2;
+class FacadePhraseTable3;
+class FacadePhraseIndex;
+class Bigram;
+
+enum JOURNAL_TYPE{
+    JOURNAL_INVALID_RECORD = 0,
+    JOURNAL_PHRASE_ITEM = 1,
+    JOURNAL_REMOVE_PHRASE_ITEM,
+    JOURNAL_SINGLE_GRAM,
+    JOURNAL_REMOVE_SINGLE_GRAM,
+    JOURNAL_ADD_PINYIN_INDEX,
+    JOURNAL_REMOVE_PINYIN_INDEX,
+    JOURNAL_ADD_PHRASE_INDEX,
+    JOURNAL_REMOVE_PHRASE_INDEX
+};
+
+/**
+ * UserJournal:
+ *
+ * The append-only journal of the user table changes.
+ *
+ * The user tables notify the journal when they are changed,
+ * then flush appends the changes since the last flush to the journal file,
+ * the full user files are only re-written when the journal is compacted.
+ *
+ */
+class UserJournal{
+private:
+    gchar * m_filename;
+    /* the size of the valid batches in the journal file. */
+    size_t m_size;
+
+    /* the changed phrase items and single grams since the last flush. */
+    GHashTable * m_phrase_tokens;
+    GHashTable * m_gram_tokens;
+    /* the pinyin and phrase index records since the last flush. */
+    MemoryChunk m_index_records;
+
+    /* the changes can't be recorded in the journal. */
+    bool m_need_compact;
+    /* don't record the changes replayed from the journal. */
+    bool m_replaying;
+
+    void reset();
+
+    void append_record(MemoryChunk * chunk, JOURNAL_TYPE type,
+                       phrase_token_t token,
+                       const void * data, guint32 len);
+
+    bool read_records(MemoryChunk * records, size_t & size);
+
+    bool replay_records(MemoryChunk * records,
+                        FacadeChewingTable2 * pinyin_table,
+                        FacadePhraseTable3 * phrase_table,
+                        FacadePhraseIndex * phrase_index,
+                        Bigram * bigram,
+                        guint8 library, bool use_mask,
+                        phrase_token_t mask, phrase_token_t value);
+
+    /* Disallow copy. */
+    UserJournal(const UserJournal &);
+    UserJournal & operator=(const UserJournal &);
+
+public:
+    /**
+     * UserJournal::UserJournal:
+     *
+     * The constructor of the UserJournal.
+     *
+     */
+    UserJournal();
+
+    /**
+     * UserJournal::~UserJournal:
+     *
+     * The destructor of the UserJournal.
+     *
+     */
+    ~UserJournal();
+
+    /**
+     * UserJournal::load:
+     * @filename: the journal file name.
+     * @returns: whether the load operation is successful.
+     *
+     * Load the journal file, the incomplete batch at the end of
+     * the journal file is truncated.
+     *
+     */
+    bool load(const char * filename);
+
+    /**
+     * UserJournal::replay:
+     * @pinyin_table: the pinyin table.
+     * @phrase_table: the phrase table.
+     * @phrase_index: the phrase index.
+     * @bigram: the user bi-gram.
+     * @returns: whether the replay operation is successful.
+     *
+     * Replay the journal over the user tables loaded from the full files.
+     *
+     */
+    bool replay(FacadeChewingTable2 * pinyin_table,
+                FacadePhraseTable3 * phrase_table,
+                FacadePhraseIndex * phrase_index,
+                Bigram * bigram);
+
+    /**
+     * UserJournal::replay_phrase_library:
+     * @phrase_index: the phrase index.
+     * @library: the index of the sub phrase index.
+     * @returns: whether the replay operation is successful.
+     *
+     * Replay the phrase items of the re-loaded sub phrase index.
+     *
+     */
+    bool replay_phrase_library(FacadePhraseIndex * phrase_index,
+                               guint8 library);
+
+    /**
+     * UserJournal::replay_phrase_library:
+     * @phrase_index: the phrase index.
+     * @library: the index of the sub phrase index.
+     * @mask: the mask.
+     * @value: the value.
+     * @returns: whether the replay operation is successful.
+     *
+     * Replay the phrase items of the re-loaded sub phrase index,
+     * except the masked out phrase items.
+     *
+     */
+    bool replay_phrase_library(FacadePhraseIndex * phrase_index,
+                               guint8 library,
+                               phrase_token_t mask, phrase_token_t value);
+
+    /**
+     * UserJournal::touch_phrase_item:
+     * @token: the phrase token.
+     *
+     * The phrase item of the token is added, removed or changed.
+     *
+     */
+    void touch_phrase_item(phrase_token_t token) {
+        if (m_replaying)
+            return;
+        g_hash_table_insert(m_phrase_tokens, GUINT_TO_POINTER(token),
+                            GUINT_TO_POINTER(token));
+    }
+
+    /**
+     * UserJournal::touch_single_gram:
+     * @token: the previous token in the bi-gram.
+     *
+     * The single gram of the previous token is stored or removed.
+     *
+     */
+    void touch_single_gram(phrase_token_t token) {
+        if (m_replaying)
+            return;
+        g_hash_table_insert(m_gram_tokens, GUINT_TO_POINTER(token),
+                            GUINT_TO_POINTER(token));
+    }
+
+    /**
+     * UserJournal::append_pinyin_index:
+     * @type: JOURNAL_ADD_PINYIN_INDEX or JOURNAL_REMOVE_PINYIN_INDEX.
+     * @phrase_length: the phrase length.
+     * @keys: the pinyin keys of the phrase.
+     * @token: the phrase token.
+     *
+     * The index of the user pinyin table is added or removed.
+     *
+     */
+    void append_pinyin_index(JOURNAL_TYPE type, int phrase_length,
+                             const ChewingKey keys[], phrase_token_t token) {
+        if (m_replaying)
+            return;
+        append_record(&m_index_records, type, token, keys,
+                      phrase_length * sizeof(ChewingKey));
+    }
+
+    /**
+     * UserJournal::append_phrase_index:
+     * @type: JOURNAL_ADD_PHRASE_INDEX or JOURNAL_REMOVE_PHRASE_INDEX.
+     * @phrase_length: the phrase length.
+     * @phrase: the ucs4 phrase string.
+     * @token: the phrase token.
+     *
+     * The index of the user phrase table is added or removed.
+     *
+     */
+    void append_phrase_index(JOURNAL_TYPE type, int phrase_length,
+                             const ucs4_t phrase[], phrase_token_t token) {
+        if (m_replaying)
+            return;
+        append_record(&m_index_records, type, token, phrase,
+                      phrase_length * sizeof(ucs4_t));
+    }
+
+    /**
+     * UserJournal::invalidate:
+     *
+     * The user tables are changed in the ways the journal can't record,
+     * like the mask out, the journal needs to be compacted.
+     *
+     */
+    void invalidate() {
+        if (m_replaying)
+            return;
+        m_need_compact = true;
+    }
+
+    /**
+     * UserJournal::need_compact:
+     * @returns: whether the full user files need to be re-written.
+     *
+     */
+    bool need_compact() const {
+        return m_need_compact;
+    }
+
+    /**
+     * UserJournal::has_changes:
+     * @returns: whether the user tables are changed since the last flush.
+     *
+     */
+    bool has_changes() const {
+        return m_need_compact || g_hash_table_size(m_phrase_tokens) ||
+            g_hash_table_size(m_gram_tokens) || m_index_records.size();
+    }
+
+    /**
+     * UserJournal::get_size:
+     * @returns: the size of the journal file.
+     *
+     */
+    size_t get_size() const {
+        return m_size;
+    }
+
+    /**
+     * UserJournal::prepare_batch:
+     * @phrase_index: the phrase index.
+     * @bigram: the user bi-gram.
+     * @batch: the batch of the changes.
+     * @returns: whether the prepare operation is successful.
+     *
+     * Copy the changes since the last flush into the batch,
+     * the batch is the snapshot of the changes to be appended later.
+     *
+     */
+    bool prepare_batch(FacadePhraseIndex * phrase_index, Bigram * bigram,
+                       MemoryChunk * batch);
+
+    /**
+     * UserJournal::append_batch:
+     * @batch: the batch of the changes.
+     * @returns: whether the append operation is successful.
+     *
+     * Append the batch to the journal file, and sync the journal file
+     * to disk, the journal needs to be compacted when failed.
+     *
+     * Note: the batches are appended in the order of prepare_batch,
+     * only one append runs at a time.
+     *
+     */
+    bool append_batch(MemoryChunk * batch);
+
+    /**
+     * UserJournal::flush:
+     * @phrase_index: the phrase index.
+     * @bigram: the user bi-gram.
+     * @returns: whether the flush operation is successful.
+     *
+     * Append the changes since the last flush as one batch to
+     * the journal file, and sync the journal file to disk.
+     *
+     */
+    bool flush(FacadePhraseIndex * phrase_index, Bigram * bigram);
+
+    /**
+     * UserJournal::truncate:
+     * @returns: whether the truncate operation is successful.
+     *
+     * Clear the journal after the full user files are re-written.
+     *
+     */
+    bool truncate();
+};
+
+};
+
+#endif
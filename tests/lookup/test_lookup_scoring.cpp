@@ -0,0 +1,116 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "timer.h"
+#include <float.h>
+#include "pinyin_internal.h"
+
+size_t bench_times = 1000000;
+
+int main(int argc, char * argv[]) {
+    /* the relative error of the fast log over the possibilities,
+       and the floats next to one where the logarithm is small. */
+    gdouble max_error = 0.;
+    for (gfloat x = 1e-30f; x < 1.f; x *= 1.0137f) {
+        gdouble error = fabs(fast_log(x) - log((gdouble) x)) /
+            fabs(log((gdouble) x));
+        max_error = std_lite::max(max_error, error);
+    }
+    for (gfloat x = 0.999f; x < 1.f; x = nextafterf(x, 1.f)) {
+        gdouble error = fabs(fast_log(x) - log((gdouble) x)) /
+            fabs(log((gdouble) x));
+        max_error = std_lite::max(max_error, error);
+    }
+    printf("max relative error of fast log:%g\n", max_error);
+    assert(max_error < 1e-6);
+
+    assert(fast_log(1.f) == 0.f);
+    assert(fabs(fast_log(2.f) - M_LN2) < 1e-6);
+
+    LookupScorer scorer(0.3);
+    scorer.prepare(1000);
+
+    gdouble unigram_poss = scorer.get_unigram_possibility(20);
+    assert(fabs(unigram_poss - 0.02) < DBL_EPSILON);
+
+    /* the exact scoring keeps the original formulas. */
+    scorer.set_exact_scoring(true);
+    unigram_poss = scorer.get_unigram_possibility(20);
+    assert(unigram_poss == 20 / (gdouble) 1000);
+    assert(fabs(scorer.unigram_score(unigram_poss, log(0.5)) -
+                log(unigram_poss * 0.5 * 0.7)) < 1e-6);
+
+    gfloat exact = scorer.bigram_score(0.25, unigram_poss, log(0.5));
+    assert(fabs(exact - log((0.3 * 0.25 + 0.7 * unigram_poss) * 0.5)) < 1e-6);
+    scorer.set_exact_scoring(false);
+    gfloat fast = scorer.bigram_score(0.25, unigram_poss, log(0.5));
+    assert(fabs(exact - fast) < 1e-5);
+
+    exact = log(unigram_poss * 0.5 * 0.7);
+    fast = scorer.unigram_score(unigram_poss, log(0.5));
+    assert(fabs(exact - fast) < 1e-5);
+
+    /* the batch kernels score the same as the single candidate. */
+    CandidateBatch batch;
+    batch.resize(3);
+    batch.set(0, 10, 1, 0.25, 0.02, log(0.5));
+    batch.set(1, 11, 2, 0., 0.001, 0.);
+    batch.set(2, 12, 3, 0.75, 0., log(0.25));
+    assert(batch.get_token(2) == 12 && batch.get_length(2) == 3);
+
+    for (int exact_scoring = 0; exact_scoring < 2; ++exact_scoring) {
+        scorer.set_exact_scoring(exact_scoring);
+
+        scorer.score_bigrams(batch);
+        for (size_t i = 0; i < batch.size(); ++i)
+            assert(batch.get_score(i) == scorer.bigram_score
+                   (batch.get_bigram_possibility(i),
+                    batch.get_unigram_possibility(i),
+                    batch.get_pinyin_log_possibility(i)));
+
+        batch.resize(2);
+        scorer.score_unigrams(batch);
+        for (size_t i = 0; i < batch.size(); ++i)
+            assert(batch.get_score(i) == scorer.unigram_score
+                   (batch.get_unigram_possibility(i),
+                    batch.get_pinyin_log_possibility(i)));
+        batch.resize(3);
+        batch.set(2, 12, 3, 0.75, 0., log(0.25));
+    }
+    /* compare the speed of the log and the fast log. */
+    gdouble sum = 0.;
+    guint32 time = record_time();
+    for (size_t i = 1; i <= bench_times; ++i)
+        sum += log(i * (gdouble) 1e-7f);
+    print_time(time, bench_times);
+
+    time = record_time();
+    for (size_t i = 1; i <= bench_times; ++i)
+        sum -= fast_log(i * 1e-7f);
+    print_time(time, bench_times);
+    printf("sum of the differences:%g\n", sum);
+
+    printf("lookup scoring tests passed.\n");
+    return 0;
+}
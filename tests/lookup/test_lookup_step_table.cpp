@@ -0,0 +1,136 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "timer.h"
+#include "pinyin_internal.h"
+
+size_t bench_times = 2000;
+
+/* the tokens of one step, most steps only have a few nodes. */
+static void fill_step_tokens(GRand * rand, GArray * tokens) {
+    g_array_set_size(tokens, 0);
+
+    size_t size = g_rand_int_range(rand, 1, 8);
+    if (0 == g_rand_int_range(rand, 0, 8))
+        size = g_rand_int_range(rand, 8, 200);
+
+    for (size_t i = 0; i < size; ++i) {
+        /* the tokens from the default phrase libraries. */
+        phrase_token_t token = PHRASE_INDEX_MAKE_TOKEN
+            (g_rand_int_range(rand, 1, 4), g_rand_int_range(rand, 1, 60000));
+        g_array_append_val(tokens, token);
+    }
+}
+
+int main(int argc, char * argv[]) {
+    GRand * rand = g_rand_new_with_seed(17);
+    GArray * tokens = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+
+    /* the table agrees with the GHashTable. */
+    LookupStepTable table;
+    GHashTable * hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (size_t n = 0; n < 100; ++n) {
+        fill_step_tokens(rand, tokens);
+        table.clear();
+        g_hash_table_remove_all(hash);
+
+        for (size_t i = 0; i < tokens->len; ++i) {
+            phrase_token_t token = g_array_index(tokens, phrase_token_t, i);
+            table.insert(token, i);
+            g_hash_table_insert(hash, GUINT_TO_POINTER(token),
+                                GUINT_TO_POINTER(i));
+        }
+        assert(table.size() == g_hash_table_size(hash));
+
+        for (size_t i = 0; i < tokens->len; ++i) {
+            phrase_token_t token = g_array_index(tokens, phrase_token_t, i);
+            guint32 value = 0;
+            check_result(table.lookup(token, value));
+            assert(value == GPOINTER_TO_UINT
+                   (g_hash_table_lookup(hash, GUINT_TO_POINTER(token))));
+        }
+
+        guint32 value = 0;
+        assert(!table.lookup(null_token, value));
+    }
+
+    /* compare the speed with the same steps. */
+    GPtrArray * steps = g_ptr_array_new();
+    for (size_t n = 0; n < 200; ++n) {
+        GArray * step = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+        fill_step_tokens(rand, step);
+        g_ptr_array_add(steps, step);
+    }
+
+    guint32 sum = 0;
+    guint32 time = record_time();
+    for (size_t n = 0; n < bench_times; ++n) {
+        for (size_t k = 0; k < steps->len; ++k) {
+            GArray * step = (GArray *) g_ptr_array_index(steps, k);
+            GHashTable * step_hash = g_hash_table_new
+                (g_direct_hash, g_direct_equal);
+
+            for (size_t i = 0; i < step->len; ++i) {
+                gpointer key = GUINT_TO_POINTER
+                    (g_array_index(step, phrase_token_t, i));
+                gpointer orig_key = NULL, orig_value = NULL;
+                if (!g_hash_table_lookup_extended
+                    (step_hash, key, &orig_key, &orig_value))
+                    g_hash_table_insert(step_hash, key, GUINT_TO_POINTER(i));
+            }
+            sum += g_hash_table_size(step_hash);
+            g_hash_table_destroy(step_hash);
+        }
+    }
+    print_time(time, bench_times * steps->len);
+
+    time = record_time();
+    for (size_t n = 0; n < bench_times; ++n) {
+        for (size_t k = 0; k < steps->len; ++k) {
+            GArray * step = (GArray *) g_ptr_array_index(steps, k);
+            LookupStepTable step_table;
+
+            for (size_t i = 0; i < step->len; ++i) {
+                phrase_token_t token = g_array_index(step, phrase_token_t, i);
+                guint32 value = 0;
+                if (!step_table.lookup(token, value))
+                    step_table.insert(token, i);
+            }
+            sum -= step_table.size();
+        }
+    }
+    print_time(time, bench_times * steps->len);
+    assert(0 == sum);
+
+    for (size_t k = 0; k < steps->len; ++k)
+        g_array_free((GArray *) g_ptr_array_index(steps, k), TRUE);
+    g_ptr_array_free(steps, TRUE);
+
+    g_hash_table_destroy(hash);
+    g_array_free(tokens, TRUE);
+    g_rand_free(rand);
+
+    printf("lookup step table tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,541 @@
+/* 
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *  
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "timer.h"
+#include <string.h>
+#include "pinyin_internal.h"
+
+/* count the heap allocations, only works with glibc. */
+#ifdef __GLIBC__
+static size_t allocations = 0;
+
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t nmemb, size_t size);
+extern "C" void * __libc_realloc(void * ptr, size_t size);
+
+extern "C" void * malloc(size_t size) {
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t nmemb, size_t size) {
+    ++allocations;
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void * realloc(void * ptr, size_t size) {
+    ++allocations;
+    return __libc_realloc(ptr, size);
+}
+#else
+static size_t allocations = 0;
+#endif
+
+static const gint32 nstep = 31;
+static const gint32 max_phrase_length = 4;
+static const phrase_token_t ntoken = 24;
+size_t bench_times = 100;
+
+/* the previous comparison with the branches. */
+template <gint32 nstore>
+static bool legacy_value_less_than(const trellis_value_t * item_lhs,
+                                   const trellis_value_t * item_rhs) {
+    if (nstore > 1) {
+        if (item_lhs->m_sentence_length + 1 == item_rhs->m_sentence_length &&
+            item_lhs->m_poss + LONG_SENTENCE_PENALTY < item_rhs->m_poss)
+            return true;
+
+        if (item_lhs->m_sentence_length == item_rhs->m_sentence_length + 1 &&
+            item_lhs->m_poss < item_rhs->m_poss + LONG_SENTENCE_PENALTY)
+            return true;
+    }
+
+    if (item_lhs->m_sentence_length == item_rhs->m_sentence_length &&
+        item_lhs->m_poss < item_rhs->m_poss)
+        return true;
+
+    if (item_lhs->m_sentence_length > item_rhs->m_sentence_length)
+        return true;
+
+    return false;
+}
+
+/* the packed comparison key keeps the previous order. */
+static bool check_value_less_than() {
+    GRand * rand = g_rand_new_with_seed(11);
+    for (size_t i = 0; i < 100000; ++i) {
+        trellis_value_t lhs(-g_rand_int_range(rand, 0, 64) * 0.125f);
+        trellis_value_t rhs(-g_rand_int_range(rand, 0, 64) * 0.125f);
+        lhs.m_sentence_length = g_rand_int_range(rand, 0, 4);
+        rhs.m_sentence_length = g_rand_int_range(rand, 0, 4);
+
+        assert(trellis_value_less_than<1>(&lhs, &rhs) ==
+               legacy_value_less_than<1>(&lhs, &rhs));
+        assert(trellis_value_less_than<2>(&lhs, &rhs) ==
+               legacy_value_less_than<2>(&lhs, &rhs));
+    }
+    g_rand_free(rand);
+    return true;
+}
+
+/* fake the search of the phonetic lookup. */
+static trellis_value_t gen_value(const trellis_value_t * cur,
+                                 gint32 start, gint32 end,
+                                 phrase_token_t token) {
+    trellis_value_t next;
+    next.m_handles[0] = cur->m_handles[1];
+    next.m_handles[1] = token;
+    next.m_sentence_length = cur->m_sentence_length + (end - start);
+    next.m_poss = cur->m_poss - (token % 7) * 0.25f - (end - start) * 0.5f;
+    next.m_last_step = start;
+    next.m_sub_index = cur->m_current_index;
+    return next;
+}
+
+/* the phrase tokens which end at the step. */
+static phrase_token_t gen_token(gint32 start, gint32 end, phrase_token_t n) {
+    return (start * 131 + end * 17 + n) % 4096 + 2;
+}
+
+/* only search the steps from the start step, as PhoneticLookup does. */
+template <typename Trellis>
+static bool search_trellis(Trellis & trellis, gint32 start, gint32 nstep,
+                           GPtrArray * candidates) {
+    for (gint32 i = 0; i < nstep - 1; ++i) {
+        gint32 first = i + 1;
+
+        if (i < start) {
+            if (i + max_phrase_length < start)
+                continue;
+
+            first = start;
+        }
+
+        trellis.get_candidates(i, candidates);
+
+        for (size_t k = 0; k < candidates->len; ++k) {
+            const trellis_value_t * cur = (const trellis_value_t *)
+                g_ptr_array_index(candidates, k);
+
+            for (gint32 m = first; m < nstep && m <= i + max_phrase_length;
+                 ++m) {
+                for (phrase_token_t n = 0; n < ntoken; ++n) {
+                    phrase_token_t token = gen_token(i, m, n);
+                    trellis_value_t next = gen_value(cur, i, m, token);
+                    trellis.insert_candidate(m, token, &next);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+template <typename Trellis>
+static bool fill_trellis(Trellis & trellis,
+                         TokenVector prefixes,
+                         GPtrArray * candidates,
+                         gint32 length = nstep) {
+    trellis.clear();
+    trellis.prepare(length);
+    trellis.fill_prefixes(prefixes);
+
+    return search_trellis(trellis, 0, length, candidates);
+}
+
+/* the user appends one key, the last column is changed. */
+template <gint32 nstore, gint32 nbest>
+static bool append_trellis(ForwardPhoneticTrellis<nstore, nbest> & trellis,
+                           GPtrArray * candidates) {
+    gint32 start = trellis.size() - 1;
+    gint32 nstep = trellis.size() + 1;
+
+    trellis.rewind(start, nstep);
+    return search_trellis(trellis, start, nstep, candidates);
+}
+
+/* compare the best results of the two trellises. */
+template <gint32 nstore, gint32 nbest>
+static bool compare_trellis(ForwardPhoneticTrellis<nstore, nbest> & lhs,
+                            ForwardPhoneticTrellis<nstore, nbest> & rhs) {
+    GPtrArray * lhs_tails = g_ptr_array_new();
+    GPtrArray * rhs_tails = g_ptr_array_new();
+    MatchResult lhs_result = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
+    MatchResult rhs_result = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
+
+    lhs.get_tails(lhs_tails);
+    rhs.get_tails(rhs_tails);
+    assert(lhs_tails->len == rhs_tails->len);
+    assert(lhs.get_node_count() == rhs.get_node_count());
+
+    for (size_t i = 0; i < lhs_tails->len; ++i) {
+        const trellis_value_t * lhs_tail = (const trellis_value_t *)
+            g_ptr_array_index(lhs_tails, i);
+        const trellis_value_t * rhs_tail = (const trellis_value_t *)
+            g_ptr_array_index(rhs_tails, i);
+        assert(lhs_tail->m_poss == rhs_tail->m_poss);
+
+        check_result(extract_result<nstore>(&lhs, lhs_tail, lhs_result));
+        check_result(extract_result<nstore>(&rhs, rhs_tail, rhs_result));
+        assert(lhs_result->len == rhs_result->len);
+        assert(0 == memcmp(lhs_result->data, rhs_result->data,
+                           lhs_result->len * sizeof(phrase_token_t)));
+    }
+
+    g_array_free(lhs_result, TRUE);
+    g_array_free(rhs_result, TRUE);
+    g_ptr_array_free(lhs_tails, TRUE);
+    g_ptr_array_free(rhs_tails, TRUE);
+    return true;
+}
+
+/* the previous trellis with the per step GHashTable and GArray. */
+template <gint32 nstore, gint32 nbest>
+class LegacyPhoneticTrellis {
+private:
+    typedef typename trellis_node_policy<nstore>::node_t node_t;
+
+
+    /* Array of GHashTable */
+    GPtrArray * m_steps_index;
+    /* Array of LookupStepContent */
+    GPtrArray * m_steps_content;
+
+public:
+    LegacyPhoneticTrellis() {
+        m_steps_index = g_ptr_array_new();
+        m_steps_content = g_ptr_array_new();
+    }
+
+    ~LegacyPhoneticTrellis() {
+        clear();
+        g_ptr_array_free(m_steps_index, TRUE);
+        m_steps_index = NULL;
+        g_ptr_array_free(m_steps_content, TRUE);
+        m_steps_content = NULL;
+    }
+
+public:
+    size_t size() const {
+        assert(m_steps_index->len == m_steps_content->len);
+        return m_steps_index->len;
+    }
+
+    bool clear() {
+        /* clear m_steps_index */
+        for ( size_t i = 0; i < m_steps_index->len; ++i){
+            GHashTable * step_index = (GHashTable *) g_ptr_array_index(m_steps_index, i);
+            g_hash_table_destroy(step_index);
+            g_ptr_array_index(m_steps_index, i) = NULL;
+        }
+        g_ptr_array_set_size(m_steps_index, 0);
+
+        /* clear m_steps_content */
+        for ( size_t i = 0; i < m_steps_content->len; ++i){
+            LookupStepContent step_content = (LookupStepContent) g_ptr_array_index(m_steps_content, i);
+            g_array_free(step_content, TRUE);
+            g_ptr_array_index(m_steps_content, i) = NULL;
+        }
+        g_ptr_array_set_size(m_steps_content, 0);
+
+        return true;
+    }
+
+    bool prepare(gint32 nstep) {
+        /* add null start step */
+        g_ptr_array_set_size(m_steps_index, nstep);
+        g_ptr_array_set_size(m_steps_content, nstep);
+
+        for (int i = 0; i < nstep; ++i) {
+            /* initialize m_steps_index */
+            g_ptr_array_index(m_steps_index, i) = g_hash_table_new(g_direct_hash, g_direct_equal);
+            /* initialize m_steps_content */
+            g_ptr_array_index(m_steps_content, i) = g_array_new(FALSE, FALSE, sizeof(node_t));
+        }
+
+        return true;
+    }
+
+    /* Array of phrase_token_t */
+    bool fill_prefixes(/* in */ TokenVector prefixes) {
+        assert(prefixes->len > 0);
+
+        for (size_t i = 0; i < prefixes->len; ++i) {
+            phrase_token_t token = g_array_index(prefixes, phrase_token_t, i);
+            lookup_key_t initial_key = token;
+            trellis_value_t initial_value(log(1.f));
+            initial_value.m_handles[1] = token;
+
+            node_t initial_node;
+            check_result(initial_node.eval_item(&initial_value));
+
+            LookupStepContent initial_step_content = (LookupStepContent)
+                g_ptr_array_index(m_steps_content, 0);
+            initial_step_content = g_array_append_val
+                (initial_step_content, initial_node);
+
+            GHashTable * initial_step_index = (GHashTable *)
+                g_ptr_array_index(m_steps_index, 0);
+            g_hash_table_insert(initial_step_index,
+                                GUINT_TO_POINTER(initial_key),
+                                GUINT_TO_POINTER(initial_step_content->len - 1));
+        }
+
+        return true;
+    }
+
+    /* PtrArray of trellis_value_t pointer */
+    bool get_candidates(/* in */ gint32 index,
+                        /* out */ GPtrArray * candidates) const {
+        LookupStepContent step = (LookupStepContent)
+            g_ptr_array_index(m_steps_content, index);
+
+        g_ptr_array_set_size(candidates, 0);
+
+        if (0 == step->len)
+            return false;
+
+        for (size_t i = 0; i < step->len; ++i) {
+            node_t * node = &g_array_index
+                (step, node_t, i);
+
+            // only initialized in the get_candidates method.
+            node->number();
+
+            const trellis_value_t * value = node->begin();
+            for (; value < node->end(); ++value) {
+                g_ptr_array_add(candidates, (trellis_value_t *)value);
+            }
+        }
+
+        /* dump_max_value(candidates); */
+
+        return true;
+    }
+
+    /* insert candidate */
+    bool insert_candidate(gint32 index, lookup_key_t token,
+                          const trellis_value_t * candidate) {
+        GHashTable * step_index = (GHashTable *) g_ptr_array_index(m_steps_index, index);
+        LookupStepContent step_content = (LookupStepContent) g_ptr_array_index(m_steps_content, index);
+
+        gpointer key = NULL, value = NULL;
+        gboolean lookup_result = g_hash_table_lookup_extended
+            (step_index, GUINT_TO_POINTER(token), &key, &value);
+
+        if (!lookup_result) {
+            node_t node;
+            check_result(node.eval_item(candidate));
+
+            g_array_append_val(step_content, node);
+            g_hash_table_insert(step_index, GUINT_TO_POINTER(token), GUINT_TO_POINTER(step_content->len - 1));
+            return true;
+        } else {
+            size_t node_index = GPOINTER_TO_UINT(value);
+            node_t * node = &g_array_index
+                (step_content, node_t, node_index);
+
+            return node->eval_item(candidate);
+        }
+
+        abort();
+    }
+
+    /* get tails */
+    /* Array of trellis_value_t * */
+    bool get_tails(/* out */ GPtrArray * tails) const {
+        gint32 tail_index = size() - 1;
+
+        GPtrArray * candidates = g_ptr_array_new();
+        get_candidates(tail_index, candidates);
+        get_top_results<nstore>(nbest, tails, candidates);
+
+        g_ptr_array_sort(tails, (GCompareFunc)trellis_value_compare);
+
+        g_ptr_array_free(candidates, TRUE);
+        return true;
+    }
+
+    /* get candidate */
+    bool get_candidate(gint32 index, lookup_key_t token, gint32 sub_index,
+                       const trellis_value_t * & candidate) const {
+        GHashTable * step_index = (GHashTable *) g_ptr_array_index(m_steps_index, index);
+        LookupStepContent step_content = (LookupStepContent) g_ptr_array_index(m_steps_content, index);
+
+        gpointer key = NULL, value = NULL;
+        gboolean lookup_result = g_hash_table_lookup_extended
+            (step_index, GUINT_TO_POINTER(token), &key, &value);
+
+        if (!lookup_result)
+            return false;
+
+        size_t node_index = GPOINTER_TO_UINT(value);
+        node_t * node = &g_array_index
+            (step_content, node_t, node_index);
+
+        if (sub_index >= node->length())
+            return false;
+
+        candidate = node->begin() + sub_index;
+
+        return true;
+    }
+};
+
+
+int main(int argc, char * argv[]) {
+    TokenVector prefixes = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+    g_array_append_val(prefixes, sentence_start);
+
+    GPtrArray * candidates = g_ptr_array_new();
+    GPtrArray * tails = g_ptr_array_new();
+    MatchResult result = g_array_new(TRUE, TRUE, sizeof(phrase_token_t));
+
+    check_value_less_than();
+
+    {
+        /* the beam keeps the top results within the margin. */
+        trellis_value_t values[6];
+        for (size_t i = 0; i < G_N_ELEMENTS(values); ++i) {
+            values[i].m_sentence_length = 2;
+            values[i].m_poss = -1.f * i;
+            g_ptr_array_add(candidates, &values[i]);
+        }
+
+        GPtrArray * topresults = g_ptr_array_new();
+        get_top_results<2>(4, topresults, candidates);
+        assert(4 == topresults->len);
+        get_top_results<2>(4, topresults, candidates, 2.5f);
+        assert(3 == topresults->len);
+        for (size_t i = 0; i < topresults->len; ++i)
+            assert(((trellis_value_t *) g_ptr_array_index
+                    (topresults, i))->m_poss >= -2.5f);
+        g_ptr_array_free(topresults, TRUE);
+        g_ptr_array_set_size(candidates, 0);
+    }
+
+    ForwardPhoneticTrellis<2, 3> trellis;
+
+    /* check the trellis content. */
+    fill_trellis(trellis, prefixes, candidates);
+    assert(nstep == (gint32) trellis.size());
+
+    trellis.get_tails(tails);
+    assert(tails->len > 0 && tails->len <= 3);
+    printf("trellis nodes:%d\n", trellis.get_node_count());
+
+    for (size_t i = 0; i < tails->len; ++i) {
+        const trellis_value_t * tail = (const trellis_value_t *)
+            g_ptr_array_index(tails, i);
+        check_result(extract_result<2>(&trellis, tail, result));
+        assert(nstep == (gint32) result->len);
+        assert(null_token != g_array_index(result, phrase_token_t, 0));
+    }
+
+    /* the recycled trellis should not find the stale nodes. */
+    trellis.clear();
+    trellis.prepare(nstep);
+    const trellis_value_t * stale = NULL;
+    assert(!trellis.get_candidate(nstep - 1, gen_token(nstep - 2, nstep - 1, 0),
+                                  0, stale));
+
+    /* the allocations of the previous trellis. */
+    LegacyPhoneticTrellis<2, 3> legacy;
+    fill_trellis(legacy, prefixes, candidates);
+
+    size_t saved_allocations = allocations;
+    guint32 start_time = record_time();
+    for (size_t i = 0; i < bench_times; ++i)
+        fill_trellis(legacy, prefixes, candidates);
+    print_time(start_time, bench_times);
+    printf("legacy trellis:%f allocations per call\n",
+           (allocations - saved_allocations) / (double) bench_times);
+
+    /* the allocations of the flat trellis storage. */
+    ForwardPhoneticTrellis<2, 3> cold;
+    saved_allocations = allocations;
+    fill_trellis(cold, prefixes, candidates);
+    printf("flat trellis first call:%zu allocations\n",
+           allocations - saved_allocations);
+
+    saved_allocations = allocations;
+    start_time = record_time();
+    for (size_t i = 0; i < bench_times; ++i)
+        fill_trellis(cold, prefixes, candidates);
+    print_time(start_time, bench_times);
+    size_t steady_allocations = allocations - saved_allocations;
+    printf("flat trellis steady state:%f allocations per call\n",
+           steady_allocations / (double) bench_times);
+
+#ifdef __GLIBC__
+    assert(0 == steady_allocations);
+#endif
+
+    /* re-use the trellis when the user appends keys. */
+    ForwardPhoneticTrellis<2, 3> incremental, full;
+    fill_trellis(incremental, prefixes, candidates, 2);
+    for (gint32 n = 3; n <= nstep * 2; ++n) {
+        append_trellis(incremental, candidates);
+        fill_trellis(full, prefixes, candidates, n);
+        assert(n == (gint32) incremental.size());
+        compare_trellis(incremental, full);
+    }
+
+    /* the linear node keeps the same scores as the heap node. */
+    ForwardPhoneticTrellis<2, 3, trellis_linear_node<2> > linear;
+    ForwardPhoneticTrellis<2, 3, trellis_heap_node<2> > heap;
+    fill_trellis(linear, prefixes, candidates, nstep * 2);
+    fill_trellis(heap, prefixes, candidates, nstep * 2);
+    linear.get_tails(tails);
+    GPtrArray * heap_tails = g_ptr_array_new();
+    heap.get_tails(heap_tails);
+    assert(tails->len == heap_tails->len);
+    /* the equal possibilities may choose the different paths. */
+    for (size_t i = 0; i < tails->len; ++i)
+        assert(((const trellis_value_t *) g_ptr_array_index(tails, i))->m_poss ==
+               ((const trellis_value_t *) g_ptr_array_index(heap_tails, i))->m_poss);
+    g_ptr_array_free(heap_tails, TRUE);
+
+    /* the latency of one key at the end of the long input. */
+    start_time = record_time();
+    for (size_t i = 0; i < bench_times; ++i)
+        fill_trellis(full, prefixes, candidates, nstep * 2);
+    print_time(start_time, bench_times);
+    printf("full search of %d steps\n", nstep * 2);
+
+    start_time = record_time();
+    for (size_t i = 0; i < bench_times; ++i) {
+        incremental.rewind(nstep * 2 - 1, nstep * 2);
+        search_trellis(incremental, nstep * 2 - 1, nstep * 2, candidates);
+    }
+    print_time(start_time, bench_times);
+    printf("incremental search of %d steps\n", nstep * 2);
+    compare_trellis(incremental, full);
+
+    g_array_free(result, TRUE);
+    g_ptr_array_free(tails, TRUE);
+    g_ptr_array_free(candidates, TRUE);
+    g_array_free(prefixes, TRUE);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "pinyin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+typedef size_t (* parse_func_t)(pinyin_instance_t * instance,
+                                const char * input);
+
+/* the sentence of the instance after the input is parsed. */
+static gchar * guess_sentence(pinyin_instance_t * instance,
+                              parse_func_t parse, const char * input) {
+    /* the results are kept when nothing is parsed. */
+    if (0 == parse(instance, input))
+        return NULL;
+
+    pinyin_guess_sentence(instance);
+
+    char * sentence = NULL;
+    if (!pinyin_get_sentence(instance, 0, &sentence))
+        return g_strdup("");
+    return sentence;
+}
+
+/* the re-used trellis gives the same sentence as the fresh context. */
+static bool check_input(pinyin_instance_t * instance,
+                        pinyin_context_t * fresh_context,
+                        parse_func_t parse, const char * input) {
+    gchar * sentence = guess_sentence(instance, parse, input);
+    if (NULL == sentence)
+        return false;
+
+    pinyin_instance_t * fresh_instance = pinyin_alloc_instance(fresh_context);
+    gchar * expected = guess_sentence(fresh_instance, parse, input);
+    pinyin_free_instance(fresh_instance);
+    assert(NULL != expected);
+
+    if (0 != strcmp(sentence, expected)) {
+        fprintf(stderr, "input:%s\nincremental:%s\nfresh:%s\n",
+                input, sentence, expected);
+        abort();
+    }
+
+    g_free(sentence);
+    g_free(expected);
+    return true;
+}
+
+/* type the input, then edit it in the middle and at the end. */
+static bool check_edits(pinyin_context_t * context,
+                        pinyin_context_t * fresh_context,
+                        parse_func_t parse, const char * input) {
+    pinyin_instance_t * instance = pinyin_alloc_instance(context);
+    const size_t len = strlen(input);
+    gchar * buf = g_strdup(input);
+
+    /* append the keys. */
+    for (size_t i = 1; i <= len; ++i) {
+        buf[i] = '\0';
+        check_input(instance, fresh_context, parse, buf);
+        buf[i] = input[i];
+    }
+
+    /* remove the keys. */
+    for (size_t i = len; i > len / 2; --i) {
+        buf[i] = '\0';
+        check_input(instance, fresh_context, parse, buf);
+    }
+
+    /* change the keys in the middle. */
+    strcpy(buf, input);
+    for (size_t i = len / 4; i < len; i += 3) {
+        char saved = buf[i];
+        buf[i] = input[len - 1 - i];
+        check_input(instance, fresh_context, parse, buf);
+        buf[i] = saved;
+        check_input(instance, fresh_context, parse, buf);
+    }
+
+    /* insert the keys in the middle. */
+    for (size_t i = 1; i < len; i += 4) {
+        gchar * inserted = g_strdup_printf
+            ("%.*s%s%s", (int) i, input, input + len / 2, input + i);
+        check_input(instance, fresh_context, parse, inserted);
+        g_free(inserted);
+        check_input(instance, fresh_context, parse, input);
+    }
+
+    g_free(buf);
+    pinyin_free_instance(instance);
+    return true;
+}
+
+int main(int argc, char * argv[]) {
+    pinyin_context_t * context = pinyin_init("../../data", "../../data");
+    pinyin_context_t * fresh_context = pinyin_init("../../data", "../../data");
+    if (NULL == context || NULL == fresh_context) {
+        fprintf(stderr, "load the system data failed.\n");
+        exit(ENOENT);
+    }
+
+    pinyin_option_t options = PINYIN_INCOMPLETE | PINYIN_CORRECT_ALL |
+        USE_DIVIDED_TABLE | USE_RESPLIT_TABLE | DYNAMIC_ADJUST;
+    pinyin_set_options(context, options);
+    pinyin_set_options(fresh_context, options);
+
+    pinyin_set_double_pinyin_scheme(context, DOUBLE_PINYIN_MS);
+    pinyin_set_double_pinyin_scheme(fresh_context, DOUBLE_PINYIN_MS);
+
+    const char * full_pinyins[] = {
+        "nihaoshijiewoaibeijingtiananmen",
+        "zhongguorenmindaxueshenghuo",
+        "xianganmenzhidaoshuohua",
+    };
+    for (size_t i = 0; i < G_N_ELEMENTS(full_pinyins); ++i)
+        check_edits(context, fresh_context,
+                    pinyin_parse_more_full_pinyins, full_pinyins[i]);
+
+    const char * double_pinyins[] = {
+        "nihkuiji",
+        "vsgoreminlda",
+    };
+    for (size_t i = 0; i < G_N_ELEMENTS(double_pinyins); ++i)
+        check_edits(context, fresh_context,
+                    pinyin_parse_more_double_pinyins, double_pinyins[i]);
+
+    const char * chewings[] = {
+        "su3cl3g4ru,4",
+        "5j/ej6b05",
+    };
+    for (size_t i = 0; i < G_N_ELEMENTS(chewings); ++i)
+        check_edits(context, fresh_context,
+                    pinyin_parse_more_chewings, chewings[i]);
+
+    pinyin_fini(fresh_context);
+    pinyin_fini(context);
+
+    printf("pinyin guess tests passed.\n");
+    return 0;
+}
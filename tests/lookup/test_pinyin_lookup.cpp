@@ -113,6 +113,25 @@ int main( int argc, char * argv[]){
             pinyin_lookup.get_nbest_match(prefixes, &matrix, &constraints, &results);
         print_time(start_time, bench_times);
 
+        /* stop the search at every step, then resume it. */
+        NBestMatchResults resumed;
+        bool finished = false; size_t dirty_offset = 0;
+        while (!finished) {
+            pinyin_lookup.get_nbest_match(prefixes, &matrix, &constraints,
+                                          &resumed, dirty_offset, 0, finished);
+            dirty_offset = matrix.size();
+        }
+
+        assert(resumed.size() == results.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            MatchResult result = NULL, resumed_result = NULL;
+            check_result(results.get_result(i, result));
+            check_result(resumed.get_result(i, resumed_result));
+            assert(result->len == resumed_result->len);
+            assert(0 == memcmp(result->data, resumed_result->data,
+                               result->len * sizeof(phrase_token_t)));
+        }
+
         for (size_t i = 0; i < results.size(); ++i) {
             MatchResult result = NULL;
             check_result(results.get_result(i, result));
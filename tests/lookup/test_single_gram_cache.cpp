@@ -0,0 +1,119 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+#include "pinyin_internal.h"
+
+static const char * system_filename = "/tmp/test_system_bigram.db";
+static const char * user_filename = "/tmp/test_user_bigram.db";
+
+static void check_statistics(SingleGramCache & cache,
+                             guint32 hits, guint32 misses) {
+    guint32 cache_hits = 0, cache_misses = 0;
+    check_result(cache.get_statistics(cache_hits, cache_misses));
+    assert(hits == cache_hits);
+    assert(misses == cache_misses);
+}
+
+int main(int argc, char * argv[]){
+    unlink(system_filename);
+    unlink(user_filename);
+
+    Bigram system_bigram, user_bigram;
+    check_result(system_bigram.attach
+                 (system_filename, ATTACH_CREATE|ATTACH_READWRITE));
+    check_result(user_bigram.attach
+                 (user_filename, ATTACH_CREATE|ATTACH_READWRITE));
+
+    /* the system single grams of token 1, 2 and 3. */
+    for (phrase_token_t index = 1; index <= 3; ++index) {
+        SingleGram gram;
+        check_result(gram.insert_freq(10, index));
+        check_result(gram.set_total_freq(index * 10));
+        check_result(system_bigram.store(index, &gram));
+    }
+
+    /* the user single gram of token 1. */
+    SingleGram user_gram;
+    check_result(user_gram.insert_freq(10, 2));
+    check_result(user_gram.insert_freq(11, 3));
+    check_result(user_gram.set_total_freq(5));
+    check_result(user_bigram.store(1, &user_gram));
+
+    SingleGramCache cache(&system_bigram, &user_bigram, 2);
+    assert(2 == cache.get_capacity());
+
+    /* the merged single gram of the system and user bi-gram. */
+    const SingleGram * merged = NULL;
+    guint32 freq = 0, total_freq = 0;
+    check_result(cache.load(1, merged));
+    check_result(merged->get_freq(10, freq));
+    assert(3 == freq);
+    check_result(merged->get_freq(11, freq));
+    assert(3 == freq);
+    check_result(merged->get_total_freq(total_freq));
+    assert(15 == total_freq);
+    check_statistics(cache, 0, 1);
+
+    check_result(cache.load(1, merged));
+    check_statistics(cache, 1, 1);
+
+    /* the missing token is also cached. */
+    assert(!cache.load(4, merged));
+    assert(NULL == merged);
+    assert(!cache.load(4, merged));
+    check_statistics(cache, 2, 2);
+
+    /* evict the least recently used token 1. */
+    check_result(cache.load(2, merged));
+    check_result(merged->get_total_freq(total_freq));
+    assert(20 == total_freq);
+    check_statistics(cache, 2, 3);
+
+    assert(!cache.load(4, merged));
+    check_statistics(cache, 3, 3);
+    check_result(cache.load(1, merged));
+    check_statistics(cache, 3, 4);
+
+    /* write the user bi-gram to invalidate the cache. */
+    check_result(user_gram.set_freq(10, 6));
+    check_result(user_gram.set_total_freq(9));
+    check_result(user_bigram.store(1, &user_gram));
+
+    check_result(cache.load(1, merged));
+    check_result(merged->get_freq(10, freq));
+    assert(7 == freq);
+    check_result(merged->get_total_freq(total_freq));
+    assert(19 == total_freq);
+    check_statistics(cache, 3, 5);
+
+    check_result(cache.reset_statistics());
+    check_statistics(cache, 0, 0);
+
+    printf("single gram cache tests passed.\n");
+
+    unlink(system_filename);
+    unlink(user_filename);
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include "pinyin_internal.h"
+
+static const char * sorted_filename = "/tmp/test_sorted_pinyin_index.bin";
+
+static const pinyin_option_t options = USE_TONE | PINYIN_INCOMPLETE;
+
+static const struct {
+    const char * m_pinyin;
+    phrase_token_t m_token;
+} phrases[] = {
+    {"ni", PHRASE_INDEX_MAKE_TOKEN(0, 20)},
+    {"ni3", PHRASE_INDEX_MAKE_TOKEN(0, 21)},
+    {"ni3", PHRASE_INDEX_MAKE_TOKEN(0, 22)},
+    {"ni3'hao3", PHRASE_INDEX_MAKE_TOKEN(0, 10)},
+    {"ni3'hao3", PHRASE_INDEX_MAKE_TOKEN(0, 11)},
+    /* the duplicated phrase. */
+    {"ni3'hao3", PHRASE_INDEX_MAKE_TOKEN(0, 11)},
+    {"ni'hao", PHRASE_INDEX_MAKE_TOKEN(1, 12)},
+    {"ni'men", PHRASE_INDEX_MAKE_TOKEN(0, 13)},
+    {"ni3'hao3'ma", PHRASE_INDEX_MAKE_TOKEN(0, 14)},
+    {"ta'men", PHRASE_INDEX_MAKE_TOKEN(1, 15)},
+    {"na'li", PHRASE_INDEX_MAKE_TOKEN(0, 16)},
+};
+
+static const char * searches[] = {
+    "ni", "ni3", "ni2", "n", "ni'hao", "ni3'hao3", "ni'hao3", "n'h",
+    "ni'men", "ni'hao'ma", "n'h'm", "ta", "ta'men", "t'm", "na",
+    "na'li", "wo", "wo'men", "ni'hao'ma'ya"
+};
+
+static ChewingKeyVector parse_keys(const char * pinyin) {
+    FullPinyinParser2 parser;
+    ChewingKeyVector keys = g_array_new(FALSE, FALSE, sizeof(ChewingKey));
+    ChewingKeyRestVector key_rests =
+        g_array_new(FALSE, FALSE, sizeof(ChewingKeyRest));
+
+    parser.parse(options, keys, key_rests, pinyin, strlen(pinyin));
+    assert(keys->len > 0);
+
+    g_array_free(key_rests, TRUE);
+    return keys;
+}
+
+static gint compare_token(gconstpointer lhs, gconstpointer rhs) {
+    phrase_token_t token_lhs = *(phrase_token_t *) lhs;
+    phrase_token_t token_rhs = *(phrase_token_t *) rhs;
+    return token_lhs - token_rhs;
+}
+
+static void check_search(ChewingLargeTable2 & largetable,
+                         FacadeChewingTable2 & sortedtable,
+                         const char * pinyin) {
+    ChewingKeyVector keys = parse_keys(pinyin);
+    const ChewingKey * data = (ChewingKey *) keys->data;
+
+    PhraseIndexRanges expected, ranges;
+    memset(expected, 0, sizeof(PhraseIndexRanges));
+    memset(ranges, 0, sizeof(PhraseIndexRanges));
+    for (size_t i = 0; i < 2; ++i) {
+        expected[i] = g_array_new(FALSE, FALSE, sizeof(PhraseIndexRange));
+        ranges[i] = g_array_new(FALSE, FALSE, sizeof(PhraseIndexRange));
+    }
+
+    int expected_result = largetable.search(keys->len, data, expected);
+    int result = sortedtable.search(keys->len, data, ranges);
+    assert(expected_result == result);
+
+    for (size_t i = 0; i < 2; ++i) {
+        assert(expected[i]->len == ranges[i]->len);
+        assert(0 == memcmp(expected[i]->data, ranges[i]->data,
+                           expected[i]->len * sizeof(PhraseIndexRange)));
+        g_array_free(expected[i], TRUE);
+        g_array_free(ranges[i], TRUE);
+    }
+
+    PhraseTokens expected_tokens, tokens;
+    memset(expected_tokens, 0, sizeof(PhraseTokens));
+    memset(tokens, 0, sizeof(PhraseTokens));
+    for (size_t i = 0; i < 2; ++i) {
+        expected_tokens[i] = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+        tokens[i] = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+    }
+
+    expected_result = largetable.search_suggestion
+        (keys->len, data, expected_tokens);
+    result = sortedtable.search_suggestion(keys->len, data, tokens);
+    assert(expected_result == result);
+
+    for (size_t i = 0; i < 2; ++i) {
+        /* the order of the longer phrases may differ. */
+        g_array_sort(expected_tokens[i], compare_token);
+        g_array_sort(tokens[i], compare_token);
+
+        assert(expected_tokens[i]->len == tokens[i]->len);
+        assert(0 == memcmp(expected_tokens[i]->data, tokens[i]->data,
+                           tokens[i]->len * sizeof(phrase_token_t)));
+        g_array_free(expected_tokens[i], TRUE);
+        g_array_free(tokens[i], TRUE);
+    }
+
+    g_array_free(keys, TRUE);
+}
+
+int main(int argc, char * argv[]) {
+    ChewingLargeTable2 largetable;
+    ChewingSortedTable2 sortedtable;
+
+    for (size_t i = 0; i < G_N_ELEMENTS(phrases); ++i) {
+        ChewingKeyVector keys = parse_keys(phrases[i].m_pinyin);
+        largetable.add_index
+            (keys->len, (ChewingKey *) keys->data, phrases[i].m_token);
+        sortedtable.add_index
+            (keys->len, (ChewingKey *) keys->data, phrases[i].m_token);
+        g_array_free(keys, TRUE);
+    }
+
+    MemoryChunk chunk;
+    check_result(sortedtable.store(&chunk));
+    check_result(chunk.save(sorted_filename));
+
+    /* only the header is read to detect the sorted table. */
+    assert(ChewingSortedTable2::is_sorted_table(sorted_filename));
+    assert(!ChewingSortedTable2::is_sorted_table("/nonexistent"));
+
+    /* the facade loads the sorted table as the system table. */
+    FacadeChewingTable2 facade;
+    check_result(facade.load(sorted_filename, NULL));
+
+    for (size_t i = 0; i < G_N_ELEMENTS(searches); ++i)
+        check_search(largetable, facade, searches[i]);
+
+    {
+        /* the facade shares the system table of another facade. */
+        FacadeChewingTable2 shared;
+        check_result(shared.load(&facade, NULL));
+
+        for (size_t i = 0; i < G_N_ELEMENTS(searches); ++i)
+            check_search(largetable, shared, searches[i]);
+    }
+
+    /* the system table is still owned by the first facade. */
+    check_search(largetable, facade, searches[0]);
+
+    /* the corrupted sorted table is rejected. */
+    MemoryChunk * corrupted = new MemoryChunk;
+    corrupted->set_content(0, "CST2", 4);
+    check_result(corrupted->save(sorted_filename));
+    assert(!ChewingSortedTable2::is_sorted_table(sorted_filename));
+    ChewingSortedTable2 table;
+    assert(!table.load(corrupted));
+
+    printf("chewing sorted table tests passed.\n");
+
+    unlink(sorted_filename);
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "pinyin_internal.h"
+
+static const pinyin_option_t options = USE_TONE | PINYIN_INCOMPLETE;
+
+static ChewingKeyVector parse_keys(const char * pinyin) {
+    FullPinyinParser2 parser;
+    ChewingKeyVector keys = g_array_new(FALSE, FALSE, sizeof(ChewingKey));
+    ChewingKeyRestVector key_rests =
+        g_array_new(FALSE, FALSE, sizeof(ChewingKeyRest));
+
+    parser.parse(options, keys, key_rests, pinyin, strlen(pinyin));
+    assert(keys->len > 0);
+
+    g_array_free(key_rests, TRUE);
+    return keys;
+}
+
+static void add_index(ChewingLargeTable2 & table,
+                      const char * pinyin, phrase_token_t token) {
+    ChewingKeyVector keys = parse_keys(pinyin);
+    table.add_index(keys->len, (ChewingKey *) keys->data, token);
+    g_array_free(keys, TRUE);
+}
+
+static void new_ranges(PhraseIndexRanges ranges, size_t count) {
+    memset(ranges, 0, sizeof(PhraseIndexRanges));
+    for (size_t i = 0; i < count; ++i)
+        ranges[i] = g_array_new(FALSE, FALSE, sizeof(PhraseIndexRange));
+}
+
+static void free_ranges(PhraseIndexRanges ranges) {
+    for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
+        if (ranges[i])
+            g_array_free(ranges[i], TRUE);
+        ranges[i] = NULL;
+    }
+}
+
+/* the cached search should match the search of both chewing tables. */
+static void check_search(ChewingTableCache & cache,
+                         ChewingLargeTable2 & system_table,
+                         ChewingLargeTable2 & user_table,
+                         const char * pinyin, size_t count = 2) {
+    ChewingKeyVector keys = parse_keys(pinyin);
+    const ChewingKey * data = (ChewingKey *) keys->data;
+
+    PhraseIndexRanges expected, ranges;
+    new_ranges(expected, count);
+    new_ranges(ranges, count);
+
+    int expected_result = system_table.search(keys->len, data, expected);
+    expected_result |= user_table.search(keys->len, data, expected);
+
+    int result = cache.search(keys->len, data, ranges);
+    assert(expected_result == result);
+
+    for (size_t i = 0; i < PHRASE_INDEX_LIBRARY_COUNT; ++i) {
+        if (NULL == expected[i]) {
+            assert(NULL == ranges[i]);
+            continue;
+        }
+
+        assert(expected[i]->len == ranges[i]->len);
+        assert(0 == memcmp(expected[i]->data, ranges[i]->data,
+                           expected[i]->len * sizeof(PhraseIndexRange)));
+    }
+
+    free_ranges(expected);
+    free_ranges(ranges);
+    g_array_free(keys, TRUE);
+}
+
+static void check_statistics(ChewingTableCache & cache,
+                             guint32 hits, guint32 misses) {
+    guint32 cache_hits = 0, cache_misses = 0;
+    check_result(cache.get_statistics(cache_hits, cache_misses));
+    assert(hits == cache_hits);
+    assert(misses == cache_misses);
+}
+
+int main(int argc, char * argv[]) {
+    ChewingLargeTable2 system_table, user_table;
+
+    add_index(system_table, "ni'hao", PHRASE_INDEX_MAKE_TOKEN(0, 10));
+    add_index(system_table, "ni'hao", PHRASE_INDEX_MAKE_TOKEN(0, 11));
+    add_index(system_table, "ni", PHRASE_INDEX_MAKE_TOKEN(0, 20));
+    add_index(system_table, "ni3", PHRASE_INDEX_MAKE_TOKEN(0, 21));
+    add_index(user_table, "ni'hao", PHRASE_INDEX_MAKE_TOKEN(1, 5));
+
+    ChewingTableCache cache(NULL, &system_table, &user_table, 4);
+
+    /* fill and hit the cache. */
+    check_search(cache, system_table, user_table, "ni'hao");
+    check_search(cache, system_table, user_table, "ni'hao");
+    check_statistics(cache, 1, 1);
+
+    /* the tones and incomplete pinyins are different keys. */
+    check_search(cache, system_table, user_table, "ni");
+    check_search(cache, system_table, user_table, "ni3");
+    check_search(cache, system_table, user_table, "n'h");
+    check_statistics(cache, 1, 4);
+
+    /* only fill the phrase libraries requested by the caller. */
+    check_search(cache, system_table, user_table, "ni'hao", 1);
+    check_statistics(cache, 2, 4);
+
+    /* the empty result is cached, and evicts the key "ni". */
+    check_search(cache, system_table, user_table, "ta");
+    check_search(cache, system_table, user_table, "ta");
+    check_statistics(cache, 3, 5);
+    check_search(cache, system_table, user_table, "ni");
+    check_statistics(cache, 3, 6);
+
+    /* add the phrase with the prefix "ta" to change the continued flag. */
+    ChewingKeyVector keys = parse_keys("ta'men");
+    phrase_token_t token = PHRASE_INDEX_MAKE_TOKEN(1, 6);
+    check_result(cache.invalidate(keys->len, (ChewingKey *) keys->data));
+    user_table.add_index(keys->len, (ChewingKey *) keys->data, token);
+    check_search(cache, system_table, user_table, "ta");
+    check_search(cache, system_table, user_table, "ta'men");
+    check_statistics(cache, 3, 8);
+
+    /* the key "ni'hao" is not changed by the phrase "ta'men". */
+    check_search(cache, system_table, user_table, "ni'hao");
+    check_statistics(cache, 4, 8);
+
+    check_result(cache.invalidate(keys->len, (ChewingKey *) keys->data));
+    user_table.remove_index(keys->len, (ChewingKey *) keys->data, token);
+    check_search(cache, system_table, user_table, "ta'men");
+    check_statistics(cache, 4, 9);
+    g_array_free(keys, TRUE);
+
+    /* mask out the user phrase library. */
+    phrase_token_t mask = PHRASE_INDEX_LIBRARY_MASK;
+    phrase_token_t value = PHRASE_INDEX_MAKE_TOKEN(1, null_token);
+    check_result(cache.mask_out(mask, value));
+    check_result(user_table.mask_out(mask, value));
+    check_search(cache, system_table, user_table, "ni'hao");
+    check_statistics(cache, 4, 10);
+
+    check_result(cache.clear());
+    check_search(cache, system_table, user_table, "ni'hao");
+    check_statistics(cache, 4, 11);
+
+    /* the sharded cache searches the same as the chewing tables. */
+    const char * pinyins[] = {"ni'hao", "ni", "ni3", "n'h", "ta", "ta'men"};
+    ChewingTableCache sharded_cache(NULL, &system_table, &user_table, 32, 4);
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < G_N_ELEMENTS(pinyins); ++i)
+            check_search(sharded_cache, system_table, user_table, pinyins[i]);
+    }
+    check_statistics(sharded_cache, 6, 6);
+
+    check_result(sharded_cache.mask_out(mask, value));
+    check_result(sharded_cache.clear());
+    check_search(sharded_cache, system_table, user_table, "ni'hao");
+    check_statistics(sharded_cache, 6, 7);
+
+    printf("chewing table cache tests passed.\n");
+    return 0;
+}
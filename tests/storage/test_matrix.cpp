@@ -82,7 +82,53 @@ bool test_pronunciation_possibility(PhoneticKeyMatrix * matrix,
     return true;
 }
 
+/* the log possibility of the single pinyin key sequence is precomputed. */
+bool test_pronunciation_log_possibility() {
+    ChewingKey key1 = ChewingKey(CHEWING_CH, CHEWING_ZERO_MIDDLE, CHEWING_ENG);
+    ChewingKey key2 = ChewingKey(CHEWING_SH, CHEWING_ZERO_MIDDLE, CHEWING_ANG);
+
+    ucs4_t string[2] = {2, 3};
+    ChewingKey keys1[2] = {key1, key2};
+    ChewingKey keys2[2] = {key2, key1};
+    PhraseItem item;
+    item.set_phrase_string(2, string);
+    item.add_pronunciation(keys1, 100);
+    item.add_pronunciation(keys2, 300);
+
+    ChewingKeyVector keys = g_array_new(FALSE, FALSE, sizeof(ChewingKey));
+    ChewingKeyRestVector key_rests =
+        g_array_new(FALSE, FALSE, sizeof(ChewingKeyRest));
+    g_array_append_vals(keys, keys1, 2);
+    for (size_t i = 0; i < 2; ++i) {
+        ChewingKeyRest key_rest;
+        key_rest.m_raw_begin = i * 3; key_rest.m_raw_end = (i + 1) * 3;
+        g_array_append_val(key_rests, key_rest);
+    }
+
+    PhoneticKeyMatrix matrix;
+    fill_matrix(&matrix, keys, key_rests, 6);
+
+    GArray * cached_keys = g_array_new(TRUE, TRUE, sizeof(ChewingKey));
+    gfloat poss = compute_pronunciation_possibility
+        (&matrix, 0, 6, cached_keys, item);
+    gfloat log_poss = compute_pronunciation_log_possibility
+        (&matrix, 0, 6, cached_keys, item.get_view());
+    assert(fabs(poss - 0.25) < FLT_EPSILON);
+    assert(fabs(log_poss - log(poss)) < 1. / phrase_item_log_poss_scale);
+
+    /* no pinyin key sequence matches the phrase item. */
+    assert(-FLT_MAX == compute_pronunciation_log_possibility
+           (&matrix, 0, 3, cached_keys, item.get_view()));
+
+    g_array_free(cached_keys, TRUE);
+    g_array_free(key_rests, TRUE);
+    g_array_free(keys, TRUE);
+    return true;
+}
+
 int main(int argc, char * argv[]) {
+    check_result(test_pronunciation_log_possibility());
+
     SystemTableInfo2 system_table_info;
 
     bool retval = system_table_info.load("../../data/table.conf");
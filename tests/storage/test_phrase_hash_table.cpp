@@ -0,0 +1,179 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include "pinyin_internal.h"
+
+static const char * hash_filename = "/tmp/test_hash_phrase_index.bin";
+
+static const struct {
+    const char * m_phrase;
+    phrase_token_t m_token;
+} phrases[] = {
+    {"你", PHRASE_INDEX_MAKE_TOKEN(0, 20)},
+    {"你", PHRASE_INDEX_MAKE_TOKEN(0, 21)},
+    {"你好", PHRASE_INDEX_MAKE_TOKEN(0, 10)},
+    {"你好", PHRASE_INDEX_MAKE_TOKEN(1, 11)},
+    /* the duplicated phrase. */
+    {"你好", PHRASE_INDEX_MAKE_TOKEN(0, 10)},
+    {"你好吗", PHRASE_INDEX_MAKE_TOKEN(0, 12)},
+    {"你们", PHRASE_INDEX_MAKE_TOKEN(0, 13)},
+    {"他们", PHRASE_INDEX_MAKE_TOKEN(1, 14)},
+    {"哪里", PHRASE_INDEX_MAKE_TOKEN(0, 15)},
+};
+
+static const char * searches[] = {
+    "你", "你好", "你好吗", "你好吗呀", "你们", "他", "他们",
+    "哪", "哪里", "我", "我们"
+};
+
+/* the random phrases use a small alphabet to share the prefixes. */
+static const size_t num_random_phrases = 5000;
+static const ucs4_t random_alphabet = 0x4e00;
+static const int random_alphabet_size = 8;
+
+static gint compare_token(gconstpointer lhs, gconstpointer rhs) {
+    phrase_token_t token_lhs = *(phrase_token_t *) lhs;
+    phrase_token_t token_rhs = *(phrase_token_t *) rhs;
+    return token_lhs - token_rhs;
+}
+
+static void check_tokens(PhraseTokens expected, PhraseTokens tokens) {
+    for (size_t i = 0; i < 2; ++i) {
+        /* the order of the longer phrases may differ. */
+        g_array_sort(expected[i], compare_token);
+        g_array_sort(tokens[i], compare_token);
+
+        assert(expected[i]->len == tokens[i]->len);
+        assert(0 == memcmp(expected[i]->data, tokens[i]->data,
+                           tokens[i]->len * sizeof(phrase_token_t)));
+        g_array_free(expected[i], TRUE);
+        g_array_free(tokens[i], TRUE);
+    }
+}
+
+static void check_search(PhraseLargeTable3 & largetable,
+                         FacadePhraseTable3 & hashtable,
+                         int phrase_length, const ucs4_t phrase[]) {
+    PhraseTokens expected, tokens;
+    memset(expected, 0, sizeof(PhraseTokens));
+    memset(tokens, 0, sizeof(PhraseTokens));
+    for (size_t i = 0; i < 2; ++i) {
+        expected[i] = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+        tokens[i] = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+    }
+
+    int expected_result = largetable.search(phrase_length, phrase, expected);
+    int result = hashtable.search(phrase_length, phrase, tokens);
+    assert(expected_result == result);
+    check_tokens(expected, tokens);
+
+    for (size_t i = 0; i < 2; ++i) {
+        expected[i] = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+        tokens[i] = g_array_new(FALSE, FALSE, sizeof(phrase_token_t));
+    }
+
+    expected_result = largetable.search_suggestion
+        (phrase_length, phrase, expected);
+    result = hashtable.search_suggestion(phrase_length, phrase, tokens);
+    assert(expected_result == result);
+    check_tokens(expected, tokens);
+}
+
+static void check_search(PhraseLargeTable3 & largetable,
+                         FacadePhraseTable3 & hashtable,
+                         const char * utf8) {
+    glong phrase_len = g_utf8_strlen(utf8, -1);
+    ucs4_t * phrase = g_utf8_to_ucs4(utf8, -1, NULL, NULL, NULL);
+    check_search(largetable, hashtable, phrase_len, phrase);
+    g_free(phrase);
+}
+
+static int random_phrase(GRand * rand, ucs4_t phrase[]) {
+    int phrase_length = g_rand_int_range(rand, 1, 7);
+    for (int i = 0; i < phrase_length; ++i)
+        phrase[i] = random_alphabet +
+            g_rand_int_range(rand, 0, random_alphabet_size);
+    return phrase_length;
+}
+
+int main(int argc, char * argv[]) {
+    PhraseLargeTable3 largetable;
+    PhraseHashTable3 hashtable;
+
+    for (size_t i = 0; i < G_N_ELEMENTS(phrases); ++i) {
+        glong phrase_len = g_utf8_strlen(phrases[i].m_phrase, -1);
+        ucs4_t * phrase = g_utf8_to_ucs4
+            (phrases[i].m_phrase, -1, NULL, NULL, NULL);
+        largetable.add_index(phrase_len, phrase, phrases[i].m_token);
+        hashtable.add_index(phrase_len, phrase, phrases[i].m_token);
+        g_free(phrase);
+    }
+
+    GRand * rand = g_rand_new_with_seed(1);
+    ucs4_t phrase[MAX_PHRASE_LENGTH];
+    for (size_t i = 0; i < num_random_phrases; ++i) {
+        int phrase_length = random_phrase(rand, phrase);
+        phrase_token_t token = PHRASE_INDEX_MAKE_TOKEN
+            (g_rand_int_range(rand, 0, 2), (100 + i));
+        largetable.add_index(phrase_length, phrase, token);
+        hashtable.add_index(phrase_length, phrase, token);
+    }
+
+    MemoryChunk chunk;
+    check_result(hashtable.store(&chunk));
+    check_result(chunk.save(hash_filename));
+
+    /* only the header is read to detect the hash table. */
+    assert(PhraseHashTable3::is_hash_table(hash_filename));
+    assert(!PhraseHashTable3::is_hash_table("/nonexistent"));
+
+    /* the facade loads the hash table as the system table. */
+    FacadePhraseTable3 facade;
+    check_result(facade.load(hash_filename, NULL));
+
+    for (size_t i = 0; i < G_N_ELEMENTS(searches); ++i)
+        check_search(largetable, facade, searches[i]);
+
+    /* both the added and the missing random phrases. */
+    for (size_t i = 0; i < num_random_phrases; ++i) {
+        int phrase_length = random_phrase(rand, phrase);
+        check_search(largetable, facade, phrase_length, phrase);
+    }
+    g_rand_free(rand);
+
+    /* the corrupted hash table is rejected. */
+    MemoryChunk * corrupted = new MemoryChunk;
+    corrupted->set_content(0, "PHT3", 4);
+    check_result(corrupted->save(hash_filename));
+    assert(!PhraseHashTable3::is_hash_table(hash_filename));
+    PhraseHashTable3 table;
+    assert(!table.load(corrupted));
+
+    printf("phrase hash table tests passed.\n");
+
+    unlink(hash_filename);
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "timer.h"
 #include <stdio.h>
 #include <errno.h>
+#include <unistd.h>
 #include "pinyin_internal.h"
 #include "tests_helper.h"
 
@@ -70,6 +71,170 @@ int main(int argc, char * argv[]){
         assert(poss == 0.5);
     }
 
+    {
+        /* the view reads the same phrase item without copy. */
+        PhraseItemView view;
+        check_result(!phrase_index_test.get_phrase_item_view(1, view));
+        assert(view.get_phrase_length() == 1);
+        assert(view.get_n_pronunciation() == 2);
+        assert(view.get_unigram_frequency() == 0);
+        assert(view.get_pronunciation_possibility(&key1) == 0.5);
+
+        ChewingKey key4; guint32 freq4 = 0;
+        check_result(view.get_nth_pronunciation(1, &key4, freq4));
+        assert(key4 == key2 && freq4 == 300);
+        assert(!view.get_nth_pronunciation(2, &key4, freq4));
+
+        assert(ERROR_NO_ITEM == phrase_index_test.get_phrase_item_view
+               (2, view) ||
+               ERROR_OUT_OF_RANGE == phrase_index_test.get_phrase_item_view
+               (2, view));
+    }
+
+    {
+        /* the odd phrase length pads the pinyin keys. */
+        PhraseItem item6;
+        ucs4_t string3[3] = {3, 4, 5};
+        ChewingKey keys3[3] = {key1, key2, key1};
+        ChewingKey keys4[3] = {key2, key2, key1};
+        item6.set_phrase_string(3, string3);
+        item6.add_pronunciation(keys3, 10);
+        item6.add_pronunciation(keys4, 30);
+        check_result(!phrase_index_test.add_phrase_item(3, &item6));
+
+        MemoryChunk* chunk2 = new MemoryChunk;
+        check_result(phrase_index_test.store(0, chunk2));
+        check_result(phrase_index_test.load(0, chunk2));
+
+        PhraseItemView view;
+        check_result(!phrase_index_test.get_phrase_item_view(3, view));
+        assert(view.get_phrase_length() == 3);
+        assert(view.get_n_pronunciation() == 2);
+        assert(view.get_pronunciation_possibility(keys4) == 0.75);
+
+        /* the precomputed total and quantized log possibility. */
+        assert(view.get_pronunciation_total_frequency() == 40);
+        gfloat log_poss = view.get_pronunciation_log_possibility(keys4);
+        assert(fabs(log_poss - log(0.75)) < 1. / phrase_item_log_poss_scale);
+        ChewingKey keys5[3] = {key1, key1, key1};
+        assert(view.get_pronunciation_log_possibility(keys5) == -FLT_MAX);
+
+        PhraseItem item7;
+        check_result(!phrase_index_test.get_writable_phrase_item(3, item7));
+        assert(item6 == item7);
+
+        item7.increase_pronunciation_possibility(keys3, 40);
+        assert(item7.get_view().get_pronunciation_total_frequency() == 80);
+        gfloat log_poss7 = item7.get_pronunciation_log_possibility(keys3);
+        assert(fabs(log_poss7 - log(0.625)) < 1. / phrase_item_log_poss_scale);
+    }
+
+    {
+        /* the sub phrase index is loaded when its item is used. */
+        const char * filename = "/tmp/test_phrase_index.bin";
+        MemoryChunk * chunk3 = new MemoryChunk;
+        check_result(phrase_index_test.store(0, chunk3));
+        check_result(chunk3->save(filename));
+        delete chunk3;
+
+        FacadePhraseIndex eager_index;
+        MemoryChunk * chunk4 = new MemoryChunk;
+        check_result(chunk4->load(filename));
+        check_result(eager_index.load(0, chunk4));
+
+        FacadePhraseIndex lazy_index;
+        check_result(lazy_index.load_on_demand(0, filename, NULL));
+        assert(lazy_index.get_phrase_index_total_freq() ==
+               eager_index.get_phrase_index_total_freq());
+
+        PhraseTokens tokens;
+        memset(tokens, 0, sizeof(PhraseTokens));
+        lazy_index.prepare_tokens(tokens);
+        assert(NULL != tokens[0]);
+        lazy_index.destroy_tokens(tokens);
+
+        PhraseItem item8;
+        check_result(!lazy_index.get_phrase_item(3, item8));
+        assert(item8.get_phrase_length() == 3);
+        assert(!lazy_index.load_pending(0));
+
+        /* the pending sub phrase index is unloaded without loading. */
+        FacadePhraseIndex lazy_index2;
+        check_result(lazy_index2.load_on_demand(0, filename, NULL));
+        check_result(lazy_index2.unload(0));
+        assert(lazy_index2.get_phrase_index_total_freq() == 0);
+        assert(ERROR_NO_SUB_PHRASE_INDEX ==
+               lazy_index2.get_phrase_item(3, item8));
+
+        unlink(filename);
+    }
+
+    {
+        /* the changes are kept in the overlay over the loaded content. */
+        MemoryChunk * chunk5 = new MemoryChunk;
+        check_result(phrase_index_test.store(0, chunk5));
+        check_result(phrase_index_test.load(0, chunk5));
+
+        MemoryChunk snapshot;
+        snapshot.set_content(0, chunk5->begin(), chunk5->size());
+
+        check_result(!phrase_index_test.add_unigram_frequency(3, 5));
+        PhraseItem item10;
+        check_result(!phrase_index_test.get_writable_phrase_item(3, item10));
+        ChewingKey keys6[3] = {key1, key2, key1};
+        item10.increase_pronunciation_possibility(keys6, 40);
+        PhraseItem * removed_item = NULL;
+        check_result(!phrase_index_test.remove_phrase_item(1, removed_item));
+        delete removed_item;
+        assert(0 == memcmp(snapshot.begin(), chunk5->begin(),
+                           chunk5->size()));
+
+        PhraseItem item9;
+        check_result(!phrase_index_test.get_phrase_item(3, item9));
+        assert(5 == item9.get_unigram_frequency());
+        assert(item9.get_pronunciation_possibility(keys6) == 0.75);
+        assert(ERROR_NO_ITEM == phrase_index_test.get_phrase_item(1, item9));
+
+        PhraseIndexRange range;
+        check_result(!phrase_index_test.get_range(0, range));
+        assert(4 == range.m_range_end);
+
+        /* store the loaded content with the overlay. */
+        MemoryChunk * chunk6 = new MemoryChunk;
+        check_result(phrase_index_test.store(0, chunk6));
+        check_result(phrase_index_test.load(0, chunk6));
+        check_result(!phrase_index_test.get_phrase_item(3, item9));
+        assert(5 == item9.get_unigram_frequency());
+        assert(ERROR_NO_ITEM == phrase_index_test.get_phrase_item(1, item9));
+    }
+
+    {
+        /* the destroyed arrays are re-used by the next prepare. */
+        PhraseTokens tokens;
+        memset(tokens, 0, sizeof(PhraseTokens));
+        phrase_index_test.prepare_tokens(tokens);
+        GArray * array = tokens[0];
+        assert(NULL != array);
+        phrase_token_t token = 1;
+        g_array_append_val(array, token);
+        phrase_index_test.destroy_tokens(tokens);
+        assert(NULL == tokens[0]);
+
+        {
+            ScopedPhraseTokens scoped_tokens(&phrase_index_test);
+            assert(array == scoped_tokens[0]);
+            assert(0 == scoped_tokens[0]->len);
+        }
+
+        /* the ranges are taken from the pool in the loops. */
+        time = record_time();
+        for (size_t i = 0; i < bench_times; ++i) {
+            ScopedPhraseIndexRanges ranges(&phrase_index_test);
+            assert(NULL != ranges[0]);
+        }
+        print_time(time, bench_times);
+    }
+
     SystemTableInfo2 system_table_info;
 
     bool retval = system_table_info.load("../../data/table.conf");
@@ -23,7 +23,54 @@
 
 /* TODO: check whether gb_char.bin and gb_char2.bin should be the same. */
 
+static void test_compact_format(){
+    MemoryChunk oldchunk, newchunk;
+    guint32 freq = 10;
+    oldchunk.set_content(0, &freq, sizeof(guint32));
+    freq = 20;
+    newchunk.set_content(0, &freq, sizeof(guint32));
+
+    /* the tokens are stored as the deltas. */
+    PhraseIndexLogger logger;
+    logger.append_record(LOG_MODIFY_HEADER, null_token, &oldchunk, &newchunk);
+    logger.append_record(LOG_ADD_RECORD, 300, NULL, &newchunk);
+    logger.append_record(LOG_MODIFY_RECORD, 5, &oldchunk, &newchunk);
+    logger.append_record(LOG_REMOVE_RECORD, 70000, &oldchunk, NULL);
+
+    MemoryChunk * chunk = new MemoryChunk;
+    logger.store(chunk);
+
+    PhraseIndexLogger reader;
+    reader.load(chunk);
+
+    const LOG_TYPE types[] = {LOG_MODIFY_HEADER, LOG_ADD_RECORD,
+                              LOG_MODIFY_RECORD, LOG_REMOVE_RECORD};
+    const phrase_token_t tokens[] = {null_token, 300, 5, 70000};
+
+    LOG_TYPE log_type; phrase_token_t token;
+    MemoryChunk oldone, newone;
+    for (size_t i = 0; i < G_N_ELEMENTS(types); ++i) {
+        assert(reader.has_next_record());
+        check_result(reader.next_record(log_type, token, &oldone, &newone));
+        assert(types[i] == log_type && tokens[i] == token);
+    }
+    assert(!reader.has_next_record());
+    assert(4 == newone.size() + oldone.size());
+
+    /* append to the loaded logs. */
+    reader.append_record(LOG_ADD_RECORD, 301, NULL, &newchunk);
+    reader.rewind();
+    size_t count = 0;
+    while (reader.has_next_record()) {
+        check_result(reader.next_record(log_type, token, &oldone, &newone));
+        ++count;
+    }
+    assert(5 == count && 301 == token);
+}
+
 int main(int argc, char * argv[]){
+    test_compact_format();
+
     FacadePhraseIndex phrase_index;
     MemoryChunk * chunk = new MemoryChunk;
     chunk->load("../../data/gb_char.bin");
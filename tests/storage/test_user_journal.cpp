@@ -0,0 +1,146 @@
+/*
+ *  libpinyin
+ *  Library to deal with pinyin.
+ *
+ *  Copyright (C) 2026 Peng Wu <alexepico@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "pinyin_internal.h"
+
+static const char * journal_filename = "/tmp/test_user_journal.bin";
+
+static void make_item(PhraseItem & item) {
+    ucs4_t string[2] = {1, 2};
+    ChewingKey keys[2] = {ChewingKey(CHEWING_CH, CHEWING_ZERO_MIDDLE,
+                                     CHEWING_ENG),
+                          ChewingKey(CHEWING_SH, CHEWING_ZERO_MIDDLE,
+                                     CHEWING_ANG)};
+    item.set_phrase_string(2, string);
+    item.add_pronunciation(keys, 10);
+}
+
+static void load_tables(FacadePhraseIndex & phrase_index, Bigram & bigram) {
+    PhraseItem item;
+    make_item(item);
+    check_result(!phrase_index.add_phrase_item(PHRASE_INDEX_MAKE_TOKEN(1, 1),
+                                               &item));
+    check_result(!phrase_index.add_phrase_item(PHRASE_INDEX_MAKE_TOKEN(1, 2),
+                                               &item));
+
+    /* the empty in-memory bi-gram without the db file. */
+    bigram.load_db("/tmp/test_user_journal.db");
+}
+
+int main(int argc, char * argv[]){
+    const phrase_token_t token1 = PHRASE_INDEX_MAKE_TOKEN(1, 1);
+    const phrase_token_t token2 = PHRASE_INDEX_MAKE_TOKEN(1, 2);
+    const phrase_token_t token3 = PHRASE_INDEX_MAKE_TOKEN(1, 3);
+    unlink(journal_filename);
+
+    FacadePhraseIndex phrase_index;
+    Bigram bigram;
+    load_tables(phrase_index, bigram);
+
+    /* the loaded tables are clean. */
+    phrase_index.clear_dirty(1);
+    assert(!phrase_index.is_dirty(1));
+    assert(!bigram.is_dirty());
+
+    UserJournal journal;
+    check_result(journal.load(journal_filename));
+    assert(0 == journal.get_size());
+    phrase_index.set_journal(&journal);
+    bigram.set_journal(&journal);
+
+    /* the changes are appended as one batch. */
+    check_result(!phrase_index.add_unigram_frequency(token1, 5));
+    check_result(!phrase_index.add_unigram_frequency(token1, 3));
+
+    SingleGram gram;
+    check_result(gram.insert_freq(token1, 7));
+    check_result(gram.set_total_freq(7));
+    check_result(bigram.store(token2, &gram));
+    assert(journal.has_changes());
+    assert(phrase_index.is_dirty(1) && !phrase_index.is_dirty(2));
+    assert(bigram.is_dirty());
+
+    check_result(journal.flush(&phrase_index, &bigram));
+    assert(!journal.has_changes());
+    size_t size = journal.get_size();
+    assert(size > 0);
+
+    /* add and remove the phrase items in the next batch. */
+    PhraseItem item, * removed_item = NULL;
+    make_item(item);
+    check_result(!phrase_index.add_phrase_item(token3, &item));
+    check_result(!phrase_index.add_unigram_frequency(token3, 8));
+    check_result(!phrase_index.remove_phrase_item(token2, removed_item));
+    delete removed_item;
+    check_result(journal.flush(&phrase_index, &bigram));
+    assert(journal.get_size() > size);
+    size = journal.get_size();
+
+    /* the incomplete batch is truncated. */
+    FILE * output = fopen(journal_filename, "ab");
+    guint32 length = 1024;
+    fwrite(&length, sizeof(guint32), 1, output);
+    fclose(output);
+
+    /* replay the journal over the original tables. */
+    FacadePhraseIndex phrase_index2;
+    Bigram bigram2;
+    load_tables(phrase_index2, bigram2);
+
+    UserJournal journal2;
+    check_result(journal2.load(journal_filename));
+    assert(journal2.get_size() == size);
+    check_result(journal2.replay(NULL, NULL, &phrase_index2, &bigram2));
+    assert(!journal2.has_changes());
+
+    PhraseItem item2;
+    check_result(!phrase_index2.get_phrase_item(token1, item2));
+    assert(8 == item2.get_unigram_frequency());
+    check_result(!phrase_index2.get_phrase_item(token3, item2));
+    assert(8 == item2.get_unigram_frequency());
+    assert(ERROR_OK != phrase_index2.get_phrase_item(token2, item2));
+    assert(phrase_index2.get_phrase_index_total_freq() ==
+           phrase_index.get_phrase_index_total_freq());
+
+    SingleGram * gram2 = NULL;
+    check_result(bigram2.load(token2, gram2));
+    guint32 freq = 0;
+    check_result(gram2->get_freq(token1, freq));
+    assert(7 == freq);
+    delete gram2;
+
+    /* the replay is idempotent. */
+    check_result(journal2.replay(NULL, NULL, &phrase_index2, &bigram2));
+    assert(phrase_index2.get_phrase_index_total_freq() ==
+           phrase_index.get_phrase_index_total_freq());
+
+    /* the journal is cleared after the compaction. */
+    check_result(journal2.truncate());
+    assert(0 == journal2.get_size());
+
+    phrase_index.set_journal(NULL);
+    bigram.set_journal(NULL);
+    unlink(journal_filename);
+
+    printf("user journal tests passed.\n");
+    return 0;
+}
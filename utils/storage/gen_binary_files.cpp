@@ -25,11 +25,15 @@
 
 static const gchar * table_dir = ".";
 static gboolean gen_punct_table = FALSE;
+static gboolean gen_sorted_pinyin_table = FALSE;
+static gboolean gen_hash_phrase_table = FALSE;
 
 static GOptionEntry entries[] =
 {
     {"table-dir", 0, 0, G_OPTION_ARG_FILENAME, &table_dir, "table directory", NULL},
     {"gen-punct-table", 0, 0, G_OPTION_ARG_NONE, &gen_punct_table, "generate punctuation table", NULL},
+    {"gen-sorted-pinyin-table", 0, 0, G_OPTION_ARG_NONE, &gen_sorted_pinyin_table, "generate read-only sorted pinyin table", NULL},
+    {"gen-hash-phrase-table", 0, 0, G_OPTION_ARG_NONE, &gen_hash_phrase_table, "generate read-only hash phrase table", NULL},
     {NULL}
 };
 
@@ -39,10 +43,14 @@ bool generate_binary_files(const char * pinyin_table_filename,
                            TABLE_PHONETIC_TYPE type) {
     /* generate pinyin index*/
     ChewingLargeTable2 pinyin_table;
-    pinyin_table.attach(pinyin_table_filename, ATTACH_READWRITE|ATTACH_CREATE);
+    ChewingSortedTable2 sorted_pinyin_table;
+    if (!gen_sorted_pinyin_table)
+        pinyin_table.attach(pinyin_table_filename, ATTACH_READWRITE|ATTACH_CREATE);
 
     PhraseLargeTable3 phrase_table;
-    phrase_table.attach(phrase_table_filename, ATTACH_READWRITE|ATTACH_CREATE);
+    PhraseHashTable3 hash_phrase_table;
+    if (!gen_hash_phrase_table)
+        phrase_table.attach(phrase_table_filename, ATTACH_READWRITE|ATTACH_CREATE);
 
     /* generate phrase index */
     FacadePhraseIndex phrase_index;
@@ -65,15 +73,41 @@ bool generate_binary_files(const char * pinyin_table_filename,
             exit(ENOENT);
         }
 
-        pinyin_table.load_text(tablefile, type);
+        if (gen_sorted_pinyin_table)
+            sorted_pinyin_table.load_text(tablefile, type);
+        else
+            pinyin_table.load_text(tablefile, type);
         fseek(tablefile, 0L, SEEK_SET);
-        phrase_table.load_text(tablefile);
+        if (gen_hash_phrase_table)
+            hash_phrase_table.load_text(tablefile);
+        else
+            phrase_table.load_text(tablefile);
         fseek(tablefile, 0L, SEEK_SET);
         phrase_index.load_text(i, tablefile, type);
         fclose(tablefile);
         g_free(filename);
     }
 
+    if (gen_sorted_pinyin_table) {
+        MemoryChunk * chunk = new MemoryChunk;
+        sorted_pinyin_table.store(chunk);
+        if (!chunk->save(pinyin_table_filename)) {
+            fprintf(stderr, "save %s failed!\n", pinyin_table_filename);
+            exit(ENOENT);
+        }
+        delete chunk;
+    }
+
+    if (gen_hash_phrase_table) {
+        MemoryChunk * chunk = new MemoryChunk;
+        if (!hash_phrase_table.store(chunk) ||
+            !chunk->save(phrase_table_filename)) {
+            fprintf(stderr, "save %s failed!\n", phrase_table_filename);
+            exit(ENOENT);
+        }
+        delete chunk;
+    }
+
     phrase_index.compact();
 
     if (!save_phrase_index(phrase_files, &phrase_index))
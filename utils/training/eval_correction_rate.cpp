@@ -23,12 +23,27 @@
 #include "config.h"
 #endif
 
+#include <locale.h>
 #include "pinyin_internal.h"
 #include "utils_helper.h"
 
+static gboolean exact_scoring = FALSE;
+static gboolean compare_scoring = FALSE;
+static gboolean benchmark = FALSE;
+
+static GOptionEntry entries[] =
+{
+    {"exact-scoring", 0, 0, G_OPTION_ARG_NONE, &exact_scoring, "use the exact scoring", NULL},
+    {"compare-scoring", 0, 0, G_OPTION_ARG_NONE, &compare_scoring, "compare the fast scoring with the exact scoring", NULL},
+    {"benchmark", 0, 0, G_OPTION_ARG_NONE, &benchmark, "benchmark the trellis over nstore and nbest", NULL},
+    {NULL}
+};
+
+/* the number of the tests guessed differently by the exact scoring. */
+static size_t mismatched_count = 0;
 
 void print_help(){
-    printf("Usage: eval_correction_rate\n");
+    printf("Usage: eval_correction_rate [--exact-scoring] [--compare-scoring] [--benchmark]\n");
 }
 
 bool get_possible_pinyin(FacadePhraseIndex * phrase_index,
@@ -60,8 +75,9 @@ bool get_possible_pinyin(FacadePhraseIndex * phrase_index,
     return true;
 }
 
+template <typename Lookup>
 bool get_best_match(FacadePhraseIndex * phrase_index,
-                    PhoneticLookup<1, 1> * pinyin_lookup,
+                    Lookup * pinyin_lookup,
                     PhoneticKeyMatrix * matrix,
                     NBestMatchResults * results) {
     /* prepare the prefixes for get_nbest_match. */
@@ -79,7 +95,9 @@ bool get_best_match(FacadePhraseIndex * phrase_index,
     return retval;
 }
 
-bool do_one_test(PhoneticLookup<1, 1> * pinyin_lookup,
+template <typename Lookup>
+bool do_one_test(Lookup * pinyin_lookup,
+                 Lookup * exact_lookup,
                  FacadePhraseIndex * phrase_index,
                  TokenVector tokens){
     bool retval = false;
@@ -104,9 +122,24 @@ bool do_one_test(PhoneticLookup<1, 1> * pinyin_lookup,
     fill_matrix(&matrix, keys, key_rests, keys->len);
     get_best_match(phrase_index, pinyin_lookup, &matrix, &results);
 
-    assert(1 == results.size());
+    /* the first result is the best match. */
+    assert(results.size() >= 1);
     check_result(results.get_result(0, guessed_tokens));
 
+    if (exact_lookup) {
+        NBestMatchResults exact_results;
+        get_best_match(phrase_index, exact_lookup, &matrix, &exact_results);
+
+        TokenVector exact_tokens = NULL;
+        assert(exact_results.size() >= 1);
+        check_result(exact_results.get_result(0, exact_tokens));
+
+        if (exact_tokens->len != guessed_tokens->len ||
+            0 != memcmp(exact_tokens->data, guessed_tokens->data,
+                        exact_tokens->len * sizeof(phrase_token_t)))
+            ++mismatched_count;
+    }
+
     /* compare the results */
     char * sentence = NULL; char * guessed_sentence = NULL;
     pinyin_lookup->convert_to_utf8(tokens, sentence);
@@ -114,9 +147,11 @@ bool do_one_test(PhoneticLookup<1, 1> * pinyin_lookup,
         (guessed_tokens, guessed_sentence);
 
     if ( strcmp(sentence, guessed_sentence) != 0 ) {
-        fprintf(stderr, "test sentence:%s\n", sentence);
-        fprintf(stderr, "guessed sentence:%s\n", guessed_sentence);
-        fprintf(stderr, "the result mis-matches.\n");
+        if (!benchmark) {
+            fprintf(stderr, "test sentence:%s\n", sentence);
+            fprintf(stderr, "guessed sentence:%s\n", guessed_sentence);
+            fprintf(stderr, "the result mis-matches.\n");
+        }
         retval = false;
     } else {
         retval = true;
@@ -127,9 +162,50 @@ bool do_one_test(PhoneticLookup<1, 1> * pinyin_lookup,
     return retval;
 }
 
+/* run all the tests with one nstore and nbest,
+   print the throughput and the correction rate. */
+template <gint32 nstore, gint32 nbest>
+bool run_benchmark(gfloat lambda,
+                   FacadeChewingTable2 * largetable,
+                   FacadePhraseIndex * phrase_index,
+                   Bigram * system_bigram, Bigram * user_bigram,
+                   GPtrArray * tests) {
+    PhoneticLookup<nstore, nbest> pinyin_lookup
+        (lambda, largetable, phrase_index, system_bigram, user_bigram);
+    pinyin_lookup.set_exact_scoring(exact_scoring);
+
+    size_t passed_count = 0;
+    gint64 start_time = g_get_monotonic_time();
+    for (size_t i = 0; i < tests->len; ++i) {
+        TokenVector tokens = (TokenVector) g_ptr_array_index(tests, i);
+        if (do_one_test<PhoneticLookup<nstore, nbest> >
+            (&pinyin_lookup, NULL, phrase_index, tokens))
+            passed_count ++;
+    }
+    gint64 elapsed = g_get_monotonic_time() - start_time;
+
+    parameter_t rate = passed_count / (parameter_t) tests->len;
+    printf("nstore:%d nbest:%d time:%.3fs sentences/s:%.1f "
+           "correction rate:%f\n", nstore, nbest, elapsed / 1e6,
+           tests->len / (elapsed / 1e6), rate);
+    return true;
+}
+
 int main(int argc, char * argv[]){
     const char * evals_text = "evals2.text";
 
+    setlocale(LC_ALL, "");
+
+    GError * error = NULL;
+    GOptionContext * context;
+
+    context = g_option_context_new("- evaluate the correction rate");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_print("option parsing failed:%s\n", error->message);
+        exit(EINVAL);
+    }
+
     SystemTableInfo2 system_table_info;
 
     bool retval = system_table_info.load(SYSTEM_TABLE_INFO);
@@ -159,6 +235,15 @@ int main(int argc, char * argv[]){
     PhoneticLookup<1, 1> pinyin_lookup(lambda,
                                     &largetable, &phrase_index,
                                     &system_bigram, &user_bigram);
+    pinyin_lookup.set_exact_scoring(exact_scoring);
+
+    PhoneticLookup<1, 1> * exact_lookup = NULL;
+    if (compare_scoring) {
+        exact_lookup = new PhoneticLookup<1, 1>
+            (lambda, &largetable, &phrase_index,
+             &system_bigram, &user_bigram);
+        exact_lookup->set_exact_scoring(true);
+    }
 
     /* open evals text. */
     FILE * evals_file = fopen(evals_text, "r");
@@ -167,8 +252,8 @@ int main(int argc, char * argv[]){
         exit(ENOENT);
     }
 
-    /* Evaluates the correction rate of test text documents. */
-    size_t tested_count = 0; size_t passed_count = 0;
+    /* Read the test sentences of the evals text. */
+    GPtrArray * tests = g_ptr_array_new();
     char* linebuf = NULL; size_t size = 0;
     TokenVector tokens = g_array_new(FALSE, TRUE, sizeof(phrase_token_t));
 
@@ -184,12 +269,8 @@ int main(int argc, char * argv[]){
 
         if ( null_token == token ) {
             if ( tokens->len ) { /* one test. */
-                if ( do_one_test(&pinyin_lookup, &phrase_index, tokens) ) {
-                    tested_count ++; passed_count ++;
-                } else {
-                    tested_count ++;
-                }
-                g_array_set_size(tokens, 0);
+                g_ptr_array_add(tests, tokens);
+                tokens = g_array_new(FALSE, TRUE, sizeof(phrase_token_t));
             }
         } else {
             g_array_append_val(tokens, token);
@@ -197,7 +278,34 @@ int main(int argc, char * argv[]){
     }
 
     if ( tokens->len ) { /* one test. */
-        if ( do_one_test(&pinyin_lookup, &phrase_index, tokens) ) {
+        g_ptr_array_add(tests, tokens);
+        tokens = NULL;
+    }
+
+    if (benchmark) {
+        /* the larger nstore keeps more paths in each trellis node. */
+        run_benchmark<1, 1>(lambda, &largetable, &phrase_index,
+                            &system_bigram, &user_bigram, tests);
+        run_benchmark<2, 3>(lambda, &largetable, &phrase_index,
+                            &system_bigram, &user_bigram, tests);
+        run_benchmark<4, 4>(lambda, &largetable, &phrase_index,
+                            &system_bigram, &user_bigram, tests);
+        run_benchmark<8, 8>(lambda, &largetable, &phrase_index,
+                            &system_bigram, &user_bigram, tests);
+        run_benchmark<16, 16>(lambda, &largetable, &phrase_index,
+                              &system_bigram, &user_bigram, tests);
+        run_benchmark<32, 32>(lambda, &largetable, &phrase_index,
+                              &system_bigram, &user_bigram, tests);
+        run_benchmark<64, 64>(lambda, &largetable, &phrase_index,
+                              &system_bigram, &user_bigram, tests);
+    }
+
+    /* Evaluates the correction rate of test text documents. */
+    size_t tested_count = 0; size_t passed_count = 0;
+    for (size_t i = 0; i < tests->len; ++i) {
+        TokenVector tokens = (TokenVector) g_ptr_array_index(tests, i);
+        if ( do_one_test(&pinyin_lookup, exact_lookup,
+                         &phrase_index, tokens) ) {
             tested_count ++; passed_count ++;
         } else {
             tested_count ++;
@@ -207,7 +315,17 @@ int main(int argc, char * argv[]){
     parameter_t rate = passed_count / (parameter_t) tested_count;
     printf("correction rate:%f\n", rate);
 
-    g_array_free(tokens, TRUE);
+    if (exact_lookup) {
+        printf("mismatched with the exact scoring:%zu of %zu\n",
+               mismatched_count, tested_count);
+        delete exact_lookup;
+    }
+
+    for (size_t i = 0; i < tests->len; ++i)
+        g_array_free((TokenVector) g_ptr_array_index(tests, i), TRUE);
+    g_ptr_array_free(tests, TRUE);
+    if (tokens)
+        g_array_free(tokens, TRUE);
     fclose(evals_file);
     free(linebuf);
 